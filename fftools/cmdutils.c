@@ -134,6 +134,7 @@ void exit_program(int ret)
     if (program_exit)
         program_exit(ret);
 
+    av_log_flush();
     exit(ret);
 }
 
@@ -897,6 +898,13 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
                 flags |= AV_LOG_PRINT_LEVEL;
             }
             arg = token + 5;
+        } else if (!strncmp(token, "async", 5)) {
+            if (cmd == '-') {
+                flags &= ~AV_LOG_ASYNC;
+            } else {
+                flags |= AV_LOG_ASYNC;
+            }
+            arg = token + 5;
         } else {
             break;
         }
@@ -130,6 +130,11 @@ static void do_video_stats(OutputStream *ost, int frame_size);
 static BenchmarkTimeStamps get_benchmark_time_stamps(void);
 static int64_t getmaxrss(void);
 static int ifilter_has_all_input_formats(FilterGraph *fg);
+#if HAVE_THREADS
+static void free_encoder_thread(OutputStream *ost);
+static void free_filter_thread(FilterGraph *fg);
+static void free_decoder_thread(InputStream *ist);
+#endif
 
 static int run_as_daemon  = 0;
 static int nb_frames_dup = 0;
@@ -523,6 +528,9 @@ static void ffmpeg_cleanup(int ret)
 
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
+#if HAVE_THREADS
+        free_filter_thread(fg);
+#endif
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             InputFilter *ifilter = fg->inputs[j];
@@ -588,6 +596,11 @@ static void ffmpeg_cleanup(int ret)
         if (!ost)
             continue;
 
+#if HAVE_THREADS
+        free_encoder_thread(ost);
+#endif
+        chunks_uninit(ost);
+
         av_bsf_free(&ost->bsf_ctx);
 
         av_frame_free(&ost->filtered_frame);
@@ -631,6 +644,9 @@ static void ffmpeg_cleanup(int ret)
     for (i = 0; i < nb_input_streams; i++) {
         InputStream *ist = input_streams[i];
 
+#if HAVE_THREADS
+        free_decoder_thread(ist);
+#endif
         av_frame_free(&ist->decoded_frame);
         av_frame_free(&ist->filter_frame);
         av_packet_free(&ist->pkt);
@@ -717,6 +733,18 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+/* measure the time spent in a stage with -stage_stats */
+static int64_t stage_time_start(void)
+{
+    return stage_stats ? av_gettime_relative() : 0;
+}
+
+static void stage_time_end(int64_t *total, int64_t start)
+{
+    if (stage_stats)
+        *total += av_gettime_relative() - start;
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
@@ -730,6 +758,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
+    int64_t mux_start;
     int ret;
 
     /*
@@ -863,7 +892,9 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
+    mux_start = stage_time_start();
     ret = av_interleaved_write_frame(s, pkt);
+    stage_time_end(&ost->mux_time, mux_start);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
@@ -1001,11 +1032,246 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     return ret;
 }
 
+#if HAVE_THREADS
+static int enc_thread_queue_packet(OutputStream *ost, AVPacket *pkt)
+{
+    AVPacket *queue_pkt;
+    int ret = 0;
+
+    queue_pkt = av_packet_alloc();
+    if (!queue_pkt)
+        return AVERROR(ENOMEM);
+    av_packet_move_ref(queue_pkt, pkt);
+
+    pthread_mutex_lock(&ost->enc_pkt_lock);
+    if (!av_fifo_space(ost->enc_pkt_queue))
+        ret = av_fifo_realloc2(ost->enc_pkt_queue,
+                               2 * av_fifo_size(ost->enc_pkt_queue));
+    if (ret >= 0)
+        av_fifo_generic_write(ost->enc_pkt_queue, &queue_pkt, sizeof(queue_pkt), NULL);
+    pthread_mutex_unlock(&ost->enc_pkt_lock);
+
+    if (ret < 0)
+        av_packet_free(&queue_pkt);
+    return ret;
+}
+
+/*
+ * Encoder thread: feed the frames queued by the main thread to the encoder
+ * and hand the resulting packets back through enc_pkt_queue. Timestamp
+ * rescaling and muxing stay on the main thread, as the muxing time base may
+ * still change until the output file header is written.
+ * When the frame queue reports EOF the encoder is flushed and the thread exits.
+ */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    const char *desc = enc->codec_type == AVMEDIA_TYPE_VIDEO ? "video" : "audio";
+    AVPacket *pkt;
+    AVFrame *frame;
+    int64_t frame_pts, enc_start;
+    int ret;
+
+    pkt = av_packet_alloc();
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    while (1) {
+        ret = av_thread_message_queue_recv(ost->enc_thread_queue, &frame, 0);
+        if (ret == AVERROR_EOF)
+            frame = NULL;
+        else if (ret < 0)
+            break;
+
+        frame_pts = frame ? frame->pts : AV_NOPTS_VALUE;
+        enc_start = stage_time_start();
+        ret = avcodec_send_frame(enc, frame);
+        av_frame_free(&frame);
+        if (ret < 0)
+            break;
+
+        while (1) {
+            ret = avcodec_receive_packet(enc, pkt);
+            if (stage_stats) {
+                pthread_mutex_lock(&ost->enc_pkt_lock);
+                stage_time_end(&ost->encode_time, enc_start);
+                pthread_mutex_unlock(&ost->enc_pkt_lock);
+                enc_start = stage_time_start();
+            }
+            if (ret < 0)
+                break;
+
+            if (debug_ts) {
+                av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                       desc,
+                       av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+                       av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+            }
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt->pts = frame_pts;
+
+            /* if two pass, output log */
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            ret = enc_thread_queue_packet(ost, pkt);
+            if (ret < 0)
+                break;
+        }
+        if (ret != AVERROR(EAGAIN))
+            break;
+    }
+
+finish:
+    if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR_EXIT) {
+        av_log(NULL, AV_LOG_ERROR, "%s encoding failed for output stream #%d:%d: %s\n",
+               desc, ost->file_index, ost->index, av_err2str(ret));
+        av_thread_message_queue_set_err_send(ost->enc_thread_queue, ret);
+    }
+    av_packet_free(&pkt);
+    ost->enc_thread_ret = ret;
+    return NULL;
+}
+
+static void enc_thread_frame_free(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    ost->enc_pkt_queue = av_fifo_alloc(8 * sizeof(AVPacket*));
+    if (!ost->enc_pkt_queue)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&ost->enc_thread_queue,
+                                        ost->enc_thread_queue_size, sizeof(AVFrame*));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ost->enc_thread_queue, enc_thread_frame_free);
+
+    if ((ret = pthread_mutex_init(&ost->enc_pkt_lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&ost->enc_pkt_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&ost->enc_thread_queue);
+    av_fifo_freep(&ost->enc_pkt_queue);
+    return ret;
+}
+
+static int enc_thread_send_frame(OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *queue_frame;
+    int ret;
+
+    queue_frame = av_frame_clone(frame);
+    if (!queue_frame)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_send(ost->enc_thread_queue, &queue_frame, 0);
+    if (ret < 0)
+        av_frame_free(&queue_frame);
+    return ret;
+}
+
+/*
+ * Mux all packets the encoder thread has produced so far.
+ */
+static void enc_thread_reap_packets(OutputFile *of, OutputStream *ost)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket *pkt;
+    int pkt_size;
+
+    while (1) {
+        pthread_mutex_lock(&ost->enc_pkt_lock);
+        if (av_fifo_size(ost->enc_pkt_queue) < sizeof(pkt)) {
+            pthread_mutex_unlock(&ost->enc_pkt_lock);
+            break;
+        }
+        av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+        pthread_mutex_unlock(&ost->enc_pkt_lock);
+
+        if (ost->finished & MUXER_FINISHED) {
+            av_packet_free(&pkt);
+            continue;
+        }
+
+        av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+        pkt_size = pkt->size;
+        output_packet(of, pkt, ost, 0);
+        av_packet_free(&pkt);
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename)
+            do_video_stats(ost, pkt_size);
+    }
+}
+
+/*
+ * Signal EOF to the encoder thread, wait for it to drain the encoder and
+ * mux the remaining packets.
+ */
+static void flush_encoder_thread(OutputFile *of, OutputStream *ost)
+{
+    av_thread_message_queue_set_err_recv(ost->enc_thread_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_thread_queue);
+
+    enc_thread_reap_packets(of, ost);
+    if (ost->enc_thread_ret < 0 && ost->enc_thread_ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_FATAL, "Encoding failed: %s\n",
+               av_err2str(ost->enc_thread_ret));
+        exit_program(1);
+    }
+
+    av_packet_unref(ost->pkt);
+    output_packet(of, ost->pkt, ost, 1);
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    if (ost->enc_thread_queue) {
+        av_thread_message_queue_set_err_recv(ost->enc_thread_queue, AVERROR_EXIT);
+        av_thread_message_flush(ost->enc_thread_queue);
+        pthread_join(ost->enc_thread, NULL);
+        av_thread_message_queue_free(&ost->enc_thread_queue);
+    }
+    if (ost->enc_pkt_queue) {
+        while (av_fifo_size(ost->enc_pkt_queue)) {
+            AVPacket *pkt;
+            av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+            av_packet_free(&pkt);
+        }
+        av_fifo_freep(&ost->enc_pkt_queue);
+        pthread_mutex_destroy(&ost->enc_pkt_lock);
+    }
+}
+#endif
+
 static void do_audio_out(OutputFile *of, OutputStream *ost,
                          AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket *pkt = ost->pkt;
+    int64_t enc_start;
     int ret;
 
     adjust_frame_pts_to_encoder_tb(of, ost, frame);
@@ -1027,13 +1293,27 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_THREADS
+    if (ost->enc_thread_queue) {
+        ret = enc_thread_send_frame(ost, frame);
+        if (ret < 0)
+            goto error;
+        enc_thread_reap_packets(of, ost);
+        return;
+    }
+#endif
+
+    enc_start = stage_time_start();
     ret = avcodec_send_frame(enc, frame);
+    stage_time_end(&ost->encode_time, enc_start);
     if (ret < 0)
         goto error;
 
     while (1) {
         av_packet_unref(pkt);
+        enc_start = stage_time_start();
         ret = avcodec_receive_packet(enc, pkt);
+        stage_time_end(&ost->encode_time, enc_start);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -1155,6 +1435,7 @@ static void do_video_out(OutputFile *of,
     double duration = 0;
     double sync_ipts = AV_NOPTS_VALUE;
     int frame_size = 0;
+    int64_t enc_start;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
 
@@ -1364,15 +1645,31 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+        enc_start = stage_time_start();
+#if HAVE_THREADS
+        if (ost->enc_thread_queue)
+            ret = enc_thread_send_frame(ost, in_picture);
+        else
+#endif
+        {
+            ret = avcodec_send_frame(enc, in_picture);
+            stage_time_end(&ost->encode_time, enc_start);
+        }
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
+#if HAVE_THREADS
+        if (ost->enc_thread_queue)
+            enc_thread_reap_packets(of, ost);
+        else
+#endif
         while (1) {
             av_packet_unref(pkt);
+            enc_start = stage_time_start();
             ret = avcodec_receive_packet(enc, pkt);
+            stage_time_end(&ost->encode_time, enc_start);
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
                 break;
@@ -1493,96 +1790,415 @@ static void finish_output_stream(OutputStream *ost)
     }
 }
 
-/**
- * Get and encode new output from any of the filtergraphs, without causing
- * activity.
- *
- * @return  0 for success, <0 for severe errors
+#if HAVE_THREADS
+/* frame sent to a filtergraph thread, or EOF if frame is NULL */
+typedef struct FilterThreadMessage {
+    AVFrame *frame;
+    int64_t eof_pts;
+} FilterThreadMessage;
+
+/*
+ * Move the frames available in the buffersink of a threaded filtergraph to
+ * its output queue. Returns AVERROR(EAGAIN) once the buffersink is empty.
  */
-static int reap_filters(int flush)
+static int filter_thread_reap(FilterGraph *fg)
 {
-    AVFrame *filtered_frame = NULL;
-    int i;
-
-    /* Reap all buffers present in the buffer sinks */
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
-        OutputFile    *of = output_files[ost->file_index];
-        AVFilterContext *filter;
-        AVCodecContext *enc = ost->enc_ctx;
-        int ret = 0;
+    AVFilterContext *sink = fg->outputs[0]->filter;
+    AVFrame *frame;
+    int ret;
 
-        if (!ost->filter || !ost->filter->graph->graph)
-            continue;
-        filter = ost->filter->filter;
+    while (1) {
+        frame = av_frame_alloc();
+        if (!frame)
+            return AVERROR(ENOMEM);
 
-        /*
-         * Unlike video, with audio the audio frame size matters.
-         * Currently we are fully reliant on the lavfi filter chain to
-         * do the buffering deed for us, and thus the frame size parameter
-         * needs to be set accordingly. Where does one get the required
-         * frame size? From the initialized AVCodecContext of an audio
-         * encoder. Thus, if we have gotten to an audio stream, initialize
-         * the encoder earlier than receiving the first AVFrame.
-         */
-        if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_AUDIO)
-            init_output_stream_wrapper(ost, NULL, 1);
+        ret = av_buffersink_get_frame_flags(sink, frame, AV_BUFFERSINK_FLAG_NO_REQUEST);
+        if (ret < 0) {
+            av_frame_free(&frame);
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                av_log(NULL, AV_LOG_WARNING,
+                       "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
+                ret = AVERROR(EAGAIN);
+            }
+            return ret;
+        }
 
-        if (!ost->pkt && !(ost->pkt = av_packet_alloc())) {
-            return AVERROR(ENOMEM);
+        pthread_mutex_lock(&fg->thread_lock);
+        if (!av_fifo_space(fg->thread_out_queue))
+            ret = av_fifo_realloc2(fg->thread_out_queue,
+                                   2 * av_fifo_size(fg->thread_out_queue));
+        if (ret >= 0) {
+            av_fifo_generic_write(fg->thread_out_queue, &frame, sizeof(frame), NULL);
+            pthread_cond_broadcast(&fg->thread_cond);
         }
-        if (!ost->filtered_frame && !(ost->filtered_frame = av_frame_alloc())) {
-            return AVERROR(ENOMEM);
+        pthread_mutex_unlock(&fg->thread_lock);
+
+        if (ret < 0) {
+            av_frame_free(&frame);
+            return ret;
         }
-        filtered_frame = ost->filtered_frame;
+    }
+}
 
-        while (1) {
-            ret = av_buffersink_get_frame_flags(filter, filtered_frame,
-                                               AV_BUFFERSINK_FLAG_NO_REQUEST);
-            if (ret < 0) {
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
-                    av_log(NULL, AV_LOG_WARNING,
-                           "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
-                } else if (flush && ret == AVERROR_EOF) {
-                    if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
-                        do_video_out(of, ost, NULL);
-                }
-                break;
-            }
-            if (ost->finished) {
-                av_frame_unref(filtered_frame);
-                continue;
-            }
+/*
+ * Run the graph the way transcode_from_filter() does, until it needs more
+ * input or is finished.
+ */
+static int filter_thread_run(FilterGraph *fg, int input_eof)
+{
+    int ret;
 
-            switch (av_buffersink_get_type(filter)) {
-            case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+    while (1) {
+        ret = filter_thread_reap(fg);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret != AVERROR(EAGAIN))
+            return ret;
 
-                do_video_out(of, ost, filtered_frame);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
-                    enc->channels != filtered_frame->channels) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
-            }
+        ret = avfilter_graph_request_oldest(fg->graph);
+        if (ret >= 0)
+            continue;
+        if (ret == AVERROR(EAGAIN) && !input_eof)
+            return 0;
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            return ret;
 
-            av_frame_unref(filtered_frame);
-        }
+        ret = filter_thread_reap(fg);
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            return ret;
+        break;
     }
 
+    pthread_mutex_lock(&fg->thread_lock);
+    fg->thread_sink_eof = 1;
+    pthread_cond_broadcast(&fg->thread_cond);
+    pthread_mutex_unlock(&fg->thread_lock);
     return 0;
 }
 
-static void print_final_stats(int64_t total_size)
+/*
+ * Filtergraph thread: push the frames sent by the main thread into the
+ * graph and queue its output for the encoders. The graph is only touched
+ * with graph_lock held, so that the main thread can use it in between.
+ */
+static void *filter_thread(void *arg)
+{
+    FilterGraph *fg = arg;
+    FilterThreadMessage msg;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(fg->thread_queue, &msg, 0)) >= 0) {
+        InputFilter *ifilter = fg->inputs[0];
+
+        pthread_mutex_lock(&fg->graph_lock);
+        if (msg.frame) {
+            ret = av_buffersrc_add_frame_flags(ifilter->filter, msg.frame,
+                                               AV_BUFFERSRC_FLAG_PUSH);
+            av_frame_free(&msg.frame);
+            /* frames sent after the graph has finished are dropped, as in
+             * send_frame_to_filters() */
+            if (ret == AVERROR_EOF)
+                ret = 0;
+            else if (ret < 0)
+                av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
+            if (ret >= 0)
+                ret = filter_thread_run(fg, 0);
+        } else {
+            ret = av_buffersrc_close(ifilter->filter, msg.eof_pts, AV_BUFFERSRC_FLAG_PUSH);
+            if (ret >= 0)
+                ret = filter_thread_run(fg, 1);
+        }
+        pthread_mutex_unlock(&fg->graph_lock);
+
+        pthread_mutex_lock(&fg->thread_lock);
+        fg->nb_thread_done++;
+        if (ret < 0)
+            fg->thread_ret = ret;
+        pthread_cond_broadcast(&fg->thread_cond);
+        pthread_mutex_unlock(&fg->thread_lock);
+
+        if (ret < 0)
+            break;
+    }
+
+    av_thread_message_queue_set_err_send(fg->thread_queue, ret);
+    return NULL;
+}
+
+static void filter_thread_message_free(void *msg)
+{
+    FilterThreadMessage *m = msg;
+    av_frame_free(&m->frame);
+}
+
+/*
+ * Only simple audio and video filtergraphs run in a thread; their output
+ * goes to a single encoder and does not depend on other inputs. With
+ * -shortest, where the other streams are cut would depend on the timing of
+ * the thread.
+ */
+static int filter_thread_supported(FilterGraph *fg)
+{
+    OutputStream *ost;
+
+    if (!filtergraph_is_simple(fg) || fg->nb_inputs != 1 || fg->nb_outputs != 1)
+        return 0;
+    ost = fg->outputs[0]->ost;
+    return (ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+            ost->st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) &&
+           !ost->chunks && !output_files[ost->file_index]->shortest;
+}
+
+static int init_filter_thread(FilterGraph *fg)
+{
+    OutputStream *ost = fg->outputs[0]->ost;
+    int ret;
+
+    /* the audio encoder sets the buffersink frame size, which must not
+     * change under the thread */
+    if (ost->st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        init_output_stream_wrapper(ost, NULL, 1);
+
+    fg->thread_out_queue = av_fifo_alloc(8 * sizeof(AVFrame*));
+    if (!fg->thread_out_queue)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&fg->thread_queue, fg->thread_queue_size,
+                                        sizeof(FilterThreadMessage));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(fg->thread_queue, filter_thread_message_free);
+
+    fg->nb_thread_sent  = 0;
+    fg->nb_thread_done  = 0;
+    fg->thread_sink_eof = 0;
+    fg->thread_ret      = 0;
+    pthread_mutex_init(&fg->graph_lock, NULL);
+    pthread_mutex_init(&fg->thread_lock, NULL);
+    pthread_cond_init(&fg->thread_cond, NULL);
+
+    if ((ret = pthread_create(&fg->thread, NULL, filter_thread, fg))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&fg->graph_lock);
+        pthread_mutex_destroy(&fg->thread_lock);
+        pthread_cond_destroy(&fg->thread_cond);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&fg->thread_queue);
+    av_fifo_freep(&fg->thread_out_queue);
+    return ret;
+}
+
+/* Send a frame, or EOF if frame is NULL, to a filtergraph thread. */
+static int filter_thread_send(FilterGraph *fg, AVFrame *frame, int64_t eof_pts)
+{
+    FilterThreadMessage msg = { 0 };
+    int ret;
+
+    if (frame) {
+        msg.frame = av_frame_alloc();
+        if (!msg.frame)
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(msg.frame, frame);
+    } else {
+        msg.eof_pts = eof_pts;
+    }
+
+    pthread_mutex_lock(&fg->thread_lock);
+    fg->nb_thread_sent++;
+    pthread_mutex_unlock(&fg->thread_lock);
+
+    ret = av_thread_message_queue_send(fg->thread_queue, &msg, 0);
+    if (ret < 0) {
+        av_frame_free(&msg.frame);
+        pthread_mutex_lock(&fg->thread_lock);
+        fg->nb_thread_sent--;
+        pthread_mutex_unlock(&fg->thread_lock);
+    }
+    return ret;
+}
+
+/*
+ * Get a frame from the output queue of a filtergraph thread. With wait set,
+ * wait for the thread to process all the frames sent to it first, so that
+ * no output that the graph would produce without more input is missed.
+ */
+static int filter_thread_get_frame(FilterGraph *fg, AVFrame *frame, int wait)
+{
+    AVFrame *queued;
+    int ret;
+
+    pthread_mutex_lock(&fg->thread_lock);
+    while (wait && !av_fifo_size(fg->thread_out_queue) && !fg->thread_ret &&
+           !fg->thread_sink_eof && fg->nb_thread_done < fg->nb_thread_sent)
+        pthread_cond_wait(&fg->thread_cond, &fg->thread_lock);
+
+    if (av_fifo_size(fg->thread_out_queue)) {
+        av_fifo_generic_read(fg->thread_out_queue, &queued, sizeof(queued), NULL);
+        ret = 0;
+    } else if (fg->thread_ret < 0) {
+        ret = fg->thread_ret;
+    } else {
+        ret = fg->thread_sink_eof ? AVERROR_EOF : AVERROR(EAGAIN);
+    }
+    pthread_mutex_unlock(&fg->thread_lock);
+
+    if (ret >= 0) {
+        av_frame_move_ref(frame, queued);
+        av_frame_free(&queued);
+    }
+    return ret;
+}
+
+static void free_filter_thread(FilterGraph *fg)
+{
+    if (!fg->thread_queue)
+        return;
+
+    av_thread_message_queue_set_err_recv(fg->thread_queue, AVERROR_EXIT);
+    av_thread_message_flush(fg->thread_queue);
+    pthread_join(fg->thread, NULL);
+    av_thread_message_queue_free(&fg->thread_queue);
+
+    while (av_fifo_size(fg->thread_out_queue)) {
+        AVFrame *frame;
+        av_fifo_generic_read(fg->thread_out_queue, &frame, sizeof(frame), NULL);
+        av_frame_free(&frame);
+    }
+    av_fifo_freep(&fg->thread_out_queue);
+    pthread_mutex_destroy(&fg->graph_lock);
+    pthread_mutex_destroy(&fg->thread_lock);
+    pthread_cond_destroy(&fg->thread_cond);
+}
+#endif
+
+/* Lock the graph of a filtergraph against its thread, if it has one. */
+static void filter_graph_lock(FilterGraph *fg)
+{
+#if HAVE_THREADS
+    if (fg->thread_queue)
+        pthread_mutex_lock(&fg->graph_lock);
+#endif
+}
+
+static void filter_graph_unlock(FilterGraph *fg)
+{
+#if HAVE_THREADS
+    if (fg->thread_queue)
+        pthread_mutex_unlock(&fg->graph_lock);
+#endif
+}
+
+/**
+ * Get and encode new output from any of the filtergraphs, without causing
+ * activity.
+ *
+ * @return  0 for success, <0 for severe errors
+ */
+static int reap_filters(int flush)
+{
+    AVFrame *filtered_frame = NULL;
+    int i;
+
+    /* Reap all buffers present in the buffer sinks */
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        OutputFile    *of = output_files[ost->file_index];
+        AVFilterContext *filter;
+        AVCodecContext *enc = ost->enc_ctx;
+        int ret = 0;
+
+#if HAVE_THREADS
+        if (ost->enc_thread_queue)
+            enc_thread_reap_packets(of, ost);
+#endif
+
+        if (!ost->filter || !ost->filter->graph->graph)
+            continue;
+        filter = ost->filter->filter;
+
+        /*
+         * Unlike video, with audio the audio frame size matters.
+         * Currently we are fully reliant on the lavfi filter chain to
+         * do the buffering deed for us, and thus the frame size parameter
+         * needs to be set accordingly. Where does one get the required
+         * frame size? From the initialized AVCodecContext of an audio
+         * encoder. Thus, if we have gotten to an audio stream, initialize
+         * the encoder earlier than receiving the first AVFrame.
+         */
+        if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_AUDIO)
+            init_output_stream_wrapper(ost, NULL, 1);
+
+        if (!ost->pkt && !(ost->pkt = av_packet_alloc())) {
+            return AVERROR(ENOMEM);
+        }
+        if (!ost->filtered_frame && !(ost->filtered_frame = av_frame_alloc())) {
+            return AVERROR(ENOMEM);
+        }
+        filtered_frame = ost->filtered_frame;
+
+        while (1) {
+#if HAVE_THREADS
+            if (ost->filter->graph->thread_queue)
+                ret = filter_thread_get_frame(ost->filter->graph, filtered_frame, flush);
+            else
+#endif
+            ret = av_buffersink_get_frame_flags(filter, filtered_frame,
+                                               AV_BUFFERSINK_FLAG_NO_REQUEST);
+            if (ret < 0) {
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                    av_log(NULL, AV_LOG_WARNING,
+                           "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
+                } else if (flush && ret == AVERROR_EOF) {
+                    if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
+                        do_video_out(of, ost, NULL);
+                }
+                break;
+            }
+            if (ost->finished) {
+                av_frame_unref(filtered_frame);
+                continue;
+            }
+
+            switch (av_buffersink_get_type(filter)) {
+            case AVMEDIA_TYPE_VIDEO: {
+                int enc_thread = 0;
+#if HAVE_THREADS
+                /* the encoder context belongs to the encoder thread once it runs */
+                enc_thread = !!ost->enc_thread_queue;
+#endif
+                if (!ost->frame_aspect_ratio.num && !enc_thread)
+                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+
+                do_video_out(of, ost, filtered_frame);
+                break;
+            }
+            case AVMEDIA_TYPE_AUDIO:
+                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
+                    enc->channels != filtered_frame->channels) {
+                    av_log(NULL, AV_LOG_ERROR,
+                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+                    break;
+                }
+                do_audio_out(of, ost, filtered_frame);
+                break;
+            default:
+                // TODO support subtitle filters
+                av_assert0(0);
+            }
+
+            av_frame_unref(filtered_frame);
+        }
+    }
+
+    return 0;
+}
+
+static void print_final_stats(int64_t total_size)
 {
     uint64_t video_size = 0, audio_size = 0, extra_size = 0, other_size = 0;
     uint64_t subtitle_size = 0;
@@ -1699,6 +2315,106 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_json_str(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            av_bprintf(bp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            av_bprintf(bp, "\\u%04x", *str);
+        else
+            av_bprint_chars(bp, *str, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+/**
+ * Print the time spent in each stage of the transcoding, as a single line
+ * JSON object. Times are in microseconds; the filter times are reset when a
+ * filtergraph is reconfigured.
+ */
+static void print_stage_stats(AVBPrint *bp)
+{
+    int i, j;
+
+    av_bprintf(bp, "{\"inputs\":[");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+        int queue_depth = 0, queue_size = 0;
+
+#if HAVE_THREADS
+        if (f->in_thread_queue) {
+            queue_depth = av_thread_message_queue_nb_elems(f->in_thread_queue);
+            queue_size  = f->thread_queue_size;
+        }
+#endif
+        av_bprintf(bp, "%s{\"file\":%d,\"demux_wait_us\":%"PRId64","
+                   "\"queue_depth\":%d,\"queue_size\":%d,\"streams\":[",
+                   i ? "," : "", i, f->demux_time, queue_depth, queue_size);
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+
+            av_bprintf(bp, "%s{\"index\":%d,\"packets\":%"PRIu64","
+                       "\"frames\":%"PRIu64",\"decode_us\":%"PRId64"}",
+                       j ? "," : "", ist->st->index, ist->nb_packets,
+                       ist->frames_decoded, ist->decode_time);
+        }
+        av_bprintf(bp, "]}");
+    }
+
+    av_bprintf(bp, "],\"filtergraphs\":[");
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        AVFilterGraph *graph = fg->graph;
+
+        av_bprintf(bp, "%s{\"index\":%d,\"filters\":[", i ? "," : "", i);
+        filter_graph_lock(fg);
+        for (j = 0; graph && j < graph->nb_filters; j++) {
+            AVFilterContext *filter = graph->filters[j];
+
+            av_bprintf(bp, "%s{\"name\":", j ? "," : "");
+            print_json_str(bp, filter->name);
+            av_bprintf(bp, ",\"filter\":\"%s\",\"time_us\":%"PRId64"}",
+                       filter->filter->name, filter->processing_time);
+        }
+        filter_graph_unlock(fg);
+        av_bprintf(bp, "]}");
+    }
+
+    av_bprintf(bp, "],\"outputs\":[");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        av_bprintf(bp, "%s{\"file\":%d,\"streams\":[", i ? "," : "", i);
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            OutputStream *ost = output_streams[of->ost_index + j];
+            int64_t encode_time = ost->encode_time;
+            int enc_queue_depth = 0;
+
+#if HAVE_THREADS
+            if (ost->enc_thread_queue) {
+                enc_queue_depth = av_thread_message_queue_nb_elems(ost->enc_thread_queue);
+                pthread_mutex_lock(&ost->enc_pkt_lock);
+                encode_time = ost->encode_time;
+                pthread_mutex_unlock(&ost->enc_pkt_lock);
+            }
+#endif
+            av_bprintf(bp, "%s{\"index\":%d,\"frames\":%"PRIu64","
+                       "\"packets\":%"PRIu64",\"encode_us\":%"PRId64","
+                       "\"mux_us\":%"PRId64",\"encoder_queue_depth\":%d,"
+                       "\"muxing_queue_depth\":%d}",
+                       j ? "," : "", ost->index, ost->frames_encoded,
+                       ost->packets_written, encode_time, ost->mux_time,
+                       enc_queue_depth,
+                       ost->muxing_queue ?
+                       (int)(av_fifo_size(ost->muxing_queue) / sizeof(AVPacket*)) : 0);
+        }
+        av_bprintf(bp, "]}");
+    }
+    av_bprintf(bp, "]}");
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1742,7 +2458,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
-    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_UNLIMITED);
     for (i = 0; i < nb_output_streams; i++) {
         float q = -1;
         ost = output_streams[i];
@@ -1890,18 +2606,23 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprint_finalize(&buf, NULL);
 
     if (progress_avio) {
+        if (stage_stats) {
+            av_bprintf(&buf_script, "stage_stats=");
+            print_stage_stats(&buf_script);
+            av_bprintf(&buf_script, "\n");
+        }
         av_bprintf(&buf_script, "progress=%s\n",
                    is_last_report ? "end" : "continue");
         avio_write(progress_avio, buf_script.str,
                    FFMIN(buf_script.len, buf_script.size - 1));
         avio_flush(progress_avio);
-        av_bprint_finalize(&buf_script, NULL);
         if (is_last_report) {
             if ((ret = avio_closep(&progress_avio)) < 0)
                 av_log(NULL, AV_LOG_ERROR,
                        "Error closing progress log, loss of information possible: %s\n", av_err2str(ret));
         }
     }
+    av_bprint_finalize(&buf_script, NULL);
 
     first_report = 0;
 
@@ -1969,9 +2690,17 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_thread_queue) {
+            flush_encoder_thread(of, ost);
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket *pkt = ost->pkt;
+            int64_t enc_start;
             int pkt_size;
 
             switch (enc->codec_type) {
@@ -1988,6 +2717,7 @@ static void flush_encoders(void)
             update_benchmark(NULL);
 
             av_packet_unref(pkt);
+            enc_start = stage_time_start();
             while ((ret = avcodec_receive_packet(enc, pkt)) == AVERROR(EAGAIN)) {
                 ret = avcodec_send_frame(enc, NULL);
                 if (ret < 0) {
@@ -1997,6 +2727,7 @@ static void flush_encoders(void)
                     exit_program(1);
                 }
             }
+            stage_time_end(&ost->encode_time, enc_start);
 
             update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
             if (ret < 0 && ret != AVERROR_EOF) {
@@ -2238,6 +2969,16 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+#if HAVE_THREADS
+    if (fg->thread_queue_size && !fg->thread_queue) {
+        ret = init_filter_thread(fg);
+        if (ret < 0)
+            return ret;
+    }
+    if (fg->thread_queue)
+        return filter_thread_send(fg, frame, AV_NOPTS_VALUE);
+#endif
+
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
@@ -2255,6 +2996,10 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
     ifilter->eof = 1;
 
     if (ifilter->filter) {
+#if HAVE_THREADS
+        if (ifilter->graph->thread_queue)
+            return filter_thread_send(ifilter->graph, NULL, pts);
+#endif
         ret = av_buffersrc_close(ifilter->filter, pts, AV_BUFFERSRC_FLAG_PUSH);
         if (ret < 0)
             return ret;
@@ -2298,6 +3043,46 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
     return 0;
 }
 
+static void get_decoder_state(DecoderState *state, const AVCodecContext *avctx)
+{
+    state->width                  = avctx->width;
+    state->height                 = avctx->height;
+    state->pix_fmt                = avctx->pix_fmt;
+    state->sample_rate            = avctx->sample_rate;
+    state->has_b_frames           = avctx->has_b_frames;
+    state->framerate              = avctx->framerate;
+    state->ticks_per_frame        = avctx->ticks_per_frame;
+    state->chroma_sample_location = avctx->chroma_sample_location;
+    state->bits_per_raw_sample    = avctx->bits_per_raw_sample;
+}
+
+#if HAVE_THREADS
+static int dec_thread_receive_frame(InputStream *ist, AVFrame *frame, int *got_frame);
+#endif
+
+/*
+ * Make the next decode() call for the stream and update ist->dec_state.
+ * With a decoder thread, the call has already been made by the thread and
+ * only its result is picked up.
+ */
+static int decode_frame(InputStream *ist, AVFrame *frame, int *got_frame, AVPacket *pkt)
+{
+    int64_t dec_start;
+    int ret;
+
+#if HAVE_THREADS
+    if (ist->dec_thread_queue)
+        return dec_thread_receive_frame(ist, frame, got_frame);
+#endif
+
+    dec_start = stage_time_start();
+    ret = decode(ist->dec_ctx, frame, got_frame, pkt);
+    stage_time_end(&ist->decode_time, dec_start);
+    get_decoder_state(&ist->dec_state, ist->dec_ctx);
+
+    return ret;
+}
+
 static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
 {
     int i, ret;
@@ -2328,7 +3113,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
                         int *decode_failed)
 {
     AVFrame *decoded_frame;
-    AVCodecContext *avctx = ist->dec_ctx;
+    const DecoderState *dec_state = &ist->dec_state;
     int ret, err = 0;
     AVRational decoded_frame_tb;
 
@@ -2339,13 +3124,13 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
-    ret = decode(avctx, decoded_frame, got_output, pkt);
+    ret = decode_frame(ist, decoded_frame, got_output, pkt);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
 
-    if (ret >= 0 && avctx->sample_rate <= 0) {
-        av_log(avctx, AV_LOG_ERROR, "Sample rate %d invalid\n", avctx->sample_rate);
+    if (ret >= 0 && dec_state->sample_rate <= 0) {
+        av_log(ist->dec_ctx, AV_LOG_ERROR, "Sample rate %d invalid\n", dec_state->sample_rate);
         ret = AVERROR_INVALIDDATA;
     }
 
@@ -2361,9 +3146,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     /* increment next_dts to use for the case where the input stream does not
        have timestamps or there are multiple frames in the packet */
     ist->next_pts += ((int64_t)AV_TIME_BASE * decoded_frame->nb_samples) /
-                     avctx->sample_rate;
+                     dec_state->sample_rate;
     ist->next_dts += ((int64_t)AV_TIME_BASE * decoded_frame->nb_samples) /
-                     avctx->sample_rate;
+                     dec_state->sample_rate;
 
     if (decoded_frame->pts != AV_NOPTS_VALUE) {
         decoded_frame_tb   = ist->st->time_base;
@@ -2376,8 +3161,8 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     }
     if (decoded_frame->pts != AV_NOPTS_VALUE)
         decoded_frame->pts = av_rescale_delta(decoded_frame_tb, decoded_frame->pts,
-                                              (AVRational){1, avctx->sample_rate}, decoded_frame->nb_samples, &ist->filter_in_rescale_delta_last,
-                                              (AVRational){1, avctx->sample_rate});
+                                              (AVRational){1, dec_state->sample_rate}, decoded_frame->nb_samples, &ist->filter_in_rescale_delta_last,
+                                              (AVRational){1, dec_state->sample_rate});
     ist->nb_samples = decoded_frame->nb_samples;
     err = send_frame_to_filters(ist, decoded_frame);
 
@@ -2393,6 +3178,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     int i, ret = 0, err = 0;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
+    const DecoderState *dec_state = &ist->dec_state;
 
     // With fate-indeo3-2, we're getting 0-sized packets before EOF for some
     // reason. This seems like a semi-critical bug. Don't trigger EOF, and
@@ -2422,23 +3208,23 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
-    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    ret = decode_frame(ist, decoded_frame, got_output, pkt);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
 
     // The following line may be required in some cases where there is no parser
     // or the parser does not has_b_frames correctly
-    if (ist->st->codecpar->video_delay < ist->dec_ctx->has_b_frames) {
+    if (ist->st->codecpar->video_delay < dec_state->has_b_frames) {
         if (ist->dec_ctx->codec_id == AV_CODEC_ID_H264) {
-            ist->st->codecpar->video_delay = ist->dec_ctx->has_b_frames;
+            ist->st->codecpar->video_delay = dec_state->has_b_frames;
         } else
             av_log(ist->dec_ctx, AV_LOG_WARNING,
                    "video_delay is larger in decoder than demuxer %d > %d.\n"
                    "If you want to help, upload a sample "
                    "of this file to https://streams.videolan.org/upload/ "
                    "and contact the ffmpeg-devel mailing list. (ffmpeg-devel@ffmpeg.org)\n",
-                   ist->dec_ctx->has_b_frames,
+                   dec_state->has_b_frames,
                    ist->st->codecpar->video_delay);
     }
 
@@ -2446,16 +3232,16 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
         check_decode_result(ist, got_output, ret);
 
     if (*got_output && ret >= 0) {
-        if (ist->dec_ctx->width  != decoded_frame->width ||
-            ist->dec_ctx->height != decoded_frame->height ||
-            ist->dec_ctx->pix_fmt != decoded_frame->format) {
+        if (dec_state->width  != decoded_frame->width ||
+            dec_state->height != decoded_frame->height ||
+            dec_state->pix_fmt != decoded_frame->format) {
             av_log(NULL, AV_LOG_DEBUG, "Frame parameters mismatch context %d,%d,%d != %d,%d,%d\n",
                 decoded_frame->width,
                 decoded_frame->height,
                 decoded_frame->format,
-                ist->dec_ctx->width,
-                ist->dec_ctx->height,
-                ist->dec_ctx->pix_fmt);
+                dec_state->width,
+                dec_state->height,
+                dec_state->pix_fmt);
         }
     }
 
@@ -2522,9 +3308,12 @@ static int transcode_subtitles(InputStream *ist, AVPacket *pkt, int *got_output,
 {
     AVSubtitle subtitle;
     int free_sub = 1;
+    int64_t dec_start = stage_time_start();
     int i, ret = avcodec_decode_subtitle2(ist->dec_ctx,
                                           &subtitle, got_output, pkt);
 
+    stage_time_end(&ist->decode_time, dec_start);
+
     check_decode_result(NULL, got_output, ret);
 
     if (ret < 0 || !*got_output) {
@@ -2611,21 +3400,14 @@ static int send_filter_eof(InputStream *ist)
     return 0;
 }
 
-/* pkt = NULL means EOF (needed to flush decoder buffers) */
-static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
+/*
+ * Set up the stream timestamps for a new packet. Calling it more than once
+ * for the same packet has no further effect.
+ */
+static void start_input_packet(InputStream *ist, const AVPacket *pkt)
 {
-    int ret = 0, i;
-    int repeating = 0;
-    int eof_reached = 0;
-
-    AVPacket *avpkt;
-
-    if (!ist->pkt && !(ist->pkt = av_packet_alloc()))
-        return AVERROR(ENOMEM);
-    avpkt = ist->pkt;
-
     if (!ist->saw_first_ts) {
-        ist->dts = ist->st->avg_frame_rate.num ? - ist->dec_ctx->has_b_frames * AV_TIME_BASE / av_q2d(ist->st->avg_frame_rate) : 0;
+        ist->dts = ist->st->avg_frame_rate.num ? - ist->dec_state.has_b_frames * AV_TIME_BASE / av_q2d(ist->st->avg_frame_rate) : 0;
         ist->pts = 0;
         if (pkt && pkt->pts != AV_NOPTS_VALUE && !ist->decoding_needed) {
             ist->dts += av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q);
@@ -2639,6 +3421,34 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
     if (ist->next_pts == AV_NOPTS_VALUE)
         ist->next_pts = ist->pts;
 
+    if (pkt && pkt->dts != AV_NOPTS_VALUE) {
+        ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
+        if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
+            ist->next_pts = ist->pts = ist->dts;
+    }
+}
+
+/*
+ * Decode a packet and process its output. repeat_pict points to the parser
+ * field of the same name as it was when the packet was demuxed, or is NULL
+ * when the stream has no parser.
+ * pkt = NULL means EOF (needed to flush decoder buffers).
+ */
+static int decode_packet(InputStream *ist, const AVPacket *pkt, int no_eof,
+                         const int *repeat_pict)
+{
+    int ret = 0, i;
+    int repeating = 0;
+    int eof_reached = 0;
+
+    AVPacket *avpkt;
+
+    if (!ist->pkt && !(ist->pkt = av_packet_alloc()))
+        return AVERROR(ENOMEM);
+    avpkt = ist->pkt;
+
+    start_input_packet(ist, pkt);
+
     if (pkt) {
         av_packet_unref(avpkt);
         ret = av_packet_ref(avpkt, pkt);
@@ -2646,12 +3456,6 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             return ret;
     }
 
-    if (pkt && pkt->dts != AV_NOPTS_VALUE) {
-        ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
-        if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
-            ist->next_pts = ist->pts = ist->dts;
-    }
-
     // while we have more to decode or while the decoder did output something on EOF
     while (ist->decoding_needed) {
         int64_t duration_dts = 0;
@@ -2674,11 +3478,11 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             if (!repeating || !pkt || got_output) {
                 if (pkt && pkt->duration) {
                     duration_dts = av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
-                } else if(ist->dec_ctx->framerate.num != 0 && ist->dec_ctx->framerate.den != 0) {
-                    int ticks= av_stream_get_parser(ist->st) ? av_stream_get_parser(ist->st)->repeat_pict+1 : ist->dec_ctx->ticks_per_frame;
+                } else if(ist->dec_state.framerate.num != 0 && ist->dec_state.framerate.den != 0) {
+                    int ticks= repeat_pict ? *repeat_pict + 1 : ist->dec_state.ticks_per_frame;
                     duration_dts = ((int64_t)AV_TIME_BASE *
-                                    ist->dec_ctx->framerate.den * ticks) /
-                                    ist->dec_ctx->framerate.num / ist->dec_ctx->ticks_per_frame;
+                                    ist->dec_state.framerate.den * ticks) /
+                                    ist->dec_state.framerate.num / ist->dec_state.ticks_per_frame;
                 }
 
                 if(ist->dts != AV_NOPTS_VALUE && duration_dts) {
@@ -2713,93 +3517,405 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             break;
         }
 
-        if (ret < 0) {
-            if (decode_failed) {
-                av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d: %s\n",
-                       ist->file_index, ist->st->index, av_err2str(ret));
-            } else {
-                av_log(NULL, AV_LOG_FATAL, "Error while processing the decoded "
-                       "data for stream #%d:%d\n", ist->file_index, ist->st->index);
-            }
-            if (!decode_failed || exit_on_error)
-                exit_program(1);
-            break;
-        }
+        if (ret < 0) {
+            if (decode_failed) {
+                av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d: %s\n",
+                       ist->file_index, ist->st->index, av_err2str(ret));
+            } else {
+                av_log(NULL, AV_LOG_FATAL, "Error while processing the decoded "
+                       "data for stream #%d:%d\n", ist->file_index, ist->st->index);
+            }
+            if (!decode_failed || exit_on_error)
+                exit_program(1);
+            break;
+        }
+
+        if (got_output)
+            ist->got_output = 1;
+
+        if (!got_output)
+            break;
+
+        // During draining, we might get multiple output frames in this loop.
+        // ffmpeg.c does not drain the filter chain on configuration changes,
+        // which means if we send multiple frames at once to the filters, and
+        // one of those frames changes configuration, the buffered frames will
+        // be lost. This can upset certain FATE tests.
+        // Decode only 1 frame per call on EOF to appease these FATE tests.
+        // The ideal solution would be to rewrite decoding to use the new
+        // decoding API in a better way.
+        if (!pkt)
+            break;
+
+        repeating = 1;
+    }
+
+    /* after flushing, send an EOF on all the filter inputs attached to the stream */
+    /* except when looping we need to flush but not to send an EOF */
+    if (!pkt && ist->decoding_needed && eof_reached && !no_eof) {
+        int ret = send_filter_eof(ist);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
+            exit_program(1);
+        }
+    }
+
+    /* handle stream copy */
+    if (!ist->decoding_needed && pkt) {
+        ist->dts = ist->next_dts;
+        switch (ist->dec_ctx->codec_type) {
+        case AVMEDIA_TYPE_AUDIO:
+            av_assert1(pkt->duration >= 0);
+            if (ist->dec_ctx->sample_rate) {
+                ist->next_dts += ((int64_t)AV_TIME_BASE * ist->dec_ctx->frame_size) /
+                                  ist->dec_ctx->sample_rate;
+            } else {
+                ist->next_dts += av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
+            }
+            break;
+        case AVMEDIA_TYPE_VIDEO:
+            if (ist->framerate.num) {
+                // TODO: Remove work-around for c99-to-c89 issue 7
+                AVRational time_base_q = AV_TIME_BASE_Q;
+                int64_t next_dts = av_rescale_q(ist->next_dts, time_base_q, av_inv_q(ist->framerate));
+                ist->next_dts = av_rescale_q(next_dts + 1, av_inv_q(ist->framerate), time_base_q);
+            } else if (pkt->duration) {
+                ist->next_dts += av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
+            } else if(ist->dec_ctx->framerate.num != 0) {
+                int ticks= repeat_pict ? *repeat_pict + 1 : ist->dec_ctx->ticks_per_frame;
+                ist->next_dts += ((int64_t)AV_TIME_BASE *
+                                  ist->dec_ctx->framerate.den * ticks) /
+                                  ist->dec_ctx->framerate.num / ist->dec_ctx->ticks_per_frame;
+            }
+            break;
+        }
+        ist->pts = ist->dts;
+        ist->next_pts = ist->next_dts;
+    }
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->pkt && !(ost->pkt = av_packet_alloc()))
+            exit_program(1);
+        if (ost->chunks) {
+            if (pkt && input_streams[ost->source_index] == ist && !ost->finished &&
+                chunks_send_packet(ost, pkt) < 0)
+                exit_program(1);
+            continue;
+        }
+        if (!check_output_constraints(ist, ost) || ost->encoding_needed)
+            continue;
+
+        do_streamcopy(ist, ost, pkt);
+    }
+
+    return !eof_reached;
+}
+
+#if HAVE_THREADS
+/* result of one decode() call made by the decoder thread */
+typedef struct DecoderResult {
+    AVFrame *frame;         /* decoded frame, NULL if there was none */
+    int ret;
+    DecoderState state;
+    int64_t decode_time;
+} DecoderResult;
+
+/* packet sent to the decoder thread whose output was not processed yet */
+typedef struct PendingPacket {
+    AVPacket *pkt;
+    int has_parser;
+    int repeat_pict;
+} PendingPacket;
+
+/*
+ * Make one decode() call in the decoder thread and pass its result on.
+ * Returns <0 only if the result could not be sent.
+ */
+static int dec_thread_decode(InputStream *ist, AVPacket *pkt, int *more)
+{
+    DecoderResult res = { 0 };
+    int64_t dec_start;
+    int got_frame = 0, ret;
+
+    res.frame = av_frame_alloc();
+    if (res.frame) {
+        dec_start = stage_time_start();
+        res.ret = decode(ist->dec_ctx, res.frame, &got_frame, pkt);
+        stage_time_end(&res.decode_time, dec_start);
+        if (!got_frame)
+            av_frame_free(&res.frame);
+    } else {
+        res.ret = AVERROR(ENOMEM);
+    }
+    get_decoder_state(&res.state, ist->dec_ctx);
+
+    ret = av_thread_message_queue_send(ist->dec_result_queue, &res, 0);
+    if (ret < 0) {
+        av_frame_free(&res.frame);
+        return ret;
+    }
+
+    *more = res.ret >= 0 && got_frame;
+    return 0;
+}
+
+/*
+ * Decoder thread: make the same sequence of decode() calls decode_packet()
+ * would make for each packet, ahead of the main thread. A NULL packet
+ * stands for a single call draining the decoder at EOF.
+ */
+static void *decoder_thread(void *arg)
+{
+    InputStream *ist = arg;
+    AVPacket *pkt, *drain_pkt;
+    int more, ret;
+
+    drain_pkt = av_packet_alloc();
+    if (!drain_pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    while ((ret = av_thread_message_queue_recv(ist->dec_thread_queue, &pkt, 0)) >= 0) {
+        ret = dec_thread_decode(ist, pkt ? pkt : drain_pkt, &more);
+        while (ret >= 0 && pkt && more)
+            ret = dec_thread_decode(ist, NULL, &more);
+        av_packet_free(&pkt);
+        if (ret < 0)
+            break;
+    }
+
+finish:
+    av_packet_free(&drain_pkt);
+    av_thread_message_queue_set_err_send(ist->dec_thread_queue, ret);
+    av_thread_message_queue_set_err_recv(ist->dec_result_queue, ret);
+    return NULL;
+}
+
+static void dec_thread_packet_free(void *msg)
+{
+    av_packet_free(msg);
+}
+
+static void dec_thread_result_free(void *msg)
+{
+    DecoderResult *res = msg;
+    av_frame_free(&res->frame);
+}
+
+/*
+ * The decoder can run ahead in a thread as long as nothing the main thread
+ * does between two decode calls feeds back into the decoder or depends on
+ * when the frames come out.
+ */
+static int decoder_thread_supported(InputStream *ist)
+{
+    InputFile *f = input_files[ist->file_index];
+    int i;
+
+    if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+        ist->dec_ctx->codec_type != AVMEDIA_TYPE_AUDIO)
+        return 0;
+    if (ist->hwaccel_id != HWACCEL_NONE)
+        return 0;
+    /* these read the stream timestamps while the packets are demuxed */
+    if (f->rate_emu || f->loop || (f->ctx->iformat->flags & AVFMT_TS_DISCONT))
+        return 0;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        FilterGraph *fg = ist->filters[i]->graph;
+        if (!filtergraph_is_simple(fg))
+            return 0;
+    }
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (ost->source_index >= 0 && input_streams[ost->source_index] == ist &&
+            (!ost->encoding_needed || ost->chunks))
+            return 0;
+    }
+    /* -shortest cuts the other streams where they are when the first one
+     * ends, which would depend on how far ahead the thread is */
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i]->shortest)
+            return 0;
+
+    return 1;
+}
+
+static int init_decoder_thread(InputStream *ist)
+{
+    int ret;
+
+    ist->dec_pending = av_fifo_alloc(ist->dec_thread_queue_size * sizeof(PendingPacket));
+    if (!ist->dec_pending)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&ist->dec_thread_queue,
+                                        ist->dec_thread_queue_size, sizeof(AVPacket*));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ist->dec_thread_queue, dec_thread_packet_free);
+
+    ret = av_thread_message_queue_alloc(&ist->dec_result_queue,
+                                        ist->dec_thread_queue_size, sizeof(DecoderResult));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ist->dec_result_queue, dec_thread_result_free);
+
+    if ((ret = pthread_create(&ist->dec_thread, NULL, decoder_thread, ist))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&ist->dec_thread_queue);
+    av_thread_message_queue_free(&ist->dec_result_queue);
+    av_fifo_freep(&ist->dec_pending);
+    return ret;
+}
+
+static int dec_thread_receive_frame(InputStream *ist, AVFrame *frame, int *got_frame)
+{
+    DecoderResult res;
+    int ret;
+
+    *got_frame = 0;
+
+    ret = av_thread_message_queue_recv(ist->dec_result_queue, &res, 0);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Decoder thread for input stream #%d:%d failed: %s\n",
+               ist->file_index, ist->st->index, av_err2str(ret));
+        exit_program(1);
+    }
+
+    ist->dec_state    = res.state;
+    ist->decode_time += res.decode_time;
+    if (res.frame) {
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, res.frame);
+        av_frame_free(&res.frame);
+        *got_frame = 1;
+    }
+
+    return res.ret;
+}
+
+static void dec_thread_send(InputStream *ist, AVPacket *pkt)
+{
+    int ret = av_thread_message_queue_send(ist->dec_thread_queue, &pkt, 0);
+    if (ret < 0) {
+        av_packet_free(&pkt);
+        av_log(NULL, AV_LOG_FATAL, "Decoder thread for input stream #%d:%d failed: %s\n",
+               ist->file_index, ist->st->index, av_err2str(ret));
+        exit_program(1);
+    }
+}
 
-        if (got_output)
-            ist->got_output = 1;
+/* Process the output of the oldest packet sent to the decoder thread. */
+static void dec_thread_process_pending(InputStream *ist)
+{
+    PendingPacket pending;
 
-        if (!got_output)
-            break;
+    av_fifo_generic_read(ist->dec_pending, &pending, sizeof(pending), NULL);
+    decode_packet(ist, pending.pkt, 0, pending.has_parser ? &pending.repeat_pict : NULL);
+    av_packet_free(&pending.pkt);
+}
 
-        // During draining, we might get multiple output frames in this loop.
-        // ffmpeg.c does not drain the filter chain on configuration changes,
-        // which means if we send multiple frames at once to the filters, and
-        // one of those frames changes configuration, the buffered frames will
-        // be lost. This can upset certain FATE tests.
-        // Decode only 1 frame per call on EOF to appease these FATE tests.
-        // The ideal solution would be to rewrite decoding to use the new
-        // decoding API in a better way.
-        if (!pkt)
-            break;
+/*
+ * Hand a packet to the decoder thread. Its output is processed once
+ * dec_thread_queue_size packets are waiting, or at EOF.
+ */
+static int dec_thread_send_packet(InputStream *ist, const AVPacket *pkt, int no_eof,
+                                  const AVCodecParserContext *parser)
+{
+    PendingPacket pending = { 0 };
+    AVPacket *thread_pkt;
 
-        repeating = 1;
+    if (!pkt) {
+        while (av_fifo_size(ist->dec_pending))
+            dec_thread_process_pending(ist);
+        dec_thread_send(ist, NULL);
+        return decode_packet(ist, NULL, no_eof, parser ? &parser->repeat_pict : NULL);
     }
 
-    /* after flushing, send an EOF on all the filter inputs attached to the stream */
-    /* except when looping we need to flush but not to send an EOF */
-    if (!pkt && ist->decoding_needed && eof_reached && !no_eof) {
-        int ret = send_filter_eof(ist);
-        if (ret < 0) {
-            av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
-            exit_program(1);
+    if (!av_fifo_space(ist->dec_pending))
+        dec_thread_process_pending(ist);
+
+    pending.has_parser  = !!parser;
+    pending.repeat_pict = parser ? parser->repeat_pict : 0;
+    pending.pkt = av_packet_clone(pkt);
+    if (!pending.pkt)
+        return AVERROR(ENOMEM);
+
+    /* decode_video() skips empty packets before EOF */
+    if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO || pkt->size) {
+        thread_pkt = av_packet_clone(pkt);
+        if (!thread_pkt) {
+            av_packet_free(&pending.pkt);
+            return AVERROR(ENOMEM);
         }
-    }
 
-    /* handle stream copy */
-    if (!ist->decoding_needed && pkt) {
-        ist->dts = ist->next_dts;
-        switch (ist->dec_ctx->codec_type) {
-        case AVMEDIA_TYPE_AUDIO:
-            av_assert1(pkt->duration >= 0);
-            if (ist->dec_ctx->sample_rate) {
-                ist->next_dts += ((int64_t)AV_TIME_BASE * ist->dec_ctx->frame_size) /
-                                  ist->dec_ctx->sample_rate;
+        /* decode_video() sets the packet dts to the stream dts, which without
+         * a packet dts depends on the output of the previous packets */
+        if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            int64_t dts;
+
+            if (pkt->dts == AV_NOPTS_VALUE) {
+                while (av_fifo_size(ist->dec_pending))
+                    dec_thread_process_pending(ist);
+                start_input_packet(ist, pkt);
+                dts = ist->next_dts;
             } else {
-                ist->next_dts += av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
-            }
-            break;
-        case AVMEDIA_TYPE_VIDEO:
-            if (ist->framerate.num) {
-                // TODO: Remove work-around for c99-to-c89 issue 7
-                AVRational time_base_q = AV_TIME_BASE_Q;
-                int64_t next_dts = av_rescale_q(ist->next_dts, time_base_q, av_inv_q(ist->framerate));
-                ist->next_dts = av_rescale_q(next_dts + 1, av_inv_q(ist->framerate), time_base_q);
-            } else if (pkt->duration) {
-                ist->next_dts += av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
-            } else if(ist->dec_ctx->framerate.num != 0) {
-                int ticks= av_stream_get_parser(ist->st) ? av_stream_get_parser(ist->st)->repeat_pict + 1 : ist->dec_ctx->ticks_per_frame;
-                ist->next_dts += ((int64_t)AV_TIME_BASE *
-                                  ist->dec_ctx->framerate.den * ticks) /
-                                  ist->dec_ctx->framerate.num / ist->dec_ctx->ticks_per_frame;
+                dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
             }
-            break;
+            if (dts != AV_NOPTS_VALUE)
+                dts = av_rescale_q(dts, AV_TIME_BASE_Q, ist->st->time_base);
+            thread_pkt->dts = dts;
         }
-        ist->pts = ist->dts;
-        ist->next_pts = ist->next_dts;
+
+        dec_thread_send(ist, thread_pkt);
     }
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
 
-        if (!ost->pkt && !(ost->pkt = av_packet_alloc()))
-            exit_program(1);
-        if (!check_output_constraints(ist, ost) || ost->encoding_needed)
-            continue;
+    av_fifo_generic_write(ist->dec_pending, &pending, sizeof(pending), NULL);
+    return 1;
+}
 
-        do_streamcopy(ist, ost, pkt);
+static void free_decoder_thread(InputStream *ist)
+{
+    if (ist->dec_thread_queue) {
+        av_thread_message_queue_set_err_recv(ist->dec_thread_queue, AVERROR_EXIT);
+        av_thread_message_queue_set_err_send(ist->dec_result_queue, AVERROR_EXIT);
+        av_thread_message_flush(ist->dec_thread_queue);
+        av_thread_message_flush(ist->dec_result_queue);
+        pthread_join(ist->dec_thread, NULL);
+        av_thread_message_queue_free(&ist->dec_thread_queue);
+        av_thread_message_queue_free(&ist->dec_result_queue);
+    }
+    if (ist->dec_pending) {
+        while (av_fifo_size(ist->dec_pending)) {
+            PendingPacket pending;
+            av_fifo_generic_read(ist->dec_pending, &pending, sizeof(pending), NULL);
+            av_packet_free(&pending.pkt);
+        }
+        av_fifo_freep(&ist->dec_pending);
     }
+}
+#endif
 
-    return !eof_reached;
+/* pkt = NULL means EOF (needed to flush decoder buffers) */
+static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
+{
+    const AVCodecParserContext *parser = av_stream_get_parser(ist->st);
+
+#if HAVE_THREADS
+    if (ist->dec_thread_queue)
+        return dec_thread_send_packet(ist, pkt, no_eof, parser);
+#endif
+
+    return decode_packet(ist, pkt, no_eof, parser ? &parser->repeat_pict : NULL);
 }
 
 static void print_sdp(void)
@@ -3003,6 +4119,26 @@ static int init_input_stream(int ist_index, char *error, int error_len)
         assert_avoptions(ist->decoder_opts);
     }
 
+    get_decoder_state(&ist->dec_state, ist->dec_ctx);
+
+#if HAVE_THREADS
+    if (ist->decoding_needed && ist->dec_thread_queue_size > 0) {
+        if (decoder_thread_supported(ist)) {
+            ret = init_decoder_thread(ist);
+            if (ret < 0) {
+                snprintf(error, error_len, "Error starting the decoder thread for "
+                         "input stream #%d:%d : %s",
+                         ist->file_index, ist->st->index, av_err2str(ret));
+                return ret;
+            }
+        } else {
+            av_log(NULL, AV_LOG_WARNING, "Input stream #%d:%d cannot be decoded "
+                   "in a separate thread, decoding it on the main thread\n",
+                   ist->file_index, ist->st->index);
+        }
+    }
+#endif
+
     ist->next_pts = AV_NOPTS_VALUE;
     ist->next_dts = AV_NOPTS_VALUE;
 
@@ -3263,6 +4399,42 @@ static void set_encoder_id(OutputFile *of, OutputStream *ost)
                 AV_DICT_DONT_STRDUP_VAL | AV_DICT_DONT_OVERWRITE);
 }
 
+static int init_output_stream_chunks(OutputStream *ost)
+{
+    InputStream *ist = get_input_stream(ost);
+    AVRational time_base, frame_rate;
+    int ret;
+
+    ret = chunks_get_parameters(ost, ost->st->codecpar, &time_base, &frame_rate, 1);
+    if (ret >= 0)
+        ret = avcodec_parameters_to_context(ost->enc_ctx, ost->st->codecpar);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL,
+               "Error getting the codec parameters of the chunks.\n");
+        return ret;
+    }
+    ost->enc_ctx->time_base = time_base;
+    ost->enc_ctx->framerate = frame_rate;
+
+    set_encoder_id(output_files[ost->file_index], ost);
+
+    ost->st->disposition          = ist->st->disposition;
+    ost->st->sample_aspect_ratio  = ost->st->codecpar->sample_aspect_ratio;
+    ost->st->avg_frame_rate       = frame_rate;
+
+    // copy timebase while removing common factors
+    if (ost->st->time_base.num <= 0 || ost->st->time_base.den <= 0)
+        ost->st->time_base = av_add_q(time_base, (AVRational){0, 1});
+
+    // copy estimated duration as a hint to the muxer
+    if (ost->st->duration <= 0 && ist->st->duration > 0)
+        ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+
+    ost->mux_timebase = time_base;
+
+    return 0;
+}
+
 static void parse_forced_key_frames(char *kf, OutputStream *ost,
                                     AVCodecContext *avctx)
 {
@@ -3354,7 +4526,7 @@ static int init_output_stream_encode(OutputStream *ost, AVFrame *frame)
 {
     InputStream *ist = get_input_stream(ost);
     AVCodecContext *enc_ctx = ost->enc_ctx;
-    AVCodecContext *dec_ctx = NULL;
+    const DecoderState *dec_state = NULL;
     AVFormatContext *oc = output_files[ost->file_index]->ctx;
     int j, ret;
 
@@ -3368,9 +4540,9 @@ static int init_output_stream_encode(OutputStream *ost, AVFrame *frame)
     if (ist) {
         ost->st->disposition          = ist->st->disposition;
 
-        dec_ctx = ist->dec_ctx;
+        dec_state = &ist->dec_state;
 
-        enc_ctx->chroma_sample_location = dec_ctx->chroma_sample_location;
+        enc_ctx->chroma_sample_location = dec_state->chroma_sample_location;
     } else {
         for (j = 0; j < oc->nb_streams; j++) {
             AVStream *st = oc->streams[j];
@@ -3419,8 +4591,8 @@ static int init_output_stream_encode(OutputStream *ost, AVFrame *frame)
     switch (enc_ctx->codec_type) {
     case AVMEDIA_TYPE_AUDIO:
         enc_ctx->sample_fmt     = av_buffersink_get_format(ost->filter->filter);
-        if (dec_ctx)
-            enc_ctx->bits_per_raw_sample = FFMIN(dec_ctx->bits_per_raw_sample,
+        if (dec_state)
+            enc_ctx->bits_per_raw_sample = FFMIN(dec_state->bits_per_raw_sample,
                                                  av_get_bytes_per_sample(enc_ctx->sample_fmt) << 3);
         enc_ctx->sample_rate    = av_buffersink_get_sample_rate(ost->filter->filter);
         enc_ctx->channel_layout = av_buffersink_get_channel_layout(ost->filter->filter);
@@ -3448,8 +4620,8 @@ static int init_output_stream_encode(OutputStream *ost, AVFrame *frame)
             av_buffersink_get_sample_aspect_ratio(ost->filter->filter);
 
         enc_ctx->pix_fmt = av_buffersink_get_format(ost->filter->filter);
-        if (dec_ctx)
-            enc_ctx->bits_per_raw_sample = FFMIN(dec_ctx->bits_per_raw_sample,
+        if (dec_state)
+            enc_ctx->bits_per_raw_sample = FFMIN(dec_state->bits_per_raw_sample,
                                                  av_pix_fmt_desc_get(enc_ctx->pix_fmt)->comp[0].depth);
 
         if (frame) {
@@ -3464,10 +4636,10 @@ static int init_output_stream_encode(OutputStream *ost, AVFrame *frame)
 
         ost->st->avg_frame_rate = ost->frame_rate;
 
-        if (!dec_ctx ||
-            enc_ctx->width   != dec_ctx->width  ||
-            enc_ctx->height  != dec_ctx->height ||
-            enc_ctx->pix_fmt != dec_ctx->pix_fmt) {
+        if (!dec_state ||
+            enc_ctx->width   != dec_state->width  ||
+            enc_ctx->height  != dec_state->height ||
+            enc_ctx->pix_fmt != dec_state->pix_fmt) {
             enc_ctx->bits_per_raw_sample = frame_bits_per_raw_sample;
         }
 
@@ -3658,6 +4830,23 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
         // copy estimated duration as a hint to the muxer
         if (ost->st->duration <= 0 && ist && ist->st->duration > 0)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+
+#if HAVE_THREADS
+        if (ost->enc_thread_queue_size > 0 &&
+            (ost->enc->type == AVMEDIA_TYPE_VIDEO || ost->enc->type == AVMEDIA_TYPE_AUDIO)) {
+            ret = init_encoder_thread(ost);
+            if (ret < 0) {
+                snprintf(error, error_len, "Could not start the encoder thread "
+                         "for output stream #%d:%d : %s",
+                         ost->file_index, ost->index, av_err2str(ret));
+                return ret;
+            }
+        }
+#endif
+    } else if (ost->chunks) {
+        ret = init_output_stream_chunks(ost);
+        if (ret < 0)
+            return ret;
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3752,6 +4941,20 @@ static int transcode_init(void)
         }
     }
 
+#if HAVE_THREADS
+    for (i = 0; i < nb_output_streams; i++) {
+        ost = output_streams[i];
+        if (!ost->filter || ost->filter_thread_queue_size <= 0)
+            continue;
+        if (filter_thread_supported(ost->filter->graph))
+            ost->filter->graph->thread_queue_size = ost->filter_thread_queue_size;
+        else
+            av_log(NULL, AV_LOG_WARNING, "The filtergraph of output stream #%d:%d "
+                   "cannot run in a separate thread, filtering on the main thread\n",
+                   ost->file_index, ost->index);
+    }
+#endif
+
     /* init framerate emulation */
     for (i = 0; i < nb_input_files; i++) {
         InputFile *ifile = input_files[i];
@@ -4026,6 +5229,7 @@ static int check_keyboard_interaction(int64_t cur_time)
             for (i = 0; i < nb_filtergraphs; i++) {
                 FilterGraph *fg = filtergraphs[i];
                 if (fg->graph) {
+                    filter_graph_lock(fg);
                     if (time < 0) {
                         ret = avfilter_graph_send_command(fg->graph, target, command, arg, buf, sizeof(buf),
                                                           key == 'c' ? AVFILTER_CMD_FLAG_ONE : 0);
@@ -4038,6 +5242,7 @@ static int check_keyboard_interaction(int64_t cur_time)
                         if (ret < 0)
                             fprintf(stderr, "Queuing command failed with error %s\n", av_err2str(ret));
                     }
+                    filter_graph_unlock(fg);
                 }
             }
         } else {
@@ -4179,8 +5384,9 @@ static int init_input_thread(int i)
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(f->pkt));
+    ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                         f->thread_queue_size, sizeof(f->pkt),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
@@ -4215,6 +5421,9 @@ static int get_input_packet_mt(InputFile *f, AVPacket **pkt)
 
 static int get_input_packet(InputFile *f, AVPacket **pkt)
 {
+    int64_t demux_start;
+    int ret;
+
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
@@ -4226,12 +5435,19 @@ static int get_input_packet(InputFile *f, AVPacket **pkt)
         }
     }
 
+    demux_start = stage_time_start();
 #if HAVE_THREADS
     if (f->thread_queue_size)
-        return get_input_packet_mt(f, pkt);
+        ret = get_input_packet_mt(f, pkt);
+    else
 #endif
-    *pkt = f->pkt;
-    return av_read_frame(f->ctx, *pkt);
+    {
+        *pkt = f->pkt;
+        ret = av_read_frame(f->ctx, *pkt);
+    }
+    stage_time_end(&f->demux_time, demux_start);
+
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4338,6 +5554,71 @@ static int seek_to_start(InputFile *ifile, AVFormatContext *is)
  *   this function should be called again
  * - AVERROR_EOF -- this function should not be called again
  */
+/**
+ * Mux the packets the chunks of an output stream have ready.
+ *
+ * @param block wait for a packet or the end of the stream
+ * @return  >0 if packets were muxed or the stream finished, 0 if no packet
+ *          was ready, <0 for error
+ */
+static int reap_chunks(OutputStream *ost, int block)
+{
+    OutputFile *of = output_files[ost->file_index];
+    int got_packet = 0;
+    int ret;
+
+    if (!ost->initialized) {
+        ret = chunks_get_parameters(ost, NULL, NULL, NULL, block);
+        if (ret == AVERROR_EOF) {
+            finish_output_stream(ost);
+            return 1;
+        }
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret < 0)
+            return ret;
+        init_output_stream_wrapper(ost, NULL, 1);
+    }
+
+    while ((ret = chunks_receive_packet(ost, ost->pkt, block && !got_packet)) >= 0) {
+        got_packet = 1;
+        av_packet_rescale_ts(ost->pkt, ost->enc_ctx->time_base, ost->mux_timebase);
+        output_packet(of, ost->pkt, ost, 0);
+    }
+    if (ret == AVERROR_EOF) {
+        output_packet(of, ost->pkt, ost, 1);
+        finish_output_stream(ost);
+        return 1;
+    }
+    if (ret != AVERROR(EAGAIN))
+        return ret;
+    return got_packet;
+}
+
+/*
+ * Wait until the chunks fed by an input file have room for another packet,
+ * muxing meanwhile what they have ready.
+ */
+static int wait_chunks_input(int file_index)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->chunks || input_streams[ost->source_index]->file_index != file_index)
+            continue;
+        while (!ost->finished && (ret = chunks_wait_input(ost)) == AVERROR(EAGAIN)) {
+            ret = reap_chunks(ost, 0);
+            if (ret < 0)
+                return ret;
+        }
+        if (!ost->finished && ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int process_input(int file_index)
 {
     InputFile *ifile = input_files[file_index];
@@ -4349,6 +5630,10 @@ static int process_input(int file_index)
     int64_t pkt_dts;
     int disable_discontinuity_correction = copy_ts;
 
+    ret = wait_chunks_input(file_index);
+    if (ret < 0)
+        return ret;
+
     is  = ifile->ctx;
     ret = get_input_packet(ifile, &pkt);
 
@@ -4624,6 +5909,53 @@ discard_packet:
     return 0;
 }
 
+#if HAVE_THREADS
+/*
+ * Counterpart of transcode_from_filter() for a filtergraph running in its own
+ * thread, which requests frames from the graph by itself.
+ */
+static int transcode_from_filter_thread(FilterGraph *graph, InputStream **best_ist)
+{
+    InputFilter *ifilter = graph->inputs[0];
+    InputStream *ist = ifilter->ist;
+    int ret, sink_eof;
+
+    pthread_mutex_lock(&graph->thread_lock);
+    sink_eof = graph->thread_sink_eof;
+    ret      = graph->thread_ret;
+    pthread_mutex_unlock(&graph->thread_lock);
+    if (ret < 0)
+        return ret;
+
+    /* once the graph has no more input, wait for the thread to finish it */
+    if (sink_eof || ifilter->eof) {
+        ret = reap_filters(1);
+        if (ret < 0)
+            return ret;
+
+        pthread_mutex_lock(&graph->thread_lock);
+        sink_eof = graph->thread_sink_eof;
+        ret      = graph->thread_ret;
+        pthread_mutex_unlock(&graph->thread_lock);
+        if (ret < 0)
+            return ret;
+        if (sink_eof) {
+            close_output_stream(graph->outputs[0]->ost);
+            return 0;
+        }
+    }
+
+    if (input_files[ist->file_index]->eagain ||
+        input_files[ist->file_index]->eof_reached) {
+        graph->outputs[0]->ost->unavailable = 1;
+        return reap_filters(0);
+    }
+
+    *best_ist = ist;
+    return 0;
+}
+#endif
+
 /**
  * Perform a step of transcoding for the specified filter graph.
  *
@@ -4639,6 +5971,10 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     InputStream *ist;
 
     *best_ist = NULL;
+#if HAVE_THREADS
+    if (graph->thread_queue)
+        return transcode_from_filter_thread(graph, best_ist);
+#endif
     ret = avfilter_graph_request_oldest(graph->graph);
     if (ret >= 0)
         return reap_filters(0);
@@ -4672,6 +6008,42 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     return 0;
 }
 
+/**
+ * Run a step of transcoding for an output stream transcoded in chunks: mux
+ * the packets the chunks have ready, or feed them more input.
+ *
+ * @return  0 for success, <0 for error
+ */
+static int transcode_chunks(OutputStream *ost)
+{
+    InputStream *ist = input_streams[ost->source_index];
+    InputFile *ifile = input_files[ist->file_index];
+    int ret;
+
+    /* once the input is exhausted, wait for the chunks to finish */
+    if (ifile->eof_reached) {
+        ret = chunks_send_packet(ost, NULL);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = reap_chunks(ost, ifile->eof_reached);
+    if (ret)
+        return FFMIN(ret, 0);
+
+    ret = process_input(ist->file_index);
+    if (ret == AVERROR(EAGAIN)) {
+        if (ifile->eagain)
+            ost->unavailable = 1;
+        return 0;
+    }
+
+    if (ret < 0)
+        return ret == AVERROR_EOF ? 0 : ret;
+
+    return reap_filters(0);
+}
+
 /**
  * Run a single step of transcoding.
  *
@@ -4694,6 +6066,9 @@ static int transcode_step(void)
         return AVERROR_EOF;
     }
 
+    if (ost->chunks)
+        return transcode_chunks(ost);
+
     if (ost->filter && !ost->filter->graph->graph) {
         if (ifilter_has_all_input_formats(ost->filter->graph)) {
             ret = configure_filtergraph(ost->filter->graph);
@@ -4825,6 +6200,12 @@ static int transcode(void)
             process_input_packet(ist, NULL, 0);
         }
     }
+#if HAVE_THREADS
+    for (i = 0; i < nb_input_streams; i++)
+        free_decoder_thread(input_streams[i]);
+    for (i = 0; i < nb_filtergraphs; i++)
+        free_filter_thread(filtergraphs[i]);
+#endif
     flush_encoders();
 
     term_exit();
@@ -219,6 +219,16 @@ typedef struct OptionsContext {
     int        nb_max_muxing_queue_size;
     SpecifierOpt *muxing_queue_data_threshold;
     int        nb_muxing_queue_data_threshold;
+    SpecifierOpt *enc_thread_queue_size;
+    int        nb_enc_thread_queue_size;
+    SpecifierOpt *filter_thread_queue_size;
+    int        nb_filter_thread_queue_size;
+    SpecifierOpt *dec_thread_queue_size;
+    int        nb_dec_thread_queue_size;
+    SpecifierOpt *parallel_chunks;
+    int        nb_parallel_chunks;
+    SpecifierOpt *chunk_queue_size;
+    int        nb_chunk_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -290,13 +300,42 @@ typedef struct FilterGraph {
 
     AVFilterGraph *graph;
     int reconfiguration;
+    // shared by the unfiltered video outputs of one input (-scale_ladder)
+    int ladder;
 
     InputFilter   **inputs;
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    int thread_queue_size;              /* maximum number of frames queued for the filtergraph thread */
+#if HAVE_THREADS
+    AVThreadMessageQueue *thread_queue; /* frames sent to the filtergraph thread */
+    pthread_t thread;                   /* thread running this simple filtergraph */
+    pthread_mutex_t graph_lock;         /* held by the thread while it runs the graph */
+    pthread_mutex_t thread_lock;        /* protects the fields below */
+    pthread_cond_t thread_cond;
+    AVFifoBuffer *thread_out_queue;     /* filtered frames, waiting to be encoded */
+    int nb_thread_sent;                 /* messages sent to the thread */
+    int nb_thread_done;                 /* messages processed by the thread */
+    int thread_sink_eof;                /* the buffersink has returned EOF */
+    int thread_ret;                     /* error that stopped the thread */
+#endif
 } FilterGraph;
 
+/* decoder parameters read after decoding, sampled right after each decode
+ * call so that they can also be read while a decoder thread is running */
+typedef struct DecoderState {
+    int width, height;
+    enum AVPixelFormat pix_fmt;
+    int sample_rate;
+    int has_b_frames;
+    AVRational framerate;
+    int ticks_per_frame;
+    enum AVChromaLocation chroma_sample_location;
+    int bits_per_raw_sample;
+} DecoderState;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -308,6 +347,7 @@ typedef struct InputStream {
 
     AVCodecContext *dec_ctx;
     const AVCodec *dec;
+    DecoderState dec_state;
     AVFrame *decoded_frame;
     AVFrame *filter_frame; /* a ref of decoded_frame, to be sent to filters */
     AVPacket *pkt;
@@ -390,11 +430,21 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+    // time spent in the decoder, in microseconds (with -stage_stats)
+    int64_t decode_time;
 
     int64_t *dts_buffer;
     int nb_dts_buffer;
 
     int got_output;
+
+    int dec_thread_queue_size;       /* maximum number of packets in flight in the decoder thread */
+#if HAVE_THREADS
+    AVThreadMessageQueue *dec_thread_queue;  /* packets sent to the decoder thread */
+    AVThreadMessageQueue *dec_result_queue;  /* results of the decode calls made by the thread */
+    pthread_t dec_thread;            /* thread running the decoder of this stream */
+    AVFifoBuffer *dec_pending;       /* packets decoded by the thread, waiting to be processed */
+#endif
 } InputStream;
 
 typedef struct InputFile {
@@ -421,6 +471,8 @@ typedef struct InputFile {
 
     AVPacket *pkt;
 
+    int64_t demux_time;   /* time spent waiting for packets, in microseconds (with -stage_stats) */
+
 #if HAVE_THREADS
     AVThreadMessageQueue *in_thread_queue;
     pthread_t thread;           /* thread reading from this file */
@@ -547,6 +599,9 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // time spent in the encoder and the muxer, in microseconds (with -stage_stats)
+    int64_t encode_time;
+    int64_t mux_time;
 
     /* packet quality factor */
     int quality;
@@ -570,6 +625,20 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    int enc_thread_queue_size;       /* maximum number of frames queued for the encoder thread */
+    int filter_thread_queue_size;    /* maximum number of frames queued for the filtergraph thread */
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_thread_queue;
+    pthread_t enc_thread;            /* thread running the encoder of this stream */
+    int enc_thread_ret;              /* exit status of the encoder thread */
+    pthread_mutex_t enc_pkt_lock;
+    AVFifoBuffer *enc_pkt_queue;     /* packets returned by the encoder thread, waiting to be muxed */
+#endif
+
+    int parallel_chunks;             /* number of chunks of the input transcoded in parallel */
+    int chunk_queue_size;            /* maximum number of packets queued for or by a chunk */
+    struct OutputChunks *chunks;     /* set when the stream is transcoded in chunks */
 } OutputStream;
 
 typedef struct OutputFile {
@@ -622,6 +691,7 @@ extern int exit_on_error;
 extern int abort_on_flags;
 extern int print_stats;
 extern int64_t stats_period;
+extern int stage_stats;
 extern int qp_hist;
 extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
@@ -631,8 +701,10 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_complex_parallel;
 extern int vstats_version;
 extern int auto_conversion_filters;
+extern int scale_ladder;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -679,4 +751,12 @@ int hw_device_setup_for_filter(FilterGraph *fg);
 
 int hwaccel_decode_init(AVCodecContext *avctx);
 
+int chunks_init(OutputStream *ost);
+void chunks_uninit(OutputStream *ost);
+int chunks_send_packet(OutputStream *ost, const AVPacket *pkt);
+int chunks_wait_input(OutputStream *ost);
+int chunks_get_parameters(OutputStream *ost, AVCodecParameters *par,
+                          AVRational *time_base, AVRational *frame_rate, int block);
+int chunks_receive_packet(OutputStream *ost, AVPacket *pkt, int block);
+
 #endif /* FFTOOLS_FFMPEG_H */
@@ -0,0 +1,953 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Chunked transcoding of a video output stream.
+ *
+ * The packets of the input stream are split at keyframes into chunks, the
+ * cut points being chosen from the demuxer index. Each chunk is decoded,
+ * filtered and encoded by its own thread with its own decoder, filtergraph
+ * and encoder, and the encoded chunks are muxed in order by the main thread.
+ *
+ * The packet queues between the main thread and the chunks are bounded: the
+ * main thread waits for room in the input queues before reading a packet,
+ * muxing meanwhile what the chunks have ready, and a chunk waits for room in
+ * its output queue until the chunks before it have been muxed.
+ */
+
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/timestamp.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+#include "ffmpeg.h"
+
+#if HAVE_THREADS
+
+typedef struct Chunk {
+    struct OutputChunks *oc;
+    int index;
+    pthread_t thread;
+
+    /* protected by OutputChunks.lock */
+    AVFifoBuffer *in_queue;     /* input packets waiting to be decoded */
+    int in_eof;                 /* no more input packets will be queued */
+    int64_t end_pts;            /* pts of the keyframe starting the next chunk */
+    AVFifoBuffer *out_queue;    /* encoded packets waiting to be muxed */
+    int out_eof;                /* the chunk thread has exited */
+    int ret;                    /* exit status of the chunk thread */
+
+    /* only used by the chunk thread */
+    AVCodecContext  *dec_ctx;
+    AVCodecContext  *enc_ctx;
+    AVFilterGraph   *graph;
+    AVFilterContext *src;
+    AVFilterContext *sink;
+    int sink_eof;
+    int64_t dec_end_pts;        /* copy of end_pts, decoded frames from there on are dropped */
+    AVFrame  *frame;
+    AVFrame  *filtered_frame;
+    AVPacket *pkt;
+} Chunk;
+
+typedef struct OutputChunks {
+    OutputStream *ost;
+    InputStream  *ist;
+
+    Chunk *chunks;
+    int nb_chunks;
+    int nb_threads;             /* number of chunk threads started */
+
+    /* a keyframe with a timestamp at or after cut_ts[i] starts chunk i + 1 */
+    int64_t *cut_ts;
+    int cur_in;                 /* chunk receiving the input packets */
+    struct Chunk *leading;      /* chunk still receiving the leading frames of
+                                   the keyframe starting cur_in */
+    int cur_out;                /* chunk whose packets are being muxed */
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int abort;
+
+    int queue_size;             /* maximum number of packets in each queue */
+    int max_in_queued;          /* most packets seen in an input queue */
+    int max_out_queued;         /* most packets seen in an output queue */
+
+    /* set by the first chunk opening its encoder */
+    AVCodecParameters *par;
+    AVRational time_base;
+    AVRational frame_rate;
+    int par_ready;
+} OutputChunks;
+
+static int queue_packet(AVFifoBuffer *fifo, AVPacket *pkt)
+{
+    int ret;
+
+    if (!av_fifo_space(fifo)) {
+        ret = av_fifo_realloc2(fifo, 2 * av_fifo_size(fifo));
+        if (ret < 0)
+            return ret;
+    }
+    av_fifo_generic_write(fifo, &pkt, sizeof(pkt), NULL);
+    return 0;
+}
+
+static int queue_nb_packets(AVFifoBuffer *fifo)
+{
+    return av_fifo_size(fifo) / sizeof(AVPacket*);
+}
+
+static int queue_full(const OutputChunks *oc, AVFifoBuffer *fifo)
+{
+    return queue_nb_packets(fifo) >= oc->queue_size;
+}
+
+/* whether the main thread can queue another input packet for a chunk */
+static int chunk_input_ready(const OutputChunks *oc, const Chunk *c)
+{
+    return c->in_eof || c->out_eof || !queue_full(oc, c->in_queue);
+}
+
+static int chunk_queue_input(Chunk *c, const AVPacket *pkt)
+{
+    OutputChunks *oc = c->oc;
+    AVPacket *queue_pkt;
+    int ret;
+
+    /* chunks_wait_input() is expected to have made room already */
+    while (!oc->abort && !chunk_input_ready(oc, c)) {
+        pthread_cond_broadcast(&oc->cond);
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    }
+    /* the chunk thread failed, the error is reported when it is muxed */
+    if (oc->abort || c->out_eof)
+        return 0;
+
+    queue_pkt = av_packet_clone(pkt);
+    if (!queue_pkt)
+        return AVERROR(ENOMEM);
+    ret = queue_packet(c->in_queue, queue_pkt);
+    if (ret < 0) {
+        av_packet_free(&queue_pkt);
+        return ret;
+    }
+    oc->max_in_queued = FFMAX(oc->max_in_queued, queue_nb_packets(c->in_queue));
+    return 0;
+}
+
+static void free_queue(AVFifoBuffer **fifo)
+{
+    AVPacket *pkt;
+
+    if (!*fifo)
+        return;
+    while (av_fifo_size(*fifo)) {
+        av_fifo_generic_read(*fifo, &pkt, sizeof(pkt), NULL);
+        av_packet_free(&pkt);
+    }
+    av_fifo_freep(fifo);
+}
+
+static int chunk_get_packet(Chunk *c, AVPacket **pkt)
+{
+    OutputChunks *oc = c->oc;
+    int ret = 0;
+
+    pthread_mutex_lock(&oc->lock);
+    while (!oc->abort && !c->in_eof && !av_fifo_size(c->in_queue))
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    if (oc->abort)
+        ret = AVERROR_EXIT;
+    else if (av_fifo_size(c->in_queue))
+        av_fifo_generic_read(c->in_queue, pkt, sizeof(*pkt), NULL);
+    else
+        ret = AVERROR_EOF;
+    c->dec_end_pts = c->end_pts;
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+
+    return ret;
+}
+
+static int chunk_output_packet(Chunk *c, AVPacket *pkt)
+{
+    OutputChunks *oc = c->oc;
+    AVPacket *queue_pkt;
+    int ret;
+
+    queue_pkt = av_packet_alloc();
+    if (!queue_pkt)
+        return AVERROR(ENOMEM);
+    av_packet_move_ref(queue_pkt, pkt);
+
+    pthread_mutex_lock(&oc->lock);
+    /* the packets of a chunk are only muxed once all the chunks before it
+     * are done, so wait for them rather than buffering the whole chunk */
+    while (!oc->abort && queue_full(oc, c->out_queue))
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    if (oc->abort) {
+        ret = AVERROR_EXIT;
+    } else {
+        ret = queue_packet(c->out_queue, queue_pkt);
+        oc->max_out_queued = FFMAX(oc->max_out_queued, queue_nb_packets(c->out_queue));
+    }
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+
+    if (ret < 0)
+        av_packet_free(&queue_pkt);
+    return ret;
+}
+
+static int chunk_open_decoder(Chunk *c)
+{
+    InputStream *ist = c->oc->ist;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    c->dec_ctx = avcodec_alloc_context3(ist->dec);
+    if (!c->dec_ctx)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_to_context(c->dec_ctx, ist->st->codecpar);
+    if (ret < 0)
+        return ret;
+    c->dec_ctx->pkt_timebase = ist->st->time_base;
+
+    av_dict_copy(&opts, ist->decoder_opts, 0);
+    /* the chunks already keep the CPUs busy */
+    if (!av_dict_get(opts, "threads", NULL, 0))
+        av_dict_set(&opts, "threads", "1", 0);
+    ret = avcodec_open2(c->dec_ctx, ist->dec, &opts);
+    av_dict_free(&opts);
+
+    return ret;
+}
+
+/*
+ * Build the filtergraph of a chunk: the filters of the output stream, followed
+ * by the same output constraints configure_output_video_filter() would insert.
+ */
+static int chunk_configure_filters(Chunk *c, const AVFrame *frame)
+{
+    OutputChunks *oc = c->oc;
+    OutputStream *ost = oc->ost;
+    InputStream  *ist = oc->ist;
+    OutputFile   *of  = output_files[ost->file_index];
+    int64_t start_time = of->start_time == AV_NOPTS_VALUE ? 0 : of->start_time;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVRational sar = frame->sample_aspect_ratio;
+    AVRational fr = ist->framerate.num ? ist->framerate : ist->st->r_frame_rate;
+    AVDictionaryEntry *e = NULL;
+    AVBPrint args;
+    int ret;
+
+    c->graph = avfilter_graph_alloc();
+    if (!c->graph)
+        return AVERROR(ENOMEM);
+    c->graph->nb_threads = filter_nbthreads > 0 ? filter_nbthreads : 1;
+
+    av_bprint_init(&args, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    if (!sar.den)
+        sar = (AVRational){ 0, 1 };
+    av_bprintf(&args, "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+               frame->width, frame->height, frame->format,
+               ist->st->time_base.num, ist->st->time_base.den, sar.num, sar.den);
+    if (fr.num && fr.den)
+        av_bprintf(&args, ":frame_rate=%d/%d", fr.num, fr.den);
+    ret = avfilter_graph_create_filter(&c->src, avfilter_get_by_name("buffer"),
+                                       "in", args.str, NULL, c->graph);
+    if (ret < 0)
+        goto fail;
+
+    ret = avfilter_graph_create_filter(&c->sink, avfilter_get_by_name("buffersink"),
+                                       "out", NULL, NULL, c->graph);
+    if (ret < 0)
+        goto fail;
+
+    av_bprint_clear(&args);
+    av_bprintf(&args, "%s", ost->avfilter);
+    if (ost->enc_ctx->width || ost->enc_ctx->height) {
+        av_bprintf(&args, ",scale=%d:%d", ost->enc_ctx->width, ost->enc_ctx->height);
+        while ((e = av_dict_get(ost->sws_dict, "", e, AV_DICT_IGNORE_SUFFIX)))
+            av_bprintf(&args, ":%s=%s", e->key, e->value);
+    }
+    if (ost->enc_ctx->pix_fmt != AV_PIX_FMT_NONE) {
+        av_bprintf(&args, ",format=pix_fmts=%s", av_get_pix_fmt_name(ost->enc_ctx->pix_fmt));
+    } else if (ost->enc->pix_fmts) {
+        const enum AVPixelFormat *p;
+
+        av_bprintf(&args, ",format=pix_fmts=");
+        for (p = ost->enc->pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+            av_bprintf(&args, "%s%s", p == ost->enc->pix_fmts ? "" : "|",
+                       av_get_pix_fmt_name(*p));
+    }
+    if (ost->frame_rate.num)
+        av_bprintf(&args, ",fps=%d/%d", ost->frame_rate.num, ost->frame_rate.den);
+    if (of->start_time != AV_NOPTS_VALUE || of->recording_time != INT64_MAX) {
+        av_bprintf(&args, ",trim");
+        if (of->start_time != AV_NOPTS_VALUE)
+            av_bprintf(&args, "=starti=%"PRId64"us", of->start_time);
+        /* each chunk only sees part of the stream, so the end is absolute */
+        if (of->recording_time != INT64_MAX)
+            av_bprintf(&args, "%sendi=%"PRId64"us",
+                       of->start_time != AV_NOPTS_VALUE ? ":" : "=",
+                       start_time + of->recording_time);
+    }
+    if (!av_bprint_is_complete(&args)) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = c->src;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = c->sink;
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = avfilter_graph_parse_ptr(c->graph, args.str, &inputs, &outputs, NULL);
+    if (ret < 0)
+        goto fail;
+
+    ret = avfilter_graph_config(c->graph, NULL);
+
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    av_bprint_finalize(&args, NULL);
+    return ret;
+}
+
+static int chunk_open_encoder(Chunk *c, const AVFrame *frame)
+{
+    OutputChunks *oc = c->oc;
+    OutputStream *ost = oc->ost;
+    InputStream  *ist = oc->ist;
+    AVCodecContext *enc;
+    AVDictionary *opts = NULL;
+    AVRational frame_rate;
+    int ret;
+
+    enc = c->enc_ctx = avcodec_alloc_context3(ost->enc);
+    if (!enc)
+        return AVERROR(ENOMEM);
+
+    /* options given on the command line which were set on the context of
+     * the output stream rather than kept in encoder_opts */
+    ret = av_opt_copy(enc, ost->enc_ctx);
+    if (ret < 0)
+        return ret;
+
+    frame_rate = ost->frame_rate;
+    if (!frame_rate.num)
+        frame_rate = av_buffersink_get_frame_rate(c->sink);
+    if (!frame_rate.num)
+        frame_rate = ist->framerate;
+    if (!frame_rate.num)
+        frame_rate = ist->st->r_frame_rate;
+    // reduce frame rate for mpeg4 to be within the spec limits
+    if (enc->codec_id == AV_CODEC_ID_MPEG4)
+        av_reduce(&frame_rate.num, &frame_rate.den,
+                  frame_rate.num, frame_rate.den, 65535);
+
+    enc->time_base = frame_rate.num ? av_inv_q(frame_rate) :
+                                      av_buffersink_get_time_base(c->sink);
+    enc->framerate = frame_rate;
+    enc->width     = av_buffersink_get_w(c->sink);
+    enc->height    = av_buffersink_get_h(c->sink);
+    enc->pix_fmt   = av_buffersink_get_format(c->sink);
+    enc->sample_aspect_ratio = ost->frame_aspect_ratio.num ?
+        av_mul_q(ost->frame_aspect_ratio, (AVRational){ enc->height, enc->width }) :
+        av_buffersink_get_sample_aspect_ratio(c->sink);
+
+    enc->color_range            = frame->color_range;
+    enc->color_primaries        = frame->color_primaries;
+    enc->color_trc              = frame->color_trc;
+    enc->colorspace             = frame->colorspace;
+    enc->chroma_sample_location = frame->chroma_location;
+
+    av_dict_copy(&opts, ost->encoder_opts, 0);
+    if (!av_dict_get(opts, "threads", NULL, 0))
+        av_dict_set(&opts, "threads", "1", 0);
+    ret = avcodec_open2(enc, ost->enc, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    pthread_mutex_lock(&oc->lock);
+    if (!oc->par_ready) {
+        ret = avcodec_parameters_from_context(oc->par, enc);
+        oc->time_base  = enc->time_base;
+        oc->frame_rate = frame_rate;
+        oc->par_ready  = ret >= 0;
+        pthread_cond_broadcast(&oc->cond);
+    }
+    pthread_mutex_unlock(&oc->lock);
+
+    return ret;
+}
+
+static int chunk_encode(Chunk *c, AVFrame *frame)
+{
+    AVCodecContext *enc = c->enc_ctx;
+    int64_t frame_pts = frame ? frame->pts : AV_NOPTS_VALUE;
+    int ret;
+
+    ret = avcodec_send_frame(enc, frame);
+    if (ret < 0)
+        return ret;
+
+    while (1) {
+        ret = avcodec_receive_packet(enc, c->pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+
+        if (c->pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+            c->pkt->pts = frame_pts;
+
+        ret = chunk_output_packet(c, c->pkt);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+/* send a decoded frame, or EOF if frame is NULL, through the filters and the encoder */
+static int chunk_filter_frame(Chunk *c, AVFrame *frame)
+{
+    OutputStream *ost = c->oc->ost;
+    OutputFile   *of  = output_files[ost->file_index];
+    int64_t start_time = of->start_time == AV_NOPTS_VALUE ? 0 : of->start_time;
+    AVFrame *filtered_frame = c->filtered_frame;
+    int ret;
+
+    if (c->sink_eof)
+        return 0;
+
+    if (!c->graph) {
+        if (!frame)
+            return 0;
+        ret = chunk_configure_filters(c, frame);
+        if (ret < 0)
+            return ret;
+    }
+
+    /* end the chunk where the next one starts, so that filters like fps
+     * handle the boundary as they would within a single stream */
+    if (!frame && c->dec_end_pts != AV_NOPTS_VALUE)
+        ret = av_buffersrc_close(c->src, c->dec_end_pts, 0);
+    else
+        ret = av_buffersrc_add_frame(c->src, frame);
+    if (ret < 0)
+        return ret;
+
+    while (1) {
+        ret = av_buffersink_get_frame(c->sink, filtered_frame);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF) {
+            c->sink_eof = 1;
+            return c->enc_ctx ? chunk_encode(c, NULL) : 0;
+        }
+        if (ret < 0)
+            return ret;
+
+        if (!c->enc_ctx) {
+            ret = chunk_open_encoder(c, filtered_frame);
+            if (ret < 0) {
+                av_frame_unref(filtered_frame);
+                return ret;
+            }
+        }
+
+        if (filtered_frame->pts != AV_NOPTS_VALUE)
+            filtered_frame->pts =
+                av_rescale_q(filtered_frame->pts, av_buffersink_get_time_base(c->sink),
+                             c->enc_ctx->time_base) -
+                av_rescale_q(start_time, AV_TIME_BASE_Q, c->enc_ctx->time_base);
+        filtered_frame->pict_type = AV_PICTURE_TYPE_NONE;
+
+        ret = chunk_encode(c, filtered_frame);
+        av_frame_unref(filtered_frame);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int chunk_decode(Chunk *c, const AVPacket *pkt)
+{
+    InputStream *ist = c->oc->ist;
+    int ret;
+
+    ret = avcodec_send_packet(c->dec_ctx, pkt);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d: %s\n",
+               ist->file_index, ist->st->index, av_err2str(ret));
+        if (exit_on_error)
+            return ret;
+    }
+
+    while (1) {
+        ret = avcodec_receive_frame(c->dec_ctx, c->frame);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF)
+            return chunk_filter_frame(c, NULL);
+        if (ret < 0)
+            return ret;
+
+        c->frame->pts = c->frame->best_effort_timestamp;
+        /* decoded again by the next chunk */
+        if (c->dec_end_pts != AV_NOPTS_VALUE && c->frame->pts != AV_NOPTS_VALUE &&
+            c->frame->pts >= c->dec_end_pts) {
+            av_frame_unref(c->frame);
+            continue;
+        }
+        ret = chunk_filter_frame(c, c->frame);
+        av_frame_unref(c->frame);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static void *chunk_thread(void *arg)
+{
+    Chunk *c = arg;
+    OutputChunks *oc = c->oc;
+    AVPacket *pkt;
+    int ret;
+
+    c->frame          = av_frame_alloc();
+    c->filtered_frame = av_frame_alloc();
+    c->pkt            = av_packet_alloc();
+    if (!c->frame || !c->filtered_frame || !c->pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    ret = chunk_open_decoder(c);
+    if (ret < 0)
+        goto finish;
+
+    while ((ret = chunk_get_packet(c, &pkt)) >= 0) {
+        ret = chunk_decode(c, pkt);
+        av_packet_free(&pkt);
+        if (ret < 0)
+            goto finish;
+    }
+    if (ret == AVERROR_EOF)
+        ret = chunk_decode(c, NULL);
+
+finish:
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_ERROR, "Error transcoding chunk %d of output stream #%d:%d: %s\n",
+               c->index, oc->ost->file_index, oc->ost->index, av_err2str(ret));
+
+    avfilter_graph_free(&c->graph);
+    avcodec_free_context(&c->dec_ctx);
+    avcodec_free_context(&c->enc_ctx);
+    av_frame_free(&c->frame);
+    av_frame_free(&c->filtered_frame);
+    av_packet_free(&c->pkt);
+
+    pthread_mutex_lock(&oc->lock);
+    c->ret     = ret;
+    c->out_eof = 1;
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+
+    return NULL;
+}
+
+/*
+ * Split the input stream duration in nb_chunks equal parts and move each cut
+ * point back to the closest keyframe in the index, if there is one.
+ */
+static void init_cut_points(OutputChunks *oc, InputFile *ifile)
+{
+    AVStream *st = oc->ist->st;
+    int64_t start    = st->start_time;
+    int64_t duration = st->duration;
+    int64_t offset;
+    int i, nb_cuts = 0;
+
+    if (start == AV_NOPTS_VALUE)
+        start = ifile->ctx->start_time == AV_NOPTS_VALUE ? 0 :
+                av_rescale_q(ifile->ctx->start_time, AV_TIME_BASE_Q, st->time_base);
+    if (duration <= 0 && ifile->ctx->duration > 0)
+        duration = av_rescale_q(ifile->ctx->duration, AV_TIME_BASE_Q, st->time_base);
+    if (duration <= 0) {
+        av_log(NULL, AV_LOG_WARNING, "Duration of input stream #%d:%d unknown, "
+               "output stream #%d:%d will be transcoded as a single chunk.\n",
+               oc->ist->file_index, st->index, oc->ost->file_index, oc->ost->index);
+        oc->nb_chunks = 1;
+        return;
+    }
+
+    /* the packets reach the chunks with the input file offset applied */
+    offset = av_rescale_q(ifile->ts_offset, AV_TIME_BASE_Q, st->time_base);
+
+    for (i = 1; i < oc->nb_chunks; i++) {
+        int64_t cut = start + av_rescale(duration, i, oc->nb_chunks);
+        int idx = av_index_search_timestamp(st, cut, AVSEEK_FLAG_BACKWARD);
+
+        /* the chunks are split at the first keyframe at or after the cut
+         * point, so an index is only needed to balance their sizes */
+        if (idx >= 0) {
+            int64_t ts = avformat_index_get_entry(st, idx)->timestamp;
+            if (ts > start && (!nb_cuts || ts + offset > oc->cut_ts[nb_cuts - 1]))
+                cut = ts;
+        }
+        if (nb_cuts && cut + offset <= oc->cut_ts[nb_cuts - 1])
+            continue;
+
+        oc->cut_ts[nb_cuts++] = cut + offset;
+        av_log(NULL, AV_LOG_VERBOSE, "Output stream #%d:%d: chunk %d starts at the first keyframe from %s\n",
+               oc->ost->file_index, oc->ost->index, nb_cuts,
+               av_ts2timestr(cut, &st->time_base));
+    }
+    oc->nb_chunks = nb_cuts + 1;
+}
+
+int chunks_init(OutputStream *ost)
+{
+    InputStream *ist = input_streams[ost->source_index];
+    InputFile *ifile = input_files[ist->file_index];
+    OutputChunks *oc;
+    int i, ret;
+
+    if (!ist->dec) {
+        av_log(NULL, AV_LOG_ERROR, "Decoder not found for input stream #%d:%d\n",
+               ist->file_index, ist->st->index);
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+
+    oc = av_mallocz(sizeof(*oc));
+    if (!oc)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&oc->lock, NULL);
+    if (ret) {
+        av_free(oc);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&oc->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&oc->lock);
+        av_free(oc);
+        return AVERROR(ret);
+    }
+    ost->chunks = oc;
+
+    oc->ost        = ost;
+    oc->ist        = ist;
+    oc->nb_chunks  = ost->parallel_chunks;
+    oc->queue_size = FFMAX(ost->chunk_queue_size, 1);
+    oc->par       = avcodec_parameters_alloc();
+    oc->cut_ts    = av_calloc(oc->nb_chunks, sizeof(*oc->cut_ts));
+    oc->chunks    = av_calloc(oc->nb_chunks, sizeof(*oc->chunks));
+    if (!oc->par || !oc->cut_ts || !oc->chunks)
+        return AVERROR(ENOMEM);
+
+    init_cut_points(oc, ifile);
+
+    for (i = 0; i < oc->nb_chunks; i++) {
+        Chunk *c = &oc->chunks[i];
+
+        c->oc        = oc;
+        c->index     = i;
+        c->end_pts   = AV_NOPTS_VALUE;
+        c->in_queue  = av_fifo_alloc(8 * sizeof(AVPacket*));
+        c->out_queue = av_fifo_alloc(8 * sizeof(AVPacket*));
+        if (!c->in_queue || !c->out_queue)
+            return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < oc->nb_chunks; i++) {
+        ret = pthread_create(&oc->chunks[i].thread, NULL, chunk_thread, &oc->chunks[i]);
+        if (ret) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s.\n", strerror(ret));
+            return AVERROR(ret);
+        }
+        oc->nb_threads++;
+    }
+
+    return 0;
+}
+
+void chunks_uninit(OutputStream *ost)
+{
+    OutputChunks *oc = ost->chunks;
+    int i;
+
+    if (!oc)
+        return;
+
+    pthread_mutex_lock(&oc->lock);
+    oc->abort = 1;
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+
+    for (i = 0; i < oc->nb_threads; i++)
+        pthread_join(oc->chunks[i].thread, NULL);
+
+    if (oc->nb_threads)
+        av_log(NULL, AV_LOG_VERBOSE, "Output stream #%d:%d: at most %d input and "
+               "%d output packets queued per chunk\n", ost->file_index, ost->index,
+               oc->max_in_queued, oc->max_out_queued);
+
+    for (i = 0; oc->chunks && i < oc->nb_chunks; i++) {
+        free_queue(&oc->chunks[i].in_queue);
+        free_queue(&oc->chunks[i].out_queue);
+    }
+
+    pthread_cond_destroy(&oc->cond);
+    pthread_mutex_destroy(&oc->lock);
+    avcodec_parameters_free(&oc->par);
+    av_freep(&oc->cut_ts);
+    av_freep(&oc->chunks);
+    av_freep(&ost->chunks);
+}
+
+int chunks_send_packet(OutputStream *ost, const AVPacket *pkt)
+{
+    OutputChunks *oc = ost->chunks;
+    int ret;
+
+    if (!pkt) {
+        int i;
+
+        pthread_mutex_lock(&oc->lock);
+        for (i = 0; i < oc->nb_chunks; i++)
+            oc->chunks[i].in_eof = 1;
+        oc->cur_in  = oc->nb_chunks - 1;
+        oc->leading = NULL;
+        pthread_cond_broadcast(&oc->cond);
+        pthread_mutex_unlock(&oc->lock);
+        return 0;
+    }
+
+    pthread_mutex_lock(&oc->lock);
+
+    if (oc->leading) {
+        Chunk *prev = oc->leading;
+
+        /* with open GOPs, the frames following the keyframe in decoding order
+         * but preceding it in presentation order may reference the previous
+         * GOP, so they are decoded by the previous chunk */
+        if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < prev->end_pts) {
+            ret = chunk_queue_input(prev, pkt);
+            goto end;
+        }
+        prev->in_eof = 1;
+        oc->leading  = NULL;
+    }
+
+    if (pkt->flags & AV_PKT_FLAG_KEY && pkt->dts != AV_NOPTS_VALUE &&
+        oc->cur_in < oc->nb_chunks - 1) {
+        int64_t ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : FFMAX(pkt->pts, pkt->dts);
+        Chunk *prev = &oc->chunks[oc->cur_in];
+
+        if (ts >= oc->cut_ts[oc->cur_in]) {
+            /* chunks whose cut points all fall within this GOP stay empty */
+            while (++oc->cur_in < oc->nb_chunks - 1 && ts >= oc->cut_ts[oc->cur_in])
+                oc->chunks[oc->cur_in].in_eof = 1;
+
+            /* the leading frames may reference the keyframe, so the
+             * previous chunk decodes it too, dropping the decoded frame */
+            if (pkt->pts != AV_NOPTS_VALUE) {
+                prev->end_pts = pkt->pts;
+                oc->leading   = prev;
+                ret = chunk_queue_input(prev, pkt);
+                if (ret < 0)
+                    goto end;
+            } else {
+                prev->in_eof = 1;
+            }
+        }
+    }
+    ret = chunk_queue_input(&oc->chunks[oc->cur_in], pkt);
+
+end:
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+    return ret;
+}
+
+int chunks_wait_input(OutputStream *ost)
+{
+    OutputChunks *oc = ost->chunks;
+    int ret;
+
+    pthread_mutex_lock(&oc->lock);
+    while (1) {
+        Chunk *out = oc->cur_out < oc->nb_chunks ? &oc->chunks[oc->cur_out] : NULL;
+
+        /* the next packet goes to the current chunk, to the chunk still
+         * receiving leading frames, or to a chunk which is still empty */
+        if (chunk_input_ready(oc, &oc->chunks[oc->cur_in]) &&
+            (!oc->leading || chunk_input_ready(oc, oc->leading))) {
+            ret = 0;
+            break;
+        }
+        /* the chunks may be waiting for the muxer */
+        if (!out || av_fifo_size(out->out_queue) || out->out_eof) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    }
+    pthread_mutex_unlock(&oc->lock);
+
+    return ret;
+}
+
+int chunks_get_parameters(OutputStream *ost, AVCodecParameters *par,
+                          AVRational *time_base, AVRational *frame_rate, int block)
+{
+    OutputChunks *oc = ost->chunks;
+    int i, ret = 0;
+
+    pthread_mutex_lock(&oc->lock);
+    while (!oc->par_ready) {
+        /* all the chunks exited without opening an encoder */
+        for (i = 0; i < oc->nb_chunks && oc->chunks[i].out_eof; i++)
+            if (oc->chunks[i].ret < 0 && oc->chunks[i].ret != AVERROR_EOF) {
+                ret = oc->chunks[i].ret;
+                goto end;
+            }
+        if (i == oc->nb_chunks) {
+            ret = AVERROR_EOF;
+            goto end;
+        }
+        if (!block) {
+            ret = AVERROR(EAGAIN);
+            goto end;
+        }
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    }
+
+    if (par)
+        ret = avcodec_parameters_copy(par, oc->par);
+    if (time_base)
+        *time_base = oc->time_base;
+    if (frame_rate)
+        *frame_rate = oc->frame_rate;
+
+end:
+    pthread_mutex_unlock(&oc->lock);
+    return ret;
+}
+
+int chunks_receive_packet(OutputStream *ost, AVPacket *pkt, int block)
+{
+    OutputChunks *oc = ost->chunks;
+    AVPacket *queue_pkt = NULL;
+    int ret;
+
+    pthread_mutex_lock(&oc->lock);
+    while (1) {
+        Chunk *c;
+
+        if (oc->cur_out == oc->nb_chunks) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        c = &oc->chunks[oc->cur_out];
+
+        if (av_fifo_size(c->out_queue)) {
+            av_fifo_generic_read(c->out_queue, &queue_pkt, sizeof(queue_pkt), NULL);
+            pthread_cond_broadcast(&oc->cond);
+            ret = 0;
+            break;
+        }
+        if (c->out_eof) {
+            if (c->ret < 0 && c->ret != AVERROR_EOF) {
+                ret = c->ret;
+                break;
+            }
+            oc->cur_out++;
+            continue;
+        }
+        if (!block) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    }
+    pthread_mutex_unlock(&oc->lock);
+
+    if (queue_pkt) {
+        av_packet_move_ref(pkt, queue_pkt);
+        av_packet_free(&queue_pkt);
+    }
+    return ret;
+}
+
+#else
+
+int chunks_init(OutputStream *ost)
+{
+    av_log(NULL, AV_LOG_ERROR, "Chunked transcoding requires threading support.\n");
+    return AVERROR(ENOSYS);
+}
+
+void chunks_uninit(OutputStream *ost)
+{
+}
+
+int chunks_send_packet(OutputStream *ost, const AVPacket *pkt)
+{
+    return AVERROR(ENOSYS);
+}
+
+int chunks_wait_input(OutputStream *ost)
+{
+    return AVERROR(ENOSYS);
+}
+
+int chunks_get_parameters(OutputStream *ost, AVCodecParameters *par,
+                          AVRational *time_base, AVRational *frame_rate, int block)
+{
+    return AVERROR(ENOSYS);
+}
+
+int chunks_receive_packet(OutputStream *ost, AVPacket *pkt, int block)
+{
+    return AVERROR(ENOSYS);
+}
+
+#endif /* HAVE_THREADS */
@@ -161,11 +161,39 @@ DEF_CHOOSE_FORMAT(channel_layouts, uint64_t, channel_layout, channel_layouts, 0,
 
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
 {
-    FilterGraph *fg = av_mallocz(sizeof(*fg));
+    FilterGraph *fg;
+    int i;
+
+    /* with -scale_ladder, all unfiltered video outputs of one input stream
+     * share a single graph, see configure_ladder() */
+    if (scale_ladder && ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+        !strcmp(ost->avfilter, "null")) {
+        for (i = 0; i < nb_filtergraphs; i++) {
+            OutputFilter *ofilter;
+
+            fg = filtergraphs[i];
+            if (!fg->ladder || fg->inputs[0]->ist != ist)
+                continue;
+
+            GROW_ARRAY(fg->outputs, fg->nb_outputs);
+            if (!(ofilter = av_mallocz(sizeof(*ofilter))))
+                exit_program(1);
+            ofilter->ost    = ost;
+            ofilter->graph  = fg;
+            ofilter->format = -1;
+            fg->outputs[fg->nb_outputs - 1] = ofilter;
 
+            ost->filter = ofilter;
+            return 0;
+        }
+    }
+
+    fg = av_mallocz(sizeof(*fg));
     if (!fg)
         exit_program(1);
     fg->index = nb_filtergraphs;
+    fg->ladder = scale_ladder && ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+                 !strcmp(ost->avfilter, "null");
 
     GROW_ARRAY(fg->outputs, fg->nb_outputs);
     if (!(fg->outputs[0] = av_mallocz(sizeof(*fg->outputs[0]))))
@@ -434,7 +462,9 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     if (ret < 0)
         return ret;
 
-    if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale) {
+    /* in a scale ladder, outputs with a size are already fed by their rung */
+    if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale &&
+        !(fg->ladder && ofilter->width && ofilter->height)) {
         char args[255];
         AVFilterContext *filter;
         AVDictionaryEntry *e = NULL;
@@ -952,6 +982,202 @@ static void cleanup_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
 }
 
+static int ladder_split(FilterGraph *fg, AVFilterContext **node,
+                        int nb_outputs, const char *name)
+{
+    AVFilterContext *split;
+    char args[16];
+    int ret;
+
+    if (nb_outputs < 2)
+        return 0;
+
+    snprintf(args, sizeof(args), "%d", nb_outputs);
+    ret = avfilter_graph_create_filter(&split, avfilter_get_by_name("split"),
+                                       name, args, NULL, fg->graph);
+    if (ret < 0)
+        return ret;
+    if ((ret = avfilter_link(*node, 0, split, 0)) < 0)
+        return ret;
+
+    *node = split;
+    return 0;
+}
+
+typedef struct LadderRung {
+    int width, height;
+    OutputFilter *ofilter;  /* first output of this size, provides sws opts */
+} LadderRung;
+
+/**
+ * Build the graph of a scale ladder: the decoded frames are converted once,
+ * then scaled down rung by rung, largest size first, each rung feeding the
+ * outputs of its size and the next smaller rung. Outputs without an explicit
+ * size are fed directly from the root.
+ */
+static int configure_ladder(FilterGraph *fg, AVFilterInOut **inputs,
+                            AVFilterInOut **outputs)
+{
+    AVFilterInOut **outs = NULL;
+    AVFilterContext *node;
+    LadderRung *rungs = NULL;
+    int *rung = NULL;
+    char *pix_fmts = NULL, name[255];
+    int nb_rungs = 0, nb_root = 0, pad = 0;
+    int i, j, k, ret;
+
+    *inputs  = NULL;
+    *outputs = NULL;
+
+    outs  = av_mallocz_array(fg->nb_outputs, sizeof(*outs));
+    rungs = av_malloc_array(fg->nb_outputs, sizeof(*rungs));
+    rung  = av_malloc_array(fg->nb_outputs, sizeof(*rung));
+    if (!outs || !rungs || !rung) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < fg->nb_outputs; i++) {
+        OutputFilter *ofilter = fg->outputs[i];
+
+        if (!(ofilter->width && ofilter->height && ofilter->ost->autoscale))
+            continue;
+        for (j = 0; j < nb_rungs; j++)
+            if (rungs[j].width  == ofilter->width &&
+                rungs[j].height == ofilter->height)
+                break;
+        if (j < nb_rungs)
+            continue;
+
+        /* keep the rungs sorted by decreasing area */
+        for (j = nb_rungs; j > 0; j--) {
+            if ((int64_t)rungs[j - 1].width * rungs[j - 1].height >=
+                (int64_t)ofilter->width * ofilter->height)
+                break;
+            rungs[j] = rungs[j - 1];
+        }
+        rungs[j].width   = ofilter->width;
+        rungs[j].height  = ofilter->height;
+        rungs[j].ofilter = ofilter;
+        nb_rungs++;
+    }
+
+    for (i = 0; i < fg->nb_outputs; i++) {
+        OutputFilter *ofilter = fg->outputs[i];
+
+        rung[i] = -1;
+        if (ofilter->width && ofilter->height && ofilter->ost->autoscale) {
+            for (j = 0; j < nb_rungs; j++)
+                if (rungs[j].width  == ofilter->width &&
+                    rungs[j].height == ofilter->height)
+                    rung[i] = j;
+        }
+        if (rung[i] < 0)
+            nb_root++;
+
+        if (!(outs[i] = avfilter_inout_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if (i > 0)
+            outs[i - 1]->next = outs[i];
+    }
+    *outputs = outs[0];
+
+    /* convert to the output pixel format before scaling if all the outputs
+     * agree on it, so that it is done only once */
+    for (i = 0; i < fg->nb_outputs; i++) {
+        char *fmts = choose_pix_fmts(fg->outputs[i]);
+
+        if (!i) {
+            pix_fmts = fmts;
+        } else if (!fmts || !pix_fmts || strcmp(fmts, pix_fmts)) {
+            av_freep(&pix_fmts);
+            av_freep(&fmts);
+            break;
+        } else {
+            av_freep(&fmts);
+        }
+    }
+
+    snprintf(name, sizeof(name), "ladder_in_%d", fg->index);
+    ret = avfilter_graph_create_filter(&node, avfilter_get_by_name(pix_fmts ? "format" : "null"),
+                                       name, pix_fmts, NULL, fg->graph);
+    if (ret < 0)
+        goto fail;
+
+    if (!(*inputs = avfilter_inout_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    (*inputs)->filter_ctx = node;
+    (*inputs)->pad_idx    = 0;
+
+    snprintf(name, sizeof(name), "ladder_split_in_%d", fg->index);
+    ret = ladder_split(fg, &node, nb_root + !!nb_rungs, name);
+    if (ret < 0)
+        goto fail;
+    for (i = 0; i < fg->nb_outputs; i++) {
+        if (rung[i] >= 0)
+            continue;
+        outs[i]->filter_ctx = node;
+        outs[i]->pad_idx    = pad++;
+    }
+
+    for (k = 0; k < nb_rungs; k++) {
+        OutputStream *ost = rungs[k].ofilter->ost;
+        AVFilterContext *scale;
+        AVDictionaryEntry *e = NULL;
+        char args[255];
+        int nb_consumers = k < nb_rungs - 1;
+
+        snprintf(args, sizeof(args), "%d:%d", rungs[k].width, rungs[k].height);
+        while ((e = av_dict_get(ost->sws_dict, "", e,
+                                AV_DICT_IGNORE_SUFFIX))) {
+            av_strlcatf(args, sizeof(args), ":%s=%s", e->key, e->value);
+        }
+
+        snprintf(name, sizeof(name), "ladder_scale_%d_%d", fg->index, k);
+        ret = avfilter_graph_create_filter(&scale, avfilter_get_by_name("scale"),
+                                           name, args, NULL, fg->graph);
+        if (ret < 0)
+            goto fail;
+        if ((ret = avfilter_link(node, pad, scale, 0)) < 0)
+            goto fail;
+        node = scale;
+        pad  = 0;
+
+        for (i = 0; i < fg->nb_outputs; i++)
+            nb_consumers += rung[i] == k;
+
+        snprintf(name, sizeof(name), "ladder_split_%d_%d", fg->index, k);
+        ret = ladder_split(fg, &node, nb_consumers, name);
+        if (ret < 0)
+            goto fail;
+        for (i = 0; i < fg->nb_outputs; i++) {
+            if (rung[i] != k)
+                continue;
+            outs[i]->filter_ctx = node;
+            outs[i]->pad_idx    = pad++;
+        }
+    }
+
+    ret = 0;
+fail:
+    if (ret < 0) {
+        avfilter_inout_free(inputs);
+        /* the outputs are chained as they are allocated */
+        if (outs)
+            avfilter_inout_free(&outs[0]);
+        *outputs = NULL;
+    }
+    av_freep(&pix_fmts);
+    av_freep(&outs);
+    av_freep(&rungs);
+    av_freep(&rung);
+    return ret;
+}
+
 int configure_filtergraph(FilterGraph *fg)
 {
     AVFilterInOut *inputs, *outputs, *cur;
@@ -962,6 +1188,7 @@ int configure_filtergraph(FilterGraph *fg)
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->measure_processing_time = stage_stats;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1001,16 +1228,22 @@ int configure_filtergraph(FilterGraph *fg)
             av_opt_set(fg->graph, "threads", e->value, 0);
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
+        if (filter_complex_parallel)
+            fg->graph->thread_type |= AVFILTER_THREAD_GRAPH;
     }
 
-    if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
+    if (fg->ladder)
+        ret = configure_ladder(fg, &inputs, &outputs);
+    else
+        ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs);
+    if (ret < 0)
         goto fail;
 
     ret = hw_device_setup_for_filter(fg);
     if (ret < 0)
         goto fail;
 
-    if (simple && (!inputs || inputs->next || !outputs || outputs->next)) {
+    if (simple && !fg->ladder && (!inputs || inputs->next || !outputs || outputs->next)) {
         const char *num_inputs;
         const char *num_outputs;
         if (!outputs) {
@@ -89,6 +89,11 @@ static const char *const opt_name_pass[]                      = {"pass", NULL};
 static const char *const opt_name_passlogfiles[]              = {"passlogfile", NULL};
 static const char *const opt_name_max_muxing_queue_size[]     = {"max_muxing_queue_size", NULL};
 static const char *const opt_name_muxing_queue_data_threshold[] = {"muxing_queue_data_threshold", NULL};
+static const char *const opt_name_enc_thread_queue_size[]     = {"enc_thread_queue_size", NULL};
+static const char *const opt_name_filter_thread_queue_size[]  = {"filter_thread_queue_size", NULL};
+static const char *const opt_name_dec_thread_queue_size[]     = {"dec_thread_queue_size", NULL};
+static const char *const opt_name_parallel_chunks[]           = {"parallel_chunks", NULL};
+static const char *const opt_name_chunk_queue_size[]          = {"chunk_queue_size", NULL};
 static const char *const opt_name_guess_layout_max[]          = {"guess_layout_max", NULL};
 static const char *const opt_name_apad[]                      = {"apad", NULL};
 static const char *const opt_name_discard[]                   = {"discard", NULL};
@@ -173,9 +178,12 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int filter_complex_parallel = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
+int scale_ladder = 0;
 int64_t stats_period = 500000;
+int stage_stats = 0;
 
 
 static int intra_only         = 0;
@@ -832,6 +840,8 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         ist->reinit_filters = -1;
         MATCH_PER_STREAM_OPT(reinit_filters, i, ist->reinit_filters, ic, st);
 
+        MATCH_PER_STREAM_OPT(dec_thread_queue_size, i, ist->dec_thread_queue_size, ic, st);
+
         MATCH_PER_STREAM_OPT(discard, str, discard_str, ic, st);
         ist->user_set_discard = AVDISCARD_NONE;
 
@@ -1583,6 +1593,14 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
     ost->muxing_queue_data_threshold = 50*1024*1024;
     MATCH_PER_STREAM_OPT(muxing_queue_data_threshold, i, ost->muxing_queue_data_threshold, oc, st);
 
+    MATCH_PER_STREAM_OPT(enc_thread_queue_size, i, ost->enc_thread_queue_size, oc, st);
+    MATCH_PER_STREAM_OPT(filter_thread_queue_size, i, ost->filter_thread_queue_size, oc, st);
+
+    MATCH_PER_STREAM_OPT(parallel_chunks, i, ost->parallel_chunks, oc, st);
+
+    ost->chunk_queue_size = 512;
+    MATCH_PER_STREAM_OPT(chunk_queue_size, i, ost->chunk_queue_size, oc, st);
+
     if (oc->oformat->flags & AVFMT_GLOBALHEADER)
         ost->enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
@@ -2495,6 +2513,35 @@ loop_end:
     for (i = of->ost_index; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
 
+        if (ost->encoding_needed && ost->source_index >= 0 &&
+            ost->parallel_chunks > 1 &&
+            ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            InputStream *ist = input_streams[ost->source_index];
+
+            if (ost->enc_ctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+                av_log(NULL, AV_LOG_ERROR, "Two-pass encoding is not supported "
+                       "with -parallel_chunks for output stream #%d:%d\n",
+                       nb_output_files - 1, ost->st->index);
+                exit_program(1);
+            }
+            if (input_files[ist->file_index]->loop) {
+                av_log(NULL, AV_LOG_ERROR, "-stream_loop is not supported "
+                       "with -parallel_chunks for output stream #%d:%d\n",
+                       nb_output_files - 1, ost->st->index);
+                exit_program(1);
+            }
+
+            /* the chunks do their own decoding, filtering and encoding */
+            err = chunks_init(ost);
+            if (err < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error initializing the chunks of "
+                       "output stream #%d:%d\n", nb_output_files - 1, ost->st->index);
+                exit_program(1);
+            }
+            ost->encoding_needed = 0;
+            continue;
+        }
+
         if (ost->encoding_needed && ost->source_index >= 0) {
             InputStream *ist = input_streams[ost->source_index];
             ist->decoding_needed |= DECODING_FOR_OST;
@@ -3566,16 +3613,22 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_complex_parallel", OPT_BOOL | OPT_EXPERT,              { &filter_complex_parallel },
+        "run independent filters of -filter_complex graphs concurrently" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
     { "auto_conversion_filters", OPT_BOOL | OPT_EXPERT,              { &auto_conversion_filters },
         "enable automatic conversion filters globally" },
+    { "scale_ladder",   OPT_BOOL | OPT_EXPERT,                       { &scale_ladder },
+        "decode once and scale unfiltered video outputs of the same input in a cascade" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
     { "stats_period",    HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_stats_period },
         "set the period at which ffmpeg updates stats and -progress output", "time" },
+    { "stage_stats",    OPT_BOOL | OPT_EXPERT,                       { &stage_stats },
+        "add per-stage timing statistics as JSON to the -progress output" },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_attach },
         "add an attachment to the output file", "filename" },
@@ -3791,6 +3844,16 @@ const OptionDef options[] = {
         "maximum number of packets that can be buffered while waiting for all streams to initialize", "packets" },
     { "muxing_queue_data_threshold", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(muxing_queue_data_threshold) },
         "set the threshold after which max_muxing_queue_size is taken into account", "bytes" },
+    { "enc_thread_queue_size", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(enc_thread_queue_size) },
+        "run the encoder in a separate thread, queueing at most this many frames", "frames" },
+    { "filter_thread_queue_size", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(filter_thread_queue_size) },
+        "run the simple filtergraph in a separate thread, queueing at most this many frames", "frames" },
+    { "dec_thread_queue_size", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_INPUT, { .off = OFFSET(dec_thread_queue_size) },
+        "run the decoder in a separate thread, with at most this many packets in flight", "packets" },
+    { "parallel_chunks", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(parallel_chunks) },
+        "split the input at keyframes and transcode this many chunks in parallel", "chunks" },
+    { "chunk_queue_size", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(chunk_queue_size) },
+        "maximum number of packets queued for or by each chunk", "packets" },
 
     /* data codec support */
     { "dcodec", HAS_ARG | OPT_DATA | OPT_PERFILE | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT, { .func_arg = opt_data_codec },
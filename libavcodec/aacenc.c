@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "mpeg4audio.h"
 #include "sinewin.h"
+#include "thread.h"
 #include "profiles.h"
 
 #include "aac.h"
@@ -551,6 +552,147 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+typedef struct AACEncElementJob {
+    int start_ch;
+    FFPsyWindowInfo *wi;
+    int alloc;                  ///< psy bit reservoir allocation per channel
+    const FFPsyChannel *next_psy; ///< psy data of the channel after the element
+    int is_mode, tns_mode, pred_mode;
+} AACEncElementJob;
+
+/**
+ * Run the quantizer search and stereo/prediction tool decisions for one
+ * channel element. Apart from the PNS noise, nothing here touches the
+ * bitstream or another element, so elements can be searched concurrently
+ * on separate coder contexts.
+ */
+static void search_element(AVCodecContext *avctx, AACEncContext *s, int i,
+                           AACEncElementJob *job)
+{
+    FFPsyWindowInfo *wi = job->wi;
+    ChannelElement *cpe = &s->cpe[i];
+    SingleChannelElement *sce;
+    int tag     = s->chan_map[i+1];
+    int chans   = tag == TYPE_CPE ? 2 : 1;
+    int start_ch = job->start_ch;
+    int ch, w;
+    /* All elements draw their PNS noise from a single random stream, in
+     * element order. A worker waits for the previous element to be done with
+     * it and takes over the state of the main context. */
+    int pns_sync = s != avctx->priv_data && s->options.pns && s->coder->search_for_pns;
+
+    job->is_mode = job->tns_mode = job->pred_mode = 0;
+    s->psy.bitres.alloc = job->alloc;
+    s->cur_type         = tag;
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        if (s->options.pns && s->coder->mark_pns)
+            s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    if (pns_sync) {
+        ff_thread_await_progress2(avctx, i, i % avctx->thread_count, 1);
+        s->random_state = ((AACEncContext *)avctx->priv_data)->random_state;
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
+        sce = &cpe->ch[ch];
+        s->cur_channel = start_ch + ch;
+        if (s->options.tns && s->coder->search_for_tns)
+            s->coder->search_for_tns(s, sce);
+        if (s->options.tns && s->coder->apply_tns_filt)
+            s->coder->apply_tns_filt(s, sce);
+        if (sce->tns.present)
+            job->tns_mode = 1;
+        if (s->options.pns && s->coder->search_for_pns)
+            s->coder->search_for_pns(s, avctx, sce);
+    }
+    if (pns_sync) {
+        ((AACEncContext *)avctx->priv_data)->random_state = s->random_state;
+        ff_thread_report_progress2(avctx, i, i % avctx->thread_count, 1);
+    }
+    s->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(s, avctx, cpe);
+        if (cpe->is_mode) job->is_mode = 1;
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(s, sce);
+            if (cpe->ch[ch].ics.predictor_present) job->pred_mode = 1;
+        }
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(s, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(s, sce);
+        }
+        s->cur_channel = start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(s, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(s, sce, cpe->common_window);
+            if (sce->ics.ltp.present) job->pred_mode = 1;
+        }
+        s->cur_channel = start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(s, cpe);
+    }
+}
+
+static int search_element_thread(AVCodecContext *avctx, void *arg,
+                                 int jobnr, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ts = &s->thread_ctx[threadnr];
+    /* the first element is searched before the others are analyzed */
+    AACEncElementJob *job = (AACEncElementJob *)arg + jobnr + 1;
+
+    ts->lambda = s->lambda;
+    ts->psy    = s->psy;
+    if (job->next_psy) {
+        /* The common prediction search of a channel pair also reads the psy
+         * data of the channel after it, which the serial encoder has not
+         * analyzed yet for this frame. Hand it the previous frame's one. */
+        int chans = s->chan_map[jobnr + 2] == TYPE_CPE ? 2 : 1;
+        memcpy(&ts->psy_ch[job->start_ch], &s->psy.ch[job->start_ch],
+               chans * sizeof(*ts->psy_ch));
+        ts->psy_ch[job->start_ch + chans] = *job->next_psy;
+        ts->psy.ch = ts->psy_ch;
+    }
+    search_element(avctx, ts, jobnr + 1, job);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -564,6 +706,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    AACEncElementJob jobs[AAC_MAX_CHANNELS];
 
     /* add current frame to queue */
     if (frame) {
@@ -686,7 +829,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
@@ -696,8 +838,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -710,6 +850,12 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     if (sce->band_type[w] > RESERVED_BT)
                         sce->band_type[w] = 0;
             }
+            if (s->next_psy && i) {
+                s->next_psy[i - 1]   = s->psy.ch[start_ch];
+                jobs[i - 1].next_psy = &s->next_psy[i - 1];
+            }
+            /* The psy model keeps state across elements, so analysis stays in
+             * element order. */
             s->psy.bitres.alloc = -1;
             s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
             s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
@@ -719,82 +865,35 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
+            jobs[i].start_ch = start_ch;
+            jobs[i].wi       = wi;
+            jobs[i].alloc    = s->psy.bitres.alloc;
+            jobs[i].next_psy = s->next_psy ? &s->psy.ch[start_ch + chans] : NULL;
+            /* Analysis uses the cutoff set by the previous quantizer search.
+             * It only depends on lambda, so once the first element has been
+             * searched the others can be analyzed up front and searched
+             * concurrently. */
+            if (!i || !s->thread_ctx)
+                search_element(avctx, s, i, &jobs[i]);
+            start_ch += chans;
+        }
+        if (s->thread_ctx) {
+            ff_reset_entries(avctx);
+            ff_thread_report_progress2(avctx, 0, 0, 1);
+            avctx->execute2(avctx, search_element_thread, jobs, NULL, s->chan_map[0] - 1);
+        }
+
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            start_ch = jobs[i].start_ch;
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            is_mode   |= jobs[i].is_mode;
+            tns_mode  |= jobs[i].tns_mode;
+            pred_mode |= jobs[i].pred_mode;
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -811,7 +910,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                 s->cur_channel = start_ch + ch;
                 encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
             }
-            start_ch += chans;
         }
 
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
@@ -897,6 +995,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
@@ -904,6 +1003,12 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        ff_lpc_end(&s->thread_ctx[i].lpc);
+        av_freep(&s->thread_ctx[i].psy_ch);
+    }
+    av_freep(&s->thread_ctx);
+    av_freep(&s->next_psy);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
@@ -1099,6 +1204,33 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     ff_af_queue_init(avctx, &s->afq);
     ff_aac_tableinit();
 
+    /* Each worker searches whole channel elements on its own copy of the
+     * context, which carries the scratch buffers and quantizer cache. */
+    if (avctx->active_thread_type & FF_THREAD_SLICE &&
+        avctx->thread_count > 1 && s->chan_map[0] > 1) {
+        if ((ret = ff_alloc_entries(avctx, s->chan_map[0])) < 0)
+            return ret;
+        if (!FF_ALLOCZ_TYPED_ARRAY(s->thread_ctx, avctx->thread_count))
+            return AVERROR(ENOMEM);
+        for (i = 0; i < avctx->thread_count; i++) {
+            AACEncContext *ts = &s->thread_ctx[i];
+            memcpy(ts, s, sizeof(*ts));
+            ts->thread_ctx = NULL;
+            memset(&ts->lpc, 0, sizeof(ts->lpc));
+            ts->psy_ch = NULL;
+            s->nb_thread_ctx = i + 1;
+            if ((ret = ff_lpc_init(&ts->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                                   FF_LPC_TYPE_LEVINSON)) < 0)
+                return ret;
+            if (s->options.pred &&
+                !FF_ALLOCZ_TYPED_ARRAY(ts->psy_ch, s->channels + 1))
+                return AVERROR(ENOMEM);
+        }
+        if (s->options.pred &&
+            !FF_ALLOCZ_TYPED_ARRAY(s->next_psy, s->chan_map[0]))
+            return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
@@ -1143,7 +1275,8 @@ const AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
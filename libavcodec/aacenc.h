@@ -420,6 +420,11 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext *thread_ctx;            ///< per-thread coder contexts for slice threading
+    int nb_thread_ctx;
+    FFPsyChannel *next_psy;                      ///< psy data of the channel after each element from the previous frame
+    FFPsyChannel *psy_ch;                        ///< psy data of the element being searched by a thread context
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
@@ -127,8 +127,28 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    struct FlacEncodeJob *jobs;     ///< frames queued for threaded encoding
+    int nb_jobs;
+    int job_head;                   ///< oldest queued frame
+    int nb_pending;                 ///< queued frames not encoded yet
+    int nb_done;                    ///< encoded frames not returned yet
 } FlacEncodeContext;
 
+/**
+ * A frame encoded on a worker thread. Frames are independent apart from
+ * the frame number, MD5 and frame size statistics, which the main thread
+ * handles in input order.
+ */
+typedef struct FlacEncodeJob {
+    FlacEncodeContext *ctx;         ///< private copy of the encoder state
+    uint8_t *buf;
+    unsigned int buf_size;
+    int size;                       ///< encoded size or error code
+    int nb_samples;
+    int64_t pts;
+} FlacEncodeJob;
+
 
 /**
  * Write streaminfo metadata block to byte array.
@@ -428,7 +448,31 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 
     dprint_compression_options(s);
 
-    return ret;
+    if (ret < 0)
+        return ret;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        if (!FF_ALLOCZ_TYPED_ARRAY(s->jobs, avctx->thread_count))
+            return AVERROR(ENOMEM);
+        for (i = 0; i < avctx->thread_count; i++) {
+            FlacEncodeContext *js = av_malloc(sizeof(*js));
+            if (!js)
+                return AVERROR(ENOMEM);
+            memcpy(js, s, sizeof(*js));
+            js->md5ctx     = NULL;
+            js->md5_buffer = NULL;
+            js->jobs       = NULL;
+            memset(&js->lpc_ctx, 0, sizeof(js->lpc_ctx));
+            s->jobs[i].ctx = js;
+            s->nb_jobs     = i + 1;
+            ret = ff_lpc_init(&js->lpc_ctx, avctx->frame_size,
+                              s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -1275,9 +1319,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int buf_size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, buf_size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1285,10 +1329,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1309,7 +1354,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1321,6 +1366,139 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples loaded into s->frame.
+ * @return size of the encoded frame in bytes or a negative error code
+ */
+static int encode_frame_samples(FlacEncodeContext *s)
+{
+    int frame_bytes;
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+            return frame_bytes;
+        }
+    }
+
+    return frame_bytes;
+}
+
+
+static void update_frame_stats(FlacEncodeContext *s, AVCodecContext *avctx,
+                               AVPacket *avpkt, int out_bytes, int nb_samples)
+{
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+
+    avpkt->duration = ff_samples_to_time_base(avctx, nb_samples);
+
+    s->next_pts = avpkt->pts + avpkt->duration;
+}
+
+
+static int encode_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job   = &s->jobs[(s->job_head + jobnr) % s->nb_jobs];
+    FlacEncodeContext *js = job->ctx;
+    int frame_bytes;
+
+    frame_bytes = encode_frame_samples(js);
+    if (frame_bytes < 0) {
+        job->size = frame_bytes;
+        return 0;
+    }
+
+    av_fast_malloc(&job->buf, &job->buf_size, frame_bytes);
+    if (!job->buf) {
+        job->size = AVERROR(ENOMEM);
+        return 0;
+    }
+    job->size = write_frame(js, job->buf, frame_bytes);
+    return 0;
+}
+
+
+/**
+ * Queue a frame for threaded encoding, encode the queue once it is full or
+ * on flush, and return the oldest encoded frame.
+ */
+static int encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                 const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job;
+    int ret;
+
+    if (frame) {
+        FlacEncodeContext *js;
+
+        job = &s->jobs[(s->job_head + s->nb_done + s->nb_pending) % s->nb_jobs];
+        js  = job->ctx;
+
+        /* change max_framesize for small final frame */
+        if (frame->nb_samples < s->max_blocksize) {
+            s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                          s->channels,
+                                                          avctx->bits_per_raw_sample);
+        }
+        js->max_framesize = s->max_framesize;
+        js->frame_count   = s->frame_count++;
+
+        init_frame(js, frame->nb_samples);
+        copy_samples(js, frame->data[0]);
+
+        s->sample_count += frame->nb_samples;
+        if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+        job->nb_samples = frame->nb_samples;
+        job->pts        = frame->pts;
+        s->nb_pending++;
+    }
+
+    if (!s->nb_done && s->nb_pending &&
+        (s->nb_pending == s->nb_jobs || !frame)) {
+        avctx->execute2(avctx, encode_job, NULL, NULL, s->nb_pending);
+        s->nb_done    = s->nb_pending;
+        s->nb_pending = 0;
+    }
+
+    if (!s->nb_done)
+        return 0;
+
+    job = &s->jobs[s->job_head];
+    s->job_head = (s->job_head + 1) % s->nb_jobs;
+    s->nb_done--;
+    if (job->size < 0)
+        return job->size;
+
+    if ((ret = ff_get_encode_buffer(avctx, avpkt, job->size, 0)) < 0)
+        return ret;
+    memcpy(avpkt->data, job->buf, job->size);
+
+    avpkt->pts = job->pts;
+    update_frame_stats(s, avctx, avpkt, job->size, job->nb_samples);
+
+    *got_packet_ptr = 1;
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1329,6 +1507,12 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->nb_jobs && (frame || s->nb_pending || s->nb_done)) {
+        ret = encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+        if (ret < 0 || *got_packet_ptr || frame)
+            return ret;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1362,43 +1546,24 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     copy_samples(s, frame->data[0]);
 
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = encode_frame_samples(s);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, avpkt->data, avpkt->size);
 
     s->frame_count++;
     s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
-
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
 
-    s->next_pts = avpkt->pts + avpkt->duration;
+    avpkt->pts = frame->pts;
+    update_frame_stats(s, avctx, avpkt, out_bytes, frame->nb_samples);
 
     av_shrink_packet(avpkt, out_bytes);
 
@@ -1410,7 +1575,14 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
+    int i;
 
+    for (i = 0; i < s->nb_jobs; i++) {
+        ff_lpc_end(&s->jobs[i].ctx->lpc_ctx);
+        av_freep(&s->jobs[i].ctx);
+        av_freep(&s->jobs[i].buf);
+    }
+    av_freep(&s->jobs);
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
@@ -1462,7 +1634,7 @@ const AVCodec ff_flac_encoder = {
     .type           = AVMEDIA_TYPE_AUDIO,
     .id             = AV_CODEC_ID_FLAC,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
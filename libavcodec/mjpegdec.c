@@ -144,6 +144,12 @@ av_cold int ff_mjpeg_decode_init(AVCodecContext *avctx)
     avctx->colorspace = AVCOL_SPC_BT470BG;
     s->hwaccel_pix_fmt = s->hwaccel_sw_pix_fmt = AV_PIX_FMT_NONE;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        s->thread_ctx = av_malloc_array(avctx->thread_count, sizeof(*s->thread_ctx));
+        if (!s->thread_ctx)
+            return AVERROR(ENOMEM);
+    }
+
     if ((ret = init_default_huffman_tables(s)) < 0)
         return ret;
 
@@ -1418,28 +1424,17 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/* Decode the MCUs first_mb to end_mb - 1 of a scan, in raster order. */
+static int decode_scan_mbs(MJpegDecodeContext *s, int nb_components, int Ah,
+                           int Al, GetBitContext *mb_bitmask_gb,
+                           const AVFrame *reference, int first_mb, int end_mb)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mb, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
-    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
     int bytes_per_pixel = 1 + (s->bits > 8);
 
-    if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
-        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
-    }
-
-    s->restart_count = 0;
-
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
     chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
@@ -1450,95 +1445,237 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    for (mb = first_mb; mb < end_mb; mb++) {
+        const int copy_mb = mb_bitmask_gb && !get_bits1(mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+        mb_x = mb % s->mb_width;
+        mb_y = mb / s->mb_width;
+
+        if (s->restart_interval && !s->restart_count)
+            s->restart_count = s->restart_interval;
+
+        if (get_bits_left(&s->gb) < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
+                   -get_bits_left(&s->gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            uint8_t *ptr;
+            int n, h, v, x, y, c, j;
+            int block_offset;
+            n = s->nb_blocks[i];
+            c = s->comp_index[i];
+            h = s->h_scount[i];
+            v = s->v_scount[i];
+            x = 0;
+            y = 0;
+            for (j = 0; j < n; j++) {
+                block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
+                    ptr = data[c] + block_offset;
+                } else
+                    ptr = NULL;
+                if (!s->progressive) {
+                    if (copy_mb) {
+                        if (ptr)
+                            mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
+                                            linesize[c], s->avctx->lowres);
 
-            if (get_bits_left(&s->gb) < 0) {
-                av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
-                return AVERROR_INVALIDDATA;
-            }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
-
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
                     } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
+                        s->bdsp.clear_block(s->block);
+                        if (decode_block(s, s->block, i,
+                                         s->dc_index[i], s->ac_index[i],
+                                         s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
                                    "error y=%d x=%d\n", mb_y, mb_x);
                             return AVERROR_INVALIDDATA;
                         }
+                        if (ptr) {
+                            s->idsp.idct_put(ptr, linesize[c], s->block);
+                            if (s->bits & 7)
+                                shift_output(s, ptr, linesize[c]);
+                        }
                     }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
+                } else {
+                    int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                     (h * mb_x + x);
+                    int16_t *block = s->blocks[c][block_idx];
+                    if (Ah)
+                        block[0] += get_bits1(&s->gb) *
+                                    s->quant_matrixes[s->quant_sindex[i]][0] << Al;
+                    else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                                   s->quant_matrixes[s->quant_sindex[i]],
+                                                   Al) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
                     }
                 }
+                ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+                ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                        mb_x, mb_y, x, y, c, s->bottom_field,
+                        (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
             }
+        }
+
+        handle_rstn(s, nb_components);
+    }
+    return 0;
+}
+
+typedef struct ScanSliceArgs {
+    int nb_components;
+    int nb_segments;
+} ScanSliceArgs;
+
+static int decode_scan_segment(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegDecodeContext *t = &s->thread_ctx[threadnr];
+    const ScanSliceArgs *a = arg;
+    int nb_mbs   = s->mb_width * s->mb_height;
+    int first_mb = jobnr * s->restart_interval;
+    int end_mb   = jobnr == a->nb_segments - 1 ? nb_mbs :
+                                                 first_mb + s->restart_interval;
+    int i, ret;
 
-            handle_rstn(s, nb_components);
+    ret = init_get_bits8(&t->gb, s->segment_buffer + s->segment_offsets[jobnr],
+                         s->segment_offsets[jobnr + 1] - s->segment_offsets[jobnr]);
+    if (ret < 0)
+        return ret;
+    for (i = 0; i < a->nb_components; i++)
+        t->last_dc[i] = (4 << t->bits);
+
+    return decode_scan_mbs(t, a->nb_components, 0, 0, NULL, NULL,
+                           first_mb, end_mb);
+}
+
+/**
+ * Decode a baseline scan with restart markers using slice threads: the
+ * segments between the RSTn markers are entropy coded independently and
+ * are decoded concurrently, each with its own copy of the context.
+ *
+ * @return 0 on success, a negative error code on decoding errors, or 1 if
+ *         the segments could not be located and the scan must be decoded
+ *         serially
+ */
+static int decode_scan_threaded(MJpegDecodeContext *s, int nb_components)
+{
+    AVCodecContext *avctx = s->avctx;
+    ScanSliceArgs args = { .nb_components = nb_components };
+    int nb_mbs = s->mb_width * s->mb_height;
+    int nb_segments = (nb_mbs + s->restart_interval - 1) / s->restart_interval;
+    const uint8_t *src = s->raw_scan_buffer + get_bits_count(&s->gb) / 8;
+    const uint8_t *end = s->raw_scan_buffer + s->raw_scan_buffer_size;
+    uint8_t *dst;
+    int i, n = 1, *rets;
+
+    av_fast_padded_malloc(&s->segment_buffer, &s->segment_buffer_size, end - src);
+    av_fast_malloc(&s->segment_offsets, &s->segment_offsets_size,
+                   (nb_segments + 1) * sizeof(*s->segment_offsets));
+    av_fast_malloc(&s->segment_rets, &s->segment_rets_size,
+                   nb_segments * sizeof(*s->segment_rets));
+    if (!s->segment_buffer || !s->segment_offsets || !s->segment_rets)
+        return AVERROR(ENOMEM);
+
+    /* unescape the entropy coded data, splitting it on the RSTn markers;
+     * unlike in the unescaped buffer they are unambiguous in the raw data */
+    dst = s->segment_buffer;
+    s->segment_offsets[0] = 0;
+    while (src < end) {
+        uint8_t x = *src++;
+
+        if (x != 0xff) {
+            *dst++ = x;
+            continue;
         }
+        while (src < end && *src == 0xff)
+            src++;
+        if (src >= end)
+            break;
+        x = *src++;
+        if (!x) {
+            *dst++ = 0xff;
+        } else if (x >= RST0 && x <= RST7) {
+            if (n < nb_segments)
+                s->segment_offsets[n] = dst - s->segment_buffer;
+            n++;
+        } else
+            break;
     }
+    /* some encoders write a marker after the last segment */
+    if (n < nb_segments)
+        return 1;
+    s->segment_offsets[nb_segments] = dst - s->segment_buffer;
+    memset(dst, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    for (i = 0; i < avctx->thread_count; i++) {
+        MJpegDecodeContext *t = &s->thread_ctx[i];
+        memcpy(t, s, sizeof(*t));
+        /* the markers have already been removed from the segments */
+        t->restart_interval = 0;
+        t->restart_count    = 0;
+    }
+
+    args.nb_segments = nb_segments;
+    rets = s->segment_rets;
+    avctx->execute2(avctx, decode_scan_segment, &args, rets, nb_segments);
+
+    /* the next marker is searched for after the scan */
+    skip_bits_long(&s->gb, get_bits_left(&s->gb));
+
+    for (i = 0; i < nb_segments; i++)
+        if (rets[i] < 0)
+            return rets[i];
     return 0;
 }
 
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    int i, ret;
+    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+    }
+
+    s->restart_count = 0;
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    if (s->thread_ctx && !s->progressive && !s->interlaced && !mb_bitmask &&
+        s->restart_interval && s->restart_interval < s->mb_width * s->mb_height &&
+        s->raw_scan_buffer) {
+        ret = decode_scan_threaded(s, nb_components);
+        if (ret <= 0)
+            return ret;
+    }
+
+    return decode_scan_mbs(s, nb_components, Ah, Al,
+                           mb_bitmask ? &mb_bitmask_gb : NULL, reference,
+                           0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -2910,6 +3047,10 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
+    av_freep(&s->thread_ctx);
+    av_freep(&s->segment_buffer);
+    av_freep(&s->segment_offsets);
+    av_freep(&s->segment_rets);
 
     for (i = 0; i < 3; i++) {
         for (j = 0; j < 4; j++)
@@ -2964,7 +3105,7 @@ const AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .receive_frame  = ff_mjpeg_receive_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -167,6 +167,15 @@ typedef struct MJpegDecodeContext {
     enum AVPixelFormat hwaccel_pix_fmt;
     void *hwaccel_picture_private;
     struct JLSState *jls_state;
+
+    // Slice threading on restart intervals.
+    struct MJpegDecodeContext *thread_ctx; ///< per-thread copies of the context
+    uint8_t *segment_buffer;       ///< unescaped scan data
+    unsigned int segment_buffer_size;
+    int *segment_offsets;          ///< start of each restart segment in segment_buffer
+    unsigned int segment_offsets_size;
+    int *segment_rets;
+    unsigned int segment_rets_size;
 } MJpegDecodeContext;
 
 int ff_mjpeg_build_vlc(VLC *vlc, const uint8_t *bits_table,
@@ -33,6 +33,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -1315,6 +1316,8 @@ static int ff_filter_activate_default(AVFilterContext *filter)
 
 int ff_filter_activate(AVFilterContext *filter)
 {
+    int timed = filter->graph->measure_processing_time;
+    int64_t start = timed ? av_gettime_relative() : 0;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
@@ -1323,6 +1326,8 @@ int ff_filter_activate(AVFilterContext *filter)
     filter->ready = 0;
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    if (timed)
+        filter->processing_time += av_gettime_relative() - start;
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
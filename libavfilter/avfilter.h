@@ -326,6 +326,12 @@ typedef struct AVFilter {
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Activate independent filters of a graph concurrently. Only meaningful in
+ * AVFilterGraph.thread_type; filters that are neither neighbors nor share a
+ * neighbor may then run at the same time on different threads.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
 
 typedef struct AVFilterInternal AVFilterInternal;
 
@@ -417,6 +423,13 @@ struct AVFilterContext {
      * configured.
      */
     int extra_hw_frames;
+
+    /**
+     * Total wall-clock time spent processing in this filter, in microseconds.
+     * Only updated if AVFilterGraph.measure_processing_time is set.
+     * Set by libavfilter, must not be modified by the caller.
+     */
+    int64_t processing_time;
 };
 
 /**
@@ -851,6 +864,13 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If nonzero, libavfilter accumulates the time spent in each filter of
+     * the graph in AVFilterContext.processing_time. Disabled by default, as
+     * it reads the clock around every filter activation.
+     */
+    int measure_processing_time;
+
     /**
      * Private fields
      *
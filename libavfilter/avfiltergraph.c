@@ -50,12 +50,15 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "measure_processing_time", "Measure the time spent in each filter", OFFSET(measure_processing_time),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
     { NULL },
 };
 
@@ -78,6 +81,12 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_thread_activate(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters)
+{
+    av_assert0(0);
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -1385,6 +1394,76 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static int batch_overlaps(AVFilterContext *filter, unsigned mark)
+{
+    unsigned i;
+
+    if (filter->internal->batch_mark == mark)
+        return 1;
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i] && filter->inputs[i]->src->internal->batch_mark == mark)
+            return 1;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i] && filter->outputs[i]->dst->internal->batch_mark == mark)
+            return 1;
+    return 0;
+}
+
+static void batch_add(AVFilterContext *filter, unsigned mark)
+{
+    unsigned i;
+
+    filter->internal->batch_mark = mark;
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i])
+            filter->inputs[i]->src->internal->batch_mark = mark;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            filter->outputs[i]->dst->internal->batch_mark = mark;
+}
+
+/**
+ * Activate the most ready filter together with other ready filters that can
+ * run concurrently with it.
+ *
+ * Activating a filter only touches its links and its neighbors, so filters
+ * whose neighborhoods are disjoint are independent. Sinks additionally update
+ * the heap of sink links, so at most one of them is part of a batch.
+ */
+static int graph_run_batch(AVFilterGraph *graph, AVFilterContext *first)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    int nb_batch = 0, nb_sinks;
+    unsigned mark, i;
+
+    if (first->filter->flags_internal & FF_FILTER_FLAG_GRAPH_SERIAL)
+        return ff_filter_activate(first);
+
+    if (!(mark = ++gi->batch_mark))
+        mark = ++gi->batch_mark;
+
+    batch_add(first, mark);
+    gi->batch[nb_batch++] = first;
+    nb_sinks = !first->nb_outputs;
+
+    for (i = 0; i < graph->nb_filters && nb_batch < gi->max_batch; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        if (!filter->ready ||
+            filter->filter->flags_internal & FF_FILTER_FLAG_GRAPH_SERIAL ||
+            (nb_sinks && !filter->nb_outputs) ||
+            batch_overlaps(filter, mark))
+            continue;
+        batch_add(filter, mark);
+        gi->batch[nb_batch++] = filter;
+        nb_sinks += !filter->nb_outputs;
+    }
+
+    if (nb_batch == 1)
+        return ff_filter_activate(first);
+    return ff_graph_thread_activate(graph, gi->batch, nb_batch);
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
@@ -1397,5 +1476,7 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+    if (graph->internal->max_batch > 1)
+        return graph_run_batch(graph, filter);
     return ff_filter_activate(filter);
 }
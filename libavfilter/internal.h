@@ -130,10 +130,19 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Filters activated concurrently by ff_filter_graph_run_once() with
+     * AVFILTER_THREAD_GRAPH, at most max_batch of them.
+     */
+    AVFilterContext **batch;
+    int max_batch;
+    unsigned batch_mark;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    unsigned batch_mark;  ///< last batch this filter or a neighbor was part of
 };
 
 /**
@@ -338,6 +347,12 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter reaches other filters of the graph than its neighbors, e.g. by
+ * sending them commands, and must not run concurrently with any other filter.
+ */
+#define FF_FILTER_FLAG_GRAPH_SERIAL  (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -42,6 +42,12 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* graph threading, see ff_filter_graph_run_once() */
+    AVSliceThread *graph_thread;
+    pthread_mutex_t execute_lock;
+    AVFilterContext **batch;
+    int *batch_rets;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -52,11 +58,28 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void graph_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    c->batch_rets[jobnr] = ff_filter_activate(c->batch[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
 }
 
+static void graph_thread_uninit(AVFilterGraph *graph, ThreadContext *c)
+{
+    if (!c->graph_thread)
+        return;
+    avpriv_slicethread_free(&c->graph_thread);
+    pthread_mutex_destroy(&c->execute_lock);
+    av_freep(&c->batch_rets);
+    av_freep(&graph->internal->batch);
+    graph->internal->max_batch = 0;
+}
+
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
                           void *arg, int *ret, int nb_jobs)
 {
@@ -64,12 +87,18 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    /* filters running concurrently share the slice threads */
+    if (c->graph_thread)
+        pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    if (c->graph_thread)
+        pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
@@ -81,6 +110,48 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     return FFMAX(nb_threads, 1);
 }
 
+static int graph_thread_init(AVFilterGraph *graph, ThreadContext *c)
+{
+    int nb_threads, ret;
+
+    nb_threads = avpriv_slicethread_create(&c->graph_thread, c, graph_worker_func,
+                                           NULL, graph->nb_threads);
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->graph_thread);
+        return FFMIN(nb_threads, 0);
+    }
+
+    if ((ret = pthread_mutex_init(&c->execute_lock, NULL))) {
+        avpriv_slicethread_free(&c->graph_thread);
+        return AVERROR(ret);
+    }
+
+    graph->internal->batch = av_malloc_array(nb_threads, sizeof(*graph->internal->batch));
+    c->batch_rets          = av_malloc_array(nb_threads, sizeof(*c->batch_rets));
+    if (!graph->internal->batch || !c->batch_rets) {
+        graph_thread_uninit(graph, c);
+        return AVERROR(ENOMEM);
+    }
+    graph->internal->max_batch = nb_threads;
+
+    return 0;
+}
+
+int ff_graph_thread_activate(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters)
+{
+    ThreadContext *c = graph->internal->thread;
+    int i;
+
+    c->batch = filters;
+    avpriv_slicethread_execute(c->graph_thread, nb_filters, 0);
+
+    for (i = 0; i < nb_filters; i++)
+        if (c->batch_rets[i] < 0)
+            return c->batch_rets[i];
+    return c->batch_rets[0];
+}
+
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
     int ret;
@@ -105,12 +176,23 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH) {
+        ret = graph_thread_init(graph, graph->internal->thread);
+        if (ret < 0) {
+            ff_graph_thread_free(graph);
+            graph->internal->thread_execute = NULL;
+            return ret;
+        }
+    }
+
     return 0;
 }
 
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
-    if (graph->internal->thread)
+    if (graph->internal->thread) {
+        graph_thread_uninit(graph, graph->internal->thread);
         slice_thread_uninit(graph->internal->thread);
+    }
     av_freep(&graph->internal->thread);
 }
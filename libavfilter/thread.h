@@ -25,4 +25,13 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Activate nb_filters filters concurrently, see ff_filter_graph_run_once().
+ *
+ * @return the first error returned by an activate callback, or the return
+ *         value of the first filter
+ */
+int ff_graph_thread_activate(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters);
+
 #endif /* AVFILTER_THREAD_H */
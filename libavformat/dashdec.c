@@ -27,10 +27,12 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 #define MAX_BPRINT_READ_SIZE (UINT_MAX - 1)
 #define DEFAULT_MANIFEST_SIZE 8 * 1024
+#define MAX_INIT_SECTION_SIZE (1024 * 1024)
 
 struct fragment {
     int64_t url_offset;
@@ -116,6 +118,10 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    /* Fragment prefetching, the current fragment is read from memory
+     * instead of input when it was prefetched. */
+    PrefetchQueue *prefetch;
 };
 
 typedef struct DASHContext {
@@ -157,6 +163,9 @@ typedef struct DASHContext {
     int is_init_section_common_audio;
     int is_init_section_common_subtitle;
 
+    int prefetch_segments;
+    int64_t prefetch_size;
+    PrefetchContext *prefetch;
 } DASHContext;
 
 static int ishttp(char *url)
@@ -399,7 +408,8 @@ static void free_subtitle_list(DASHContext *c)
 }
 
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http)
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http,
+                    const AVIOInterruptCB *int_cb)
 {
     DASHContext *c = s->priv_data;
     AVDictionary *tmp = NULL;
@@ -441,7 +451,7 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
-    ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
+    ret = avio_open2(pb, url, AVIO_FLAG_READ, int_cb ? int_cb : c->interrupt_callback, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1582,29 +1592,69 @@ finish:
     return ret;
 }
 
+static struct fragment *copy_fragment(const struct fragment *src)
+{
+    struct fragment *seg = av_mallocz(sizeof(struct fragment));
+
+    if (!seg)
+        return NULL;
+    seg->url = av_strdup(src->url);
+    if (!seg->url) {
+        av_free(seg);
+        return NULL;
+    }
+    seg->size = src->size;
+    seg->url_offset = src->url_offset;
+    return seg;
+}
+
+/* Builds fragment seq_no of a representation using a template url */
+static struct fragment *get_template_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    if (!pls->url_template) {
+        av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
+        return NULL;
+    }
+    seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        av_free(seg);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
     int64_t max_seq_no = 0;
-    struct fragment *seg = NULL;
-    struct fragment *seg_ptr = NULL;
     DASHContext *c = pls->parent->priv_data;
 
     while (( !ff_check_interrupt(c->interrupt_callback)&& pls->n_fragments > 0)) {
         if (pls->cur_seq_no < pls->n_fragments) {
-            seg_ptr = pls->fragments[pls->cur_seq_no];
-            seg = av_mallocz(sizeof(struct fragment));
-            if (!seg) {
-                return NULL;
-            }
-            seg->url = av_strdup(seg_ptr->url);
-            if (!seg->url) {
-                av_free(seg);
-                return NULL;
-            }
-            seg->size = seg_ptr->size;
-            seg->url_offset = seg_ptr->url_offset;
-            return seg;
+            return copy_fragment(pls->fragments[pls->cur_seq_no]);
         } else if (c->is_live) {
             refresh_manifest(pls->parent);
         } else {
@@ -1624,45 +1674,136 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"]\n", min_seq_no, max_seq_no);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+    } else if (pls->cur_seq_no > pls->last_seq_no) {
+        return NULL;
     }
-    if (seg) {
-        char *tmpfilename;
-        if (!pls->url_template) {
-            av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
-            av_free(seg);
-            return NULL;
-        }
-        tmpfilename = av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            av_free(seg);
-            return NULL;
+
+    return get_template_fragment(pls, pls->cur_seq_no);
+}
+
+static int prefetch_open(void *opaque, AVIOContext **in, const char *url,
+                         int64_t offset, int64_t size, AVDictionary **opts,
+                         const AVIOInterruptCB *int_cb)
+{
+    struct representation *pls = opaque;
+    AVDictionary *opts2 = NULL;
+    int ret;
+
+    if (size >= 0) {
+        av_dict_set_int(&opts2, "offset", offset, 0);
+        av_dict_set_int(&opts2, "end_offset", offset + size, 0);
+    }
+
+    /* opts is private to the prefetch thread, so cookies can be updated */
+    ret = open_url(pls->parent, in, url, opts, opts2, NULL, int_cb);
+
+    av_dict_free(&opts2);
+    return ret;
+}
+
+/* Approximate duration of a fragment in AV_TIME_BASE units, only used to
+ * weigh fragments of different representations against each other */
+static int64_t get_fragment_duration(struct representation *pls)
+{
+    if (pls->fragment_timescale > 0) {
+        if (pls->fragment_duration > 0)
+            return av_rescale(pls->fragment_duration, AV_TIME_BASE, pls->fragment_timescale);
+        if (pls->n_timelines && pls->timelines[0]->duration > 0)
+            return av_rescale(pls->timelines[0]->duration, AV_TIME_BASE, pls->fragment_timescale);
+    }
+    return AV_TIME_BASE;
+}
+
+static int prefetch_queue(DASHContext *c, struct representation *pls,
+                          int64_t seq_no, int64_t ahead, const struct fragment *seg)
+{
+    char *url = av_mallocz(c->max_url_size);
+    int ret;
+
+    if (!url)
+        return AVERROR(ENOMEM);
+    ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+    ret = ff_prefetch_set(pls->prefetch, seq_no, ahead, url,
+                          seg->url_offset, seg->size, c->avio_opts);
+    av_free(url);
+    return ret;
+}
+
+/*
+ * Queues the current fragment and the ones following it for prefetching and
+ * drops the ones that left that window, e.g. after a seek. Called before
+ * opening the current fragment.
+ */
+static void prefetch_update(DASHContext *c, struct representation *pls)
+{
+    int64_t last = pls->n_fragments ? pls->n_fragments - 1 : pls->last_seq_no;
+    int64_t seq_no, ahead = 0, duration = get_fragment_duration(pls);
+
+    if (!pls->prefetch)
+        return;
+
+    last = FFMIN(last, pls->cur_seq_no + c->prefetch_segments);
+    ff_prefetch_window(pls->prefetch, pls->cur_seq_no, last);
+
+    for (seq_no = pls->cur_seq_no; seq_no <= last; seq_no++, ahead += duration) {
+        struct fragment *seg;
+        int ret;
+
+        /* only updates the distance of fragments that are already queued */
+        if (ff_prefetch_set(pls->prefetch, seq_no, ahead, NULL, 0, -1, NULL) > 0)
+            continue;
+
+        if (pls->n_fragments)
+            seg = copy_fragment(pls->fragments[seq_no]);
+        else
+            seg = get_template_fragment(pls, seq_no);
+        ret = seg ? prefetch_queue(c, pls, seq_no, ahead, seg) : AVERROR(ENOMEM);
+        free_fragment(&seg);
+        if (ret < 0)
+            break;
+    }
+}
+
+/*
+ * Starts prefetching for the given representations before their demuxers are
+ * opened, so that their initialization sections and first fragments are
+ * downloaded in parallel. A common initialization section is only loaded for
+ * the first representation, the others copy it.
+ */
+static int prefetch_start(AVFormatContext *s, struct representation **reps,
+                          int n_reps, int common_init)
+{
+    DASHContext *c = s->priv_data;
+    int i, ret;
+
+    for (i = 0; i < n_reps; i++) {
+        struct representation *pls = reps[i];
+
+        /* the demuxer may seek in fragments without initialization section */
+        if (pls->n_fragments && !pls->init_section)
+            continue;
+
+        pls->parent      = s;
+        pls->cur_seq_no  = calc_cur_seg_no(s, pls);
+        if (!pls->last_seq_no)
+            pls->last_seq_no = calc_max_seg_no(pls, c);
+
+        ret = ff_prefetch_add_queue(c->prefetch, &pls->prefetch, pls);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Failed to start prefetching: %s\n",
+                   av_err2str(ret));
+            continue;
         }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                av_free(seg);
-                return NULL;
-            }
+
+        if (pls->init_section && !(common_init && i > 0)) {
+            ret = prefetch_queue(c, pls, -1, 0, pls->init_section);
+            if (ret < 0)
+                return ret;
         }
-        av_free(tmpfilename);
-        seg->size = -1;
+        prefetch_update(c, pls);
     }
 
-    return seg;
+    return 0;
 }
 
 static int read_from_url(struct representation *pls, struct fragment *seg,
@@ -1674,7 +1815,10 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (ff_prefetch_reading(pls->prefetch))
+        ret = ff_prefetch_read(pls->prefetch, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1703,7 +1847,7 @@ static int open_input(DASHContext *c, struct representation *pls, struct fragmen
     ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
     av_log(pls->parent, AV_LOG_VERBOSE, "DASH request for url '%s', offset %"PRId64"\n",
            url, seg->url_offset);
-    ret = open_url(pls->parent, &pls->input, url, &c->avio_opts, opts, NULL);
+    ret = open_url(pls->parent, &pls->input, url, &c->avio_opts, opts, NULL, NULL);
 
 cleanup:
     av_free(url);
@@ -1715,7 +1859,6 @@ cleanup:
 
 static int update_init_section(struct representation *pls)
 {
-    static const int max_init_section_size = 1024 * 1024;
     DASHContext *c = pls->parent->priv_data;
     int64_t sec_size;
     int64_t urlsize;
@@ -1724,6 +1867,23 @@ static int update_init_section(struct representation *pls)
     if (!pls->init_section || pls->init_sec_buf)
         return 0;
 
+    if (pls->prefetch) {
+        uint8_t *buf = NULL;
+        unsigned int buf_size = 0, len = 0;
+
+        ret = ff_prefetch_take_buffer(pls->prefetch, -1, &buf, &buf_size, &len);
+        if (ret < 0)
+            return ret;
+        if (ret) {
+            av_free(pls->init_sec_buf);
+            pls->init_sec_buf             = buf;
+            pls->init_sec_buf_size        = buf_size;
+            pls->init_sec_data_len        = FFMIN(len, MAX_INIT_SECTION_SIZE);
+            pls->init_sec_buf_read_offset = 0;
+            return 0;
+        }
+    }
+
     ret = open_input(c, pls, pls->init_section);
     if (ret < 0) {
         av_log(pls->parent, AV_LOG_WARNING,
@@ -1736,13 +1896,13 @@ static int update_init_section(struct representation *pls)
     else if ((urlsize = avio_size(pls->input)) >= 0)
         sec_size = urlsize;
     else
-        sec_size = max_init_section_size;
+        sec_size = MAX_INIT_SECTION_SIZE;
 
     av_log(pls->parent, AV_LOG_DEBUG,
            "Downloading an initialization section of size %"PRId64"\n",
            sec_size);
 
-    sec_size = FFMIN(sec_size, max_init_section_size);
+    sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
 
     av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
 
@@ -1762,7 +1922,7 @@ static int update_init_section(struct representation *pls)
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && v->input) {
         return avio_seek(v->input, offset, whence);
     }
 
@@ -1776,7 +1936,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !ff_prefetch_reading(v->prefetch)) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1789,15 +1949,21 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
-        if (ret < 0) {
-            if (ff_check_interrupt(c->interrupt_callback)) {
-                ret = AVERROR_EXIT;
-                goto end;
+        prefetch_update(c, v);
+        if (v->prefetch && ff_prefetch_take(v->prefetch, v->cur_seq_no)) {
+            v->cur_seg_offset = 0;
+            v->cur_seg_size = v->cur_seg->size;
+        } else {
+            ret = open_input(c, v, v->cur_seg);
+            if (ret < 0) {
+                if (ff_check_interrupt(c->interrupt_callback)) {
+                    ret = AVERROR_EXIT;
+                    goto end;
+                }
+                av_log(v->parent, AV_LOG_WARNING, "Failed to open fragment of playlist\n");
+                v->cur_seq_no++;
+                goto restart;
             }
-            av_log(v->parent, AV_LOG_WARNING, "Failed to open fragment of playlist\n");
-            v->cur_seq_no++;
-            goto restart;
         }
     }
 
@@ -2074,6 +2240,25 @@ static int dash_read_header(AVFormatContext *s)
 
     if(c->n_videos)
         c->is_init_section_common_video = is_common_init_section_exist(c->videos, c->n_videos);
+    if(c->n_audios)
+        c->is_init_section_common_audio = is_common_init_section_exist(c->audios, c->n_audios);
+    if (c->n_subtitles)
+        c->is_init_section_common_subtitle = is_common_init_section_exist(c->subtitles, c->n_subtitles);
+
+    if (c->prefetch_segments > 0 && c->is_live) {
+        av_log(s, AV_LOG_WARNING, "Prefetching is not supported for live streams\n");
+    } else if (c->prefetch_segments > 0) {
+        ret = ff_prefetch_init(&c->prefetch, s, "DASH", c->prefetch_size, prefetch_open);
+        if (ret < 0)
+            goto fail;
+
+        /* load the start of all representations in parallel */
+        if (c->prefetch &&
+            ((ret = prefetch_start(s, c->videos, c->n_videos, c->is_init_section_common_video)) < 0 ||
+             (ret = prefetch_start(s, c->audios, c->n_audios, c->is_init_section_common_audio)) < 0 ||
+             (ret = prefetch_start(s, c->subtitles, c->n_subtitles, c->is_init_section_common_subtitle)) < 0))
+            goto fail;
+    }
 
     /* Open the demuxer for video and audio components if available */
     for (i = 0; i < c->n_videos; i++) {
@@ -2091,9 +2276,6 @@ static int dash_read_header(AVFormatContext *s)
         ++stream_index;
     }
 
-    if(c->n_audios)
-        c->is_init_section_common_audio = is_common_init_section_exist(c->audios, c->n_audios);
-
     for (i = 0; i < c->n_audios; i++) {
         rep = c->audios[i];
         if (i > 0 && c->is_init_section_common_audio) {
@@ -2109,9 +2291,6 @@ static int dash_read_header(AVFormatContext *s)
         ++stream_index;
     }
 
-    if (c->n_subtitles)
-        c->is_init_section_common_subtitle = is_common_init_section_exist(c->subtitles, c->n_subtitles);
-
     for (i = 0; i < c->n_subtitles; i++) {
         rep = c->subtitles[i];
         if (i > 0 && c->is_init_section_common_subtitle) {
@@ -2190,6 +2369,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            ff_prefetch_flush(pls->prefetch);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2251,6 +2431,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            ff_prefetch_release(cur->prefetch);
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2261,6 +2442,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_close(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
+    ff_prefetch_close(&c->prefetch);
     free_audio_list(c);
     free_video_list(c);
     free_subtitle_list(c);
@@ -2290,6 +2472,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    ff_prefetch_release(pls->prefetch);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2387,6 +2570,10 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead of the current one in the background",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1000, FLAGS},
+    {"prefetch_size", "Maximum memory used by prefetched segments",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -82,6 +82,12 @@ typedef struct FifoContext {
     atomic_int_least64_t queue_duration;
     int64_t last_sent_dts;
     int64_t timeshift;
+
+    /* Queue statistics, the depth is sampled after every queued packet */
+    int64_t nb_queued;
+    int64_t queue_depth_sum;
+    int queue_depth_max;
+    atomic_int_least64_t nb_dropped;
 } FifoContext;
 
 typedef struct FifoThreadContext {
@@ -193,6 +199,7 @@ static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
             av_log(avf, AV_LOG_VERBOSE, "Keyframe received, recovering...\n");
         } else {
             av_log(avf, AV_LOG_VERBOSE, "Dropping non-keyframe packet\n");
+            atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
             av_packet_unref(pkt);
             return 0;
         }
@@ -442,7 +449,15 @@ static void *fifo_consumer_thread(void *data)
          * set, the queue is flushed and flag cleared. */
         pthread_mutex_lock(&fifo->overflow_flag_lock);
         if (fifo->overflow_flag) {
-            av_thread_message_flush(queue);
+            FifoMessage flushed;
+
+            /* Drain the queue one message at a time rather than flushing it,
+             * so that exactly the discarded packets are counted as dropped. */
+            while (av_thread_message_queue_recv(queue, &flushed, AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+                if (flushed.type == FIFO_WRITE_PACKET)
+                    atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
+                free_message(&flushed);
+            }
             if (fifo->restart_with_keyframe)
                 fifo_thread_ctx.drop_until_keyframe = 1;
             fifo->overflow_flag = 0;
@@ -517,6 +532,7 @@ static int fifo_init(AVFormatContext *avf)
         return AVERROR(EINVAL);
     }
     atomic_init(&fifo->queue_duration, 0);
+    atomic_init(&fifo->nb_dropped, 0);
     fifo->last_sent_dts = AV_NOPTS_VALUE;
 
     oformat = av_guess_format(fifo->format, avf->url, NULL);
@@ -529,8 +545,11 @@ static int fifo_init(AVFormatContext *avf)
     if (ret < 0)
         return ret;
 
-    ret = av_thread_message_queue_alloc(&fifo->queue, (unsigned) fifo->queue_size,
-                                        sizeof(FifoMessage));
+    /* packets are sent by the muxing thread and received by the writer
+     * thread, which is also the only one flushing the queue */
+    ret = av_thread_message_queue_alloc2(&fifo->queue, (unsigned) fifo->queue_size,
+                                         sizeof(FifoMessage),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
@@ -587,12 +606,21 @@ static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
 
         if (overflow_set)
             av_log(avf, AV_LOG_WARNING, "FIFO queue full\n");
+        if (pkt)
+            atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
         ret = 0;
         goto fail;
     } else if (ret < 0) {
         goto fail;
     }
 
+    if (pkt) {
+        int depth = av_thread_message_queue_nb_elems(fifo->queue);
+        fifo->nb_queued++;
+        fifo->queue_depth_sum += FFMAX(depth, 0);
+        fifo->queue_depth_max  = FFMAX(fifo->queue_depth_max, depth);
+    }
+
     if (fifo->timeshift && pkt && pkt->dts != AV_NOPTS_VALUE)
         atomic_fetch_add_explicit(&fifo->queue_duration, next_duration(avf, pkt, &fifo->last_sent_dts), memory_order_relaxed);
 
@@ -638,6 +666,13 @@ static int fifo_write_trailer(AVFormatContext *avf)
         return AVERROR(ret);
     }
 
+    av_log(avf, AV_LOG_VERBOSE, "Queue statistics for '%s': %"PRId64" packets queued, "
+           "depth average %.1f maximum %d of %d, %"PRId64" packets dropped\n",
+           avf->url, fifo->nb_queued,
+           fifo->nb_queued ? (double)fifo->queue_depth_sum / fifo->nb_queued : 0.0,
+           fifo->queue_depth_max, fifo->queue_size,
+           (int64_t)atomic_load(&fifo->nb_dropped));
+
     ret = fifo->write_trailer_ret;
     return ret;
 }
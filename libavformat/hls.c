@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -160,6 +161,10 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments downloaded in the background, the current segment is read
+     * from memory instead of input when it was prefetched. */
+    PrefetchQueue *prefetch;
 };
 
 /*
@@ -214,6 +219,11 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     AVIOContext *playlist_pb;
+
+    int prefetch_segments;
+    int64_t prefetch_size;
+    PrefetchContext *prefetch;
+    int prefetch_active;
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -622,8 +632,13 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
+/*
+ * If int_cb is not NULL, the url is opened with it rather than through
+ * s->io_open(), and has to be closed with avio_closep().
+ */
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out,
+                    const AVIOInterruptCB *int_cb)
 {
     HLSContext *c = s->priv_data;
     AVDictionary *tmp = NULL;
@@ -687,6 +702,9 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
             av_dict_copy(&tmp, opts2, 0);
             ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
         }
+    } else if (int_cb) {
+        ret = ffio_open_whitelist(pb, url, AVIO_FLAG_READ, int_cb, &tmp,
+                                  s->protocol_whitelist, s->protocol_blacklist);
     } else {
         ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
     }
@@ -1017,11 +1035,71 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static int prefetch_open(void *opaque, AVIOContext **in, const char *url,
+                         int64_t offset, int64_t size, AVDictionary **opts,
+                         const AVIOInterruptCB *int_cb)
+{
+    struct playlist *pls = opaque;
+    AVDictionary *opts2 = NULL;
+    int ret, is_http = 0;
+
+    if (size >= 0) {
+        av_dict_set_int(&opts2, "offset", offset, 0);
+        av_dict_set_int(&opts2, "end_offset", offset + size, 0);
+    }
+
+    ret = open_url(pls->parent, in, url, opts, opts2, &is_http, int_cb);
+    if (ret >= 0 && !is_http && offset) {
+        int64_t seekret = avio_seek(*in, offset, SEEK_SET);
+        if (seekret < 0) {
+            ret = seekret;
+            avio_closep(in);
+        }
+    }
+
+    av_dict_free(&opts2);
+    return ret;
+}
+
+/*
+ * Queues the segments following the current one for prefetching and drops
+ * the ones that left that window, e.g. after a seek. Called before opening the
+ * current segment.
+ */
+static void prefetch_update(HLSContext *c, struct playlist *pls)
+{
+    int64_t last = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                         pls->start_seq_no + pls->n_segments - 1);
+    int64_t seq_no, ahead = 0;
+
+    if (!pls->prefetch && ff_prefetch_add_queue(c->prefetch, &pls->prefetch, pls) < 0) {
+        c->prefetch_active = 0;
+        return;
+    }
+
+    ff_prefetch_window(pls->prefetch, pls->cur_seq_no, last);
+
+    for (seq_no = pls->cur_seq_no; seq_no <= last; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        /* only plain segments are prefetched, keys are fetched on opening */
+        const char *url = seq_no > pls->cur_seq_no && seg->key_type == KEY_NONE ?
+                          seg->url : NULL;
+
+        if (ff_prefetch_set(pls->prefetch, seq_no, ahead, url, seg->url_offset,
+                            seg->size, c->avio_opts) < 0)
+            break;
+        ahead += seg->duration;
+    }
+}
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
     int ret;
 
+    if (ff_prefetch_reading(pls->prefetch))
+        return ff_prefetch_read(pls->prefetch, buf, buf_size);
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -1251,12 +1329,12 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http, NULL);
     } else if (seg->key_type == KEY_AES_128) {
         char iv[33], key[33], url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
             AVIOContext *pb = NULL;
-            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL) == 0) {
+            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL, NULL) == 0) {
                 ret = avio_read(pb, pls->key, sizeof(pls->key));
                 if (ret != sizeof(pls->key)) {
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
@@ -1280,7 +1358,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
         av_dict_set(&opts, "key", key, 0);
         av_dict_set(&opts, "iv", iv, 0);
 
-        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http, NULL);
         if (ret < 0) {
             goto cleanup;
         }
@@ -1441,7 +1519,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !ff_prefetch_reading(v->prefetch)) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1512,7 +1591,14 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_active)
+            prefetch_update(c, v);
+
+        if (c->prefetch_active && ff_prefetch_take(v->prefetch, v->cur_seq_no)) {
+            /* the segment is read from memory */
+            ff_format_io_close(v->parent, &v->input);
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1532,7 +1618,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1542,7 +1628,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->prefetch_active &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1575,7 +1661,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (ff_prefetch_reading(v->prefetch)) {
+        ff_prefetch_release(v->prefetch);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1850,6 +1938,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    ff_prefetch_close(&c->prefetch);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -1876,6 +1965,13 @@ static int hls_read_header(AVFormatContext *s)
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
+    if (c->prefetch_segments > 0) {
+        ret = ff_prefetch_init(&c->prefetch, s, "HLS", c->prefetch_size, prefetch_open);
+        if (ret < 0)
+            goto fail;
+        c->prefetch_active = !!c->prefetch;
+    }
+
     /* XXX: Some HLS servers don't like being sent the range header,
        in this case, need to  setting http_seekable = 0 to disable
        the range header */
@@ -2103,6 +2199,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            ff_prefetch_flush(pls->prefetch);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2343,6 +2440,9 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        /* prefetched segments are kept, they are dropped on the next read if
+         * they are not close to the new position */
+        ff_prefetch_release(pls->prefetch);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2410,6 +2510,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
     {"seg_format_options", "Set options for segment demuxer",
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead of the current one in the background",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1000, FLAGS},
+    {"prefetch_size", "Maximum memory used by prefetched segments",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -235,6 +235,26 @@ typedef struct MOVStreamContext {
     uint32_t format;
 
     int has_sidx;  // If there is an sidx entry for this stream.
+    struct {
+        int enabled;               ///< index entries are built on demand in a window
+        int disabled;              ///< the full index is needed, never build it on demand
+        unsigned int nb_samples;   ///< number of index entries of the track
+        unsigned int sample_off;   ///< track sample of the first index entry
+        unsigned int first;        ///< index entry number of the first entry of the window
+        int key_off;               ///< offset of the sample numbers in stss and stps
+        int64_t start_dts;         ///< dts of the first track sample
+        int64_t *stts_dts;         ///< dts of the first sample of each stts entry, relative to start_dts
+        unsigned int *stts_sample; ///< first sample of each stts entry
+        unsigned int *stsc_sample; ///< first sample of each stsc entry
+        int rfps_added;            ///< the first entries were passed to ff_rfps_add_frame()
+        int edit;                  ///< an edit list entry is applied on the fly
+        unsigned int edit_first;   ///< first index entry that is not discarded
+        int64_t edit_time;         ///< media time of the edit
+        int64_t edit_duration;     ///< duration of the edit in the track timescale
+        MOVStts *ctts_data;        ///< ctts entries of the whole track while ctts_data is cut to the edit
+        unsigned int ctts_count;
+        unsigned int *ctts_sample; ///< first track sample of each entry of ctts_data, plus the total
+    } lazy;
     struct {
         struct AVAESCTR* aes_ctr;
         unsigned int per_sample_iv_size;  // Either 0, 8, or 16.
@@ -295,6 +315,7 @@ typedef struct MOVContext {
     uint8_t *decryption_key;
     int decryption_key_len;
     int enable_drefs;
+    int lazy_index;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
     int have_read_mfra_size;
     uint32_t mfra_size;
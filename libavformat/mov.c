@@ -3763,6 +3763,601 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+/* Number of index entries materialized at a time for lazily indexed tracks. */
+#define MOV_LAZY_INDEX_WINDOW 4096
+
+/**
+ * Return the number of elements of the sorted array tab that are not
+ * greater than val.
+ */
+static unsigned int mov_lazy_upper_bound(const unsigned int *tab, unsigned int n,
+                                         unsigned int val)
+{
+    unsigned int a = 0, b = n;
+
+    while (a < b) {
+        unsigned int m = a + (b - a) / 2;
+        if (tab[m] <= val)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static unsigned int mov_lazy_sample_size(MOVStreamContext *sc, unsigned int sample)
+{
+    return sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+}
+
+static int64_t mov_lazy_sample_dts(MOVStreamContext *sc, unsigned int sample)
+{
+    unsigned int i = mov_lazy_upper_bound(sc->lazy.stts_sample, sc->stts_count, sample) - 1;
+
+    return sc->lazy.start_dts + sc->lazy.stts_dts[i] +
+           (sample - sc->lazy.stts_sample[i]) * (int64_t)sc->stts_data[i].duration;
+}
+
+/**
+ * Get the composition offset of a track sample from the ctts entries of
+ * the whole track. Returns 0 if the sample has none.
+ */
+static int mov_lazy_sample_ctts(MOVStreamContext *sc, unsigned int sample, int *ctts)
+{
+    unsigned int i;
+
+    if (!sc->lazy.ctts_data)
+        return 0;
+    i = mov_lazy_upper_bound(sc->lazy.ctts_sample, sc->lazy.ctts_count + 1, sample);
+    if (i > sc->lazy.ctts_count)
+        return 0;
+    *ctts = sc->lazy.ctts_data[i - 1].duration;
+    return 1;
+}
+
+/* Same keyframe rules as mov_build_index(), minus sample groups. */
+static int mov_lazy_is_keyframe(MOVStreamContext *sc, int audio, unsigned int sample)
+{
+    unsigned int v = sample + sc->lazy.key_off, n;
+
+    if (!sc->keyframe_absent) {
+        if (!sc->keyframe_count)
+            return 1;
+        n = mov_lazy_upper_bound((const unsigned int *)sc->keyframes, sc->keyframe_count, v);
+        if (n && sc->keyframes[n - 1] == v)
+            return 1;
+    }
+    if (sc->stps_count) {
+        n = mov_lazy_upper_bound(sc->stps_data, sc->stps_count, v);
+        return n && sc->stps_data[n - 1] == v;
+    }
+    return sc->keyframe_absent && (audio || !sample);
+}
+
+static int64_t mov_lazy_search_sync_table(MOVStreamContext *sc, const unsigned int *tab,
+                                          unsigned int n, unsigned int sample, int backward)
+{
+    unsigned int v = sample + sc->lazy.key_off;
+    unsigned int i = mov_lazy_upper_bound(tab, n, v);
+
+    if (backward)
+        return i ? (int64_t)tab[i - 1] - sc->lazy.key_off : -1;
+    if (i && tab[i - 1] == v)
+        return sample;
+    return i < n && tab[i] - sc->lazy.key_off < sc->lazy.sample_off + sc->lazy.nb_samples ?
+           (int64_t)tab[i] - sc->lazy.key_off : -1;
+}
+
+/**
+ * Find the closest keyframe at or before (backward) or at or after the
+ * given sample. Returns -1 if there is none.
+ */
+static int64_t mov_lazy_find_keyframe(MOVStreamContext *sc, int audio,
+                                      unsigned int sample, int backward)
+{
+    int64_t key = -1, k;
+
+    if ((!sc->keyframe_absent && !sc->keyframe_count) ||
+        (sc->keyframe_absent && !sc->stps_count && audio))
+        return sample;
+
+    if (!sc->keyframe_absent)
+        key = mov_lazy_search_sync_table(sc, (const unsigned int *)sc->keyframes,
+                                         sc->keyframe_count, sample, backward);
+    if (sc->stps_count)
+        k = mov_lazy_search_sync_table(sc, sc->stps_data, sc->stps_count,
+                                       sample, backward);
+    else if (sc->keyframe_absent)
+        k = backward || !sample ? 0 : -1;
+    else
+        k = -1;
+
+    if (key < 0 || (k >= 0 && (backward ? k > key : k < key)))
+        key = k;
+    return key;
+}
+
+/**
+ * Return the last track sample with a dts not greater than the given one,
+ * or -1.
+ */
+static int64_t mov_lazy_search_dts(MOVStreamContext *sc, int64_t dts)
+{
+    unsigned int a = 0, b = sc->stts_count;
+    int64_t sample, duration, last = sc->lazy.sample_off + sc->lazy.nb_samples - 1;
+
+    dts -= sc->lazy.start_dts;
+    if (dts < 0)
+        return -1;
+
+    while (a < b) {
+        unsigned int m = a + (b - a) / 2;
+        if (sc->lazy.stts_dts[m] <= dts)
+            a = m + 1;
+        else
+            b = m;
+    }
+    a--;
+
+    duration = sc->stts_data[a].duration;
+    if (a + 1 < sc->stts_count)
+        sample = sc->lazy.stts_sample[a + 1] - 1;
+    else
+        sample = last;
+    if (duration > 0)
+        sample = FFMIN(sample, sc->lazy.stts_sample[a] + (dts - sc->lazy.stts_dts[a]) / duration);
+    return FFMIN(sample, last);
+}
+
+/**
+ * Equivalent of av_index_search_timestamp() over the whole track of a
+ * lazily indexed stream.
+ */
+static int mov_lazy_search_timestamp(AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    int backward = !!(flags & AVSEEK_FLAG_BACKWARD);
+    int64_t sample;
+
+    if (backward)
+        sample = mov_lazy_search_dts(sc, timestamp);
+    else
+        sample = FFMAX(mov_lazy_search_dts(sc, timestamp - 1) + 1, sc->lazy.sample_off);
+    if (sample < sc->lazy.sample_off || sample >= sc->lazy.sample_off + sc->lazy.nb_samples)
+        return -1;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        sample = mov_lazy_find_keyframe(sc, audio, sample, backward);
+    return sample >= sc->lazy.sample_off ? sample - sc->lazy.sample_off : -1;
+}
+
+/**
+ * Materialize the index entries of a window of samples around the given one.
+ */
+static int mov_lazy_index_fill(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    unsigned int first, nb, track_first, stts_index, stts_sample, stsc_index, chunk, chunk_sample, i;
+    int64_t dts, offset, prev_key;
+    AVIndexEntry *e;
+
+    e = av_fast_realloc(st->internal->index_entries,
+                        &st->internal->index_entries_allocated_size,
+                        MOV_LAZY_INDEX_WINDOW * sizeof(*e));
+    if (!e)
+        return AVERROR(ENOMEM);
+    st->internal->index_entries = e;
+
+    /* keep a few samples before the requested one, for retries and
+     * backward seeking */
+    first = sample - FFMIN(sample, MOV_LAZY_INDEX_WINDOW / 16);
+    nb    = FFMIN(sc->lazy.nb_samples - first, MOV_LAZY_INDEX_WINDOW);
+    track_first = sc->lazy.sample_off + first;
+
+    stts_index  = mov_lazy_upper_bound(sc->lazy.stts_sample, sc->stts_count, track_first) - 1;
+    stts_sample = track_first - sc->lazy.stts_sample[stts_index];
+    dts = sc->lazy.start_dts + sc->lazy.stts_dts[stts_index] +
+          stts_sample * (int64_t)sc->stts_data[stts_index].duration;
+
+    stsc_index   = mov_lazy_upper_bound(sc->lazy.stsc_sample, sc->stsc_count, track_first) - 1;
+    chunk_sample = track_first - sc->lazy.stsc_sample[stsc_index];
+    chunk        = sc->stsc_data[stsc_index].first - 1 + chunk_sample / sc->stsc_data[stsc_index].count;
+    chunk_sample = chunk_sample % sc->stsc_data[stsc_index].count;
+    offset = sc->chunk_offsets[chunk];
+    for (i = track_first - chunk_sample; i < track_first; i++)
+        offset += mov_lazy_sample_size(sc, i);
+
+    prev_key = mov_lazy_find_keyframe(sc, audio, track_first, 1);
+    if (prev_key < 0)
+        prev_key = 0;
+
+    for (i = 0; i < nb; i++) {
+        unsigned int size = mov_lazy_sample_size(sc, track_first + i);
+        int keyframe = mov_lazy_is_keyframe(sc, audio, track_first + i);
+
+        if (keyframe)
+            prev_key = track_first + i;
+        e[i].pos          = offset;
+        e[i].timestamp    = dts;
+        e[i].size         = size;
+        e[i].min_distance = track_first + i - prev_key;
+        e[i].flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+        if (sc->lazy.edit && first + i != sc->lazy.edit_first) {
+            /* same frames as mov_fix_index() drops */
+            int64_t cts = dts - sc->lazy.start_dts;
+            int ctts;
+
+            if (mov_lazy_sample_ctts(sc, track_first + i, &ctts))
+                cts += ctts;
+            if (first + i < sc->lazy.edit_first || cts < sc->lazy.edit_time ||
+                cts >= sc->lazy.edit_time + sc->lazy.edit_duration)
+                e[i].flags |= AVINDEX_DISCARD_FRAME;
+        }
+
+        offset += size;
+        dts    += sc->stts_data[stts_index].duration;
+        stts_sample++;
+        if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
+            stts_sample = 0;
+            stts_index++;
+        }
+        if (++chunk_sample == sc->stsc_data[stsc_index].count) {
+            chunk_sample = 0;
+            if (++chunk >= sc->chunk_count)
+                break;
+            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+                   chunk + 1 == sc->stsc_data[stsc_index + 1].first)
+                stsc_index++;
+            offset = sc->chunk_offsets[chunk];
+        }
+    }
+
+    sc->lazy.first = first;
+    st->internal->nb_index_entries = nb;
+    return 0;
+}
+
+/**
+ * Return the index entry of the given sample, or NULL if there is none.
+ * For lazily indexed streams the window is moved as needed, which
+ * invalidates entries returned earlier.
+ */
+static AVIndexEntry *mov_get_index_entry(AVStream *st, int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sample < 0)
+        return NULL;
+    if (!sc->lazy.enabled)
+        return sample < st->internal->nb_index_entries ?
+               &st->internal->index_entries[sample] : NULL;
+
+    if (sample >= sc->lazy.nb_samples)
+        return NULL;
+    if (sample < sc->lazy.first ||
+        sample >= sc->lazy.first + st->internal->nb_index_entries) {
+        if (mov_lazy_index_fill(st, sample) < 0)
+            return NULL;
+    }
+    return &st->internal->index_entries[sample - sc->lazy.first];
+}
+
+static void mov_lazy_index_free(MOVStreamContext *sc)
+{
+    sc->lazy.enabled    = 0;
+    sc->lazy.edit       = 0;
+    sc->lazy.sample_off = 0;
+    av_freep(&sc->lazy.stts_dts);
+    av_freep(&sc->lazy.stts_sample);
+    av_freep(&sc->lazy.stsc_sample);
+    av_freep(&sc->lazy.ctts_sample);
+    /* give back the ctts entries of the whole track */
+    if (sc->lazy.ctts_data) {
+        av_free(sc->ctts_data);
+        sc->ctts_data  = sc->lazy.ctts_data;
+        sc->ctts_count = sc->lazy.ctts_count;
+        sc->ctts_allocated_size = sc->ctts_count * sizeof(*sc->ctts_data);
+        sc->ctts_index  = 0;
+        sc->ctts_sample = 0;
+        sc->lazy.ctts_data = NULL;
+    }
+}
+
+static int mov_lazy_index_eligible(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned int i, stsc_index = 0;
+
+    if (!mov->lazy_index || sc->lazy.disabled || mov->trex_data || mov->frag_index.nb_items)
+        return 0;
+    if (sc->sample_count <= MOV_LAZY_INDEX_WINDOW || !sc->chunk_count ||
+        !sc->stts_count || !sc->stsc_count || st->internal->nb_index_entries ||
+        (sc->rap_group_count && sc->rap_group))
+        return 0;
+    /* the old uncompressed audio chunk demuxing and multiple edits need
+     * the full index */
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+        sc->stts_count == 1 && sc->stts_data[0].duration == 1)
+        return 0;
+    if (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist) {
+        if (mov->time_scale <= 0)
+            return 0;
+        /* empty edits followed by a single edit */
+        for (i = 0; i < sc->elst_count && sc->elst_data[i].time == -1; i++);
+        if (i + 1 != sc->elst_count || sc->elst_data[i].time < 0)
+            return 0;
+        /* durations must keep the timestamps strictly increasing */
+        for (i = 0; i < sc->stts_count; i++)
+            if (sc->stts_data[i].duration <= 0)
+                return 0;
+    }
+
+    /* anything mov_build_index() would have to correct on the fly */
+    if (sc->stsc_data[0].first != 1)
+        return 0;
+    for (i = 0; i < sc->stsc_count; i++)
+        if (!sc->stsc_data[i].count ||
+            (i && sc->stsc_data[i].first < sc->stsc_data[i - 1].first) ||
+            (sc->pseudo_stream_id != -1 && sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+    for (i = 0; i < sc->stts_count; i++)
+        if (!sc->stts_data[i].count || sc->stts_data[i].duration < 0)
+            return 0;
+    for (i = 0; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] < sc->lazy.key_off ||
+            (i && sc->keyframes[i] <= sc->keyframes[i - 1]))
+            return 0;
+    for (i = 0; i < sc->stps_count; i++)
+        if (sc->stps_data[i] < sc->lazy.key_off ||
+            (i && sc->stps_data[i] <= sc->stps_data[i - 1]))
+            return 0;
+    for (i = 0; i < sc->chunk_count; i++) {
+        int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+        int64_t current_offset = sc->chunk_offsets[i];
+        while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+            i + 1 == sc->stsc_data[stsc_index + 1].first)
+            stsc_index++;
+        if ((next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+             sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) ||
+            (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Apply an edit list made of empty edits and a single edit to a lazily
+ * indexed track, giving the same index as mov_fix_index() would: the
+ * entries start at the keyframe needed to decode the start of the edit,
+ * end at the first keyframe past it and are shifted by a constant.
+ *
+ * @return 1 if the edit list was applied, 0 if it needs the full index,
+ *         a negative error code on failure
+ */
+static int mov_lazy_index_edit(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    int trim_audio = audio && st->codecpar->codec_id != AV_CODEC_ID_VORBIS;
+    int64_t empty_duration = 0, media_time, duration, search_timestamp;
+    int64_t counter, delta = 0, min_pts = -1, skip_samples = 0;
+    int64_t first, edit_first = -1, end, sample, ts, next_ts;
+    unsigned int nb = sc->lazy.nb_samples, ctts_samples = 0, i;
+    int found_keyframe_after_edit = 0, ctts;
+    MOVStts *ctts_data;
+
+    for (i = 0; sc->elst_data[i].time == -1; i++)
+        empty_duration += av_rescale(sc->elst_data[i].duration, sc->time_scale, mov->time_scale);
+    media_time = sc->elst_data[i].time;
+    duration   = av_rescale(sc->elst_data[i].duration, sc->time_scale, mov->time_scale);
+
+    if (sc->ctts_data) {
+        sc->lazy.ctts_sample = av_malloc_array(sc->ctts_count + 1, sizeof(*sc->lazy.ctts_sample));
+        if (!sc->lazy.ctts_sample)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < sc->ctts_count; i++) {
+            sc->lazy.ctts_sample[i] = ctts_samples;
+            if (sc->ctts_data[i].count > nb - ctts_samples)
+                return 0;
+            ctts_samples += sc->ctts_data[i].count;
+        }
+        sc->lazy.ctts_sample[i] = ctts_samples;
+        sc->lazy.ctts_data  = sc->ctts_data;
+        sc->lazy.ctts_count = sc->ctts_count;
+        sc->ctts_data  = NULL;
+        sc->ctts_count = 0;
+    }
+
+    /* same frame as find_prev_closest_index() */
+    search_timestamp = media_time;
+    if (audio)
+        search_timestamp = FFMAX(search_timestamp - sc->time_scale, sc->lazy.start_dts);
+    search_timestamp -= sc->dts_shift;
+    first = mov_lazy_search_dts(sc, search_timestamp);
+    if (first >= 0)
+        first = mov_lazy_find_keyframe(sc, audio, first, 1);
+    while (first >= 0 && mov_lazy_sample_ctts(sc, first, &ctts)) {
+        if (mov_lazy_sample_dts(sc, first) + ctts <= search_timestamp &&
+            mov_lazy_is_keyframe(sc, audio, first))
+            break;
+        first--;
+    }
+    if (first < 0)
+        return 0;
+
+    /* same walk as mov_fix_index(), without building the entries */
+    end     = nb - 1;
+    counter = sc->lazy.start_dts + empty_duration;
+    next_ts = mov_lazy_sample_dts(sc, first);
+    for (sample = first; sample < nb; sample++) {
+        int64_t frame_duration, cts;
+
+        ts = next_ts;
+        if (sample + 1 < nb) {
+            next_ts = mov_lazy_sample_dts(sc, sample + 1);
+            frame_duration = next_ts - ts;
+        } else {
+            frame_duration = duration;
+        }
+        ctts = 0;
+        mov_lazy_sample_ctts(sc, sample, &ctts);
+        cts = ts + sc->dts_shift + ctts;
+
+        if (cts < media_time || cts >= media_time + duration) {
+            if (trim_audio && cts < media_time && cts + frame_duration > media_time) {
+                /* only the frame starting the edit may be cut */
+                if (edit_first >= 0)
+                    return 0;
+                skip_samples += media_time - cts;
+                counter      -= media_time - cts;
+                edit_first    = sample;
+                delta         = counter - ts;
+            } else if (edit_first < 0 && trim_audio) {
+                skip_samples += frame_duration;
+            }
+        } else {
+            if (min_pts < 0)
+                min_pts = counter + ctts + sc->dts_shift;
+            else
+                min_pts = FFMIN(min_pts, counter + ctts + sc->dts_shift);
+            if (edit_first < 0) {
+                edit_first = sample;
+                delta      = counter - ts;
+            }
+        }
+        if (edit_first >= 0)
+            counter += frame_duration;
+
+        if (cts + frame_duration >= media_time + duration &&
+            (audio || mov_lazy_is_keyframe(sc, audio, sample))) {
+            if (sc->lazy.ctts_data && !audio && !found_keyframe_after_edit) {
+                found_keyframe_after_edit = 1;
+                continue;
+            }
+            end = sample;
+            break;
+        }
+    }
+    if (edit_first < 0)
+        return 0;
+
+    /* the ctts entries of the indexed samples */
+    if (sc->lazy.ctts_data && first < ctts_samples) {
+        unsigned int start = mov_lazy_upper_bound(sc->lazy.ctts_sample, sc->lazy.ctts_count + 1, first) - 1;
+        unsigned int stop  = FFMIN(mov_lazy_upper_bound(sc->lazy.ctts_sample, sc->lazy.ctts_count + 1, end),
+                                   sc->lazy.ctts_count);
+
+        ctts_data = av_malloc_array(stop - start, sizeof(*ctts_data));
+        if (!ctts_data)
+            return AVERROR(ENOMEM);
+        for (i = start; i < stop; i++)
+            ctts_data[i - start] = sc->lazy.ctts_data[i];
+        ctts_data[0].count -= first - sc->lazy.ctts_sample[start];
+        if (end + 1 < sc->lazy.ctts_sample[stop])
+            ctts_data[stop - 1 - start].count -= sc->lazy.ctts_sample[stop] - end - 1;
+        sc->ctts_data  = ctts_data;
+        sc->ctts_count = stop - start;
+        sc->ctts_allocated_size = sc->ctts_count * sizeof(*ctts_data);
+    }
+
+    sc->min_corrected_pts = min_pts - empty_duration;
+    if (!audio && sc->min_corrected_pts > 0)
+        delta -= sc->min_corrected_pts;
+    if (audio)
+        st->internal->skip_samples = skip_samples;
+    sc->start_pad = st->internal->skip_samples;
+    st->start_time = empty_duration;
+    st->duration   = FFMIN(st->duration, empty_duration + duration);
+
+    sc->lazy.edit          = 1;
+    sc->lazy.edit_first    = edit_first - first;
+    sc->lazy.edit_time     = media_time;
+    sc->lazy.edit_duration = duration;
+    sc->lazy.sample_off    = first;
+    sc->lazy.nb_samples    = end - first + 1;
+    sc->lazy.start_dts    += delta;
+    return 1;
+}
+
+/**
+ * Set up on-demand index entries for a track, keeping only the compact
+ * sample tables in memory.
+ *
+ * @return 1 if the track is indexed lazily, 0 if it needs a full index,
+ *         a negative error code on failure
+ */
+static int mov_lazy_index_init(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    uint64_t stream_size = 0, nb_samples = 0;
+    int64_t dts = 0;
+    unsigned int i, sample = 0;
+    int ret;
+
+    sc->lazy.key_off = (sc->keyframe_count && sc->keyframes[0] > 0) ||
+                       (sc->stps_count && sc->stps_data[0] > 0);
+    if (!mov_lazy_index_eligible(mov, st))
+        return 0;
+
+    for (i = 0; i < sc->stsc_count; i++)
+        nb_samples += mov_get_stsc_samples(sc, i);
+    nb_samples = FFMIN(nb_samples, sc->sample_count);
+    for (i = 0; i < nb_samples; i++) {
+        unsigned int size = mov_lazy_sample_size(sc, i);
+        if (size > 0x3FFFFFFF)
+            return 0;
+        stream_size += size;
+    }
+
+    sc->lazy.stts_dts    = av_malloc_array(sc->stts_count, sizeof(*sc->lazy.stts_dts));
+    sc->lazy.stts_sample = av_malloc_array(sc->stts_count, sizeof(*sc->lazy.stts_sample));
+    sc->lazy.stsc_sample = av_malloc_array(sc->stsc_count, sizeof(*sc->lazy.stsc_sample));
+    if (!sc->lazy.stts_dts || !sc->lazy.stts_sample || !sc->lazy.stsc_sample) {
+        mov_lazy_index_free(sc);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < sc->stts_count; i++) {
+        sc->lazy.stts_dts[i]    = dts;
+        sc->lazy.stts_sample[i] = sample;
+        dts    += sc->stts_data[i].count * (int64_t)sc->stts_data[i].duration;
+        sample += FFMIN(sc->stts_data[i].count, nb_samples - sample);
+    }
+    for (i = 0, sample = 0; i < sc->stsc_count; i++) {
+        sc->lazy.stsc_sample[i] = sample;
+        sample += FFMIN(mov_get_stsc_samples(sc, i), nb_samples - sample);
+    }
+
+    sc->lazy.enabled    = 1;
+    sc->lazy.nb_samples = nb_samples;
+    sc->lazy.start_dts  = start_dts;
+
+    /* same entries as mov_build_index() would feed before the edit list is
+     * applied, only once per stream in case the full index is built later */
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !sc->lazy.rfps_added) {
+        for (i = 0; i < 99 && i < nb_samples; i++)
+            ff_rfps_add_frame(mov->fc, st, mov_lazy_sample_dts(sc, i));
+        sc->lazy.rfps_added = 1;
+    }
+
+    if (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist &&
+        (ret = mov_lazy_index_edit(mov, st)) <= 0) {
+        mov_lazy_index_free(sc);
+        return ret;
+    }
+    if ((ret = mov_lazy_index_fill(st, 0)) < 0) {
+        mov_lazy_index_free(sc);
+        return ret;
+    }
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: %u samples indexed on demand\n",
+           st->index, sc->lazy.nb_samples);
+    return 1;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3817,8 +4412,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     }
 
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
-    if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-          sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
+    if (mov_lazy_index_init(mov, st, current_dts - sc->dts_shift) > 0) {
+        /* index entries are materialized on demand by mov_get_index_entry() */
+    } else if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                 sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
         unsigned int sample_size;
@@ -3935,7 +4532,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
                             "size %u, distance %u, keyframe %d\n", st->index, current_sample,
                             current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->internal->nb_index_entries < 100)
+                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->internal->nb_index_entries < 100 &&
+                        !sc->lazy.rfps_added)
                         ff_rfps_add_frame(mov->fc, st, current_dts);
                 }
 
@@ -4075,7 +4673,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
     }
 
-    if (!mov->ignore_editlist && mov->advanced_editlist) {
+    if (!sc->lazy.enabled && !mov->ignore_editlist && mov->advanced_editlist) {
         // Fix index according to edit lists.
         mov_fix_index(mov, st);
     }
@@ -4091,6 +4689,30 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     mov_estimate_video_delay(mov, st);
 }
 
+/**
+ * Replace the on-demand index of a track with a full one.
+ */
+static void mov_lazy_index_disable(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    mov_lazy_index_free(sc);
+    sc->lazy.disabled = 1;
+    av_freep(&st->internal->index_entries);
+    st->internal->index_entries_allocated_size = 0;
+    st->internal->nb_index_entries = 0;
+
+    mov_build_index(mov, st);
+
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->elst_data);
+    av_freep(&sc->rap_group);
+}
+
 static int test_same_origin(const char *src, const char *ref) {
     char src_proto[64];
     char ref_proto[64];
@@ -4319,14 +4941,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->internal->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
-    av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
+    /* Do not need those anymore, unless the index is built on demand. */
+    if (!sc->lazy.enabled) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->elst_data);
+        av_freep(&sc->rap_group);
+    }
 
     return 0;
 }
@@ -4761,6 +5385,10 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if (sc->lazy.enabled) {
+        av_log(c->fc, AV_LOG_WARNING, "ignoring fragment of lazily indexed track id %u\n", frag->track_id);
+        return 0;
+    }
 
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
@@ -7161,6 +7789,10 @@ static void mov_read_chapters(AVFormatContext *s)
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
 
+        /* the chapters are read from all the index entries at once */
+        if (sc->lazy.enabled)
+            mov_lazy_index_disable(mov, st);
+
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
             if (st->internal->nb_index_entries) {
@@ -7323,6 +7955,7 @@ static int mov_read_close(AVFormatContext *s)
         if (!sc)
             continue;
 
+        mov_lazy_index_free(sc);
         av_freep(&sc->ctts_data);
         for (j = 0; j < sc->drefs_count; j++) {
             av_freep(&sc->drefs[j].path);
@@ -7566,6 +8199,15 @@ static int mov_read_header(AVFormatContext *s)
     }
     av_log(mov->fc, AV_LOG_TRACE, "on_parse_exit_offset=%"PRId64"\n", avio_tell(pb));
 
+    /* fragmented files add to the index while demuxing */
+    if (mov->trex_data) {
+        for (i = 0; i < s->nb_streams; i++) {
+            MOVStreamContext *sc = s->streams[i]->priv_data;
+            if (sc->lazy.enabled)
+                mov_lazy_index_disable(mov, s->streams[i]);
+        }
+    }
+
     if (pb->seekable & AVIO_SEEKABLE_NORMAL) {
         if (mov->nb_chapter_tracks > 0 && !mov->ignore_chapters)
             mov_read_chapters(s);
@@ -7746,8 +8388,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->internal->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->internal->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample;
+        if (msc->pb && (current_sample = mov_get_index_entry(avst, msc->current_sample))) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -7855,7 +8497,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, lazy_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
@@ -7870,6 +8512,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    if (sc->lazy.enabled) {
+        /* the window may move when looking at the next sample */
+        lazy_sample = *sample;
+        sample = &lazy_sample;
+    }
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
     mov_current_sample_inc(sc);
@@ -7950,8 +8597,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->internal->nb_index_entries) ?
-            st->internal->index_entries[sc->current_sample].timestamp : st->duration;
+        AVIndexEntry *next = mov_get_index_entry(st, sc->current_sample);
+        int64_t next_dts = next ? next->timestamp : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8030,8 +8677,14 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    if (sc->lazy.enabled)
+        sample = mov_lazy_search_timestamp(st, timestamp, flags);
+    else
+        sample = av_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
+    if (sample < 0 && sc->lazy.enabled &&
+        timestamp < mov_lazy_sample_dts(sc, sc->lazy.sample_off))
+        sample = 0;
     if (sample < 0 && st->internal->nb_index_entries && timestamp < st->internal->index_entries[0].timestamp)
         sample = 0;
     if (sample < 0) /* not sure what to do */
@@ -8073,12 +8726,15 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    int64_t first_ts = st->internal->index_entries[0].timestamp;
-    int64_t ts = st->internal->index_entries[sample].timestamp;
+    AVIndexEntry *e = mov_get_index_entry(st, sample);
+    int64_t first_ts = sc->lazy.enabled ? mov_lazy_sample_dts(sc, sc->lazy.sample_off) :
+                                          st->internal->index_entries[0].timestamp;
+    int64_t ts;
     int64_t off;
 
-    if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO || !e)
         return 0;
+    ts = e->timestamp;
 
     /* compute skip samples according to stream start_pad, seek ts and first ts */
     off = av_rescale_q(ts - first_ts, st->time_base,
@@ -8103,7 +8759,12 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->internal->index_entries[sample].timestamp;
+        AVIndexEntry *e = mov_get_index_entry(st, sample);
+        int64_t seek_timestamp;
+
+        if (!e)
+            return AVERROR(ENOMEM);
+        seek_timestamp = e->timestamp;
         st->internal->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
@@ -8188,6 +8849,8 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "lazy_index", "Build the index entries on demand instead of at open time", OFFSET(lazy_index), AV_OPT_TYPE_BOOL,
+        {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
@@ -62,6 +62,7 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "moov_duration", "expected duration used to estimate the moov size for reserve_moov", offsetof(MOVMuxContext, moov_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_every_frame", "Fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_EVERY_FRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -69,6 +70,7 @@ static const AVOption options[] = {
     { "frag_custom", "Flush fragments on caller requests", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_CUSTOM}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "faststart", "Run a second pass to put the index (moov atom) at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "reserve_moov", "Reserve estimated space for the moov atom at the beginning of the file, running a second pass only if it does not fit", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RESERVE_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "disable_chpl", "Disable Nero chapter atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DISABLE_CHPL}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "default_base_moof", "Set the default-base-is-moof flag in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DEFAULT_BASE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -6425,6 +6427,15 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+            av_log(s, AV_LOG_WARNING, "Fragmented output; ignoring reserve_moov flag\n");
+            mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+        } else {
+            mov->flags |= FF_MOV_FLAG_FASTSTART;
+        }
+    }
+
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
     }
@@ -6720,6 +6731,84 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Estimate the number of samples a stream will contribute to the sample
+ * tables, from its expected duration in AV_TIME_BASE units.
+ */
+static int64_t estimate_stream_samples(AVStream *st, int64_t duration)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    switch (par->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+            return av_rescale_q_rnd(duration, AV_TIME_BASE_Q,
+                                    av_inv_q(st->avg_frame_rate), AV_ROUND_UP);
+        return av_rescale_rnd(duration, 60, AV_TIME_BASE, AV_ROUND_UP);
+    case AVMEDIA_TYPE_AUDIO:
+        return av_rescale_rnd(duration, FFMAX(par->sample_rate, 1),
+                              (int64_t)AV_TIME_BASE * (par->frame_size > 0 ? par->frame_size : 1024),
+                              AV_ROUND_UP);
+    default:
+        return av_rescale_rnd(duration, 2, AV_TIME_BASE, AV_ROUND_UP);
+    }
+}
+
+/*
+ * Estimate the size of the final moov atom for reserve_moov. The estimate
+ * is deliberately generous: a short reservation costs a full second pass,
+ * while an oversized one only costs some padding. Returns 0 if there is not
+ * enough information to make an estimate.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t size = 4096;
+    int i;
+
+    for (i = 0; i < mov->nb_streams; i++) {
+        AVStream *st;
+        const AVCodecDescriptor *desc;
+        int64_t duration, samples, entry_size;
+
+        size += 1024;
+        if (i >= s->nb_streams)
+            continue;
+
+        st = s->streams[i];
+        if (mov->moov_duration > 0)
+            duration = mov->moov_duration;
+        else if (st->duration > 0 && st->time_base.num > 0)
+            duration = av_rescale_q(st->duration, st->time_base, AV_TIME_BASE_Q);
+        else if (s->duration > 0)
+            duration = s->duration;
+        else
+            return 0;
+
+        samples = estimate_stream_samples(st, duration);
+        if (mov->flags & FF_MOV_FLAG_RTP_HINT && rtp_hinting_needed(st))
+            samples *= 2;
+
+        /* stsz, co64 and stsc entries, assuming one chunk per sample */
+        entry_size = 4 + 8 + 12;
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            /* stts, plus ctts and stss unless the codec is intra only */
+            entry_size += 8;
+            desc = avcodec_descriptor_get(st->codecpar->codec_id);
+            if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY))
+                entry_size += 8 + 4;
+        }
+
+        if (samples > INT_MAX / entry_size)
+            return 0;
+        size += st->codecpar->extradata_size + samples * entry_size;
+        if (size > INT_MAX / 2)
+            return 0;
+    }
+
+    return size + size / 8;
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -6790,6 +6879,20 @@ static int mov_write_header(AVFormatContext *s)
             avio_skip(pb, mov->reserved_moov_size);
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+        mov->moov_size_estimate = estimate_moov_size(s);
+        if (mov->moov_size_estimate > 0) {
+            av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+                   mov->moov_size_estimate);
+            avio_wb32(pb, mov->moov_size_estimate);
+            ffio_wfourcc(pb, "free");
+            ffio_fill(pb, 0, mov->moov_size_estimate - 8);
+        } else {
+            av_log(s, AV_LOG_WARNING, "Unable to estimate the moov size, "
+                   "falling back to a second pass\n");
+        }
+    }
+
     if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
         /* If no fragmentation options have been set, set a default. */
         if (!(mov->flags & (FF_MOV_FLAG_FRAG_KEYFRAME |
@@ -6798,7 +6901,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->moov_size_estimate)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -7065,13 +7168,40 @@ static int mov_write_trailer(AVFormatContext *s)
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
-            if (res < 0)
-                return res;
-            avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
-            if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
-                return res;
+            int moov_size = 0;
+
+            /* The reserved space must either be filled exactly or leave
+             * room for a free atom padding it. */
+            if (mov->moov_size_estimate > 0) {
+                moov_size = get_moov_size(s);
+                if (moov_size < 0)
+                    return moov_size;
+                if (moov_size != mov->moov_size_estimate &&
+                    moov_size > mov->moov_size_estimate - 8) {
+                    av_log(s, AV_LOG_INFO, "Reserved moov size %d is too small, needed %d\n",
+                           mov->moov_size_estimate, moov_size);
+                    moov_size = 0;
+                }
+            }
+
+            if (moov_size > 0) {
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                    return res;
+                if (moov_size < mov->moov_size_estimate) {
+                    avio_wb32(pb, mov->moov_size_estimate - moov_size);
+                    ffio_wfourcc(pb, "free");
+                }
+                avio_seek(pb, moov_pos, SEEK_SET);
+            } else {
+                av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
+                res = shift_data(s);
+                if (res < 0)
+                    return res;
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                    return res;
+            }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -0,0 +1,634 @@
+/*
+ * Background prefetching of the segments of segmented streams
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "internal.h"
+#include "prefetch.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define PREFETCH_CHUNK_SIZE 32768
+
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_LOADING,
+    PREFETCH_DONE,
+};
+
+/*
+ * A segment downloaded ahead of time by the thread of its queue. The request
+ * parameters are copied when the segment is queued, so that the thread never
+ * touches the segment lists of the demuxer.
+ */
+typedef struct PrefetchSegment {
+    int64_t seq_no;
+    int64_t ahead; /* distance from the playback position in AV_TIME_BASE */
+    char *url;
+    int64_t offset;
+    int64_t size;
+    AVDictionary *opts;
+
+    enum PrefetchState state;
+    int error;
+    int cancel; /* dropped while loading, freed by the prefetch thread */
+    uint8_t *buf;
+    unsigned int buf_size;
+    unsigned int len;
+} PrefetchSegment;
+
+/*
+ * The segment list and the segments in it are protected by
+ * PrefetchContext.lock. The current segment is taken out of the list while
+ * it is read.
+ */
+struct PrefetchQueue {
+    PrefetchContext *pc;
+    void *opaque;
+    pthread_t thread;
+    int quit;
+    PrefetchSegment *loading; /* segment being downloaded by the thread */
+    int nb_segs;
+    PrefetchSegment **segs;
+    PrefetchSegment *cur;
+    unsigned int read_offset;
+};
+
+struct PrefetchContext {
+    AVFormatContext *s;
+    const char *name;
+    PrefetchOpenFunc open;
+    int64_t max_size;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int nb_queues;
+    PrefetchQueue **queues;
+
+    int64_t used;   /* memory held by prefetched segments */
+    int64_t bytes;  /* statistics */
+    int fetched;
+    int hits;
+    int waits;
+    int misses;
+    int evictions;
+};
+
+static void free_segment(PrefetchContext *pc, PrefetchSegment **pseg)
+{
+    PrefetchSegment *seg = *pseg;
+
+    pc->used -= seg->buf_size;
+    av_freep(&seg->buf);
+    av_freep(&seg->url);
+    av_dict_free(&seg->opts);
+    av_freep(pseg);
+}
+
+/* Removes entry i from the list, segments being loaded are freed by the
+ * thread once it notices. Must be called with the lock. */
+static void drop_segment(PrefetchQueue *q, int i)
+{
+    PrefetchSegment *seg = q->segs[i];
+
+    if (seg->state == PREFETCH_LOADING)
+        seg->cancel = 1;
+    else
+        free_segment(q->pc, &seg);
+    memmove(q->segs + i, q->segs + i + 1, (q->nb_segs - i - 1) * sizeof(*q->segs));
+    q->nb_segs--;
+}
+
+static int find_segment(PrefetchQueue *q, int64_t seq_no)
+{
+    int i;
+
+    for (i = 0; i < q->nb_segs; i++)
+        if (q->segs[i]->seq_no == seq_no)
+            return i;
+    return -1;
+}
+
+/*
+ * Frees memory for a segment that is ahead of the playback position by the
+ * given time, by evicting the prefetched segment furthest ahead of the
+ * playback position of its queue, provided it is further ahead. The evicted
+ * segment is queued again. Must be called with the lock.
+ */
+static int evict(PrefetchContext *pc, int64_t ahead)
+{
+    PrefetchSegment *victim = NULL;
+    int i, j;
+
+    for (i = 0; i < pc->nb_queues; i++) {
+        PrefetchQueue *q = pc->queues[i];
+        for (j = 0; j < q->nb_segs; j++) {
+            PrefetchSegment *seg = q->segs[j];
+            if (seg->state == PREFETCH_DONE && seg->buf_size &&
+                seg->ahead > ahead && (!victim || seg->ahead > victim->ahead))
+                victim = seg;
+        }
+    }
+    if (!victim)
+        return 0;
+
+    pc->used -= victim->buf_size;
+    av_freep(&victim->buf);
+    victim->buf_size = victim->len = 0;
+    victim->error    = 0;
+    victim->state    = PREFETCH_QUEUED;
+    pc->evictions++;
+    return 1;
+}
+
+/* Waits for a change of the segment being read, returns an error when
+ * interrupted. Must be called with the lock. */
+static int wait_segment(PrefetchContext *pc)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    if (ff_check_interrupt(&pc->s->interrupt_callback))
+        return AVERROR_EXIT;
+    pthread_cond_timedwait(&pc->cond, &pc->lock, &tv);
+    return 0;
+}
+
+/* Aborts the I/O of the thread when its segment is dropped or the context
+ * closed, as well as when the demuxer is interrupted. */
+static int prefetch_interrupt_cb(void *opaque)
+{
+    PrefetchQueue *q = opaque;
+    PrefetchContext *pc = q->pc;
+    int ret;
+
+    pthread_mutex_lock(&pc->lock);
+    ret = q->quit || (q->loading && q->loading->cancel);
+    pthread_mutex_unlock(&pc->lock);
+
+    return ret || ff_check_interrupt(&pc->s->interrupt_callback);
+}
+
+static void *prefetch_thread(void *arg)
+{
+    PrefetchQueue *q = arg;
+    PrefetchContext *pc = q->pc;
+    const AVIOInterruptCB int_cb = { prefetch_interrupt_cb, q };
+    uint8_t *chunk = av_malloc(PREFETCH_CHUNK_SIZE);
+
+    pthread_mutex_lock(&pc->lock);
+    while (!q->quit) {
+        PrefetchSegment *seg = NULL;
+        AVIOContext *in = NULL;
+        int i, ret;
+
+        /* download the queued segments in order */
+        for (i = 0; i < q->nb_segs; i++)
+            if (q->segs[i]->state == PREFETCH_QUEUED &&
+                (!seg || q->segs[i]->seq_no < seg->seq_no))
+                seg = q->segs[i];
+        if (seg && pc->used >= pc->max_size && evict(pc, seg->ahead))
+            continue;
+        if (!seg || !chunk || pc->used >= pc->max_size) {
+            pthread_cond_wait(&pc->cond, &pc->lock);
+            continue;
+        }
+
+        seg->state = PREFETCH_LOADING;
+        q->loading = seg;
+        pthread_mutex_unlock(&pc->lock);
+
+        av_log(pc->s, AV_LOG_VERBOSE, "%s prefetch request for url '%s', offset %"PRId64"\n",
+               pc->name, seg->url, seg->offset);
+        /* seg->opts is private to this thread, so cookies can be updated */
+        ret = pc->open(q->opaque, &in, seg->url, seg->offset, seg->size, &seg->opts, &int_cb);
+
+        pthread_mutex_lock(&pc->lock);
+        while (ret >= 0 && !seg->cancel && !q->quit) {
+            int size = PREFETCH_CHUNK_SIZE;
+            unsigned int old_size = seg->buf_size;
+            uint8_t *buf;
+
+            /* limit read if the segment was only a part of a file */
+            if (seg->size >= 0 && seg->size - seg->len < size)
+                size = seg->size - seg->len;
+            if (size <= 0)
+                break;
+
+            pthread_mutex_unlock(&pc->lock);
+            ret = avio_read(in, chunk, size);
+            pthread_mutex_lock(&pc->lock);
+            if (ret <= 0)
+                break;
+
+            /* headers and the segment being read are never held back */
+            while (pc->used >= pc->max_size && seg != q->cur && seg->seq_no >= 0 &&
+                   !seg->cancel && !q->quit && !evict(pc, seg->ahead))
+                pthread_cond_wait(&pc->cond, &pc->lock);
+            if (seg->cancel || q->quit)
+                break;
+
+            buf = av_fast_realloc(seg->buf, &seg->buf_size, seg->len + ret);
+            pc->used += (int64_t)seg->buf_size - old_size;
+            if (!buf) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            seg->buf = buf;
+            memcpy(seg->buf + seg->len, chunk, ret);
+            seg->len  += ret;
+            pc->bytes += ret;
+            pthread_cond_broadcast(&pc->cond);
+        }
+
+        seg->error = ret < 0 && ret != AVERROR_EOF ? ret : 0;
+        seg->state = PREFETCH_DONE;
+        q->loading = NULL;
+        if (seg->cancel) {
+            free_segment(pc, &seg);
+        } else if (seg->error && seg->error != AVERROR_EXIT) {
+            av_log(pc->s, AV_LOG_WARNING, "Failed to prefetch '%s'\n", seg->url);
+        } else {
+            pc->fetched++;
+        }
+        pthread_cond_broadcast(&pc->cond);
+        pthread_mutex_unlock(&pc->lock);
+
+        avio_closep(&in);
+        pthread_mutex_lock(&pc->lock);
+    }
+    pthread_mutex_unlock(&pc->lock);
+
+    av_free(chunk);
+    return NULL;
+}
+
+int ff_prefetch_init(PrefetchContext **ppc, AVFormatContext *s, const char *name,
+                     int64_t max_size, PrefetchOpenFunc open)
+{
+    PrefetchContext *pc;
+    int ret;
+
+    *ppc = NULL;
+    pc = av_mallocz(sizeof(*pc));
+    if (!pc)
+        return AVERROR(ENOMEM);
+    pc->s        = s;
+    pc->name     = name;
+    pc->max_size = max_size;
+    pc->open     = open;
+
+    if ((ret = pthread_mutex_init(&pc->lock, NULL))) {
+        av_free(pc);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&pc->cond, NULL))) {
+        pthread_mutex_destroy(&pc->lock);
+        av_free(pc);
+        return AVERROR(ret);
+    }
+
+    *ppc = pc;
+    return 0;
+}
+
+int ff_prefetch_add_queue(PrefetchContext *pc, PrefetchQueue **pq, void *opaque)
+{
+    PrefetchQueue *q = av_mallocz(sizeof(*q));
+    int ret;
+
+    if (!q)
+        return AVERROR(ENOMEM);
+    q->pc     = pc;
+    q->opaque = opaque;
+
+    pthread_mutex_lock(&pc->lock);
+    ret = av_dynarray_add_nofree(&pc->queues, &pc->nb_queues, q);
+    pthread_mutex_unlock(&pc->lock);
+    if (ret < 0) {
+        av_free(q);
+        return ret;
+    }
+
+    ret = pthread_create(&q->thread, NULL, prefetch_thread, q);
+    if (ret) {
+        av_log(pc->s, AV_LOG_WARNING, "Failed to start the prefetch thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        pthread_mutex_lock(&pc->lock);
+        pc->nb_queues--;
+        pthread_mutex_unlock(&pc->lock);
+        av_free(q);
+        return AVERROR(ret);
+    }
+
+    *pq = q;
+    return 0;
+}
+
+int ff_prefetch_set(PrefetchQueue *q, int64_t seq_no, int64_t ahead,
+                    const char *url, int64_t offset, int64_t size,
+                    const AVDictionary *opts)
+{
+    PrefetchContext *pc = q->pc;
+    PrefetchSegment *seg;
+    int i, ret = 0;
+
+    pthread_mutex_lock(&pc->lock);
+    if ((i = find_segment(q, seq_no)) >= 0) {
+        q->segs[i]->ahead = ahead;
+        ret = 1;
+    } else if (url) {
+        seg = av_mallocz(sizeof(*seg));
+        if (!seg) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        seg->seq_no = seq_no;
+        seg->ahead  = ahead;
+        seg->offset = offset;
+        seg->size   = size;
+        seg->state  = PREFETCH_QUEUED;
+        seg->url    = av_strdup(url);
+        if (!seg->url)
+            ret = AVERROR(ENOMEM);
+        if (ret < 0 || (ret = av_dict_copy(&seg->opts, opts, 0)) < 0 ||
+            (ret = av_dynarray_add_nofree(&q->segs, &q->nb_segs, seg)) < 0) {
+            free_segment(pc, &seg);
+            goto end;
+        }
+        pthread_cond_broadcast(&pc->cond);
+    }
+end:
+    pthread_mutex_unlock(&pc->lock);
+    return ret;
+}
+
+void ff_prefetch_window(PrefetchQueue *q, int64_t first, int64_t last)
+{
+    PrefetchContext *pc = q->pc;
+    int i;
+
+    pthread_mutex_lock(&pc->lock);
+    for (i = 0; i < q->nb_segs; i++) {
+        int64_t seq_no = q->segs[i]->seq_no;
+        if (seq_no >= 0 && (seq_no < first || seq_no > last))
+            drop_segment(q, i--);
+    }
+    pthread_cond_broadcast(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+}
+
+int ff_prefetch_take(PrefetchQueue *q, int64_t seq_no)
+{
+    PrefetchContext *pc = q->pc;
+    PrefetchSegment *seg = NULL;
+    int i;
+
+    pthread_mutex_lock(&pc->lock);
+    i = find_segment(q, seq_no);
+    if (i >= 0)
+        seg = q->segs[i];
+    /* failed and not yet started segments are opened directly */
+    if (seg && (seg->state == PREFETCH_QUEUED || (seg->error && !seg->len))) {
+        drop_segment(q, i);
+        seg = NULL;
+    } else if (seg) {
+        memmove(q->segs + i, q->segs + i + 1, (q->nb_segs - i - 1) * sizeof(*q->segs));
+        q->nb_segs--;
+        q->cur         = seg;
+        q->read_offset = 0;
+        if (seg->state == PREFETCH_DONE) {
+            pc->hits++;
+        } else {
+            /* the thread may be held back by the memory limit, which does
+             * not apply to the current segment */
+            pc->waits++;
+            pthread_cond_broadcast(&pc->cond);
+        }
+    }
+    if (!seg)
+        pc->misses++;
+    pthread_mutex_unlock(&pc->lock);
+
+    return !!seg;
+}
+
+int ff_prefetch_take_buffer(PrefetchQueue *q, int64_t seq_no, uint8_t **buf,
+                            unsigned int *buf_size, unsigned int *len)
+{
+    PrefetchContext *pc = q->pc;
+    PrefetchSegment *seg = NULL;
+    int i, ret = 0;
+
+    pthread_mutex_lock(&pc->lock);
+    i = find_segment(q, seq_no);
+    if (i >= 0)
+        seg = q->segs[i];
+    while (seg && seg->state == PREFETCH_LOADING) {
+        if ((ret = wait_segment(pc)) < 0) {
+            pthread_mutex_unlock(&pc->lock);
+            return ret;
+        }
+    }
+    /* failed and not yet started segments are opened directly */
+    if (seg && seg->state == PREFETCH_DONE && !seg->error) {
+        *buf      = seg->buf;
+        *buf_size = seg->buf_size;
+        *len      = seg->len;
+        pc->used -= seg->buf_size;
+        seg->buf      = NULL;
+        seg->buf_size = 0;
+        pc->hits++;
+        ret = 1;
+    } else {
+        pc->misses++;
+    }
+    if (seg)
+        drop_segment(q, i);
+    pthread_mutex_unlock(&pc->lock);
+
+    return ret;
+}
+
+int ff_prefetch_reading(PrefetchQueue *q)
+{
+    return q && q->cur;
+}
+
+int ff_prefetch_read(PrefetchQueue *q, uint8_t *buf, int buf_size)
+{
+    PrefetchContext *pc = q->pc;
+    PrefetchSegment *seg = q->cur;
+    int ret;
+
+    pthread_mutex_lock(&pc->lock);
+    while (q->read_offset >= seg->len && seg->state == PREFETCH_LOADING) {
+        if ((ret = wait_segment(pc)) < 0) {
+            pthread_mutex_unlock(&pc->lock);
+            return ret;
+        }
+    }
+    if (q->read_offset < seg->len) {
+        ret = FFMIN(buf_size, seg->len - q->read_offset);
+        memcpy(buf, seg->buf + q->read_offset, ret);
+        q->read_offset += ret;
+    } else {
+        ret = seg->error ? seg->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&pc->lock);
+
+    return ret;
+}
+
+void ff_prefetch_release(PrefetchQueue *q)
+{
+    PrefetchContext *pc;
+
+    if (!q || !q->cur)
+        return;
+    pc = q->pc;
+
+    pthread_mutex_lock(&pc->lock);
+    if (q->cur->state == PREFETCH_LOADING)
+        q->cur->cancel = 1;
+    else
+        free_segment(pc, &q->cur);
+    q->cur = NULL;
+    pthread_cond_broadcast(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+}
+
+void ff_prefetch_flush(PrefetchQueue *q)
+{
+    PrefetchContext *pc;
+
+    if (!q)
+        return;
+    pc = q->pc;
+
+    ff_prefetch_release(q);
+
+    pthread_mutex_lock(&pc->lock);
+    while (q->nb_segs)
+        drop_segment(q, q->nb_segs - 1);
+    pthread_cond_broadcast(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+}
+
+void ff_prefetch_close(PrefetchContext **ppc)
+{
+    PrefetchContext *pc = *ppc;
+    int i;
+
+    if (!pc)
+        return;
+
+    pthread_mutex_lock(&pc->lock);
+    for (i = 0; i < pc->nb_queues; i++)
+        pc->queues[i]->quit = 1;
+    pthread_cond_broadcast(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+
+    for (i = 0; i < pc->nb_queues; i++) {
+        PrefetchQueue *q = pc->queues[i];
+        pthread_join(q->thread, NULL);
+        /* nothing is loading anymore, so everything is freed here */
+        ff_prefetch_flush(q);
+        av_freep(&q->segs);
+        av_freep(&pc->queues[i]);
+    }
+    av_freep(&pc->queues);
+
+    av_log(pc->s, AV_LOG_VERBOSE, "%s prefetch: %d segments prefetched (%"PRId64" bytes), "
+           "%d hits, %d waits, %d misses, %d evictions\n",
+           pc->name, pc->fetched, pc->bytes, pc->hits,
+           pc->waits, pc->misses, pc->evictions);
+
+    pthread_cond_destroy(&pc->cond);
+    pthread_mutex_destroy(&pc->lock);
+    av_freep(ppc);
+}
+
+#else
+
+int ff_prefetch_init(PrefetchContext **pc, AVFormatContext *s, const char *name,
+                     int64_t max_size, PrefetchOpenFunc open)
+{
+    av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads, disabling it\n");
+    *pc = NULL;
+    return 0;
+}
+
+int ff_prefetch_add_queue(PrefetchContext *pc, PrefetchQueue **pq, void *opaque)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_prefetch_set(PrefetchQueue *q, int64_t seq_no, int64_t ahead,
+                    const char *url, int64_t offset, int64_t size,
+                    const AVDictionary *opts)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_prefetch_window(PrefetchQueue *q, int64_t first, int64_t last)
+{
+}
+
+int ff_prefetch_take(PrefetchQueue *q, int64_t seq_no)
+{
+    return 0;
+}
+
+int ff_prefetch_take_buffer(PrefetchQueue *q, int64_t seq_no, uint8_t **buf,
+                            unsigned int *buf_size, unsigned int *len)
+{
+    return 0;
+}
+
+int ff_prefetch_reading(PrefetchQueue *q)
+{
+    return 0;
+}
+
+int ff_prefetch_read(PrefetchQueue *q, uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_prefetch_release(PrefetchQueue *q)
+{
+}
+
+void ff_prefetch_flush(PrefetchQueue *q)
+{
+}
+
+void ff_prefetch_close(PrefetchContext **pc)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,139 @@
+/*
+ * Background prefetching of the segments of segmented streams
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PREFETCH_H
+#define AVFORMAT_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * @file
+ * Segment prefetching shared by the HLS and DASH demuxers.
+ *
+ * Every playlist or representation gets a queue with its own thread, which
+ * downloads the queued segments in sequence number order into memory. The
+ * memory used by all queues of a context is bounded. When the limit is
+ * reached, the segment furthest ahead of the playback position is evicted
+ * and queued again if the one being loaded is needed sooner.
+ *
+ * Negative sequence numbers are meant for headers such as initialization
+ * sections: they are loaded first, are not held back by the memory limit
+ * and are not dropped by ff_prefetch_window().
+ */
+
+typedef struct PrefetchContext PrefetchContext;
+typedef struct PrefetchQueue PrefetchQueue;
+
+/**
+ * Open a segment, called from the prefetch threads. The segment is closed
+ * with avio_closep().
+ *
+ * @param opaque opaque pointer of the queue
+ * @param offset offset of the segment in the resource
+ * @param size   size of the segment, -1 for the rest of the resource
+ * @param opts   I/O options private to the segment, which may be updated
+ * @param int_cb interrupt callback to open the segment with, which also
+ *               fires when the segment is dropped or the context closed
+ */
+typedef int (*PrefetchOpenFunc)(void *opaque, AVIOContext **pb, const char *url,
+                                int64_t offset, int64_t size, AVDictionary **opts,
+                                const AVIOInterruptCB *int_cb);
+
+/**
+ * Allocate a prefetch context.
+ *
+ * If threads are not available, a warning is printed and *pc is set to NULL.
+ *
+ * @param name     name of the demuxer, used in log messages
+ * @param max_size maximum memory used by prefetched segments
+ */
+int ff_prefetch_init(PrefetchContext **pc, AVFormatContext *s, const char *name,
+                     int64_t max_size, PrefetchOpenFunc open);
+
+/**
+ * Add a queue and start its thread.
+ */
+int ff_prefetch_add_queue(PrefetchContext *pc, PrefetchQueue **pq, void *opaque);
+
+/**
+ * Set the distance of a segment from the playback position, used to choose
+ * the segments to evict. If the segment is not queued and url is not NULL,
+ * it is queued.
+ *
+ * @param ahead distance in AV_TIME_BASE units
+ * @param opts  I/O options to open the segment with, copied
+ * @return 1 if the segment was already queued, 0 if it was not, a negative
+ *         error code on failure
+ */
+int ff_prefetch_set(PrefetchQueue *q, int64_t seq_no, int64_t ahead,
+                    const char *url, int64_t offset, int64_t size,
+                    const AVDictionary *opts);
+
+/**
+ * Drop the segments outside of [first, last], e.g. after a seek.
+ */
+void ff_prefetch_window(PrefetchQueue *q, int64_t first, int64_t last);
+
+/**
+ * Switch the queue to reading the given segment with ff_prefetch_read(),
+ * which waits for the data that is still being downloaded.
+ *
+ * @return 1 if the segment was prefetched or is being loaded, 0 if it has to
+ *         be opened directly
+ */
+int ff_prefetch_take(PrefetchQueue *q, int64_t seq_no);
+
+/**
+ * Take over the buffer of the given segment, waiting until it is complete.
+ * The buffer can be reallocated with av_fast_malloc() and is freed with
+ * av_free().
+ *
+ * @return 1 if the segment was prefetched, 0 if it has to be opened directly,
+ *         a negative error code on interruption
+ */
+int ff_prefetch_take_buffer(PrefetchQueue *q, int64_t seq_no, uint8_t **buf,
+                            unsigned int *buf_size, unsigned int *len);
+
+/**
+ * @return 1 if the current segment is read from memory, q may be NULL
+ */
+int ff_prefetch_reading(PrefetchQueue *q);
+
+int ff_prefetch_read(PrefetchQueue *q, uint8_t *buf, int buf_size);
+
+/**
+ * Stop reading the current segment from memory, q may be NULL.
+ */
+void ff_prefetch_release(PrefetchQueue *q);
+
+/**
+ * Drop all segments of the queue, q may be NULL.
+ */
+void ff_prefetch_flush(PrefetchQueue *q);
+
+/**
+ * Stop all threads, free the context and log statistics.
+ */
+void ff_prefetch_close(PrefetchContext **pc);
+
+#endif /* AVFORMAT_PREFETCH_H */
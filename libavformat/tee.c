@@ -118,6 +118,25 @@ static int parse_slave_fifo_options(const char *use_fifo,
     return ret;
 }
 
+static int parse_slave_overflow_policy_option(const char *opt, TeeSlave *tee_slave)
+{
+    int drop;
+
+    if (!opt)
+        return 0;
+    else if (!av_strcasecmp("block", opt))
+        drop = 0;
+    else if (!av_strcasecmp("drop", opt))
+        drop = 1;
+    else
+        return AVERROR(EINVAL);
+
+    /* the queue is provided by the fifo pseudo-muxer */
+    tee_slave->use_fifo = 1;
+    return av_dict_set(&tee_slave->fifo_options, "drop_pkts_on_overflow",
+                       drop ? "1" : "0", 0);
+}
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
@@ -161,7 +180,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     AVDictionary *options = NULL, *bsf_options = NULL;
     AVDictionaryEntry *entry;
     char *filename;
-    char *format = NULL, *select = NULL, *on_fail = NULL;
+    char *format = NULL, *select = NULL, *on_fail = NULL, *on_full = NULL;
     char *use_fifo = NULL, *fifo_options_str = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
@@ -183,6 +202,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     STEAL_OPTION("f", format);
     STEAL_OPTION("select", select);
     STEAL_OPTION("onfail", on_fail);
+    STEAL_OPTION("onfull", on_full);
     STEAL_OPTION("use_fifo", use_fifo);
     STEAL_OPTION("fifo_options", fifo_options_str);
     entry = NULL;
@@ -205,6 +225,13 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    ret = parse_slave_overflow_policy_option(on_full, tee_slave);
+    if (ret < 0) {
+        av_log(avf, AV_LOG_ERROR,
+               "Invalid onfull option value, valid options are 'block' and 'drop'\n");
+        goto end;
+    }
+
     if (tee_slave->use_fifo) {
 
         if (options) {
@@ -403,6 +430,7 @@ end:
     av_free(format);
     av_free(select);
     av_free(on_fail);
+    av_free(on_full);
     av_dict_free(&options);
     av_dict_free(&bsf_options);
     av_freep(&tmp_select);
@@ -19,6 +19,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
@@ -30,6 +31,7 @@
 #define MAX_TST_PACKETS 128
 #define SLEEPTIME_50_MS 50000
 #define SLEEPTIME_10_MS 10000
+#define SLEEPTIME_500_MS 500000
 
 /* This is structure of data sent in packets to
  * failing muxer */
@@ -268,6 +270,114 @@ const TestCase tests[] = {
         {NULL}
 };
 
+static int64_t tee_slow_dropped = -1;
+
+static void tee_log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    char line[256];
+    int64_t queued, dropped;
+    va_list vl2;
+
+    va_copy(vl2, vl);
+    av_log_default_callback(avcl, level, fmt, vl2);
+    va_end(vl2);
+
+    if (level == AV_LOG_VERBOSE) {
+        vsnprintf(line, sizeof(line), fmt, vl);
+        if (sscanf(line, "Queue statistics for 'slow': %"SCNd64" packets queued, "
+                   "depth average %*f maximum %*d of %*d, %"SCNd64" packets dropped",
+                   &queued, &dropped) == 2)
+            tee_slow_dropped = dropped;
+    }
+}
+
+/* The tee muxer feeds a fast slave, which blocks when its queue is full, and
+ * a slave with a small queue, which drops packets when full. The first packet
+ * stalls both fifo_test slaves, so all the following packets overflow the
+ * queue of the dropping slave. The other slave must still receive every
+ * packet, the producer must never block and the dropped packets must show up
+ * in the queue statistics. */
+static int fifo_tee_drop_test(void)
+{
+    const char *slaves = "[f=fifo_test:onfull=block]fast|"
+                         "[f=fifo_test:onfull=drop:fifo_options=queue_size=2]slow";
+    const FailingMuxerPacketData stall_data = {0, 0, SLEEPTIME_500_MS};
+    const FailingMuxerPacketData data = {0, 0, 0};
+    const int nb_pkts = 20;
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = NULL;
+    int64_t write_pkt_start = 0, duration;
+    int ret, i;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "tee", slaves);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to create format context: %s\n",
+                av_err2str(ret));
+        goto end;
+    }
+    if (!avformat_new_stream(oc, NULL) || !(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    av_log_set_callback(tee_log_callback);
+
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Unexpected write_header failure: %s\n",
+                av_err2str(ret));
+        goto end;
+    }
+
+    for (i = 0; i < nb_pkts; i++) {
+        ret = prepare_packet(pkt, i ? &data : &stall_data, i);
+        if (ret < 0)
+            break;
+        ret = av_write_frame(oc, pkt);
+        av_packet_unref(pkt);
+        if (ret < 0)
+            break;
+        /* let both consumers pick up the stalling packet */
+        if (!i) {
+            av_usleep(SLEEPTIME_50_MS);
+            write_pkt_start = av_gettime_relative();
+        }
+    }
+    duration = av_gettime_relative() - write_pkt_start;
+
+    if (ret < 0) {
+        fprintf(stderr, "Unexpected write_packet error: %s\n", av_err2str(ret));
+        av_write_trailer(oc);
+        goto end;
+    }
+    if (duration > SLEEPTIME_500_MS / 2) {
+        fprintf(stderr, "Writing packets to tee muxer took too much time "
+                        "while one of the slaves was stalled.\n");
+        ret = AVERROR_BUG;
+        av_write_trailer(oc);
+        goto end;
+    }
+
+    /* closing the slaves prints the packets seen by the fast, then by the
+     * slow slave */
+    ret = av_write_trailer(oc);
+    if (ret < 0) {
+        fprintf(stderr, "Unexpected write_trailer error: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    printf("slow slave packets dropped: %"PRId64"\n", tee_slow_dropped);
+    if (tee_slow_dropped != nb_pkts - 1)
+        ret = AVERROR_BUG;
+
+end:
+    av_log_set_callback(av_log_default_callback);
+    avformat_free_context(oc);
+    av_packet_free(&pkt);
+    printf("tee with packet dropping slave: %s\n", ret < 0 ? "fail" : "ok");
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     int i, ret, ret_all = 0;
@@ -278,5 +388,9 @@ int main(int argc, char *argv[])
             ret_all = ret;
     }
 
-    return ret;
+    ret = fifo_tee_drop_test();
+    if (!ret_all && ret < 0)
+        ret_all = ret;
+
+    return ret_all;
 }
@@ -32,6 +32,7 @@
 
 #include "config.h"
 #include "adler32.h"
+#include "adler32_internal.h"
 #include "common.h"
 #include "intreadwrite.h"
 
@@ -41,7 +42,7 @@
 #define DO4(buf)  DO1(buf); DO1(buf); DO1(buf); DO1(buf);
 #define DO16(buf) DO4(buf); DO4(buf); DO4(buf); DO4(buf);
 
-AVAdler av_adler32_update(AVAdler adler, const uint8_t *buf, size_t len)
+static AVAdler adler32_update_c(AVAdler adler, const uint8_t *buf, size_t len)
 {
     unsigned long s1 = adler & 0xffff;
     unsigned long s2 = adler >> 16;
@@ -94,3 +95,25 @@ AVAdler av_adler32_update(AVAdler adler, const uint8_t *buf, size_t len)
     }
     return (s2 << 16) | s1;
 }
+
+FFAdler32Func ff_adler32_get_func(void)
+{
+    FFAdler32Func func = NULL;
+
+#if ARCH_X86
+    func = ff_adler32_get_func_x86();
+#endif
+    return func ? func : adler32_update_c;
+}
+
+AVAdler av_adler32_update(AVAdler adler, const uint8_t *buf, size_t len)
+{
+#if ARCH_X86
+    if (len >= FF_ADLER32_SIMD_MIN_LEN) {
+        FFAdler32Func func = ff_adler32_get_func_x86();
+        if (func)
+            return func(adler, buf, len);
+    }
+#endif
+    return adler32_update_c(adler, buf, len);
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_ADLER32_INTERNAL_H
+#define AVUTIL_ADLER32_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "adler32.h"
+
+/**
+ * Shortest buffer av_adler32_update() hands to the SIMD functions.
+ */
+#define FF_ADLER32_SIMD_MIN_LEN 64
+
+/**
+ * Function computing the same as av_adler32_update().
+ */
+typedef AVAdler (*FFAdler32Func)(AVAdler adler, const uint8_t *buf, size_t len);
+
+/**
+ * Get the fastest function with the current CPU flags.
+ */
+FFAdler32Func ff_adler32_get_func(void);
+
+/**
+ * @return the SIMD function, NULL if there is none
+ */
+FFAdler32Func ff_adler32_get_func_x86(void);
+
+#endif /* AVUTIL_ADLER32_INTERNAL_H */
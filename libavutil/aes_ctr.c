@@ -25,12 +25,14 @@
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
+#define AES_CTR_BATCH  (8)
 
 typedef struct AVAESCTR {
     struct AVAES* aes;
     uint8_t counter[AES_BLOCK_SIZE];
     uint8_t encrypted_counter[AES_BLOCK_SIZE];
     int block_offset;
+    uint8_t keystream[AES_CTR_BATCH * AES_BLOCK_SIZE];
 } AVAESCTR;
 
 struct AVAESCTR *av_aes_ctr_alloc(void)
@@ -113,8 +115,23 @@ void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int
     const uint8_t* src_end = src + count;
     const uint8_t* cur_end_pos;
     uint8_t* encrypted_counter_pos;
+    int i, blocks;
 
     while (src < src_end) {
+        /* Encrypt runs of whole blocks with a single call, which lets
+         * SIMD implementations process several counters at once. */
+        if (a->block_offset == 0 && src_end - src >= 2 * AES_BLOCK_SIZE) {
+            blocks = FFMIN((src_end - src) / AES_BLOCK_SIZE, AES_CTR_BATCH);
+            for (i = 0; i < blocks; i++) {
+                memcpy(a->keystream + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
+                av_aes_ctr_increment_be64(a->counter + 8);
+            }
+            av_aes_crypt(a->aes, a->keystream, a->keystream, blocks, NULL, 0);
+            for (i = 0; i < blocks * AES_BLOCK_SIZE; i++)
+                *dst++ = *src++ ^ a->keystream[i];
+            continue;
+        }
+
         if (a->block_offset == 0) {
             av_aes_crypt(a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
 
@@ -24,6 +24,7 @@
 #include "buffer_internal.h"
 #include "common.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "thread.h"
 
 AVBufferRef *av_buffer_create(uint8_t *data, size_t size,
@@ -33,7 +34,7 @@ AVBufferRef *av_buffer_create(uint8_t *data, size_t size,
     AVBufferRef *ref = NULL;
     AVBuffer    *buf = NULL;
 
-    buf = av_mallocz(sizeof(*buf));
+    buf = ff_small_allocz(sizeof(*buf));
     if (!buf)
         return NULL;
 
@@ -46,9 +47,9 @@ AVBufferRef *av_buffer_create(uint8_t *data, size_t size,
 
     buf->flags = flags;
 
-    ref = av_mallocz(sizeof(*ref));
+    ref = ff_small_allocz(sizeof(*ref));
     if (!ref) {
-        av_freep(&buf);
+        ff_small_freep(&buf);
         return NULL;
     }
 
@@ -64,11 +65,28 @@ void av_buffer_default_free(void *opaque, uint8_t *data)
     av_free(data);
 }
 
+static void buffer_small_free(void *opaque, uint8_t *data)
+{
+    ff_small_free(data);
+}
+
 AVBufferRef *av_buffer_alloc(size_t size)
 {
     AVBufferRef *ret = NULL;
     uint8_t    *data = NULL;
 
+    if (size <= FF_SMALL_ALLOC_MAX) {
+        data = ff_small_alloc(size);
+        if (!data)
+            return NULL;
+
+        ret = av_buffer_create(data, size, buffer_small_free, NULL, 0);
+        if (!ret)
+            ff_small_free(data);
+
+        return ret;
+    }
+
     data = av_malloc(size);
     if (!data)
         return NULL;
@@ -92,7 +110,7 @@ AVBufferRef *av_buffer_allocz(size_t size)
 
 AVBufferRef *av_buffer_ref(AVBufferRef *buf)
 {
-    AVBufferRef *ret = av_mallocz(sizeof(*ret));
+    AVBufferRef *ret = ff_small_alloc(sizeof(*ret));
 
     if (!ret)
         return NULL;
@@ -112,13 +130,13 @@ static void buffer_replace(AVBufferRef **dst, AVBufferRef **src)
 
     if (src) {
         **dst = **src;
-        av_freep(src);
+        ff_small_freep(src);
     } else
-        av_freep(dst);
+        ff_small_freep(dst);
 
     if (atomic_fetch_sub_explicit(&b->refcount, 1, memory_order_acq_rel) == 1) {
         b->free(b->opaque, b->data);
-        av_freep(&b);
+        ff_small_freep(&b);
     }
 }
 
@@ -251,6 +269,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->pool, 0);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -270,6 +289,7 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->pool, 0);
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -279,15 +299,53 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     return pool;
 }
 
+static BufferPoolEntry *pool_get_entry(AVBufferPool *pool, unsigned idx)
+{
+    unsigned i = idx - 1 + POOL_CHUNK_SIZE;
+    int chunk  = av_log2(i);
+
+    return &pool->entries[chunk - POOL_CHUNK_SHIFT][i - (1U << chunk)];
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uintptr_t head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+
+    do {
+        atomic_store_explicit(&buf->next, head & POOL_IDX_MASK,
+                              memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head,
+                                                    (head & ~POOL_IDX_MASK) | buf->idx,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    uintptr_t head = atomic_load_explicit(&pool->pool, memory_order_acquire);
+    uintptr_t next;
+    BufferPoolEntry *buf;
+
+    do {
+        if (!(head & POOL_IDX_MASK))
+            return NULL;
+        buf  = pool_get_entry(pool, head & POOL_IDX_MASK);
+        /* bump the tag, so that a concurrent pop of the same head fails */
+        next = ((head & ~POOL_IDX_MASK) + POOL_IDX_MASK + 1) |
+               atomic_load_explicit(&buf->next, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, next,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    return buf;
+}
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolEntry *buf;
 
+    while ((buf = pool_pop(pool)))
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
-    }
 }
 
 /*
@@ -296,9 +354,14 @@ static void buffer_pool_flush(AVBufferPool *pool)
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+    int i;
+
     buffer_pool_flush(pool);
     ff_mutex_destroy(&pool->mutex);
 
+    for (i = 0; i < POOL_MAX_CHUNKS; i++)
+        av_freep(&pool->entries[i]);
+
     if (pool->pool_free)
         pool->pool_free(pool->opaque);
 
@@ -314,9 +377,7 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
     pool   = *ppool;
     *ppool = NULL;
 
-    ff_mutex_lock(&pool->mutex);
     buffer_pool_flush(pool);
-    ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -330,15 +391,38 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+/* get an unused entry, must be called with the pool mutex held */
+static BufferPoolEntry *pool_new_entry(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf;
+    unsigned idx = pool->nb_entries + 1;
+    int chunk;
+
+    if (idx > POOL_IDX_MASK - POOL_CHUNK_SIZE)
+        return NULL;
+
+    chunk = av_log2(idx - 1 + POOL_CHUNK_SIZE) - POOL_CHUNK_SHIFT;
+    if (!pool->entries[chunk]) {
+        pool->entries[chunk] = av_calloc((size_t)POOL_CHUNK_SIZE << chunk,
+                                         sizeof(*pool->entries[chunk]));
+        if (!pool->entries[chunk])
+            return NULL;
+    }
+
+    buf = pool_get_entry(pool, idx);
+    buf->idx = idx;
+    atomic_init(&buf->next, 0);
+    pool->nb_entries++;
+
+    return buf;
+}
+
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
 static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
@@ -348,15 +432,16 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
     av_assert0(pool->alloc || pool->alloc2);
 
+    ff_mutex_lock(&pool->mutex);
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
     if (!ret)
-        return NULL;
+        goto end;
 
-    buf = av_mallocz(sizeof(*buf));
+    buf = pool_new_entry(pool);
     if (!buf) {
         av_buffer_unref(&ret);
-        return NULL;
+        goto end;
     }
 
     buf->data   = ret->buffer->data;
@@ -367,6 +452,8 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
+end:
+    ff_mutex_unlock(&pool->mutex);
     return ret;
 }
 
@@ -375,19 +462,15 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
+        if (!ret)
+            pool_push(pool, buf);
     } else {
         ret = pool_alloc_buffer(pool);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -72,12 +72,46 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /*
+     * Index of this entry and of the next one in the free list, see below.
+     * next is only meaningful while the entry is in the free list.
+     */
+    unsigned    idx;
+    atomic_uint next;
 } BufferPoolEntry;
 
+/*
+ * The free buffers of a pool are kept in a lock-free LIFO. Entries are
+ * referred to by a 1-based index instead of a pointer, so that the head of
+ * the list can hold a modification tag in its upper half. This makes a pop
+ * fail if the list was changed in between, even if the same entry is at the
+ * top again (the ABA problem).
+ *
+ * Entries are never freed before the pool itself. They are stored in chunks
+ * of increasing size, chunk n holding POOL_CHUNK_SIZE << n entries, so that
+ * an index can be turned into an entry without locking.
+ */
+#define POOL_IDX_BITS    (4 * sizeof(uintptr_t))
+#define POOL_IDX_MASK    (((uintptr_t)1 << POOL_IDX_BITS) - 1)
+#define POOL_CHUNK_SHIFT 4
+#define POOL_CHUNK_SIZE  (1 << POOL_CHUNK_SHIFT)
+#define POOL_MAX_CHUNKS  (POOL_IDX_BITS - POOL_CHUNK_SHIFT)
+
 struct AVBufferPool {
+    /*
+     * Head of the free list: modification tag << POOL_IDX_BITS | index of
+     * the first free entry, 0 if there is none.
+     */
+    atomic_uintptr_t pool;
+
+    /*
+     * Only taken when a new buffer has to be allocated. Serializes the calls
+     * to alloc/alloc2 and protects entries and nb_entries.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+    BufferPoolEntry *entries[POOL_MAX_CHUNKS];
+    unsigned nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
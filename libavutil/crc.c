@@ -25,6 +25,7 @@
 #include "bswap.h"
 #include "common.h"
 #include "crc.h"
+#include "crc_internal.h"
 
 #if CONFIG_HARDCODED_TABLES
 static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
@@ -389,8 +390,8 @@ const AVCRC *av_crc_get_table(AVCRCId crc_id)
     return av_crc_table[crc_id];
 }
 
-uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
-                const uint8_t *buffer, size_t length)
+static uint32_t crc_c(const AVCRC *ctx, uint32_t crc,
+                     const uint8_t *buffer, size_t length)
 {
     const uint8_t *end = buffer + length;
 
@@ -413,3 +414,47 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
 
     return crc;
 }
+
+FFCRCFunc ff_crc_get_func(AVCRCId crc_id)
+{
+    FFCRCFunc func = NULL;
+
+#if ARCH_X86
+    func = ff_crc_get_func_x86(crc_id);
+#endif
+    return func ? func : crc_c;
+}
+
+#if ARCH_X86
+static FFCRCFunc crc_simd_funcs[AV_CRC_MAX];
+static AVOnce crc_simd_funcs_once = AV_ONCE_INIT;
+
+static av_cold void crc_init_simd_funcs(void)
+{
+    int id;
+
+    for (id = 0; id < AV_CRC_MAX; id++)
+        crc_simd_funcs[id] = ff_crc_get_func_x86(id);
+}
+#endif
+
+uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
+                const uint8_t *buffer, size_t length)
+{
+#if ARCH_X86
+    /* only the built-in tables have SIMD functions, find which one ctx is
+     * from its position in av_crc_table */
+    uintptr_t offset = (uintptr_t)ctx - (uintptr_t)av_crc_table;
+
+    if (length >= FF_CRC_SIMD_MIN_LEN && offset < sizeof(av_crc_table) &&
+        !(offset % sizeof(av_crc_table[0]))) {
+        FFCRCFunc func;
+
+        ff_thread_once(&crc_simd_funcs_once, crc_init_simd_funcs);
+        func = crc_simd_funcs[offset / sizeof(av_crc_table[0])];
+        if (func)
+            return func(ctx, crc, buffer, length);
+    }
+#endif
+    return crc_c(ctx, crc, buffer, length);
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_CRC_INTERNAL_H
+#define AVUTIL_CRC_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc.h"
+
+/**
+ * Shortest buffer av_crc() hands to the SIMD functions.
+ */
+#define FF_CRC_SIMD_MIN_LEN 64
+
+/**
+ * Function computing the same as av_crc() for the table of a built-in CRC.
+ */
+typedef uint32_t (*FFCRCFunc)(const AVCRC *ctx, uint32_t crc,
+                              const uint8_t *buffer, size_t length);
+
+/**
+ * Get the fastest function for a built-in CRC with the current CPU flags.
+ */
+FFCRCFunc ff_crc_get_func(AVCRCId crc_id);
+
+/**
+ * @return the SIMD function for a built-in CRC, NULL if there is none
+ */
+FFCRCFunc ff_crc_get_func_x86(AVCRCId crc_id);
+
+#endif /* AVUTIL_CRC_INTERNAL_H */
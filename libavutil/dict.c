@@ -24,12 +24,30 @@
 #include "dict.h"
 #include "internal.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "time_internal.h"
 #include "bprint.h"
 
+/* Dictionaries with at least this many entries get a hash table index. */
+#define DICT_HASH_MIN_COUNT 16
+
+typedef struct DictHashSlot {
+    uint32_t hash;
+    unsigned idx;   ///< index in elems + 1, 0 for an empty slot
+} DictHashSlot;
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+
+    /*
+     * Open addressing hash table of the indexes in elems, keyed on the case
+     * folded key so that it serves case insensitive lookups as well. Kept at
+     * most half full. It is only an index: elems keeps the iteration order,
+     * and a failure to allocate it just falls back to the linear search.
+     */
+    DictHashSlot *hash;
+    unsigned hash_size;
 };
 
 int av_dict_count(const AVDictionary *m)
@@ -37,10 +55,113 @@ int av_dict_count(const AVDictionary *m)
     return m ? m->count : 0;
 }
 
+static uint32_t dict_hash(const char *key)
+{
+    uint32_t h = 2166136261U;
+
+    while (*key)
+        h = (h ^ av_toupper(*key++)) * 16777619U;
+    return h;
+}
+
+static unsigned dict_hash_find(const AVDictionary *m, uint32_t hash, int idx)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned pos  = hash & mask;
+
+    while (m->hash[pos].idx != idx + 1)
+        pos = (pos + 1) & mask;
+    return pos;
+}
+
+static void dict_hash_insert(AVDictionary *m, uint32_t hash, int idx)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned pos  = hash & mask;
+
+    while (m->hash[pos].idx)
+        pos = (pos + 1) & mask;
+    m->hash[pos].hash = hash;
+    m->hash[pos].idx  = idx + 1;
+}
+
+static void dict_hash_rebuild(AVDictionary *m, unsigned size)
+{
+    int i;
+
+    av_freep(&m->hash);
+    m->hash_size = 0;
+    m->hash = av_calloc(size, sizeof(*m->hash));
+    if (!m->hash)
+        return;
+    m->hash_size = size;
+    for (i = 0; i < m->count; i++)
+        dict_hash_insert(m, dict_hash(m->elems[i].key), i);
+}
+
+/* index the last entry of elems */
+static void dict_hash_add(AVDictionary *m)
+{
+    int idx = m->count - 1;
+
+    if (m->hash && m->count <= m->hash_size / 2)
+        dict_hash_insert(m, dict_hash(m->elems[idx].key), idx);
+    else if (m->hash || m->count >= DICT_HASH_MIN_COUNT)
+        dict_hash_rebuild(m, FFMAX(m->hash_size * 2, 4 * DICT_HASH_MIN_COUNT));
+}
+
+/*
+ * Unindex entry idx, and reindex the last entry of elems as idx, matching
+ * av_dict_set() moving it there.
+ */
+static void dict_hash_remove(AVDictionary *m, int idx)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned pos, next;
+    int last = m->count - 1;
+
+    if (!m->hash)
+        return;
+
+    /* backward shift deletion, refill the hole with the next entry of
+     * the probe sequence that may live there */
+    pos = next = dict_hash_find(m, dict_hash(m->elems[idx].key), idx);
+    for (;;) {
+        next = (next + 1) & mask;
+        if (!m->hash[next].idx)
+            break;
+        if (((next - m->hash[next].hash) & mask) >= ((next - pos) & mask)) {
+            m->hash[pos] = m->hash[next];
+            pos = next;
+        }
+    }
+    m->hash[pos].idx = 0;
+
+    if (idx != last)
+        m->hash[dict_hash_find(m, dict_hash(m->elems[last].key), last)].idx = idx + 1;
+}
+
+static int dict_key_match(const char *s, const char *key, int flags)
+{
+    unsigned int j;
+
+    if (flags & AV_DICT_MATCH_CASE)
+        for (j = 0; s[j] == key[j] && key[j]; j++)
+            ;
+    else
+        for (j = 0; av_toupper(s[j]) == av_toupper(key[j]) && key[j]; j++)
+            ;
+    if (key[j])
+        return 0;
+    if (s[j] && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return 0;
+    return 1;
+}
+
 AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
                                const AVDictionaryEntry *prev, int flags)
 {
-    unsigned int i, j;
+    unsigned int i;
 
     if (!m)
         return NULL;
@@ -50,20 +171,27 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     else
         i = 0;
 
-    for (; i < m->count; i++) {
-        const char *s = m->elems[i].key;
-        if (flags & AV_DICT_MATCH_CASE)
-            for (j = 0; s[j] == key[j] && key[j]; j++)
-                ;
-        else
-            for (j = 0; av_toupper(s[j]) == av_toupper(key[j]) && key[j]; j++)
-                ;
-        if (key[j])
-            continue;
-        if (s[j] && !(flags & AV_DICT_IGNORE_SUFFIX))
-            continue;
-        return &m->elems[i];
+    if (m->hash && !(flags & AV_DICT_IGNORE_SUFFIX)) {
+        /* the first match after prev in elems order, which is not
+         * necessarily the first one in the probe sequence */
+        uint32_t hash = dict_hash(key);
+        unsigned mask = m->hash_size - 1;
+        unsigned pos  = hash & mask;
+        AVDictionaryEntry *ret = NULL;
+
+        for (; m->hash[pos].idx; pos = (pos + 1) & mask) {
+            AVDictionaryEntry *e = &m->elems[m->hash[pos].idx - 1];
+            if (m->hash[pos].hash != hash || e < m->elems + i || (ret && e > ret))
+                continue;
+            if (dict_key_match(e->key, key, flags))
+                ret = e;
+        }
+        return ret;
     }
+
+    for (; i < m->count; i++)
+        if (dict_key_match(m->elems[i].key, key, flags))
+            return &m->elems[i];
     return NULL;
 }
 
@@ -80,11 +208,11 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
     if (flags & AV_DICT_DONT_STRDUP_KEY)
         copy_key = (void *)key;
     else
-        copy_key = av_strdup(key);
+        copy_key = ff_small_strdup(key);
     if (flags & AV_DICT_DONT_STRDUP_VAL)
         copy_value = (void *)value;
     else if (copy_key)
-        copy_value = av_strdup(value);
+        copy_value = ff_small_strdup(value);
     if (!m)
         m = *pm = av_mallocz(sizeof(*m));
     if (!m || (key && !copy_key) || (value && !copy_value))
@@ -92,15 +220,16 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 
     if (tag) {
         if (flags & AV_DICT_DONT_OVERWRITE) {
-            av_free(copy_key);
-            av_free(copy_value);
+            ff_small_free(copy_key);
+            ff_small_free(copy_value);
             return 0;
         }
         if (flags & AV_DICT_APPEND)
             oldval = tag->value;
         else
-            av_free(tag->value);
-        av_free(tag->key);
+            ff_small_free(tag->value);
+        dict_hash_remove(m, tag - m->elems);
+        ff_small_free(tag->key);
         *tag = m->elems[--m->count];
     } else if (copy_value) {
         AVDictionaryEntry *tmp = av_realloc_array(m->elems,
@@ -114,21 +243,23 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         m->elems[m->count].value = copy_value;
         if (oldval && flags & AV_DICT_APPEND) {
             size_t len = strlen(oldval) + strlen(copy_value) + 1;
-            char *newval = av_mallocz(len);
+            char *newval = ff_small_allocz(len);
             if (!newval)
                 goto err_out;
             av_strlcat(newval, oldval, len);
-            av_freep(&oldval);
+            ff_small_freep(&oldval);
             av_strlcat(newval, copy_value, len);
             m->elems[m->count].value = newval;
-            av_freep(&copy_value);
+            ff_small_freep(&copy_value);
         }
         m->count++;
+        dict_hash_add(m);
     } else {
-        av_freep(&copy_key);
+        ff_small_freep(&copy_key);
     }
     if (!m->count) {
         av_freep(&m->elems);
+        av_freep(&m->hash);
         av_freep(pm);
     }
 
@@ -137,10 +268,11 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 err_out:
     if (m && !m->count) {
         av_freep(&m->elems);
+        av_freep(&m->hash);
         av_freep(pm);
     }
-    av_free(copy_key);
-    av_free(copy_value);
+    ff_small_free(copy_key);
+    ff_small_free(copy_value);
     return AVERROR(ENOMEM);
 }
 
@@ -206,10 +338,11 @@ void av_dict_free(AVDictionary **pm)
 
     if (m) {
         while (m->count--) {
-            av_freep(&m->elems[m->count].key);
-            av_freep(&m->elems[m->count].value);
+            ff_small_freep(&m->elems[m->count].key);
+            ff_small_freep(&m->elems[m->count].value);
         }
         av_freep(&m->elems);
+        av_freep(&m->hash);
     }
     av_freep(pm);
 }
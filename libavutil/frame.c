@@ -24,6 +24,7 @@
 #include "frame.h"
 #include "imgutils.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "samplefmt.h"
 #include "hwcontext.h"
 
@@ -80,7 +81,7 @@ static void free_side_data(AVFrameSideData **ptr_sd)
 
     av_buffer_unref(&sd->buf);
     av_dict_free(&sd->metadata);
-    av_freep(ptr_sd);
+    ff_small_freep(ptr_sd);
 }
 
 static void wipe_side_data(AVFrame *frame)
@@ -587,7 +588,7 @@ AVFrameSideData *av_frame_new_side_data_from_buf(AVFrame *frame,
         return NULL;
     frame->side_data = tmp;
 
-    ret = av_mallocz(sizeof(*ret));
+    ret = ff_small_allocz(sizeof(*ret));
     if (!ret)
         return NULL;
 
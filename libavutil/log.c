@@ -33,6 +33,7 @@
 #include <io.h>
 #endif
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include "avutil.h"
 #include "bprint.h"
@@ -53,6 +54,7 @@ static AVMutex mutex = AV_MUTEX_INITIALIZER;
 
 static int av_log_level = AV_LOG_INFO;
 static int flags;
+static atomic_int print_prefix = ATOMIC_VAR_INIT(1);
 
 #define NB_LEVELS 8
 #if defined(_WIN32) && HAVE_SETCONSOLETEXTATTRIBUTE && HAVE_GETSTDHANDLE
@@ -343,60 +345,370 @@ int av_log_format_line2(void *ptr, int level, const char *fmt, va_list vl,
     return ret;
 }
 
-void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+/* Writes out one formatted line, must be called with mutex held */
+static void log_output(int level, unsigned tint, const int type[2],
+                       char *part[4], const char *line, int prefix)
 {
-    static int print_prefix = 1;
     static int count;
     static char prev[LINE_SZ];
-    AVBPrint part[4];
-    char line[LINE_SZ];
     static int is_atty;
-    int type[2];
-    unsigned tint = 0;
-
-    if (level >= 0) {
-        tint = level & 0xff00;
-        level &= 0xff;
-    }
-
-    if (level > av_log_level)
-        return;
-    ff_mutex_lock(&mutex);
-
-    format_line(ptr, level, fmt, vl, part, &print_prefix, type);
-    snprintf(line, sizeof(line), "%s%s%s%s", part[0].str, part[1].str, part[2].str, part[3].str);
 
 #if HAVE_ISATTY
     if (!is_atty)
         is_atty = isatty(2) ? 1 : -1;
 #endif
 
-    if (print_prefix && (flags & AV_LOG_SKIP_REPEATED) && !strcmp(line, prev) &&
+    if (prefix && (flags & AV_LOG_SKIP_REPEATED) && !strcmp(line, prev) &&
         *line && line[strlen(line) - 1] != '\r'){
         count++;
         if (is_atty == 1)
             fprintf(stderr, "    Last message repeated %d times\r", count);
-        goto end;
+        return;
     }
     if (count > 0) {
         fprintf(stderr, "    Last message repeated %d times\n", count);
         count = 0;
     }
     strcpy(prev, line);
-    sanitize(part[0].str);
-    colored_fputs(type[0], 0, part[0].str);
-    sanitize(part[1].str);
-    colored_fputs(type[1], 0, part[1].str);
-    sanitize(part[2].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2].str);
-    sanitize(part[3].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3].str);
+    sanitize(part[0]);
+    colored_fputs(type[0], 0, part[0]);
+    sanitize(part[1]);
+    colored_fputs(type[1], 0, part[1]);
+    sanitize(part[2]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2]);
+    sanitize(part[3]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3]);
+}
+
+#if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
+
+/*
+ * Asynchronous logging: messages are formatted by the logging thread into a
+ * slot of a bounded lock-free MPSC ring and written out by a background
+ * thread, in the order the slots were claimed.
+ */
+
+/* Number of queued lines, must be a power of two */
+#define RING_SIZE 256
+
+/* Positions are counted modulo 2^31, the top bit of ring_head holds the
+ * print_prefix state left by the line at the previous position, so that
+ * claiming a slot and updating the state is a single atomic operation. */
+#define POS_MASK    0x7fffffffU
+#define PREFIX_FLAG 0x80000000U
+
+typedef struct LogSlot {
+    /* Sequence number: equal to the position when the slot is free for that
+     * position, position + 1 once the line at that position is published */
+    atomic_uint seq;
+    int level;
+    unsigned tint;
+    int type[2];
+    int print_prefix;
+    int len[4];
+    /* the four parts of the line, each followed by a null terminator */
+    char buf[LINE_SZ];
+} LogSlot;
+
+static AVOnce async_init_once = AV_ONCE_INIT;
+static int async_init_ret;
+static pthread_mutex_t async_lock;
+static pthread_cond_t  wake_cond;       /* new lines for the writer */
+static pthread_cond_t  progress_cond;   /* lines were written */
+static pthread_t       writer_thread;
+static LogSlot        *ring;
+static atomic_uint     ring_head;       /* next position to claim | PREFIX_FLAG */
+static atomic_uint     ring_done;       /* lines written so far */
+static atomic_int      writer_sleeping;
+static atomic_int      async_running;
+
+/* Signed distance between two positions */
+static int pos_diff(unsigned a, unsigned b)
+{
+    return (int)((a - b) << 1) >> 1;
+}
+
+static int slot_ready(unsigned pos)
+{
+    LogSlot *slot = &ring[pos & (RING_SIZE - 1)];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) == ((pos + 1) & POS_MASK);
+}
+
+static void *log_writer(void *arg)
+{
+    unsigned tail = 0;
+
+    for (;;) {
+        unsigned start = tail;
+
+        ff_mutex_lock(&mutex);
+        while (slot_ready(tail)) {
+            LogSlot *slot = &ring[tail & (RING_SIZE - 1)];
+            char line[LINE_SZ];
+            char *part[4];
+
+            part[0] = slot->buf;
+            for (int i = 1; i < 4; i++)
+                part[i] = part[i - 1] + slot->len[i - 1] + 1;
+            snprintf(line, sizeof(line), "%s%s%s%s", part[0], part[1], part[2], part[3]);
+            log_output(slot->level, slot->tint, slot->type, part, line,
+                       slot->print_prefix);
+
+            atomic_store_explicit(&slot->seq, (tail + RING_SIZE) & POS_MASK,
+                                  memory_order_release);
+            tail = (tail + 1) & POS_MASK;
+        }
+        ff_mutex_unlock(&mutex);
+
+        pthread_mutex_lock(&async_lock);
+        if (tail != start) {
+            atomic_store(&ring_done, tail);
+            pthread_cond_broadcast(&progress_cond);
+        } else {
+            /* Producers check writer_sleeping after publishing their line,
+             * so either they see it set or we see their line here. */
+            atomic_store(&writer_sleeping, 1);
+            if (!slot_ready(tail))
+                pthread_cond_wait(&wake_cond, &async_lock);
+            atomic_store(&writer_sleeping, 0);
+        }
+        pthread_mutex_unlock(&async_lock);
+    }
+
+    return NULL;
+}
+
+#if HAVE_PTHREADS
+static void log_atexit(void)
+{
+    av_log_flush();
+}
+#endif
+
+static void async_init(void)
+{
+    int ret;
+
+    ring = av_malloc_array(RING_SIZE, sizeof(*ring));
+    if (!ring) {
+        async_init_ret = AVERROR(ENOMEM);
+        return;
+    }
+    for (int i = 0; i < RING_SIZE; i++)
+        atomic_init(&ring[i].seq, i);
+    atomic_init(&ring_head,
+                atomic_load_explicit(&print_prefix, memory_order_relaxed) ? PREFIX_FLAG : 0);
+
+    if ((ret = pthread_mutex_init(&async_lock, NULL))) {
+        av_freep(&ring);
+        async_init_ret = AVERROR(ret);
+        return;
+    }
+    pthread_cond_init(&wake_cond, NULL);
+    pthread_cond_init(&progress_cond, NULL);
+
+    /* The writer is kept until the process exits, queued lines are written
+     * out on exit, when logging a fatal message or on av_log_flush(). */
+    if ((ret = pthread_create(&writer_thread, NULL, log_writer, NULL))) {
+        pthread_cond_destroy(&progress_cond);
+        pthread_cond_destroy(&wake_cond);
+        pthread_mutex_destroy(&async_lock);
+        av_freep(&ring);
+        async_init_ret = AVERROR(ret);
+        return;
+    }
+#if HAVE_PTHREADS
+    atexit(log_atexit);
+#endif
+    atomic_store(&async_running, 1);
+}
+
+/* Waits until the writer has freed the slot for position pos */
+static void wait_for_slot(unsigned pos)
+{
+    LogSlot *slot = &ring[pos & (RING_SIZE - 1)];
+
+    pthread_mutex_lock(&async_lock);
+    while (pos_diff(atomic_load(&slot->seq), pos) < 0) {
+        pthread_cond_signal(&wake_cond);
+        pthread_cond_wait(&progress_cond, &async_lock);
+    }
+    pthread_mutex_unlock(&async_lock);
+}
+
+/* Queues a line, returns a negative value if it has to be logged synchronously */
+static int log_async(void *ptr, int level, unsigned tint, const char *fmt, va_list vl)
+{
+    AVBPrint part[4];
+    LogSlot *slot;
+    va_list vl2;
+    unsigned pos;
+    int type[2], prefix, next, complete, size;
+
+    ff_thread_once(&async_init_once, async_init);
+    if (async_init_ret < 0)
+        return async_init_ret;
+
+    /* The line is formatted for the print_prefix state at the position it
+     * is queued at, and formatted again if another thread queued a line
+     * with a different outcome in the meantime. */
+    prefix = -1;
+    for (;;) {
+        unsigned head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        int cur = !!(head & PREFIX_FLAG), diff;
+
+        if (cur != prefix) {
+            if (prefix >= 0)
+                av_bprint_finalize(part + 3, NULL);
+            prefix = next = cur;
+            va_copy(vl2, vl);
+            format_line(ptr, level, fmt, vl2, part, &next, type);
+            va_end(vl2);
+
+            complete = 1;
+            size     = 0;
+            for (int i = 0; i < 4; i++) {
+                complete &= av_bprint_is_complete(part + i);
+                size     += part[i].len + 1;
+            }
+            if (!complete || size > LINE_SZ) {
+                av_bprint_finalize(part + 3, NULL);
+                return AVERROR(ENOSPC);
+            }
+        }
+
+        pos  = head & POS_MASK;
+        slot = &ring[pos & (RING_SIZE - 1)];
+        diff = pos_diff(atomic_load_explicit(&slot->seq, memory_order_acquire), pos);
+        if (!diff) {
+            unsigned new_head = ((pos + 1) & POS_MASK) | (next ? PREFIX_FLAG : 0);
+            if (atomic_compare_exchange_weak_explicit(&ring_head, &head, new_head,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            wait_for_slot(pos);
+        }
+    }
+
+    slot->level   = level;
+    slot->tint    = tint;
+    slot->type[0] = type[0];
+    slot->type[1] = type[1];
+    slot->print_prefix = next;
+    size = 0;
+    for (int i = 0; i < 4; i++) {
+        slot->len[i] = part[i].len;
+        memcpy(slot->buf + size, part[i].str, part[i].len + 1);
+        size += part[i].len + 1;
+    }
+    av_bprint_finalize(part + 3, NULL);
+
+    atomic_store_explicit(&slot->seq, (pos + 1) & POS_MASK, memory_order_release);
+    if (atomic_load(&writer_sleeping)) {
+        pthread_mutex_lock(&async_lock);
+        pthread_cond_signal(&wake_cond);
+        pthread_mutex_unlock(&async_lock);
+    }
+    return 0;
+}
+
+static int load_prefix(void)
+{
+    if (atomic_load(&async_running))
+        return !!(atomic_load_explicit(&ring_head, memory_order_relaxed) & PREFIX_FLAG);
+    return atomic_load_explicit(&print_prefix, memory_order_relaxed);
+}
+
+static void store_prefix(int prefix)
+{
+    atomic_store_explicit(&print_prefix, prefix, memory_order_relaxed);
+    if (!atomic_load(&async_running))
+        return;
+    if (prefix)
+        atomic_fetch_or_explicit(&ring_head, PREFIX_FLAG, memory_order_relaxed);
+    else
+        atomic_fetch_and_explicit(&ring_head, POS_MASK, memory_order_relaxed);
+}
+
+void av_log_flush(void)
+{
+    unsigned head;
+
+    if (!atomic_load(&async_running))
+        return;
+
+    head = atomic_load(&ring_head) & POS_MASK;
+    pthread_mutex_lock(&async_lock);
+    while (pos_diff(atomic_load(&ring_done), head) < 0) {
+        pthread_cond_signal(&wake_cond);
+        pthread_cond_wait(&progress_cond, &async_lock);
+    }
+    pthread_mutex_unlock(&async_lock);
+}
+
+#else
+
+static int log_async(void *ptr, int level, unsigned tint, const char *fmt, va_list vl)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int load_prefix(void)
+{
+    return atomic_load_explicit(&print_prefix, memory_order_relaxed);
+}
+
+static void store_prefix(int prefix)
+{
+    atomic_store_explicit(&print_prefix, prefix, memory_order_relaxed);
+}
+
+void av_log_flush(void)
+{
+}
+
+#endif
+
+void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+{
+    AVBPrint part[4];
+    char line[LINE_SZ];
+    int type[2], prefix;
+    unsigned tint = 0;
+
+    if (level >= 0) {
+        tint = level & 0xff00;
+        level &= 0xff;
+    }
+
+    if (level > av_log_level)
+        return;
+
+    if (flags & AV_LOG_ASYNC) {
+        /* Fatal messages are usually followed by abort(), so they are
+         * written out synchronously after everything queued before. */
+        if (level > AV_LOG_FATAL && log_async(ptr, level, tint, fmt, vl) >= 0)
+            return;
+        av_log_flush();
+    }
+
+    ff_mutex_lock(&mutex);
+
+    prefix = load_prefix();
+    format_line(ptr, level, fmt, vl, part, &prefix, type);
+    store_prefix(prefix);
+    snprintf(line, sizeof(line), "%s%s%s%s", part[0].str, part[1].str, part[2].str, part[3].str);
+
+    log_output(level, tint, type,
+               (char *[4]){ part[0].str, part[1].str, part[2].str, part[3].str },
+               line, prefix);
 
 #if CONFIG_VALGRIND_BACKTRACE
     if (level <= BACKTRACE_LOGLEVEL)
         VALGRIND_PRINTF_BACKTRACE("%s", "");
 #endif
-end:
+
     av_bprint_finalize(part+3, NULL);
     ff_mutex_unlock(&mutex);
 }
@@ -444,6 +756,9 @@ void av_log_set_level(int level)
 
 void av_log_set_flags(int arg)
 {
+    /* write out what was queued before going synchronous */
+    if ((flags & AV_LOG_ASYNC) && !(arg & AV_LOG_ASYNC))
+        av_log_flush();
     flags = arg;
 }
 
@@ -378,9 +378,30 @@ int av_log_format_line2(void *ptr, int level, const char *fmt, va_list vl,
  */
 #define AV_LOG_PRINT_LEVEL 2
 
+/**
+ * Make av_log_default_callback() queue messages and write them out from a
+ * background thread, so that logging threads do not wait on each other or
+ * on stderr.
+ *
+ * Messages are formatted when they are logged and written in the order
+ * they were queued. Messages at AV_LOG_FATAL and below, and messages too
+ * long to be queued, are written synchronously after everything queued
+ * before them. Queued messages are also written out when this flag is
+ * cleared, on av_log_flush() and on exit where supported.
+ *
+ * Without threading support, this flag has no effect.
+ */
+#define AV_LOG_ASYNC 4
+
 void av_log_set_flags(int arg);
 int av_log_get_flags(void);
 
+/**
+ * Wait until all messages queued by av_log_default_callback() with the
+ * AV_LOG_ASYNC flag set have been written out.
+ */
+void av_log_flush(void);
+
 /**
  * @}
  */
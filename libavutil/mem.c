@@ -43,6 +43,7 @@
 #include "dynarray.h"
 #include "intreadwrite.h"
 #include "mem.h"
+#include "thread.h"
 
 #ifdef MALLOC_PREFIX
 
@@ -547,3 +548,284 @@ void av_fast_mallocz(void *ptr, unsigned int *size, size_t min_size)
 {
     fast_malloc(ptr, size, min_size, 1);
 }
+
+/*
+ * Small allocation cache.
+ *
+ * Objects of up to SMALL_MAX_SIZE bytes are carved from SMALL_CHUNK_SIZE
+ * chunks, each of which holds objects of a single size class. Chunks are
+ * aligned on their size, so the chunk an object belongs to is found by
+ * masking its address, and looked up in small_chunks[] to tell cached
+ * objects from av_malloc()ed ones without touching the memory.
+ *
+ * Every class keeps its free objects in a lock-free LIFO, using the same
+ * tagged index scheme as AVBufferPool. The next links live in an array at
+ * the start of each chunk, not in the objects, so a racing reader never
+ * sees user data. Chunks are never given back, which is what makes reading
+ * the links of an object popped by another thread safe.
+ */
+#define SMALL_CHUNK_SIZE    (1 << 16)
+#define SMALL_REGION_CHUNKS 16
+#define SMALL_NB_CLASSES    4
+#define SMALL_MAX_SIZE      FF_SMALL_ALLOC_MAX
+#define SMALL_MAX_CHUNKS    256 /* per class */
+#define SMALL_HASH_SIZE     (2 * SMALL_NB_CLASSES * SMALL_MAX_CHUNKS)
+#define SMALL_IDX_BITS      (4 * sizeof(uintptr_t))
+#define SMALL_IDX_MASK      (((uintptr_t)1 << SMALL_IDX_BITS) - 1)
+
+typedef struct SmallClass {
+    /* Generation in the upper half, 1 + index of the first free object in
+     * the lower half, 0 if there is none */
+    atomic_uintptr_t free;
+    atomic_size_t    allocs;
+    atomic_size_t    frees;
+    atomic_int       nb_chunks;
+    uint8_t         *chunks[SMALL_MAX_CHUNKS];
+} SmallClass;
+
+static SmallClass small_classes[SMALL_NB_CLASSES];
+/* Chunk address | chunk index << 2 | class, 0 for unused slots */
+static atomic_uintptr_t small_chunks[SMALL_HASH_SIZE];
+static atomic_int small_total_chunks;
+static atomic_int small_enabled;
+static atomic_size_t small_fallbacks;
+
+static AVMutex small_mutex = AV_MUTEX_INITIALIZER;
+static uint8_t *small_region;
+static int small_region_left;
+
+static inline size_t small_size(int c)
+{
+    return 32 << c;
+}
+
+static inline unsigned small_per_chunk(int c)
+{
+    return (SMALL_CHUNK_SIZE - 64) / (small_size(c) + sizeof(atomic_uint));
+}
+
+static inline unsigned small_max_chunks(int c)
+{
+    return FFMIN(SMALL_MAX_CHUNKS, (SMALL_IDX_MASK - 1) / small_per_chunk(c));
+}
+
+static inline atomic_uint *small_next(int c, unsigned idx)
+{
+    const unsigned per_chunk = small_per_chunk(c);
+    return (atomic_uint *)small_classes[c].chunks[idx / per_chunk] + idx % per_chunk;
+}
+
+static inline uint8_t *small_obj(int c, unsigned idx)
+{
+    const unsigned per_chunk = small_per_chunk(c);
+    uint8_t *chunk = small_classes[c].chunks[idx / per_chunk];
+    return chunk + FFALIGN(per_chunk * sizeof(atomic_uint), 64) +
+           (idx % per_chunk) * small_size(c);
+}
+
+static inline unsigned small_hash(uintptr_t chunk)
+{
+    return ((uint32_t)(chunk / SMALL_CHUNK_SIZE) * 0x9E3779B1U) & (SMALL_HASH_SIZE - 1);
+}
+
+/* Returns the chunk entry of ptr, 0 if it was not allocated by the cache */
+static uintptr_t small_lookup(const void *ptr)
+{
+    const uintptr_t chunk = (uintptr_t)ptr & ~(uintptr_t)(SMALL_CHUNK_SIZE - 1);
+    uintptr_t entry;
+    unsigned h;
+
+    if (!atomic_load_explicit(&small_total_chunks, memory_order_acquire))
+        return 0;
+
+    for (h = small_hash(chunk);
+         (entry = atomic_load_explicit(&small_chunks[h], memory_order_acquire));
+         h = (h + 1) & (SMALL_HASH_SIZE - 1))
+        if ((entry & ~(uintptr_t)(SMALL_CHUNK_SIZE - 1)) == chunk)
+            return entry;
+
+    return 0;
+}
+
+/* Pushes the objects first to last, which are linked already, on the free list */
+static void small_push(SmallClass *cls, int c, unsigned first, unsigned last)
+{
+    uintptr_t head = atomic_load_explicit(&cls->free, memory_order_relaxed);
+    uintptr_t new;
+
+    do {
+        atomic_store_explicit(small_next(c, last), head & SMALL_IDX_MASK,
+                              memory_order_relaxed);
+        new = ((head & ~SMALL_IDX_MASK) + (SMALL_IDX_MASK + 1)) | (first + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&cls->free, &head, new,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/* Adds a chunk to class c, returns its first object and frees the others */
+static void *small_add_chunk(int c)
+{
+    SmallClass *cls = &small_classes[c];
+    const unsigned per_chunk = small_per_chunk(c);
+    unsigned first, h;
+    uint8_t *chunk = NULL;
+    int idx;
+
+    ff_mutex_lock(&small_mutex);
+
+    idx = atomic_load_explicit(&cls->nb_chunks, memory_order_relaxed);
+    if (idx >= small_max_chunks(c))
+        goto end;
+
+    if (!small_region_left) {
+        uint8_t *region = malloc((SMALL_REGION_CHUNKS + 1) * SMALL_CHUNK_SIZE);
+        if (!region)
+            goto end;
+        /* regions are never freed, see above */
+        small_region      = (uint8_t *)FFALIGN((uintptr_t)region, SMALL_CHUNK_SIZE);
+        small_region_left = SMALL_REGION_CHUNKS;
+    }
+    chunk = small_region;
+    small_region += SMALL_CHUNK_SIZE;
+    small_region_left--;
+
+    cls->chunks[idx] = chunk;
+    atomic_store_explicit(&cls->nb_chunks, idx + 1, memory_order_relaxed);
+
+    for (h = small_hash((uintptr_t)chunk); atomic_load_explicit(&small_chunks[h], memory_order_relaxed);
+         h = (h + 1) & (SMALL_HASH_SIZE - 1))
+        ;
+    atomic_store_explicit(&small_chunks[h], (uintptr_t)chunk | idx << 2 | c,
+                          memory_order_release);
+    atomic_fetch_add_explicit(&small_total_chunks, 1, memory_order_release);
+
+end:
+    ff_mutex_unlock(&small_mutex);
+
+    if (!chunk)
+        return NULL;
+
+    first = idx * per_chunk;
+    for (unsigned i = first + 1; i < first + per_chunk - 1; i++)
+        atomic_init(small_next(c, i), i + 2);
+    small_push(cls, c, first + 1, first + per_chunk - 1);
+
+    return small_obj(c, first);
+}
+
+void *ff_small_alloc(size_t size)
+{
+    SmallClass *cls;
+    uintptr_t head;
+    void *ptr;
+    int c;
+
+    if (!size || size > SMALL_MAX_SIZE ||
+        !atomic_load_explicit(&small_enabled, memory_order_relaxed))
+        return av_malloc(size);
+
+    c   = size <= 32 ? 0 : av_log2(size - 1) - 4;
+    cls = &small_classes[c];
+
+    head = atomic_load_explicit(&cls->free, memory_order_acquire);
+    while (head & SMALL_IDX_MASK) {
+        const unsigned idx = (head & SMALL_IDX_MASK) - 1;
+        const uintptr_t next = atomic_load_explicit(small_next(c, idx),
+                                                    memory_order_relaxed);
+        const uintptr_t new = ((head & ~SMALL_IDX_MASK) + (SMALL_IDX_MASK + 1)) | next;
+
+        if (atomic_compare_exchange_weak_explicit(&cls->free, &head, new,
+                                                  memory_order_acquire,
+                                                  memory_order_acquire)) {
+            atomic_fetch_add_explicit(&cls->allocs, 1, memory_order_relaxed);
+            return small_obj(c, idx);
+        }
+    }
+
+    ptr = small_add_chunk(c);
+    if (!ptr) {
+        atomic_fetch_add_explicit(&small_fallbacks, 1, memory_order_relaxed);
+        return av_malloc(size);
+    }
+    atomic_fetch_add_explicit(&cls->allocs, 1, memory_order_relaxed);
+    return ptr;
+}
+
+void *ff_small_allocz(size_t size)
+{
+    void *ptr = ff_small_alloc(size);
+    if (ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+char *ff_small_strdup(const char *s)
+{
+    char *ptr = NULL;
+    if (s) {
+        size_t len = strlen(s) + 1;
+        ptr = ff_small_alloc(len);
+        if (ptr)
+            memcpy(ptr, s, len);
+    }
+    return ptr;
+}
+
+void ff_small_free(void *ptr)
+{
+    const uintptr_t entry = ptr ? small_lookup(ptr) : 0;
+    const int c = entry & 3;
+    const unsigned chunk_idx = (entry & (SMALL_CHUNK_SIZE - 1)) >> 2;
+    SmallClass *cls = &small_classes[c];
+    unsigned idx;
+
+    if (!entry) {
+        av_free(ptr);
+        return;
+    }
+
+    idx = chunk_idx * small_per_chunk(c) +
+          ((uint8_t *)ptr - small_obj(c, chunk_idx * small_per_chunk(c))) / small_size(c);
+    small_push(cls, c, idx, idx);
+    atomic_fetch_add_explicit(&cls->frees, 1, memory_order_relaxed);
+}
+
+void ff_small_freep(void *arg)
+{
+    void *val;
+
+    memcpy(&val, arg, sizeof(val));
+    memcpy(arg, &(void *){ NULL }, sizeof(val));
+    ff_small_free(val);
+}
+
+void av_mem_cache_enable(int enable)
+{
+    atomic_store_explicit(&small_enabled, !!enable, memory_order_relaxed);
+}
+
+int64_t av_mem_cache_get_stat(enum AVMemCacheStat stat)
+{
+    int64_t ret = 0;
+
+    if (stat == AV_MEM_CACHE_STAT_FALLBACKS)
+        return atomic_load_explicit(&small_fallbacks, memory_order_relaxed);
+
+    for (int c = 0; c < SMALL_NB_CLASSES; c++) {
+        SmallClass *cls = &small_classes[c];
+        size_t allocs = atomic_load_explicit(&cls->allocs, memory_order_relaxed);
+        size_t frees  = atomic_load_explicit(&cls->frees,  memory_order_relaxed);
+        int nb_chunks = atomic_load_explicit(&cls->nb_chunks, memory_order_relaxed);
+
+        if (stat == AV_MEM_CACHE_STAT_ALLOCS)
+            ret += allocs;
+        else if (stat == AV_MEM_CACHE_STAT_FREES)
+            ret += frees;
+        else if (stat == AV_MEM_CACHE_STAT_IN_USE)
+            ret += (int64_t)(allocs - frees) * small_size(c);
+        else if (stat == AV_MEM_CACHE_STAT_RESERVED)
+            ret += (int64_t)nb_chunks * SMALL_CHUNK_SIZE;
+    }
+
+    return ret;
+}
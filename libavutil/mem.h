@@ -705,6 +705,46 @@ static inline int av_size_mult(size_t a, size_t b, size_t *r)
  */
 void av_max_alloc(size_t max);
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup lavu_mem_cache Small Allocation Cache
+ *
+ * Cache for the small internal allocations libavutil makes for every packet
+ * and frame, such as AVBufferRef and AVBuffer headers, small buffers
+ * allocated with av_buffer_alloc() (e.g. frame side data) and dictionary
+ * strings. Cached objects come from large chunks and are recycled without
+ * locking, instead of going through malloc() and free() each time.
+ *
+ * The cache is disabled by default. Memory taken by it is kept for reuse
+ * until the process exits.
+ *
+ * @{
+ */
+
+enum AVMemCacheStat {
+    AV_MEM_CACHE_STAT_ALLOCS,    ///< number of allocations served by the cache
+    AV_MEM_CACHE_STAT_FREES,     ///< number of allocations returned to the cache
+    AV_MEM_CACHE_STAT_FALLBACKS, ///< number of allocations passed to av_malloc() because the cache was full
+    AV_MEM_CACHE_STAT_IN_USE,    ///< bytes currently allocated from the cache
+    AV_MEM_CACHE_STAT_RESERVED,  ///< bytes of memory held by the cache
+};
+
+/**
+ * Enable or disable the small allocation cache. This can be called at any
+ * time, disabling it only affects new allocations.
+ *
+ * @param enable 1 to enable, 0 to disable
+ */
+void av_mem_cache_enable(int enable);
+
+/**
+ * Get a statistic about the small allocation cache, summed over all threads.
+ */
+int64_t av_mem_cache_get_stat(enum AVMemCacheStat stat);
+
 /**
  * @}
  * @}
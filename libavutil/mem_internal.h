@@ -136,4 +136,30 @@
 #   define LOCAL_ALIGNED_32(t, v, ...) E1(LOCAL_ALIGNED_A(32, t, v, __VA_ARGS__,,))
 #endif
 
+/**
+ * Largest allocation served by the small allocation cache.
+ */
+#define FF_SMALL_ALLOC_MAX 256
+
+/**
+ * Allocate size bytes from the small allocation cache if it was enabled with
+ * av_mem_cache_enable() and size is at most FF_SMALL_ALLOC_MAX, with
+ * av_malloc() otherwise. The memory is aligned like with av_malloc() up to
+ * the size of the allocation, and must be freed with ff_small_free().
+ */
+void *ff_small_alloc(size_t size);
+void *ff_small_allocz(size_t size);
+char *ff_small_strdup(const char *s);
+
+/**
+ * Free memory allocated with ff_small_alloc() or av_malloc().
+ */
+void ff_small_free(void *ptr);
+
+/**
+ * Free memory allocated with ff_small_alloc() or av_malloc() and set the
+ * pointer pointing to it to NULL.
+ */
+void ff_small_freep(void *ptr);
+
 #endif /* AVUTIL_MEM_INTERNAL_H */
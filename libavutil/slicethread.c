@@ -17,6 +17,7 @@
  */
 
 #include <stdatomic.h>
+#include "config.h"
 #include "slicethread.h"
 #include "mem.h"
 #include "thread.h"
@@ -24,25 +25,50 @@
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+/*
+ * Threads poll for new work for a while before going to sleep. The budget of
+ * each thread adapts between SPIN_MIN and SPIN_MAX iterations: it is doubled
+ * when the wait ended while polling and halved when it did not. Below
+ * SPIN_MIN polling stops, and is only tried again every SPIN_RETRY waits.
+ */
+#define SPIN_MIN   64
+#define SPIN_MAX   (1 << 10)
+#define SPIN_RETRY 16
+
+/* jobs are taken from the shared counter in about this many chunks per thread */
+#define CHUNKS_PER_THREAD 8
+
+typedef struct SpinState {
+    unsigned budget;
+    unsigned waits;     ///< waits since polling was stopped
+} SpinState;
+
 typedef struct WorkerContext {
     AVSliceThread   *ctx;
     pthread_mutex_t mutex;
     pthread_cond_t  cond;
     pthread_t       thread;
-    int             done;
+    atomic_uint     generation; ///< incremented for each execute the worker takes part in
+    atomic_int      sleeping;
+    SpinState       spin;
 } WorkerContext;
 
 struct AVSliceThread {
     WorkerContext   *workers;
     int             nb_threads;
     int             nb_active_threads;
+    int             nb_runners;     ///< threads calling run_jobs() in the current execute
     int             nb_jobs;
+    unsigned        chunk_size;
+    unsigned        max_spin;
+    SpinState       main_spin;
 
     atomic_uint     first_job;
     atomic_uint     current_job;
+    atomic_uint     nb_finished;
     pthread_mutex_t done_mutex;
     pthread_cond_t  done_cond;
-    int             done;
+    atomic_int      done;
     int             finished;
 
     void            *priv;
@@ -50,58 +76,119 @@ struct AVSliceThread {
     void            (*main_func)(void *priv);
 };
 
+static av_always_inline void cpu_relax(void)
+{
+#if ARCH_X86 && HAVE_INLINE_ASM
+    __asm__ volatile ("pause" ::: "memory");
+#elif ARCH_AARCH64 && HAVE_INLINE_ASM
+    __asm__ volatile ("yield" ::: "memory");
+#endif
+}
+
+static unsigned spin_begin(const AVSliceThread *ctx, SpinState *s)
+{
+    if (!s->budget && ctx->max_spin && ++s->waits >= SPIN_RETRY) {
+        s->waits = 0;
+        return SPIN_MIN;
+    }
+    return s->budget;
+}
+
+static void spin_end(const AVSliceThread *ctx, SpinState *s, unsigned budget, int hit)
+{
+    if (!budget)
+        return;
+    if (hit)
+        s->budget = FFMIN(budget * 2, ctx->max_spin);
+    else
+        s->budget = budget / 2 >= SPIN_MIN ? budget / 2 : 0;
+}
+
+/*
+ * The first nb_active_threads callers each get a threadnr, starting with the
+ * job of the same number, and share the remaining jobs. There can be one
+ * caller more than threadnrs, which then has nothing to do.
+ * Returns 1 for the last caller to finish.
+ */
 static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
     unsigned nb_active_threads = ctx->nb_active_threads;
+    unsigned chunk_size = ctx->chunk_size;
     unsigned first_job    = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
-    unsigned current_job  = first_job;
-
-    do {
-        ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
-    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs);
+    unsigned current_job, end;
+
+    if (first_job < nb_active_threads) {
+        ctx->worker_func(ctx->priv, first_job, first_job, nb_jobs, nb_active_threads);
+        while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, chunk_size, memory_order_acq_rel)) < nb_jobs) {
+            end = FFMIN(current_job + chunk_size, nb_jobs);
+            for (; current_job < end; current_job++)
+                ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
+        }
+    }
 
-    return current_job == nb_jobs + nb_active_threads - 1;
+    return atomic_fetch_add_explicit(&ctx->nb_finished, 1, memory_order_acq_rel) == ctx->nb_runners - 1;
 }
 
 static void *attribute_align_arg thread_worker(void *v)
 {
     WorkerContext *w = v;
     AVSliceThread *ctx = w->ctx;
-
-    pthread_mutex_lock(&w->mutex);
-    pthread_cond_signal(&w->cond);
+    unsigned generation = 0;
 
     while (1) {
-        w->done = 1;
-        while (w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
+        unsigned budget = spin_begin(ctx, &w->spin), spin = 0;
 
-        if (ctx->finished) {
+        while (spin < budget &&
+               atomic_load_explicit(&w->generation, memory_order_acquire) == generation) {
+            cpu_relax();
+            spin++;
+        }
+        spin_end(ctx, &w->spin, budget, spin < budget);
+
+        if (atomic_load(&w->generation) == generation) {
+            pthread_mutex_lock(&w->mutex);
+            atomic_store(&w->sleeping, 1);
+            while (atomic_load(&w->generation) == generation)
+                pthread_cond_wait(&w->cond, &w->mutex);
+            atomic_store(&w->sleeping, 0);
             pthread_mutex_unlock(&w->mutex);
-            return NULL;
         }
+        generation++;
+
+        if (ctx->finished)
+            return NULL;
 
         if (run_jobs(ctx)) {
             pthread_mutex_lock(&ctx->done_mutex);
-            ctx->done = 1;
+            atomic_store_explicit(&ctx->done, 1, memory_order_release);
             pthread_cond_signal(&ctx->done_cond);
             pthread_mutex_unlock(&ctx->done_mutex);
         }
     }
 }
 
+static void wake_worker(WorkerContext *w)
+{
+    atomic_fetch_add(&w->generation, 1);
+    if (atomic_load(&w->sleeping)) {
+        pthread_mutex_lock(&w->mutex);
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->mutex);
+    }
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
                               int nb_threads)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
+    int nb_workers, nb_cpus, i;
 
     av_assert0(nb_threads >= 0);
+    nb_cpus = av_cpu_count();
     if (!nb_threads) {
-        int nb_cpus = av_cpu_count();
         if (nb_cpus > 1)
             nb_threads = nb_cpus + 1;
         else
@@ -128,34 +215,34 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     ctx->nb_active_threads = 0;
     ctx->nb_jobs     = 0;
     ctx->finished    = 0;
+    /* polling only makes sense if the thread waited for can run meanwhile */
+    ctx->max_spin    = nb_cpus > 1 ? SPIN_MAX : 0;
+    ctx->main_spin.budget = FFMIN(SPIN_MIN, ctx->max_spin);
 
     atomic_init(&ctx->first_job, 0);
     atomic_init(&ctx->current_job, 0);
+    atomic_init(&ctx->nb_finished, 0);
+    atomic_init(&ctx->done, 0);
     pthread_mutex_init(&ctx->done_mutex, NULL);
     pthread_cond_init(&ctx->done_cond, NULL);
-    ctx->done        = 0;
 
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
         int ret;
-        w->ctx = ctx;
+        w->ctx  = ctx;
+        w->spin = ctx->main_spin;
+        atomic_init(&w->generation, 0);
+        atomic_init(&w->sleeping, 0);
         pthread_mutex_init(&w->mutex, NULL);
         pthread_cond_init(&w->cond, NULL);
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
 
         if (ret = pthread_create(&w->thread, NULL, thread_worker, w)) {
             ctx->nb_threads = main_func ? i : i + 1;
-            pthread_mutex_unlock(&w->mutex);
             pthread_cond_destroy(&w->cond);
             pthread_mutex_destroy(&w->mutex);
             avpriv_slicethread_free(pctx);
             return AVERROR(ret);
         }
-
-        while (!w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
-        pthread_mutex_unlock(&w->mutex);
     }
 
     return nb_threads;
@@ -168,30 +255,39 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    ctx->chunk_size        = FFMAX(nb_jobs / (ctx->nb_active_threads * CHUNKS_PER_THREAD), 1);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
     atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+    atomic_store_explicit(&ctx->nb_finished, 0, memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
+    ctx->nb_runners        = nb_workers + 1;
 
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
-    }
+    for (i = 0; i < nb_workers; i++)
+        wake_worker(&ctx->workers[i]);
 
+    /* Once main_func returns, the main thread helps with the jobs left. As all
+     * the workers were woken up, it only gets a threadnr if one of them has
+     * not started yet, so main_func can still wait for any of the jobs. */
     if (ctx->main_func && execute_main)
         ctx->main_func(ctx->priv);
-    else
-        is_last = run_jobs(ctx);
+    is_last = run_jobs(ctx);
 
     if (!is_last) {
+        unsigned budget = spin_begin(ctx, &ctx->main_spin), spin = 0;
+
+        while (spin < budget &&
+               !atomic_load_explicit(&ctx->done, memory_order_acquire)) {
+            cpu_relax();
+            spin++;
+        }
+        spin_end(ctx, &ctx->main_spin, budget, spin < budget);
+
         pthread_mutex_lock(&ctx->done_mutex);
-        while (!ctx->done)
+        while (!atomic_load_explicit(&ctx->done, memory_order_acquire))
             pthread_cond_wait(&ctx->done_cond, &ctx->done_mutex);
-        ctx->done = 0;
+        atomic_store_explicit(&ctx->done, 0, memory_order_relaxed);
         pthread_mutex_unlock(&ctx->done_mutex);
     }
 }
@@ -210,13 +306,8 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         nb_workers--;
 
     ctx->finished = 1;
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
-    }
+    for (i = 0; i < nb_workers; i++)
+        wake_worker(&ctx->workers[i]);
 
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
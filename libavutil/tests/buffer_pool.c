@@ -0,0 +1,132 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Concurrent av_buffer_pool_get()/av_buffer_unref() stress test and
+ * benchmark. Usage: buffer_pool [max threads [iterations per thread]]
+ * The throughput for 1, 2, 4... up to max threads is printed, the exit
+ * status tells whether a buffer was ever handed out twice.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUFFER_SIZE 64
+#define HELD        4
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    AVBufferRef *bufs[HELD];
+    int i, j;
+
+    for (i = 0; i < arg->iterations; i++) {
+        for (j = 0; j < HELD; j++) {
+            bufs[j] = av_buffer_pool_get(arg->pool);
+            if (!bufs[j]) {
+                arg->errors++;
+                goto end;
+            }
+            memset(bufs[j]->data, arg->id * HELD + j, BUFFER_SIZE);
+        }
+        for (j = 0; j < HELD; j++) {
+            const uint8_t *data = bufs[j]->data;
+            if (data[0] != (uint8_t)(arg->id * HELD + j) ||
+                data[BUFFER_SIZE - 1] != data[0])
+                arg->errors++;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+end:
+    while (j--)
+        av_buffer_unref(&bufs[j]);
+    return NULL;
+}
+
+static int run(int nb_threads, int iterations)
+{
+    ThreadArg *args      = av_calloc(nb_threads, sizeof(*args));
+    pthread_t *threads   = av_calloc(nb_threads, sizeof(*threads));
+    AVBufferPool *pool   = av_buffer_pool_init(BUFFER_SIZE, NULL);
+    int i, ret, errors = 0, started = 0;
+    int64_t t;
+
+    if (!args || !threads || !pool) {
+        errors = 1;
+        goto end;
+    }
+
+    t = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        args[i].pool       = pool;
+        args[i].id         = i;
+        args[i].iterations = iterations;
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            errors = 1;
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+    t = av_gettime_relative() - t;
+
+    printf("%2d threads: %8.2f Mops/s%s\n", nb_threads,
+           (double)started * iterations * HELD / FFMAX(t, 1),
+           errors ? ", FAILED" : "");
+
+end:
+    av_buffer_pool_uninit(&pool);
+    av_free(threads);
+    av_free(args);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations  = argc > 2 ? atoi(argv[2]) : 100000;
+    int nb_threads, errors = 0;
+
+    if (max_threads < 1 || iterations < 1) {
+        fprintf(stderr, "Usage: %s [max threads [iterations]]\n", argv[0]);
+        return 2;
+    }
+
+    for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2)
+        errors += run(nb_threads, iterations);
+
+    return !!errors;
+}
@@ -49,6 +49,54 @@ static void test_separators(const AVDictionary *m, const char pair, const char v
     av_dict_free(&dict);
 }
 
+static int check_lookups(const AVDictionary *m, const char *key, int flags)
+{
+    const AVDictionaryEntry *e = NULL;
+    int i, errors = 0;
+
+    for (i = 0; i < m->count; i++) {
+        if (!dict_key_match(m->elems[i].key, key, flags))
+            continue;
+        e = av_dict_get(m, key, e, flags);
+        if (e != &m->elems[i])
+            errors++;
+        e = &m->elems[i];
+    }
+    if (av_dict_get(m, key, e, flags))
+        errors++;
+    return errors;
+}
+
+static void test_hashed(void)
+{
+    AVDictionary *dict = NULL;
+    char key[16], val[16];
+    int i, errors = 0;
+
+    for (i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "%ckey%d", i & 1 ? 'K' : 'k', i % 40);
+        snprintf(val, sizeof(val), "%d", i);
+        av_dict_set(&dict, key, val, i % 7 ? 0 : AV_DICT_MULTIKEY);
+        if (i % 11 == 10) {
+            snprintf(key, sizeof(key), "key%d", i % 40);
+            av_dict_set(&dict, key + 1, NULL, 0);
+        }
+    }
+    av_dict_set(&dict, "kkey3", "a", AV_DICT_MATCH_CASE | AV_DICT_APPEND);
+    av_dict_set(&dict, "KKEY3", "b", AV_DICT_APPEND);
+    print_dict(dict);
+
+    for (i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "kkey%d", i);
+        errors += check_lookups(dict, key, 0);
+        errors += check_lookups(dict, key, AV_DICT_MATCH_CASE);
+        key[0] = 'K';
+        errors += check_lookups(dict, key, AV_DICT_MATCH_CASE);
+    }
+    printf("%d entries, %d lookup errors\n", av_dict_count(dict), errors);
+    av_dict_free(&dict);
+}
+
 int main(void)
 {
     AVDictionary *dict = NULL;
@@ -132,5 +180,8 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting av_dict_get() on a hashed dictionary\n");
+    test_hashed();
+
     return 0;
 }
@@ -21,7 +21,11 @@
 
 #include "libavutil/log.c"
 
+#include <stdio.h>
 #include <string.h>
+#if HAVE_PTHREADS
+#include <unistd.h>
+#endif
 
 static int call_log_format_line2(const char *fmt, char *buffer, int buffer_size, ...)
 {
@@ -34,6 +38,58 @@ static int call_log_format_line2(const char *fmt, char *buffer, int buffer_size,
     return ret;
 }
 
+#if HAVE_PTHREADS
+#define NB_THREADS 4
+#define NB_LINES   2000
+
+/* Each line is logged in two parts, so the prefix state matters */
+static void *log_thread(void *arg)
+{
+    for (int i = 0; i < NB_LINES; i++) {
+        av_log(NULL, AV_LOG_INFO, "a");
+        av_log(NULL, AV_LOG_INFO, "b\n");
+    }
+    return NULL;
+}
+
+/* Checks that concurrent async logging prints the level prefix exactly once
+ * at the start of every line */
+static int test_async_prefix(void)
+{
+    pthread_t threads[NB_THREADS];
+    FILE *out = tmpfile();
+    char line[256];
+    int saved_stderr, nb_lines = 0, ret = 0;
+
+    if (!out)
+        return 0;
+    fflush(stderr);
+    saved_stderr = dup(2);
+    dup2(fileno(out), 2);
+
+    av_log_set_flags(AV_LOG_ASYNC | AV_LOG_PRINT_LEVEL);
+    for (int i = 0; i < NB_THREADS; i++)
+        pthread_create(&threads[i], NULL, log_thread, NULL);
+    for (int i = 0; i < NB_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    av_log_set_flags(0);
+
+    fflush(stderr);
+    dup2(saved_stderr, 2);
+    close(saved_stderr);
+
+    rewind(out);
+    while (fgets(line, sizeof(line), out)) {
+        const char *p = line + strlen("[info] ");
+        if (strncmp(line, "[info] ", strlen("[info] ")) || strstr(p, "[info]"))
+            ret = 1;
+        nb_lines++;
+    }
+    fclose(out);
+    return ret || nb_lines != NB_THREADS * NB_LINES;
+}
+#endif
+
 int main(int argc, char **argv)
 {
     int i;
@@ -67,5 +123,39 @@ int main(int argc, char **argv)
             return 1;
         }
     }
+#if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
+    {
+        char long_line[2 * LINE_SZ];
+
+        memset(long_line, 'x', sizeof(long_line) - 2);
+        long_line[sizeof(long_line) - 2] = '\n';
+        long_line[sizeof(long_line) - 1] = 0;
+
+        av_log_set_flags(AV_LOG_ASYNC);
+        for (i = 0; i < 4 * RING_SIZE; i++) {
+            av_log(NULL, AV_LOG_INFO, "async %d\n", i);
+            if (i == RING_SIZE)
+                av_log(NULL, AV_LOG_INFO, "%s", long_line);
+        }
+        av_log_flush();
+        if (atomic_load(&ring_done) != 4 * RING_SIZE) {
+            printf("Test async flush failed.\n");
+            return 1;
+        }
+        av_log(NULL, AV_LOG_INFO, "last async\n");
+        av_log_set_flags(0);
+        if (atomic_load(&ring_done) != 4 * RING_SIZE + 1) {
+            printf("Test async flush on reset failed.\n");
+            return 1;
+        }
+    }
+#endif
+#if HAVE_PTHREADS
+    use_color = 0;
+    if (test_async_prefix()) {
+        printf("Test async prefix failed.\n");
+        return 1;
+    }
+#endif
     return 0;
 }
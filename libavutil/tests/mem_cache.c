@@ -0,0 +1,140 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+
+#define NB_BUFS 3000
+
+static void print_stats(const char *when)
+{
+    printf("%s: allocs %"PRId64" frees %"PRId64" in use %"PRId64" fallbacks %"PRId64"\n",
+           when,
+           av_mem_cache_get_stat(AV_MEM_CACHE_STAT_ALLOCS),
+           av_mem_cache_get_stat(AV_MEM_CACHE_STAT_FREES),
+           av_mem_cache_get_stat(AV_MEM_CACHE_STAT_IN_USE),
+           av_mem_cache_get_stat(AV_MEM_CACHE_STAT_FALLBACKS));
+}
+
+/* Allocates buffers of all cached sizes, checks they do not overlap and
+ * frees them again, returns the number of errors */
+static int test_buffers(AVBufferRef **bufs)
+{
+    int i, errors = 0;
+
+    for (i = 0; i < NB_BUFS; i++) {
+        size_t size = 1 + i % 256;
+        bufs[i] = av_buffer_alloc(size);
+        if (!bufs[i])
+            return 1;
+        if ((uintptr_t)bufs[i]->data & 15)
+            errors++;
+        memset(bufs[i]->data, i, size);
+    }
+    for (i = 0; i < NB_BUFS; i++) {
+        const uint8_t *data = bufs[i]->data;
+        size_t size = 1 + i % 256;
+        if (data[0] != (uint8_t)i || data[size - 1] != (uint8_t)i)
+            errors++;
+        av_buffer_unref(&bufs[i]);
+    }
+    return errors;
+}
+
+int main(void)
+{
+    AVBufferRef **bufs = av_calloc(NB_BUFS, sizeof(*bufs));
+    AVBufferRef *buf, *ref;
+    AVDictionary *dict = NULL;
+    AVFrame *frame = av_frame_alloc();
+    int64_t reserved;
+    int i, errors = 0;
+
+    if (!bufs || !frame)
+        return 1;
+
+    print_stats("initial");
+
+    /* nothing is cached before the cache is enabled */
+    errors += test_buffers(bufs);
+    print_stats("disabled");
+
+    av_mem_cache_enable(1);
+
+    /* buffers allocated before are fine to free afterwards and the other
+     * way round */
+    av_mem_cache_enable(0);
+    buf = av_buffer_alloc(16);
+    av_mem_cache_enable(1);
+    ref = av_buffer_ref(buf);
+    av_buffer_unref(&buf);
+    av_mem_cache_enable(0);
+    av_buffer_unref(&ref);
+    av_mem_cache_enable(1);
+    print_stats("mixed");
+
+    errors += test_buffers(bufs);
+    print_stats("first run");
+    reserved = av_mem_cache_get_stat(AV_MEM_CACHE_STAT_RESERVED);
+
+    /* freed objects are reused */
+    errors += test_buffers(bufs);
+    print_stats("second run");
+    if (av_mem_cache_get_stat(AV_MEM_CACHE_STAT_RESERVED) != reserved) {
+        printf("the cache grew on reuse\n");
+        errors++;
+    }
+
+    /* large buffers are not cached */
+    buf = av_buffer_alloc(4096);
+    if (!buf)
+        return 1;
+    av_buffer_unref(&buf);
+    print_stats("large buffer");
+
+    for (i = 0; i < 100; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set(&dict, key, "value", 0);
+        av_dict_set(&dict, key, "appended", AV_DICT_APPEND);
+        av_dict_set(&dict, key, av_strdup("own"), AV_DICT_DONT_STRDUP_VAL | AV_DICT_APPEND);
+    }
+    if (strcmp(av_dict_get(dict, "key42", NULL, 0)->value, "valueappendedown"))
+        errors++;
+    av_dict_free(&dict);
+    print_stats("dictionary");
+
+    for (i = 0; i < 10; i++)
+        if (!av_frame_new_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS, 100))
+            return 1;
+    av_frame_free(&frame);
+    print_stats("side data");
+
+    av_free(bufs);
+
+    if (errors)
+        printf("%d errors\n", errors);
+    return !!errors;
+}
@@ -0,0 +1,220 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * avpriv_slicethread_execute() test.
+ * Usage: slicethread [bench [max threads [executes [job size]]]]
+ * In bench mode, the average time per execute is printed instead for 1, 2,
+ * 4... up to max threads and a few job counts, each job doing about job size
+ * iterations of trivial work. It is meant to tune the SPIN_* and
+ * CHUNKS_PER_THREAD constants of slicethread.c.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS 16
+
+typedef struct TestContext {
+    int *results;               ///< written by the jobs without atomics
+    int nb_threads;             ///< value returned by avpriv_slicethread_create()
+    int nb_jobs;                ///< jobs of the current execute
+    int execute;                ///< index of the current execute
+    atomic_int busy[MAX_THREADS];
+    atomic_int errors;
+    atomic_int main_calls;
+} TestContext;
+
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    TestContext *s = priv;
+
+    /* nb_threads is the number of threads actually running jobs */
+    if (jobnr < 0 || jobnr >= s->nb_jobs || nb_jobs != s->nb_jobs ||
+        nb_threads != FFMIN(s->nb_jobs, s->nb_threads) ||
+        threadnr < 0 || threadnr >= nb_threads) {
+        atomic_fetch_add(&s->errors, 1);
+        return;
+    }
+
+    /* a threadnr is never used by two jobs at the same time, callers rely
+     * on it to index per-thread scratch buffers */
+    if (atomic_exchange(&s->busy[threadnr], 1))
+        atomic_fetch_add(&s->errors, 1);
+    /* give the other threads a chance to pick up jobs meanwhile */
+    if (!jobnr)
+        av_usleep(1);
+    s->results[jobnr] += s->execute + 1;
+    atomic_store(&s->busy[threadnr], 0);
+}
+
+static void main_func(void *priv)
+{
+    atomic_fetch_add(&((TestContext *)priv)->main_calls, 1);
+}
+
+static int run(int nb_threads, int nb_jobs, int use_main)
+{
+    static const int nb_executes = 64;
+    AVSliceThread *thread;
+    TestContext s = { 0 };
+    int i, j, ret, errors = 0, main_calls = 0;
+
+    ret = avpriv_slicethread_create(&thread, &s, worker_func,
+                                    use_main ? main_func : NULL, nb_threads);
+    if (ret < 0)
+        return 1;
+    s.nb_threads = ret;
+    if (s.nb_threads != nb_threads)
+        errors++;
+
+    s.results = av_calloc(nb_jobs, sizeof(*s.results));
+    if (!s.results) {
+        avpriv_slicethread_free(&thread);
+        return 1;
+    }
+
+    for (i = 0; i < nb_executes; i++) {
+        int execute_main = use_main && (i & 1);
+
+        s.nb_jobs = nb_jobs - (i % 3) * nb_jobs / 4;
+        s.execute = i;
+        /* let the workers go to sleep before some of the executes */
+        if (!(i % 16))
+            av_usleep(2000);
+        avpriv_slicethread_execute(thread, s.nb_jobs, execute_main);
+        main_calls += execute_main;
+
+        /* all the jobs are done and their results visible on return */
+        for (j = 0; j < nb_jobs; j++) {
+            errors += s.results[j] != (j < s.nb_jobs ? i + 1 : 0);
+            s.results[j] = 0;
+        }
+    }
+    errors += atomic_load(&s.errors);
+    errors += atomic_load(&s.main_calls) != main_calls;
+
+    printf("%2d threads, %4d jobs, %s: %s\n", nb_threads, nb_jobs,
+           use_main ? "main_func" : "no main_func", errors ? "FAILED" : "OK");
+
+    avpriv_slicethread_free(&thread);
+    av_free(s.results);
+    return !!errors;
+}
+
+typedef struct BenchContext {
+    unsigned *out;
+    int job_size;
+} BenchContext;
+
+static void bench_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    BenchContext *b = priv;
+    unsigned x = jobnr;
+    int i;
+
+    for (i = 0; i < b->job_size; i++)
+        x = x * 1664525 + 1013904223;
+    b->out[jobnr] = x;
+}
+
+static void bench_main_func(void *priv)
+{
+}
+
+static int bench(int nb_threads, int nb_jobs, int use_main, int nb_executes, int job_size)
+{
+    AVSliceThread *thread;
+    BenchContext b = { .job_size = job_size };
+    int64_t t;
+    int i, ret;
+
+    b.out = av_calloc(nb_jobs, sizeof(*b.out));
+    if (!b.out)
+        return 1;
+    ret = avpriv_slicethread_create(&thread, &b, bench_worker_func,
+                                    use_main ? bench_main_func : NULL, nb_threads);
+    if (ret < 0) {
+        av_free(b.out);
+        return 1;
+    }
+
+    /* let the polling budgets settle */
+    for (i = 0; i < 64; i++)
+        avpriv_slicethread_execute(thread, nb_jobs, use_main);
+
+    t = av_gettime_relative();
+    for (i = 0; i < nb_executes; i++)
+        avpriv_slicethread_execute(thread, nb_jobs, use_main);
+    t = av_gettime_relative() - t;
+
+    printf("%2d threads, %4d jobs, %-12s: %8.2f us/execute\n", nb_threads, nb_jobs,
+           use_main ? "main_func" : "no main_func", (double)t / nb_executes);
+
+    avpriv_slicethread_free(&thread);
+    av_free(b.out);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int nb_threads[] = { 1, 2, 3, 8, MAX_THREADS };
+    static const int nb_jobs[]    = { 1, 5, 64, 1080 };
+    AVSliceThread *thread;
+    TestContext s = { 0 };
+    int i, j, errors = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+        int nb_executes = argc > 3 ? atoi(argv[3]) : 10000;
+        int job_size    = argc > 4 ? atoi(argv[4]) : 0;
+        int k;
+
+        if (max_threads < 1 || nb_executes < 1 || job_size < 0) {
+            fprintf(stderr, "Usage: %s [bench [max threads [executes [job size]]]]\n", argv[0]);
+            return 2;
+        }
+        for (i = 1; i <= max_threads; i *= 2)
+            for (j = 0; j < FF_ARRAY_ELEMS(nb_jobs); j++)
+                for (k = 0; k < 2; k++)
+                    errors += bench(i, nb_jobs[j], k, nb_executes, job_size);
+        return !!errors;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(nb_threads); i++)
+        for (j = 0; j < FF_ARRAY_ELEMS(nb_jobs); j++) {
+            errors += run(nb_threads[i], nb_jobs[j], 0);
+            errors += run(nb_threads[i], nb_jobs[j], 1);
+        }
+
+    /* freeing must wake up and join the workers that never got any job */
+    for (i = 0; i < 16; i++) {
+        if (avpriv_slicethread_create(&thread, &s, worker_func, NULL, 4) < 0)
+            break;
+        avpriv_slicethread_free(&thread);
+    }
+
+    return !!errors;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Checks the RDFT and DCT output of av_tx against naive O(n^2) transforms. */
+
+#include <limits.h>
+#include <stdio.h>
+
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/tx.h"
+
+#define MAX_LEN 1024
+
+static const int lens[] = { 2, 4, 8, 16, 30, 60, 64, 120, 256, 480, 1024 };
+
+/* Forward RDFT: len real inputs to len/2 + 1 interleaved complex outputs. */
+static void rdft_ref(double *out, const double *in, int len)
+{
+    for (int k = 0; k <= len / 2; k++) {
+        double re = 0.0, im = 0.0;
+        for (int n = 0; n < len; n++) {
+            double phi = 2.0 * M_PI * (((int64_t)n * k) % len) / len;
+            re += in[n] * cos(phi);
+            im -= in[n] * sin(phi);
+        }
+        out[2 * k    ] = re;
+        out[2 * k + 1] = im;
+    }
+}
+
+/* Inverse RDFT: the imaginary parts of the DC and Nyquist bins are ignored. */
+static void irdft_ref(double *out, const double *in, int len)
+{
+    for (int n = 0; n < len; n++) {
+        double sum = in[0] + (n & 1 ? -in[len] : in[len]);
+        for (int k = 1; k < len / 2; k++) {
+            double phi = 2.0 * M_PI * (((int64_t)n * k) % len) / len;
+            sum += 2.0 * (in[2 * k] * cos(phi) - in[2 * k + 1] * sin(phi));
+        }
+        out[n] = sum;
+    }
+}
+
+/* DCT-II */
+static void dct_ref(double *out, const double *in, int len)
+{
+    for (int k = 0; k < len; k++) {
+        double sum = 0.0;
+        for (int n = 0; n < len; n++)
+            sum += in[n] * cos(M_PI / len * (n + 0.5) * k);
+        out[k] = sum;
+    }
+}
+
+/* DCT-III */
+static void idct_ref(double *out, const double *in, int len)
+{
+    for (int n = 0; n < len; n++) {
+        double sum = in[0] * 0.5;
+        for (int k = 1; k < len; k++)
+            sum += in[k] * cos(M_PI / len * (n + 0.5) * k);
+        out[n] = sum;
+    }
+}
+
+static int check(AVLFG *lfg, int is_double, int is_dct, int inv, int len)
+{
+    const char *name = is_dct ? (inv ? "dct-iii" : "dct-ii") :
+                                (inv ? "rdft c2r" : "rdft r2c");
+    const float  scale_float  = 1.0f;
+    const double scale_double = 1.0;
+    const double eps = is_double ? 1e-12 : 1e-5;
+    int nb_in  = is_dct ? len : inv ? len + 2 : len;
+    int nb_out = is_dct ? len : inv ? len : len + 2;
+    enum AVTXType type;
+    AVTXContext *tx = NULL;
+    av_tx_fn fn;
+    double in[MAX_LEN + 2], ref[MAX_LEN + 2], max = 1.0, err = 0.0;
+    void *in_tx  = av_malloc((MAX_LEN + 2) * sizeof(double));
+    void *out_tx = av_malloc((MAX_LEN + 2) * sizeof(double));
+    int ret;
+
+    if (!in_tx || !out_tx) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (is_dct)
+        type = is_double ? AV_TX_DOUBLE_DCT  : AV_TX_FLOAT_DCT;
+    else
+        type = is_double ? AV_TX_DOUBLE_RDFT : AV_TX_FLOAT_RDFT;
+
+    ret = av_tx_init(&tx, &fn, type, inv, len,
+                     is_double ? (const void *)&scale_double : &scale_float, 0);
+    if (ret < 0) {
+        fprintf(stderr, "%s %s %d: init failed: %s\n", is_double ? "double" : "float",
+                name, len, av_err2str(ret));
+        goto end;
+    }
+
+    for (int i = 0; i < nb_in; i++) {
+        in[i] = av_lfg_get(lfg) / (double)UINT_MAX * 2.0 - 1.0;
+        if (is_double)
+            ((double *)in_tx)[i] = in[i];
+        else
+            ((float *)in_tx)[i] = in[i];
+    }
+
+    if (is_dct)
+        (inv ? idct_ref : dct_ref)(ref, in, len);
+    else
+        (inv ? irdft_ref : rdft_ref)(ref, in, len);
+
+    fn(tx, out_tx, in_tx, is_double ? sizeof(double) : sizeof(float));
+
+    for (int i = 0; i < nb_out; i++) {
+        double val = is_double ? ((double *)out_tx)[i] : ((float *)out_tx)[i];
+        max = FFMAX(max, fabs(ref[i]));
+        err = FFMAX(err, fabs(val - ref[i]));
+    }
+
+    /* the error of the fast transforms grows with the output magnitude */
+    if (err > eps * max) {
+        fprintf(stderr, "%s %s %d: error %g exceeds %g\n", is_double ? "double" : "float",
+                name, len, err, eps * max);
+        ret = AVERROR_BUG;
+    }
+
+end:
+    av_tx_uninit(&tx);
+    av_free(in_tx);
+    av_free(out_tx);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (int is_double = 0; is_double < 2; is_double++)
+        for (int is_dct = 0; is_dct < 2; is_dct++)
+            for (int inv = 0; inv < 2; inv++)
+                for (int i = 0; i < FF_ARRAY_ELEMS(lens); i++)
+                    if (check(&lfg, is_double, is_dct, inv, lens[i]) < 0)
+                        ret = 1;
+
+    return ret;
+}
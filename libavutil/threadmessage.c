@@ -18,6 +18,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
+#include "common.h"
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
@@ -28,10 +32,23 @@ struct AVThreadMessageQueue {
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* AV_THREAD_MESSAGE_QUEUE_SPSC: the lock and the conditions are only used
+     * to sleep and to wake up, messages go through a lock-free ring whose
+     * positions run from 0 to 2 * nelem - 1, so that a full and an empty ring
+     * can be told apart. head is only written by the sender, tail only by the
+     * receiver. */
+    int spsc;
+    uint8_t *ring;
+    unsigned nelem;
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_int send_waiting;
+    atomic_int recv_waiting;
 #else
     int dummy;
 #endif
@@ -40,6 +57,14 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
@@ -47,6 +72,8 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
 
     if (nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
+    if ((flags & AV_THREAD_MESSAGE_QUEUE_SPSC) && !nelem)
+        return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
     if ((ret = pthread_mutex_init(&rmq->lock, NULL))) {
@@ -64,7 +91,14 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+        rmq->spsc  = 1;
+        rmq->nelem = nelem;
+        rmq->ring  = av_malloc_array(nelem, elsize);
+    } else {
+        rmq->fifo  = av_fifo_alloc(elsize * nelem);
+    }
+    if (!rmq->fifo && !rmq->ring) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
@@ -94,6 +128,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -102,10 +137,141 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
 #endif
 }
 
+#if HAVE_THREADS
+
+static unsigned spsc_used(AVThreadMessageQueue *mq, unsigned head, unsigned tail)
+{
+    return head >= tail ? head - tail : head + 2 * mq->nelem - tail;
+}
+
+static unsigned spsc_advance(AVThreadMessageQueue *mq, unsigned pos, unsigned n)
+{
+    pos += n;
+    return pos >= 2 * mq->nelem ? pos - 2 * mq->nelem : pos;
+}
+
+static uint8_t *spsc_elem(AVThreadMessageQueue *mq, unsigned pos)
+{
+    return mq->ring + (size_t)(pos >= mq->nelem ? pos - mq->nelem : pos) * mq->elsize;
+}
+
+/* Copies n messages from msgs into the ring or from the ring into msgs */
+static void spsc_copy(AVThreadMessageQueue *mq, unsigned pos, uint8_t *msgs,
+                      unsigned n, int to_ring)
+{
+    unsigned idx   = pos >= mq->nelem ? pos - mq->nelem : pos;
+    unsigned first = FFMIN(n, mq->nelem - idx);
+    size_t   size1 = (size_t)first * mq->elsize;
+    size_t   size2 = (size_t)(n - first) * mq->elsize;
+
+    if (to_ring) {
+        memcpy(spsc_elem(mq, pos), msgs, size1);
+        memcpy(mq->ring, msgs + size1, size2);
+    } else {
+        memcpy(msgs, spsc_elem(mq, pos), size1);
+        memcpy(msgs + size1, mq->ring, size2);
+    }
+}
+
+/*
+ * The sleeping side sets its waiting flag under the lock before checking the
+ * ring a last time, the other side checks the flag after updating the ring,
+ * so either the sleeper sees the update or it gets woken up. The flag is
+ * cleared by the waker, so that only one wakeup is sent per sleep.
+ */
+static void spsc_wake(AVThreadMessageQueue *mq, atomic_int *waiting,
+                      pthread_cond_t *cond)
+{
+    if (atomic_load(waiting) && atomic_exchange(waiting, 0)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+static int spsc_send(AVThreadMessageQueue *mq, uint8_t *msgs, unsigned nb_msgs,
+                     unsigned flags)
+{
+    unsigned sent = 0;
+
+    while (sent < nb_msgs) {
+        unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&mq->tail, memory_order_acquire);
+        unsigned n    = mq->nelem - spsc_used(mq, head, tail);
+        int err       = atomic_load(&mq->err_send);
+
+        if (err)
+            return sent ? sent : err;
+        if (!n) {
+            if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+                return sent ? sent : AVERROR(EAGAIN);
+            pthread_mutex_lock(&mq->lock);
+            for (;;) {
+                atomic_store(&mq->send_waiting, 1);
+                if (mq->err_send ||
+                    spsc_used(mq, head, atomic_load(&mq->tail)) < mq->nelem)
+                    break;
+                pthread_cond_wait(&mq->cond_send, &mq->lock);
+            }
+            atomic_store(&mq->send_waiting, 0);
+            pthread_mutex_unlock(&mq->lock);
+            continue;
+        }
+
+        n = FFMIN(n, nb_msgs - sent);
+        spsc_copy(mq, head, msgs + (size_t)sent * mq->elsize, n, 1);
+        atomic_store(&mq->head, spsc_advance(mq, head, n));
+        sent += n;
+        spsc_wake(mq, &mq->recv_waiting, &mq->cond_recv);
+    }
+    return sent;
+}
+
+static int spsc_recv(AVThreadMessageQueue *mq, uint8_t *msgs, unsigned nb_msgs,
+                     unsigned flags)
+{
+    unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+    unsigned head, n;
+
+    while ((head = atomic_load_explicit(&mq->head, memory_order_acquire)) == tail) {
+        if (mq->err_recv) {
+            /* messages sent before the error was set are still returned */
+            if (atomic_load(&mq->head) == tail)
+                return mq->err_recv;
+            continue;
+        }
+        if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+            return AVERROR(EAGAIN);
+        pthread_mutex_lock(&mq->lock);
+        for (;;) {
+            atomic_store(&mq->recv_waiting, 1);
+            if (mq->err_recv || atomic_load(&mq->head) != tail)
+                break;
+            pthread_cond_wait(&mq->cond_recv, &mq->lock);
+        }
+        atomic_store(&mq->recv_waiting, 0);
+        pthread_mutex_unlock(&mq->lock);
+    }
+
+    n = FFMIN(spsc_used(mq, head, tail), nb_msgs);
+    spsc_copy(mq, tail, msgs, n, 0);
+    tail = spsc_advance(mq, tail, n);
+    atomic_store(&mq->tail, tail);
+    /* a blocked sender is only woken up once it can send a batch, which
+     * saves a wakeup per message when the receiver is the slower side */
+    if (spsc_used(mq, head, tail) <= mq->nelem / 2)
+        spsc_wake(mq, &mq->send_waiting, &mq->cond_send);
+    return n;
+}
+
+#endif /* HAVE_THREADS */
+
 int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+    if (mq->spsc)
+        return spsc_used(mq, atomic_load(&mq->head), atomic_load(&mq->tail));
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -160,6 +326,8 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return FFMIN(spsc_send(mq, msg, 1, flags), 0);
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +344,8 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return FFMIN(spsc_recv(mq, msg, 1, flags), 0);
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -185,6 +355,60 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #endif /* HAVE_THREADS */
 }
 
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
+{
+#if HAVE_THREADS
+    uint8_t *msg = msgs;
+    int ret = 0, sent;
+
+    if (mq->spsc)
+        return nb_msgs ? spsc_send(mq, msgs, FFMIN(nb_msgs, INT_MAX), flags) : 0;
+
+    pthread_mutex_lock(&mq->lock);
+    for (sent = 0; sent < nb_msgs && sent < INT_MAX; sent++) {
+        ret = av_thread_message_queue_send_locked(mq, msg, flags);
+        if (ret < 0)
+            break;
+        msg += mq->elsize;
+    }
+    pthread_mutex_unlock(&mq->lock);
+    return sent ? sent : ret;
+#else
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
+{
+#if HAVE_THREADS
+    uint8_t *msg = msgs;
+    int ret = 0, received;
+
+    if (mq->spsc)
+        return nb_msgs ? spsc_recv(mq, msgs, FFMIN(nb_msgs, INT_MAX), flags) : 0;
+
+    pthread_mutex_lock(&mq->lock);
+    for (received = 0; received < nb_msgs && received < INT_MAX; received++) {
+        /* only wait for the first message */
+        ret = av_thread_message_queue_recv_locked(mq, msg, received ?
+                                                  AV_THREAD_MESSAGE_NONBLOCK : flags);
+        if (ret < 0)
+            break;
+        msg += mq->elsize;
+    }
+    pthread_mutex_unlock(&mq->lock);
+    return received ? received : ret;
+#else
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
 void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
                                           int err)
 {
@@ -221,6 +445,20 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     int used, off;
     void *free_func = mq->free_func;
 
+    if (mq->spsc) {
+        unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&mq->head, memory_order_acquire);
+
+        if (free_func)
+            for (unsigned pos = tail; pos != head; pos = spsc_advance(mq, pos, 1))
+                mq->free_func(spsc_elem(mq, pos));
+        atomic_store(&mq->tail, head);
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+        return;
+    }
+
     pthread_mutex_lock(&mq->lock);
     used = av_fifo_size(mq->fifo);
     if (free_func)
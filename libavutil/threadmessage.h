@@ -32,6 +32,19 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+typedef enum AVThreadMessageQueueFlags {
+
+    /**
+     * The queue is used by a single sending thread and a single receiving
+     * thread at any time, and av_thread_message_flush() is only called by the
+     * receiving thread. Messages then go through a lock-free ring and the
+     * threads only take a lock to sleep when the queue is full or empty, or
+     * to wake the other thread up when it is sleeping.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SPSC = 1,
+
+} AVThreadMessageQueueFlags;
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +58,21 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue.
+ *
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   a combination of AVThreadMessageQueueFlags
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -66,6 +94,36 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags);
 
+/**
+ * Send several messages on the queue.
+ *
+ * Without AV_THREAD_MESSAGE_NONBLOCK, this waits until all messages are sent
+ * or an error code is set; with it, only the messages that fit in the queue
+ * are sent. Messages that were not sent are left to the caller.
+ *
+ * @param msgs    array of nb_msgs messages
+ * @return the number of messages sent if any, otherwise a negative error code
+ */
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
+/**
+ * Receive up to nb_msgs messages from the queue.
+ *
+ * Without AV_THREAD_MESSAGE_NONBLOCK, this waits for at least one message,
+ * but not for more.
+ *
+ * @param msgs    array with room for nb_msgs messages
+ * @return the number of messages received if any, otherwise a negative error
+ *         code
+ */
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
 /**
  * Set the sending error code.
  *
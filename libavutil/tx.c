@@ -220,6 +220,7 @@ av_cold void av_tx_uninit(AVTXContext **ctx)
     av_free((*ctx)->revtab_c);
     av_free((*ctx)->inplace_idx);
     av_free((*ctx)->tmp);
+    av_free((*ctx)->dcttmp);
 
     av_freep(ctx);
 }
@@ -240,11 +241,23 @@ av_cold int av_tx_init(AVTXContext **ctx, av_tx_fn *tx, enum AVTXType type,
         if (ARCH_X86)
             ff_tx_init_float_x86(s, tx);
         break;
+    case AV_TX_FLOAT_RDFT:
+    case AV_TX_FLOAT_DCT:
+        if ((err = ff_tx_init_rdft_dct_float(s, tx, type, inv, len, scale, flags)))
+            goto fail;
+        if (ARCH_X86)
+            ff_tx_init_float_x86(s, tx);
+        break;
     case AV_TX_DOUBLE_FFT:
     case AV_TX_DOUBLE_MDCT:
         if ((err = ff_tx_init_mdct_fft_double(s, tx, type, inv, len, scale, flags)))
             goto fail;
         break;
+    case AV_TX_DOUBLE_RDFT:
+    case AV_TX_DOUBLE_DCT:
+        if ((err = ff_tx_init_rdft_dct_double(s, tx, type, inv, len, scale, flags)))
+            goto fail;
+        break;
     case AV_TX_INT32_FFT:
     case AV_TX_INT32_MDCT:
         if ((err = ff_tx_init_mdct_fft_int32(s, tx, type, inv, len, scale, flags)))
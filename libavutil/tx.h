@@ -82,6 +82,46 @@ enum AVTXType {
      * Stride must be a non-zero multiple of sizeof(int32_t).
      */
     AV_TX_INT32_MDCT = 5,
+
+    /**
+     * Real to complex and complex to real DFTs.
+     * For the float variant the scale type is float, for the double variant
+     * it's double. If scale is NULL, 1.0 will be used as a default.
+     * The stride parameter is ignored. The length must be even.
+     *
+     * The forward transform performs a real-to-complex DFT of len samples to
+     * len/2+1 complex values. The inverse transform performs a complex-to-real
+     * DFT of len/2+1 complex values to len real samples. The imaginary parts
+     * of the first and last complex values are ignored on input and set to
+     * 0 on output. The output is not normalized, but can be made so by setting
+     * the scale value to 1.0/len.
+     *
+     * NOTE: the inverse transform always overwrites the input.
+     */
+    AV_TX_FLOAT_RDFT = 6,
+
+    /**
+     * Same as AV_TX_FLOAT_RDFT with a data and scale type of double.
+     */
+    AV_TX_DOUBLE_RDFT = 7,
+
+    /**
+     * Real to real transforms, a DCT-II forward and a DCT-III inverse:
+     * forward: y[k] = scale * sum(x[n]*cos(pi/len*(n + 0.5)*k))
+     * inverse: x[n] = scale * (y[0]/2 + sum(y[k]*cos(pi/len*(n + 0.5)*k), k > 0))
+     * so an inverse with a scale of 2.0/len undoes a forward with 1.0.
+     * For the float variant the scale type is float, for the double variant
+     * it's double. If scale is NULL, 1.0 will be used as a default.
+     * The stride parameter is ignored. The length must be even.
+     *
+     * NOTE: the inverse transform always overwrites the input.
+     */
+    AV_TX_FLOAT_DCT = 8,
+
+    /**
+     * Same as AV_TX_FLOAT_DCT with a data and scale type of double.
+     */
+    AV_TX_DOUBLE_DCT = 9,
 };
 
 /**
@@ -27,20 +27,24 @@
 
 #ifdef TX_FLOAT
 #define TX_NAME(x) x ## _float
+#define TX_TYPE(x) AV_TX_FLOAT_ ## x
 #define SCALE_TYPE float
 typedef float FFTSample;
 typedef AVComplexFloat FFTComplex;
 #elif defined(TX_DOUBLE)
 #define TX_NAME(x) x ## _double
+#define TX_TYPE(x) AV_TX_DOUBLE_ ## x
 #define SCALE_TYPE double
 typedef double FFTSample;
 typedef AVComplexDouble FFTComplex;
 #elif defined(TX_INT32)
 #define TX_NAME(x) x ## _int32
+#define TX_TYPE(x) AV_TX_INT32_ ## x
 #define SCALE_TYPE float
 typedef int32_t FFTSample;
 typedef AVComplexInt32 FFTComplex;
 #else
+typedef void FFTSample;
 typedef void FFTComplex;
 #endif
 
@@ -127,7 +131,26 @@ struct AVTXContext {
 
     av_tx_fn    top_tx; /* Used for computing transforms derived from other
                          * transforms, like full-length iMDCTs and RDFTs.
-                         * NOTE: Do NOT use this to mix assembly with C code. */
+                         * NOTE: Do NOT use this to mix assembly with C code,
+                         * except for the inner FFT of real transforms, which
+                         * is set up by the same init function. */
+
+    FFTComplex *dcttmp; /* Temporary buffer for DCTs, tmp may be in use by
+                         * the inner FFT */
+
+    av_tx_fn   ptwo_tx; /* Power-of-two FFT used by compound transforms and
+                         * MDCTs set up by ff_tx_init_ptwo_sub(), takes its
+                         * input in natural order and must be out-of-place. */
+    void (*mdct_postrot)(FFTComplex *z, const FFTComplex *exp, ptrdiff_t len8);
+                        /* In-place (i)MDCT post-rotation used with ptwo_tx */
+    void (*mdct_prerot)(FFTComplex *z, const FFTSample *src,
+                        const FFTComplex *exp, ptrdiff_t len4);
+                        /* (i)MDCT folding and pre-rotation into z in natural
+                         * order, used with ptwo_tx on a contiguous input */
+    void (*fft_n)(FFTComplex *out, FFTComplex *in, ptrdiff_t m);
+                        /* m non-power-of-two FFTs at once, input j of
+                         * transform i is in[j*m + i], its output k goes to
+                         * out[k*m + i]. Clobbers in, optional. */
 };
 
 /* Checks if type is an MDCT */
@@ -194,6 +217,34 @@ int ff_tx_init_mdct_fft_int32(AVTXContext *s, av_tx_fn *tx,
                               enum AVTXType type, int inv, int len,
                               const void *scale, uint64_t flags);
 
+/*
+ * Templated init functions for RDFTs and DCTs, which are done through a
+ * half-length FFT set up on the same context in top_tx.
+ */
+int ff_tx_init_rdft_dct_float(AVTXContext *s, av_tx_fn *tx,
+                              enum AVTXType type, int inv, int len,
+                              const void *scale, uint64_t flags);
+int ff_tx_init_rdft_dct_double(AVTXContext *s, av_tx_fn *tx,
+                               enum AVTXType type, int inv, int len,
+                               const void *scale, uint64_t flags);
+
+/*
+ * Switches a compound FFT or an (i)MDCT over to doing its power-of-two part
+ * through ptwo_tx, its pre- and post-rotation through prerot and postrot,
+ * and its non-power-of-two part through fft_n, all of which work on whole
+ * contiguous buffers. Used to plug in assembly, prerot and fft_n may be NULL.
+ */
+int ff_tx_init_ptwo_sub_float(AVTXContext *s, av_tx_fn *tx, av_tx_fn ptwo_tx,
+                              void (*postrot)(FFTComplex *z,
+                                              const FFTComplex *exp,
+                                              ptrdiff_t len8),
+                              void (*prerot)(FFTComplex *z,
+                                             const FFTSample *src,
+                                             const FFTComplex *exp,
+                                             ptrdiff_t len4),
+                              void (*fft_n)(FFTComplex *out, FFTComplex *in,
+                                            ptrdiff_t m));
+
 typedef struct CosTabsInitOnce {
     void (*func)(void);
     AVOnce control;
@@ -893,6 +893,451 @@ static void full_imdct_wrapper_fn(AVTXContext *s, void *_dst, void *_src,
     }
 }
 
+#ifdef TX_FLOAT
+/*
+ * Versions of the compound transforms and (i)MDCTs which do their
+ * power-of-two part with s->ptwo_tx on a natural order input, and their
+ * post-rotation with s->mdct_postrot, so both can be done in assembly.
+ * The output buffer doubles as the input of the power-of-two transforms.
+ */
+#define DECL_COMP_FFT_SUB(N)                                                   \
+static void compound_fft_##N##xM_sub(AVTXContext *s, void *_out,               \
+                                     void *_in, ptrdiff_t stride)              \
+{                                                                              \
+    const int m = s->m, *in_map = s->pfatab, *out_map = in_map + N*m;          \
+    FFTComplex *in = _in;                                                      \
+    FFTComplex *out = _out;                                                    \
+    FFTComplex fft##N##in[N];                                                  \
+                                                                               \
+    for (int i = 0; i < m; i++) {                                              \
+        for (int j = 0; j < N; j++)                                            \
+            fft##N##in[j] = in[in_map[i*N + j]];                               \
+        fft##N(out + i, fft##N##in, m);                                        \
+    }                                                                          \
+                                                                               \
+    for (int i = 0; i < N; i++)                                                \
+        s->ptwo_tx(s, s->tmp + m*i, out + m*i, sizeof(*out));                  \
+                                                                               \
+    for (int i = 0; i < N*m; i++)                                              \
+        out[i] = s->tmp[out_map[i]];                                           \
+}
+
+DECL_COMP_FFT_SUB(3)
+DECL_COMP_FFT_SUB(5)
+DECL_COMP_FFT_SUB(7)
+DECL_COMP_FFT_SUB(9)
+DECL_COMP_FFT_SUB(15)
+
+#define DECL_COMP_IMDCT_SUB(N)                                                 \
+static void compound_imdct_##N##xM_sub(AVTXContext *s, void *_dst,             \
+                                       void *_src, ptrdiff_t stride)           \
+{                                                                              \
+    FFTComplex fft##N##in[N];                                                  \
+    FFTComplex *z = _dst, *exp = s->exptab;                                    \
+    const int m = s->m, len4 = N*m;                                            \
+    const int *in_map = s->pfatab, *out_map = in_map + N*m;                    \
+    const FFTSample *src = _src, *in1, *in2;                                   \
+                                                                               \
+    stride /= sizeof(*src); /* To convert it from bytes */                     \
+    in1 = src;                                                                 \
+    in2 = src + ((N*m*2) - 1) * stride;                                        \
+                                                                               \
+    for (int i = 0; i < m; i++) {                                              \
+        for (int j = 0; j < N; j++) {                                          \
+            const int k = in_map[i*N + j];                                     \
+            FFTComplex tmp = { in2[-k*stride], in1[k*stride] };                \
+            CMUL3(fft##N##in[j], tmp, exp[k >> 1]);                            \
+        }                                                                      \
+        fft##N(z + i, fft##N##in, m);                                          \
+    }                                                                          \
+                                                                               \
+    for (int i = 0; i < N; i++)                                                \
+        s->ptwo_tx(s, s->tmp + m*i, z + m*i, sizeof(*z));                      \
+                                                                               \
+    for (int i = 0; i < len4; i++)                                             \
+        z[i] = s->tmp[out_map[i]];                                             \
+                                                                               \
+    s->mdct_postrot(z, exp, len4 >> 1);                                        \
+}
+
+DECL_COMP_IMDCT_SUB(3)
+DECL_COMP_IMDCT_SUB(5)
+DECL_COMP_IMDCT_SUB(7)
+DECL_COMP_IMDCT_SUB(9)
+DECL_COMP_IMDCT_SUB(15)
+
+#define DECL_COMP_MDCT_SUB(N)                                                  \
+static void compound_mdct_##N##xM_sub(AVTXContext *s, void *_dst,              \
+                                      void *_src, ptrdiff_t stride)            \
+{                                                                              \
+    FFTSample *src = _src;                                                     \
+    FFTComplex *z = _dst, *exp = s->exptab, tmp, fft##N##in[N];                \
+    const int m = s->m, len4 = N*m, len3 = len4 * 3;                           \
+    const int *in_map = s->pfatab, *out_map = in_map + N*m;                    \
+                                                                               \
+    /* The output is used as a buffer, which needs it to be contiguous */      \
+    if (stride != sizeof(*src)) {                                              \
+        compound_mdct_##N##xM(s, _dst, _src, stride);                          \
+        return;                                                                \
+    }                                                                          \
+                                                                               \
+    for (int i = 0; i < m; i++) { /* Folding and pre-reindexing */             \
+        for (int j = 0; j < N; j++) {                                          \
+            const int k = in_map[i*N + j];                                     \
+            if (k < len4) {                                                    \
+                tmp.re = FOLD(-src[ len4 + k],  src[1*len4 - 1 - k]);          \
+                tmp.im = FOLD(-src[ len3 + k], -src[1*len3 - 1 - k]);          \
+            } else {                                                           \
+                tmp.re = FOLD(-src[ len4 + k], -src[5*len4 - 1 - k]);          \
+                tmp.im = FOLD( src[-len4 + k], -src[1*len3 - 1 - k]);          \
+            }                                                                  \
+            CMUL(fft##N##in[j].im, fft##N##in[j].re, tmp.re, tmp.im,           \
+                 exp[k >> 1].re, exp[k >> 1].im);                              \
+        }                                                                      \
+        fft##N(z + i, fft##N##in, m);                                          \
+    }                                                                          \
+                                                                               \
+    for (int i = 0; i < N; i++)                                                \
+        s->ptwo_tx(s, s->tmp + m*i, z + m*i, sizeof(*z));                      \
+                                                                               \
+    for (int i = 0; i < len4; i++)                                             \
+        z[i] = s->tmp[out_map[i]];                                             \
+                                                                               \
+    s->mdct_postrot(z, exp, len4 >> 1);                                        \
+}
+
+DECL_COMP_MDCT_SUB(3)
+DECL_COMP_MDCT_SUB(5)
+DECL_COMP_MDCT_SUB(7)
+DECL_COMP_MDCT_SUB(9)
+DECL_COMP_MDCT_SUB(15)
+
+/* iMDCT pre-rotation of len4 values into z in natural order */
+static av_always_inline void imdct_prerot(FFTComplex *z, const FFTSample *src,
+                                          const FFTComplex *exp, int len4,
+                                          ptrdiff_t stride)
+{
+    const FFTSample *in1 = src, *in2 = src + ((len4*2) - 1) * stride;
+
+    for (int i = 0; i < len4; i++) {
+        FFTComplex tmp = { in2[-2*i*stride], in1[2*i*stride] };
+        CMUL3(z[i], tmp, exp[i]);
+    }
+}
+
+/* MDCT folding and pre-rotation of len4 values into z in natural order */
+static av_always_inline void mdct_prerot(FFTComplex *z, const FFTSample *src,
+                                         const FFTComplex *exp, int len4)
+{
+    const int len3 = len4 * 3;
+    FFTComplex tmp;
+
+    for (int i = 0; i < len4; i++) {
+        const int k = 2*i;
+        if (k < len4) {
+            tmp.re = FOLD(-src[ len4 + k],  src[1*len4 - 1 - k]);
+            tmp.im = FOLD(-src[ len3 + k], -src[1*len3 - 1 - k]);
+        } else {
+            tmp.re = FOLD(-src[ len4 + k], -src[5*len4 - 1 - k]);
+            tmp.im = FOLD( src[-len4 + k], -src[1*len3 - 1 - k]);
+        }
+        CMUL(z[i].im, z[i].re, tmp.re, tmp.im, exp[i].re, exp[i].im);
+    }
+}
+
+static void imdct_prerot_c(FFTComplex *z, const FFTSample *src,
+                           const FFTComplex *exp, ptrdiff_t len4)
+{
+    imdct_prerot(z, src, exp, len4, 1);
+}
+
+static void mdct_prerot_c(FFTComplex *z, const FFTSample *src,
+                          const FFTComplex *exp, ptrdiff_t len4)
+{
+    mdct_prerot(z, src, exp, len4);
+}
+
+/*
+ * Compound transforms with their non-power-of-two part done by s->fft_n.
+ * The input is gathered into the transposed layout s->fft_n works on in
+ * s->tmp, with the (i)MDCTs being pre-rotated in natural order into the
+ * output beforehand.
+ */
+static void compound_fft_cols_sub(AVTXContext *s, void *_out,
+                                  void *_in, ptrdiff_t stride)
+{
+    const int n = s->n, m = s->m, *in_map = s->pfatab, *out_map = in_map + n*m;
+    FFTComplex *in = _in;
+    FFTComplex *out = _out;
+
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            s->tmp[j*m + i] = in[in_map[i*n + j]];
+
+    s->fft_n(out, s->tmp, m);
+
+    for (int i = 0; i < n; i++)
+        s->ptwo_tx(s, s->tmp + m*i, out + m*i, sizeof(*out));
+
+    for (int i = 0; i < n*m; i++)
+        out[i] = s->tmp[out_map[i]];
+}
+
+static void compound_mdct_cols_sub(AVTXContext *s, void *_dst,
+                                   void *_src, ptrdiff_t stride)
+{
+    FFTComplex *z = _dst, *exp = s->exptab;
+    const int n = s->n, m = s->m, len4 = n*m;
+    const int *in_map = s->pfatab, *out_map = in_map + len4;
+
+    if (stride == sizeof(FFTSample)) {
+        s->mdct_prerot(z, _src, exp, len4);
+    } else if (s->inv) {
+        imdct_prerot(z, _src, exp, len4, stride / sizeof(FFTSample));
+    } else { /* The output is used as a buffer, which needs it to be contiguous */
+        av_tx_fn fn = n ==  3 ? compound_mdct_3xM :
+                      n ==  5 ? compound_mdct_5xM :
+                      n ==  7 ? compound_mdct_7xM :
+                      n ==  9 ? compound_mdct_9xM :
+                                compound_mdct_15xM;
+        fn(s, _dst, _src, stride);
+        return;
+    }
+
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            s->tmp[j*m + i] = z[in_map[i*n + j] >> 1];
+
+    s->fft_n(z, s->tmp, m);
+
+    for (int i = 0; i < n; i++)
+        s->ptwo_tx(s, s->tmp + m*i, z + m*i, sizeof(*z));
+
+    for (int i = 0; i < len4; i++)
+        z[i] = s->tmp[out_map[i]];
+
+    s->mdct_postrot(z, exp, len4 >> 1);
+}
+
+static void monolithic_imdct_sub(AVTXContext *s, void *_dst, void *_src,
+                                 ptrdiff_t stride)
+{
+    FFTComplex *z = _dst, *exp = s->exptab;
+    const int m = s->m;
+
+    if (stride != sizeof(FFTSample))
+        imdct_prerot(s->tmp, _src, exp, m, stride / sizeof(FFTSample));
+    else
+        s->mdct_prerot(s->tmp, _src, exp, m);
+
+    s->ptwo_tx(s, z, s->tmp, sizeof(*z));
+
+    s->mdct_postrot(z, exp, m >> 1);
+}
+
+static void monolithic_mdct_sub(AVTXContext *s, void *_dst, void *_src,
+                                ptrdiff_t stride)
+{
+    FFTComplex *exp = s->exptab, *z = _dst;
+    const int m = s->m;
+
+    if (stride != sizeof(FFTSample)) {
+        monolithic_mdct(s, _dst, _src, stride);
+        return;
+    }
+
+    s->mdct_prerot(s->tmp, _src, exp, m);
+
+    s->ptwo_tx(s, z, s->tmp, sizeof(*z));
+
+    s->mdct_postrot(z, exp, m >> 1);
+}
+
+int TX_NAME(ff_tx_init_ptwo_sub)(AVTXContext *s, av_tx_fn *tx, av_tx_fn ptwo_tx,
+                                 void (*postrot)(FFTComplex *z,
+                                                 const FFTComplex *exp,
+                                                 ptrdiff_t len8),
+                                 void (*prerot)(FFTComplex *z,
+                                                const FFTSample *src,
+                                                const FFTComplex *exp,
+                                                ptrdiff_t len4),
+                                 void (*fft_n)(FFTComplex *out, FFTComplex *in,
+                                               ptrdiff_t m))
+{
+    const int n = s->n, m = s->m, inv = s->inv;
+    const int is_mdct = ff_tx_type_is_mdct(s->type);
+    av_tx_fn fn;
+
+    /* Naive transforms and plain FFTs have nothing to split off */
+    if (m < 2 || (n == 1 && !is_mdct) || (s->flags & AV_TX_INPLACE))
+        return AVERROR(ENOSYS);
+    if (is_mdct && !postrot)
+        return AVERROR(EINVAL);
+
+    if (!s->tmp && !(s->tmp = av_malloc(n*m*sizeof(*s->tmp))))
+        return AVERROR(ENOMEM);
+
+    s->ptwo_tx      = ptwo_tx;
+    s->mdct_postrot = postrot;
+    s->mdct_prerot  = prerot ? prerot : inv ? imdct_prerot_c : mdct_prerot_c;
+    s->fft_n        = fft_n;
+
+    if (n == 1)
+        fn = inv ? monolithic_imdct_sub : monolithic_mdct_sub;
+    else if (fft_n && is_mdct)
+        fn = compound_mdct_cols_sub;
+    else if (fft_n)
+        fn = compound_fft_cols_sub;
+    else if (!is_mdct)
+        fn = n == 3 ? compound_fft_3xM_sub :
+             n == 5 ? compound_fft_5xM_sub :
+             n == 7 ? compound_fft_7xM_sub :
+             n == 9 ? compound_fft_9xM_sub :
+                      compound_fft_15xM_sub;
+    else
+        fn = n == 3 ? inv ? compound_imdct_3xM_sub  : compound_mdct_3xM_sub  :
+             n == 5 ? inv ? compound_imdct_5xM_sub  : compound_mdct_5xM_sub  :
+             n == 7 ? inv ? compound_imdct_7xM_sub  : compound_mdct_7xM_sub  :
+             n == 9 ? inv ? compound_imdct_9xM_sub  : compound_mdct_9xM_sub  :
+                      inv ? compound_imdct_15xM_sub : compound_mdct_15xM_sub;
+
+    if (is_mdct && inv && (s->flags & AV_TX_FULL_IMDCT))
+        s->top_tx = fn;
+    else
+        *tx = fn;
+
+    return 0;
+}
+#endif /* TX_FLOAT */
+
+#ifndef TX_INT32 /* Fixed-point real transforms are not supported yet */
+/*
+ * Real transforms are done with a complex FFT of half the length. The RDFT
+ * table starts with RDFT_TAB_HDR entries: half the scale in 0-3 (so it can
+ * be loaded as a vector), the scale for the DC and Nyquist terms in 4, and is
+ * followed by the twiddles for pairs 1 to len/2. DCTs append their own table.
+ */
+#define RDFT_TAB_HDR 8
+
+/*
+ * Combines pairs k, len - k for k = 1 to len/2:
+ * z[k]       =       h*(z[k] + conj(z[len - k])) + w[k]*(z[k] - conj(z[len - k]))
+ * z[len - k] = conj(h*(z[k] + conj(z[len - k])) - w[k]*(z[k] - conj(z[len - k])))
+ * which turns the FFT of the even/odd samples into the half spectrum of the
+ * real signal and back, depending on h and w.
+ */
+static void rdft_pairs(FFTComplex *z, const FFTComplex *tab, int len)
+{
+    const FFTSample half = tab[0].re;
+    const FFTComplex *tw = tab + RDFT_TAB_HDR - 1;
+
+    for (int k = 1; k <= len >> 1; k++) {
+        const int j = len - k;
+        FFTComplex a, b, t;
+
+        a.re = z[k].re + z[j].re;
+        a.im = z[k].im - z[j].im;
+        b.re = z[k].re - z[j].re;
+        b.im = z[k].im + z[j].im;
+        CMUL3(t, b, tw[k]);
+        z[k].re =   half*a.re + t.re;
+        z[k].im =   half*a.im + t.im;
+        z[j].re =   half*a.re - t.re;
+        z[j].im = -(half*a.im - t.im);
+    }
+}
+
+static void rdft_r2c(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTComplex *z = _dst;
+    const FFTComplex *tab = s->exptab;
+    const int len = s->n*s->m;
+
+    s->top_tx(s, z, _src, sizeof(*z));
+
+    z[len].re = tab[4].re*(z[0].re - z[0].im);
+    z[0].re   = tab[4].re*(z[0].re + z[0].im);
+    z[len].im = z[0].im = 0;
+
+    rdft_pairs(z, tab, len);
+}
+
+static void rdft_c2r(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTComplex *z = _src;
+    const FFTComplex *tab = s->exptab;
+    const int len = s->n*s->m;
+    const FFTSample re = z[0].re;
+
+    z[0].re = tab[4].re*(re + z[len].re);
+    z[0].im = tab[4].re*(re - z[len].re);
+
+    rdft_pairs(z, tab, len);
+
+    s->top_tx(s, _dst, z, sizeof(*z));
+}
+
+/*
+ * DCT-II through an RDFT of the input reordered as
+ * v[n] = x[2n], v[len - 1 - n] = x[2n + 1], with y[k] = Re(V[k]*e^(-i*pi*k/(2*len)))
+ */
+static void dctII(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTSample *dst = _dst, *src = _src;
+    FFTComplex *z = s->dcttmp;
+    const FFTComplex *tab = s->exptab;
+    const int len2 = s->n*s->m, len = len2*2;
+    const FFTComplex *exp = tab + RDFT_TAB_HDR + (len2 >> 1);
+
+    for (int i = 0; i < len2; i++) {
+        dst[i]           = src[2*i + 0];
+        dst[len - 1 - i] = src[2*i + 1];
+    }
+
+    s->top_tx(s, z, dst, sizeof(*z));
+
+    z[len2].re = z[0].re - z[0].im;
+    z[0].re    = z[0].re + z[0].im;
+    z[len2].im = z[0].im = 0;
+    rdft_pairs(z, tab, len2);
+
+    dst[0]    = z[0].re*exp[0].re;
+    dst[len2] = z[len2].re*exp[len2].re;
+    for (int k = 1; k < len2; k++) {
+        FFTComplex t;
+        CMUL3(t, z[k], exp[k]);
+        dst[k]       =  t.re;
+        dst[len - k] = -t.im;
+    }
+}
+
+/* DCT-III, the above in reverse, overwrites the input */
+static void dctIII(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    FFTSample *dst = _dst, *src = _src;
+    FFTComplex *z = s->dcttmp;
+    const FFTComplex *tab = s->exptab;
+    const int len2 = s->n*s->m, len = len2*2;
+    const FFTComplex *exp = tab + RDFT_TAB_HDR + (len2 >> 1);
+
+    for (int k = 1; k < len2; k++) {
+        FFTComplex t = { src[k], -src[len - k] };
+        CMUL3(z[k], t, exp[k]);
+    }
+
+    z[0].re = src[0]*exp[0].re + src[len2]*exp[len2].re;
+    z[0].im = src[0]*exp[0].re - src[len2]*exp[len2].re;
+    rdft_pairs(z, tab, len2);
+
+    s->top_tx(s, src, z, sizeof(*z));
+
+    for (int i = 0; i < len2; i++) {
+        dst[2*i + 0] = src[i];
+        dst[2*i + 1] = src[len - 1 - i];
+    }
+}
+#endif /* TX_INT32 */
+
 static int gen_mdct_exptab(AVTXContext *s, int len4, double scale)
 {
     const double theta = (scale < 0 ? len4 : 0) + 1.0/8.0;
@@ -1022,3 +1467,70 @@ int TX_NAME(ff_tx_init_mdct_fft)(AVTXContext *s, av_tx_fn *tx,
 
     return 0;
 }
+
+#ifndef TX_INT32
+int TX_NAME(ff_tx_init_rdft_dct)(AVTXContext *s, av_tx_fn *tx,
+                                 enum AVTXType type, int inv, int len,
+                                 const void *scale, uint64_t flags)
+{
+    const int is_dct = type == TX_TYPE(DCT);
+    const double sc  = scale ? *((SCALE_TYPE *)scale) : 1.0;
+    const int len2   = len >> 1;
+    /* the RDFT half scale and twiddles for each direction, see rdft_pairs() */
+    const double half   = is_dct ? (inv ? 1.0 : 0.5) : (inv ? sc : sc/2);
+    const double dc     = is_dct ? 1.0 : sc;
+    FFTComplex *tab;
+    int err;
+
+    if (len < 2 || (len & 1))
+        return AVERROR(EINVAL);
+    if (flags & AV_TX_INPLACE) /* In-place real transforms are not supported yet */
+        return AVERROR(ENOSYS);
+
+    if ((err = TX_NAME(ff_tx_init_mdct_fft)(s, &s->top_tx, TX_TYPE(FFT), inv,
+                                            len2, NULL, flags)))
+        return err;
+
+    s->type  = type;
+    s->scale = sc;
+
+    if (!(s->exptab = av_mallocz_array(RDFT_TAB_HDR + (len2 >> 1) +
+                                       (is_dct ? len2 + 1 : 0),
+                                       sizeof(*s->exptab))))
+        return AVERROR(ENOMEM);
+    tab = s->exptab;
+
+    for (int i = 0; i < 4; i++)
+        tab[i].re = tab[i].im = RESCALE(half);
+    tab[4].re = tab[4].im = RESCALE(dc);
+
+    /* -i*e^(-2*pi*i*k/len)*sc/2 forward, i*e^(2*pi*i*k/len)*sc inverse */
+    for (int k = 1; k <= len2 >> 1; k++) {
+        const double alpha = 2.0*M_PI*k/len;
+        tab[RDFT_TAB_HDR + k - 1].re = RESCALE(-sin(alpha)*half);
+        tab[RDFT_TAB_HDR + k - 1].im = RESCALE( cos(alpha)*half*(inv ? 1 : -1));
+    }
+
+    if (is_dct) {
+        FFTComplex *exp = tab + RDFT_TAB_HDR + (len2 >> 1);
+
+        /* sc*e^(-i*pi*k/(2*len)) forward, sc/2*e^(i*pi*k/(2*len)) inverse */
+        for (int k = 0; k < len2; k++) {
+            const double alpha = M_PI_2*k/len;
+            exp[k].re = RESCALE(cos(alpha)*sc*(inv ? 0.5 : 1.0));
+            exp[k].im = RESCALE(sin(alpha)*sc*(inv ? 0.5 : -1.0));
+        }
+        /* only the real part is used for the Nyquist term */
+        exp[len2].re = RESCALE(sc*M_SQRT1_2);
+
+        if (!(s->dcttmp = av_malloc_array(len2 + 1, sizeof(*s->dcttmp))))
+            return AVERROR(ENOMEM);
+
+        *tx = inv ? dctIII : dctII;
+    } else {
+        *tx = inv ? rdft_c2r : rdft_r2c;
+    }
+
+    return 0;
+}
+#endif /* TX_INT32 */
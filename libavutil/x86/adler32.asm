@@ -0,0 +1,127 @@
+;*****************************************************************************
+;* x86-optimized Adler-32 checksum
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION_RODATA 32
+
+pb_weights: db 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17
+            db 16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1
+pw_1:       times 16 dw 1
+
+%define BASE 65521
+; largest multiple of 32 for which the sums below cannot overflow 32 bits
+%define NMAX 5536
+
+SECTION .text
+
+; %1 = register to sum the dwords of, %2 = tmp, %3 = destination
+%macro HADDD_TO_GPR 3
+%if mmsize == 32
+    vextracti128 xm%2, m%1, 1
+    paddd        xm%1, xm%2
+%endif
+    pshufd       xm%2, xm%1, q1032
+    paddd        xm%1, xm%2
+    pshufd       xm%2, xm%1, q2301
+    paddd        xm%1, xm%2
+    movd           %3, xm%1
+%endmacro
+
+; %1 %= BASE, using 2^16 = 15 mod BASE; %1 must be less than 2^32
+; %2 = tmp
+%macro MOD_BASE 2
+%rep 2
+    mov            %2, %1
+    shr            %2, 16
+    and            %1, 0xffff
+    imul           %2, 15
+    add            %1, %2
+%endrep
+    mov            %2, %1
+    sub            %2, BASE
+    cmovae         %1, %2
+%endmacro
+
+;-----------------------------------------------------------------------------
+; AVAdler ff_adler32_update(AVAdler adler, const uint8_t *buf, size_t len);
+; len must be a multiple of mmsize
+;-----------------------------------------------------------------------------
+%macro ADLER32 0
+cglobal adler32_update, 3,6,7, adler, buf, len, s1, n, tmp
+    mova          m5, [pb_weights + 32 - mmsize]
+    mov          s1d, adlerd
+    and          s1d, 0xffff
+    shr       adlerd, 16
+    test        lenq, lenq
+    jz .end
+.block:
+    mov           nq, NMAX
+    cmp           nq, lenq
+    cmova         nq, lenq
+    sub         lenq, nq
+    mov         tmpd, s1d
+    imul        tmpd, nd
+    add       adlerd, tmpd
+    pxor          m0, m0 ; sum of the bytes
+    pxor          m1, m1 ; weighted sum of the bytes within each vector
+    pxor          m2, m2 ; sum of the bytes in all previous vectors
+    pxor          m4, m4
+.loop:
+    movu          m3, [bufq]
+    paddd         m2, m0
+    mova          m6, m3
+    psadbw        m3, m4
+    paddd         m0, m3
+    pmaddubsw     m6, m5
+    pmaddwd       m6, [pw_1]
+    paddd         m1, m6
+    add         bufq, mmsize
+    sub           nq, mmsize
+    jg .loop
+
+%if mmsize == 32
+    pslld         m2, 5
+%else
+    pslld         m2, 4
+%endif
+    paddd         m1, m2
+    HADDD_TO_GPR   0, 3, tmpd
+    add          s1d, tmpd
+    HADDD_TO_GPR   1, 3, tmpd
+    add       adlerd, tmpd
+
+    MOD_BASE     s1d, tmpd
+    MOD_BASE  adlerd, tmpd
+    test        lenq, lenq
+    jnz .block
+.end:
+    shl       adlerd, 16
+    or        adlerd, s1d
+    mov           eax, adlerd
+    RET
+%endmacro
+
+INIT_XMM ssse3
+ADLER32
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+ADLER32
+%endif
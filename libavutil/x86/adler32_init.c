@@ -0,0 +1,55 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/adler32.h"
+#include "libavutil/adler32_internal.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "cpu.h"
+
+AVAdler ff_adler32_update_ssse3(AVAdler adler, const uint8_t *buf, size_t len);
+AVAdler ff_adler32_update_avx2(AVAdler adler, const uint8_t *buf, size_t len);
+
+#define ADLER32_FUNC(opt, block)                                             \
+static AVAdler adler32_update_ ## opt(AVAdler adler, const uint8_t *buf,     \
+                                      size_t len)                            \
+{                                                                            \
+    size_t done = len & ~(block - 1);                                        \
+                                                                             \
+    if (len < FF_ADLER32_SIMD_MIN_LEN)                                       \
+        return av_adler32_update(adler, buf, len);                           \
+    adler = ff_adler32_update_ ## opt(adler, buf, done);                     \
+    /* the C code does the remaining bytes */                                \
+    return av_adler32_update(adler, buf + done, len - done);                 \
+}
+
+ADLER32_FUNC(ssse3, 16)
+ADLER32_FUNC(avx2,  32)
+
+FFAdler32Func ff_adler32_get_func_x86(void)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        return adler32_update_avx2;
+    if (EXTERNAL_SSSE3(cpu_flags))
+        return adler32_update_ssse3;
+    return NULL;
+}
@@ -0,0 +1,178 @@
+;*****************************************************************************
+;* x86-optimized AES functions
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION .text
+
+; The round keys are stored in the order they are used by the C code:
+; round_key[rounds] is applied first and round_key[0] last. For decryption
+; the inner keys already have InvMixColumns applied, which is the form
+; aesdec expects.
+
+; %1 = aesenc/aesdec, %2 = aesenclast/aesdeclast, %3 = number of blocks in m0-m3
+%macro AES_ROUNDS 3
+    lea       keyq, [aq + roundsq]
+    movu        m4, [keyq]
+%assign i 0
+%rep %3
+    pxor     m %+ i, m4
+%assign i i+1
+%endrep
+    sub       keyq, 16
+%%round:
+    movu        m4, [keyq]
+%assign i 0
+%rep %3
+    %1       m %+ i, m4
+%assign i i+1
+%endrep
+    sub       keyq, 16
+    cmp       keyq, aq
+    jne %%round
+    movu        m4, [aq]
+%assign i 0
+%rep %3
+    %2       m %+ i, m4
+%assign i i+1
+%endrep
+%endmacro
+
+; %1 = aesenc/aesdec, %2 = aesenclast/aesdeclast
+%macro AES_ECB 2
+    sub     countd, 4
+    jl .ecb_tail
+.ecb4:
+    movu        m0, [srcq]
+    movu        m1, [srcq + 16]
+    movu        m2, [srcq + 32]
+    movu        m3, [srcq + 48]
+    AES_ROUNDS  %1, %2, 4
+    movu [dstq],      m0
+    movu [dstq + 16], m1
+    movu [dstq + 32], m2
+    movu [dstq + 48], m3
+    add       srcq, 64
+    add       dstq, 64
+    sub     countd, 4
+    jge .ecb4
+.ecb_tail:
+    add     countd, 4
+    jz .end
+.ecb1:
+    movu        m0, [srcq]
+    AES_ROUNDS  %1, %2, 1
+    movu    [dstq], m0
+    add       srcq, 16
+    add       dstq, 16
+    dec     countd
+    jg .ecb1
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void ff_aes_encrypt(AVAES *a, uint8_t *dst, const uint8_t *src,
+;                     int count, uint8_t *iv, int rounds);
+;-----------------------------------------------------------------------------
+INIT_XMM aesni
+cglobal aes_encrypt, 6,7,6, a, dst, src, count, iv, rounds, key
+    test    countd, countd
+    jle .end
+    shl    roundsd, 4
+    test        ivq, ivq
+    jnz .cbc
+    AES_ECB aesenc, aesenclast
+    RET
+
+; each block depends on the previous one, so CBC encryption is serial
+.cbc:
+    movu        m5, [ivq]
+.cbc_loop:
+    movu        m0, [srcq]
+    pxor        m0, m5
+    AES_ROUNDS  aesenc, aesenclast, 1
+    movu    [dstq], m0
+    mova        m5, m0
+    add       srcq, 16
+    add       dstq, 16
+    dec     countd
+    jg .cbc_loop
+    movu     [ivq], m5
+.end:
+    RET
+
+;-----------------------------------------------------------------------------
+; void ff_aes_decrypt(AVAES *a, uint8_t *dst, const uint8_t *src,
+;                     int count, uint8_t *iv, int rounds);
+;-----------------------------------------------------------------------------
+INIT_XMM aesni
+cglobal aes_decrypt, 6,7,6, a, dst, src, count, iv, rounds, key
+    test    countd, countd
+    jle .end
+    shl    roundsd, 4
+    test        ivq, ivq
+    jnz .cbc
+    AES_ECB aesdec, aesdeclast
+    RET
+
+; the ciphertext is reloaded from src before dst is written, which keeps
+; in-place decryption working
+.cbc:
+    movu        m5, [ivq]
+    sub     countd, 4
+    jl .cbc_tail
+.cbc4:
+    movu        m0, [srcq]
+    movu        m1, [srcq + 16]
+    movu        m2, [srcq + 32]
+    movu        m3, [srcq + 48]
+    AES_ROUNDS  aesdec, aesdeclast, 4
+    pxor        m0, m5
+    movu        m4, [srcq]
+    pxor        m1, m4
+    movu        m4, [srcq + 16]
+    pxor        m2, m4
+    movu        m4, [srcq + 32]
+    pxor        m3, m4
+    movu        m5, [srcq + 48]
+    movu [dstq],      m0
+    movu [dstq + 16], m1
+    movu [dstq + 32], m2
+    movu [dstq + 48], m3
+    add       srcq, 64
+    add       dstq, 64
+    sub     countd, 4
+    jge .cbc4
+.cbc_tail:
+    add     countd, 4
+    jz .cbc_end
+.cbc1:
+    movu        m0, [srcq]
+    AES_ROUNDS  aesdec, aesdeclast, 1
+    pxor        m0, m5
+    movu        m5, [srcq]
+    movu    [dstq], m0
+    add       srcq, 16
+    add       dstq, 16
+    dec     countd
+    jg .cbc1
+.cbc_end:
+    movu     [ivq], m5
+.end:
+    RET
@@ -0,0 +1,157 @@
+;*****************************************************************************
+;* x86-optimized CRC functions
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION_RODATA
+
+pb_reverse:   db 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0
+pb_bitrev_lo: db 0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0
+              db 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0
+pb_bitrev_hi: db 0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e
+              db 0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f
+pb_0f:        times 16 db 0x0f
+
+SECTION .text
+
+; All CRCs are computed as a 32-bit CRC with the generator polynomial
+; G(x) = x^32 + poly << (32 - bits), which gives the same remainder aligned to
+; the top of the register. The constants table passed in holds, per CRC:
+;   k[0-1]: fold by 4 blocks, x^512 mod G and x^576 mod G
+;   k[2-3]: fold by 1 block,  x^128 mod G and x^192 mod G
+;   k[4-5]: x^64 mod G and x^96 mod G for the 128 -> 64 bit reduction
+;   k[6-7]: floor(x^64 / G) and G for the Barrett reduction
+; For the bit-reflected CRCs the data is folded as loaded, with the fold
+; constants bit-reflected, in swapped order and multiplied by x^-1 to make up
+; for the product of two reflected operands ending up one bit off. The final
+; reduction is done after reflecting the remaining 128 bits back.
+
+; %1 = accumulator, %2 = data, %3 = constants, %4 = tmp
+%macro FOLD 4
+    mova         %4, %1
+    pclmulqdq    %1, %3, 0x00
+    pclmulqdq    %4, %3, 0x11
+    pxor         %1, %2
+    pxor         %1, %4
+%endmacro
+
+; reverse the bit order of every byte, %1 = data, %2-%3 = tmp
+%macro BITREV 3
+    mova         %2, %1
+    psrlw        %2, 4
+    pand         %1, [pb_0f]
+    pand         %2, [pb_0f]
+    mova         %3, [pb_bitrev_lo]
+    pshufb       %3, %1
+    mova         %1, [pb_bitrev_hi]
+    pshufb       %1, %2
+    por          %1, %3
+%endmacro
+
+; %1 = be/le
+%macro CRC 1
+;-----------------------------------------------------------------------------
+; uint32_t ff_crc_%1(const uint64_t k[8], uint32_t crc, const uint8_t *buf,
+;                    size_t len);
+; len must be at least 64, only complete 16 byte blocks are processed
+;-----------------------------------------------------------------------------
+cglobal crc_%1, 4,4,8, k, crc, buf, len
+    movd         m4, crcd
+    movu         m0, [bufq]
+    movu         m1, [bufq + 16]
+    movu         m2, [bufq + 32]
+    movu         m3, [bufq + 48]
+    pxor         m0, m4
+%ifidn %1, be
+    mova         m7, [pb_reverse]
+    pshufb       m0, m7
+    pshufb       m1, m7
+    pshufb       m2, m7
+    pshufb       m3, m7
+%endif
+    add        bufq, 64
+    sub        lenq, 128
+    jl .fold_4to1
+    mova         m4, [kq]
+.fold4:
+%assign i 0
+%rep 4
+    movu         m5, [bufq + 16 * i]
+%ifidn %1, be
+    pshufb       m5, m7
+%endif
+    FOLD    m %+ i, m5, m4, m6
+%assign i i+1
+%endrep
+    add        bufq, 64
+    sub        lenq, 64
+    jge .fold4
+
+.fold_4to1:
+    mova         m4, [kq + 16]
+    FOLD         m0, m1, m4, m6
+    FOLD         m0, m2, m4, m6
+    FOLD         m0, m3, m4, m6
+    add        lenq, 64 - 16
+    jl .reduce
+.fold1:
+    movu         m1, [bufq]
+%ifidn %1, be
+    pshufb       m1, m7
+%endif
+    FOLD         m0, m1, m4, m6
+    add        bufq, 16
+    sub        lenq, 16
+    jge .fold1
+
+.reduce:
+%ifidn %1, le
+    BITREV       m0, m1, m2
+    pshufb       m0, [pb_reverse]
+%endif
+    ; x * x^32 mod G, 128 -> 96 -> 64 bits
+    mova         m4, [kq + 32]
+    movq         m1, m0
+    pclmulqdq    m0, m4, 0x11
+    pslldq       m1, 4
+    pxor         m0, m1
+    movq         m1, m0
+    psrldq       m0, 8
+    pclmulqdq    m0, m4, 0x00
+    pxor         m0, m1
+    ; Barrett reduction, 64 -> 32 bits
+    mova         m4, [kq + 48]
+    mova         m1, m0
+    psrlq        m0, 32
+    pclmulqdq    m0, m4, 0x00
+    psrlq        m0, 32
+    pclmulqdq    m0, m4, 0x10
+    pxor         m0, m1
+%ifidn %1, le
+    BITREV       m0, m1, m2
+%endif
+    movd        eax, m0
+    bswap       eax
+    RET
+%endmacro
+
+INIT_XMM clmul
+CRC be
+CRC le
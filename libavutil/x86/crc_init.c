@@ -0,0 +1,164 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/attributes.h"
+#include "libavutil/bswap.h"
+#include "libavutil/cpu.h"
+#include "libavutil/crc.h"
+#include "libavutil/crc_internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "cpu.h"
+
+uint32_t ff_crc_be_clmul(const uint64_t k[8], uint32_t crc,
+                         const uint8_t *buffer, size_t length);
+uint32_t ff_crc_le_clmul(const uint64_t k[8], uint32_t crc,
+                         const uint8_t *buffer, size_t length);
+
+/* See crc.asm for the layout. */
+static DECLARE_ALIGNED(16, uint64_t, clmul_consts)[AV_CRC_MAX][8];
+static AVOnce clmul_consts_once = AV_ONCE_INIT;
+
+static int crc_is_le(AVCRCId id)
+{
+    return id == AV_CRC_32_IEEE_LE || id == AV_CRC_16_ANSI_LE;
+}
+
+static uint64_t bitrev64(uint64_t x)
+{
+    uint64_t r = 0;
+    int i;
+
+    for (i = 0; i < 64; i++)
+        r |= ((x >> i) & 1) << (63 - i);
+    return r;
+}
+
+/* x^n mod G, with G = x^32 + poly */
+static uint32_t xn_mod_g(unsigned n, uint32_t poly)
+{
+    uint32_t r = 1;
+
+    while (n--)
+        r = (r << 1) ^ (poly & -(r >> 31));
+    return r;
+}
+
+/* floor(x^64 / G) */
+static uint64_t x64_div_g(uint32_t poly)
+{
+    uint64_t q = 0;
+    uint32_t r = 0;
+    int i;
+
+    /* x^64 = x^32 * x^32, and x^32 mod G = poly */
+    for (i = 31, r = poly; i >= 0; i--) {
+        int bit = r >> 31;
+        q |= (uint64_t)bit << i;
+        r   = (r << 1) ^ (poly & -bit);
+    }
+    return q | 1ULL << 32;
+}
+
+static av_cold void init_clmul_consts(void)
+{
+    int id;
+
+    for (id = 0; id < AV_CRC_MAX; id++) {
+        const AVCRC *table = av_crc_get_table(id);
+        uint64_t *k = clmul_consts[id];
+        uint32_t poly;
+
+        /* Recover the generator aligned to the top of a 32-bit register. The
+         * entry for 0x80 (LE) or 0x01 (BE) is the polynomial itself. */
+        if (crc_is_le(id)) {
+            poly = bitrev64(table[0x80]) >> 32;
+            k[0] = bitrev64(xn_mod_g(512 + 64 - 1, poly));
+            k[1] = bitrev64(xn_mod_g(512 - 1,      poly));
+            k[2] = bitrev64(xn_mod_g(128 + 64 - 1, poly));
+            k[3] = bitrev64(xn_mod_g(128 - 1,      poly));
+        } else {
+            poly = av_bswap32(table[0x01]);
+            k[0] = xn_mod_g(512,      poly);
+            k[1] = xn_mod_g(512 + 64, poly);
+            k[2] = xn_mod_g(128,      poly);
+            k[3] = xn_mod_g(128 + 64, poly);
+        }
+        k[4] = xn_mod_g(64, poly);
+        k[5] = xn_mod_g(96, poly);
+        k[6] = x64_div_g(poly);
+        k[7] = poly | 1ULL << 32;
+    }
+}
+
+static av_always_inline uint32_t crc_clmul(AVCRCId id, const AVCRC *ctx, uint32_t crc,
+                                           const uint8_t *buffer, size_t length)
+{
+    size_t done = length & ~15;
+
+    if (length < FF_CRC_SIMD_MIN_LEN)
+        return av_crc(ctx, crc, buffer, length);
+
+    if (crc_is_le(id))
+        crc = ff_crc_le_clmul(clmul_consts[id], crc, buffer, done);
+    else
+        crc = ff_crc_be_clmul(clmul_consts[id], crc, buffer, done);
+
+    /* the table code does the remaining bytes */
+    return av_crc(ctx, crc, buffer + done, length - done);
+}
+
+#define CRC_CLMUL_FUNC(name)                                                 \
+static uint32_t crc_clmul_ ## name(const AVCRC *ctx, uint32_t crc,           \
+                                   const uint8_t *buffer, size_t length)     \
+{                                                                            \
+    return crc_clmul(AV_CRC_ ## name, ctx, crc, buffer, length);             \
+}
+
+CRC_CLMUL_FUNC(8_ATM)
+CRC_CLMUL_FUNC(16_ANSI)
+CRC_CLMUL_FUNC(16_CCITT)
+CRC_CLMUL_FUNC(32_IEEE)
+CRC_CLMUL_FUNC(32_IEEE_LE)
+CRC_CLMUL_FUNC(16_ANSI_LE)
+CRC_CLMUL_FUNC(24_IEEE)
+CRC_CLMUL_FUNC(8_EBU)
+
+static const FFCRCFunc crc_clmul_funcs[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = crc_clmul_8_ATM,
+    [AV_CRC_16_ANSI]    = crc_clmul_16_ANSI,
+    [AV_CRC_16_CCITT]   = crc_clmul_16_CCITT,
+    [AV_CRC_32_IEEE]    = crc_clmul_32_IEEE,
+    [AV_CRC_32_IEEE_LE] = crc_clmul_32_IEEE_LE,
+    [AV_CRC_16_ANSI_LE] = crc_clmul_16_ANSI_LE,
+    [AV_CRC_24_IEEE]    = crc_clmul_24_IEEE,
+    [AV_CRC_8_EBU]      = crc_clmul_8_EBU,
+};
+
+FFCRCFunc ff_crc_get_func_x86(AVCRCId crc_id)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_CLMUL(cpu_flags)) {
+        ff_thread_once(&clmul_consts_once, init_clmul_consts);
+        return crc_clmul_funcs[crc_id];
+    }
+    return NULL;
+}
@@ -0,0 +1,164 @@
+;*****************************************************************************
+;* x86-optimized SHA-1 and SHA-256 functions
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+%if ARCH_X86_64
+
+SECTION_RODATA
+
+pb_bswap128: db 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0
+pb_bswap32:  db  3,  2,  1,  0,  7,  6,  5,  4, 11, 10,  9,  8, 15, 14, 13, 12
+
+k256: dd 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5
+      dd 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5
+      dd 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3
+      dd 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174
+      dd 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc
+      dd 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da
+      dd 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7
+      dd 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967
+      dd 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13
+      dd 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85
+      dd 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3
+      dd 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070
+      dd 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5
+      dd 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3
+      dd 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208
+      dd 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+
+SECTION .text
+
+; The message schedule lives in m3-m6, four words per register. Block n of the
+; schedule is started by sha*msg1 on block n - 4 three quad-rounds before it
+; is needed, and completed by sha*msg2 in the quad-round before.
+
+;-----------------------------------------------------------------------------
+; void ff_sha1_transform(uint32_t state[5], const uint8_t buffer[64]);
+;-----------------------------------------------------------------------------
+INIT_XMM shani
+cglobal sha1_transform, 2,2,10, state, buf
+%define ABCD m0
+%define SHUF m7
+    movu         ABCD, [stateq]
+    pshufd       ABCD, ABCD, q0123
+    movd           m1, [stateq + 16]
+    pslldq         m1, 12
+    mova         SHUF, [pb_bswap128]
+    mova           m8, m1
+    mova           m9, ABCD
+
+%assign i 0
+%rep 20
+    %assign e  1 + (i & 1)
+    %assign en 2 - (i & 1)
+    %assign w  3 + (i % 4)
+    %assign w1 3 + ((i + 1) % 4)
+    %assign w2 3 + ((i + 2) % 4)
+    %assign w3 3 + ((i + 3) % 4)
+    %assign f  i / 5
+%if i < 4
+    movu       m %+ w, [bufq + 16 * i]
+    pshufb     m %+ w, SHUF
+%endif
+%if i == 0
+    paddd          m1, m3
+%else
+    sha1nexte m %+ e, m %+ w
+%endif
+    mova      m %+ en, ABCD
+%if i >= 3 && i <= 18
+    sha1msg2 m %+ w1, m %+ w
+%endif
+    sha1rnds4    ABCD, m %+ e, f
+%if i >= 1 && i <= 16
+    sha1msg1 m %+ w3, m %+ w
+%endif
+%if i >= 2 && i <= 17
+    pxor      m %+ w2, m %+ w
+%endif
+%assign i i+1
+%endrep
+
+    sha1nexte      m1, m8
+    paddd        ABCD, m9
+    pshufd       ABCD, ABCD, q0123
+    movu     [stateq], ABCD
+    pextrd [stateq + 16], m1, 3
+    RET
+
+;-----------------------------------------------------------------------------
+; void ff_sha256_transform(uint32_t state[8], const uint8_t buffer[64]);
+;-----------------------------------------------------------------------------
+; sha256rnds2 takes the message words in xmm0, the state is kept as ABEF in
+; m1 and CDGH in m2
+INIT_XMM shani
+cglobal sha256_transform, 2,2,11, state, buf
+%define MSG m0
+%define SHUF m7
+    movu           m1, [stateq]
+    movu           m2, [stateq + 16]
+    mova           m8, m1
+    punpcklqdq     m1, m2
+    punpckhqdq     m2, m8
+    pshufd         m1, m1, q0123
+    pshufd         m2, m2, q2301
+    mova         SHUF, [pb_bswap32]
+    mova           m9, m1
+    mova          m10, m2
+
+%assign i 0
+%rep 16
+    %assign w  3 + (i % 4)
+    %assign w1 3 + ((i + 1) % 4)
+    %assign w3 3 + ((i + 3) % 4)
+%if i < 4
+    movu       m %+ w, [bufq + 16 * i]
+    pshufb     m %+ w, SHUF
+%endif
+    mova          MSG, [k256 + 16 * i]
+    paddd         MSG, m %+ w
+    sha256rnds2    m2, m1, MSG
+%if i >= 3 && i <= 14
+    mova           m8, m %+ w
+    palignr        m8, m %+ w3, 4
+    paddd     m %+ w1, m8
+    sha256msg2 m %+ w1, m %+ w
+%endif
+    punpckhqdq    MSG, MSG
+    sha256rnds2    m1, m2, MSG
+%if i >= 1 && i <= 12
+    sha256msg1 m %+ w3, m %+ w
+%endif
+%assign i i+1
+%endrep
+
+    paddd          m1, m9
+    paddd          m2, m10
+    mova           m8, m1
+    punpcklqdq     m1, m2
+    punpckhqdq     m8, m2
+    pshufd         m1, m1, q2301
+    pshufd         m8, m8, q2301
+    movu     [stateq], m8
+    movu [stateq + 16], m1
+    RET
+
+%endif ; ARCH_X86_64
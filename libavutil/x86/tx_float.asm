@@ -68,6 +68,11 @@ SECTION_RODATA 32
 %define M_SQRT1_2 0.707106781186547524401
 %define COS16_1   0.92387950420379638671875
 %define COS16_3   0.3826834261417388916015625
+%define COS12_1   0.866025403784438646763723 ; cos(2pi/12)
+%define COS5_1    0.309016994374947424102293 ; cos(2pi/5)
+%define SIN5_1    0.951056516295153572116439 ; sin(2pi/5)
+%define COS10_1   0.809016994374947424102293 ; cos(2pi/10)
+%define SIN10_1   0.587785252292473129168706 ; sin(2pi/10)
 
 d8_mult_odd:   dd M_SQRT1_2, -M_SQRT1_2, -M_SQRT1_2, M_SQRT1_2, \
                   M_SQRT1_2, -M_SQRT1_2, -M_SQRT1_2, M_SQRT1_2
@@ -88,6 +93,15 @@ mask_mppmmpmp: dd NEG, POS, POS, NEG, NEG, POS, NEG, POS
 mask_mpmppmpm: dd NEG, POS, NEG, POS, POS, NEG, POS, NEG
 mask_pmmppmmp: dd POS, NEG, NEG, POS, POS, NEG, NEG, POS
 mask_pmpmpmpm: times 4 dd POS, NEG
+mask_mpmpmpmp: times 4 dd NEG, POS
+
+; 3 and 5-point FFT constants, long enough for zmm registers
+s3_half:       times 16 dd 0.5
+s3_mult:       times  8 dd COS12_1, -COS12_1
+s5_cos1:       times 16 dd COS5_1
+s5_cos2:       times 16 dd COS10_1
+s5_sin1:       times  8 dd SIN5_1,  -SIN5_1
+s5_sin2:       times  8 dd SIN10_1, -SIN10_1
 
 SECTION .text
 
@@ -1212,3 +1226,419 @@ FFT_SPLIT_RADIX_FN avx
 FFT_SPLIT_RADIX_FN avx2
 %endif
 %endif
+
+; Reverses the order of the complex values in a register
+%macro REVERSE_CPLX 1
+%if mmsize == 32
+    vperm2f128 %1, %1, %1, 0x01
+%endif
+    shufps     %1, %1, q1032
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void ff_tx_rdft_pairs_float(AVComplexFloat *z, const AVComplexFloat *tab,
+;                             ptrdiff_t len);
+; Combines the pairs k, len - k for k = 1 to len/2 of a real transform, see
+; rdft_pairs() in libavutil/tx_template.c. tab is the RDFT table, with the
+; half scale in the first mmsize bytes and the twiddles from offset 64.
+; len must be a multiple of mmsize/4.
+;-----------------------------------------------------------------------------
+%macro RDFT_PAIRS_FN 0
+cglobal tx_rdft_pairs_float, 3, 4, 8, z, tab, len, zj
+    mova            m6, [tabq]
+    mova            m7, [mask_pmpmpmpm]
+    lea            zjq, [zq + lenq*8 - mmsize]
+    add             zq, 8
+    add           tabq, 64
+    shr           lenq, 1
+
+.loop:
+    movu            m0, [zq]                ; z[k]
+    movu            m1, [zjq]               ; z[len - k]
+    REVERSE_CPLX    m1
+    xorps           m1, m7                  ; conj(z[len - k])
+    subps           m2, m0, m1              ; b
+    addps           m0, m1                  ; a
+
+    mova            m3, [tabq]
+    movsldup        m4, m3
+    movshdup        m3, m3
+    shufps          m5, m2, m2, q2301
+    mulps           m4, m2
+    mulps           m5, m3
+    addsubps        m4, m5                  ; t = b*w
+
+    mulps           m0, m6                  ; h*a
+    addps           m1, m0, m4
+    subps           m0, m4
+    xorps           m0, m7
+    REVERSE_CPLX    m0
+
+    movu          [zq], m1
+    movu         [zjq], m0
+
+    add             zq, mmsize
+    sub            zjq, mmsize
+    add           tabq, mmsize
+    sub           lenq, mmsize/8
+    jg .loop
+
+    RET
+%endmacro
+
+INIT_XMM sse3
+RDFT_PAIRS_FN
+INIT_YMM avx
+RDFT_PAIRS_FN
+
+;-----------------------------------------------------------------------------
+; void ff_tx_mdct_postrot_float(AVComplexFloat *z, const AVComplexFloat *exp,
+;                               ptrdiff_t len8);
+; void ff_tx_imdct_postrot_float(AVComplexFloat *z, const AVComplexFloat *exp,
+;                                ptrdiff_t len8);
+; In-place post-rotation of an MDCT/iMDCT of len8*2 complex values, see
+; monolithic_mdct()/monolithic_imdct() in libavutil/tx_template.c.
+; The values len8 + i and len8 - 1 - i are done together, len8 must be
+; a multiple of mmsize/8.
+;-----------------------------------------------------------------------------
+%macro MDCT_POSTROT_FN 1
+cglobal tx_%1_postrot_float, 3, 5, 8, z, exp, len, z1, exp1
+    lea            z1q, [zq   + lenq*8 - mmsize]
+    lea          exp1q, [expq + lenq*8 - mmsize]
+    lea             zq, [zq   + lenq*8]
+    lea           expq, [expq + lenq*8]
+
+.loop:
+    movu            m0, [zq]                ; a = z[len8 + i]
+    movu            m1, [z1q]
+    REVERSE_CPLX    m1                      ; b = z[len8 - 1 - i]
+    movu            m2, [expq]
+    movu            m3, [exp1q]
+    REVERSE_CPLX    m3
+    movshdup        m4, m2
+    movsldup        m2, m2
+    movshdup        m5, m3
+    movsldup        m3, m3
+    shufps          m6, m0, m0, q2301
+    shufps          m7, m1, m1, q2301
+
+%ifidn %1, imdct ; swap(z)*swap(exp)
+    mulps           m4, m6
+    mulps           m2, m0
+    mulps           m5, m7
+    mulps           m3, m1
+%else ; z*swap(exp)
+    mulps           m4, m0
+    mulps           m2, m6
+    mulps           m5, m1
+    mulps           m3, m7
+%endif
+    addsubps        m4, m2
+    addsubps        m5, m3
+
+    ; the real and imaginary parts of the two products are exchanged
+%ifidn %1, imdct
+    shufps          m0, m4, m5, q3120
+    shufps          m1, m5, m4, q3120
+%else
+    shufps          m0, m4, m5, q2031
+    shufps          m1, m5, m4, q2031
+%endif
+    shufps          m0, m0, q3120
+    shufps          m1, m1, q3120
+    REVERSE_CPLX    m1
+
+    movu          [zq], m0
+    movu         [z1q], m1
+
+    add             zq, mmsize
+    add           expq, mmsize
+    sub            z1q, mmsize
+    sub          exp1q, mmsize
+    sub           lenq, mmsize/8
+    jg .loop
+
+    RET
+%endmacro
+
+INIT_XMM sse3
+MDCT_POSTROT_FN mdct
+MDCT_POSTROT_FN imdct
+INIT_YMM avx
+MDCT_POSTROT_FN mdct
+MDCT_POSTROT_FN imdct
+
+;-----------------------------------------------------------------------------
+; void ff_tx_mdct_prerot_float(AVComplexFloat *z, const float *src,
+;                              const AVComplexFloat *exp, ptrdiff_t len4);
+; void ff_tx_imdct_prerot_float(AVComplexFloat *z, const float *src,
+;                               const AVComplexFloat *exp, ptrdiff_t len4);
+; Folding and pre-rotation of an MDCT/iMDCT with a contiguous input into z in
+; natural order, see mdct_prerot()/imdct_prerot() in libavutil/tx_template.c.
+; len4 must be a multiple of mmsize/4.
+;-----------------------------------------------------------------------------
+
+; Folds the values of one iteration and stores their pre-rotation to z
+; %1 - forward input a, with src[k] in the real parts
+; %2 - forward input b
+; %3 - reversed input a, with src[-k] in the imaginary parts
+; %4 - reversed input b
+; %5 - 0 for tmp = rev*m7 - fwd, 1 for tmp = fwd*m7 - rev, with m7 holding
+;      the sign mask of the real and imaginary parts
+%macro MDCT_PREROT 5
+    movu            m0, %1
+    movu            m1, %2
+    movu            m2, %3
+    movu            m3, %4
+    REVERSE_CPLX    m2
+    REVERSE_CPLX    m3
+    shufps          m0, m1, q2020
+    shufps          m2, m3, q3131
+    shufps          m0, m0, q3120           ; { a[k],      b[k]      }
+    shufps          m2, m2, q3120           ; { a[-1 - k], b[-1 - k] }
+%if %5
+    xorps           m0, m7
+    subps           m0, m2                  ; tmp
+    %define %%tmp m0
+%else
+    xorps           m2, m7
+    subps           m2, m0                  ; tmp
+    %define %%tmp m2
+%endif
+
+    movu            m4, [expq]
+    movsldup        m5, %%tmp
+    movshdup     %%tmp, %%tmp
+    shufps          m6, m4, m4, q2301
+    mulps           m5, m4
+    mulps        %%tmp, m6
+    addsubps        m5, %%tmp               ; tmp*exp
+    shufps          m5, m5, q2301           ; swapped into z
+    movu          [zq], m5
+
+    add             zq, mmsize
+    add           expq, mmsize
+%endmacro
+
+%macro MDCT_PREROT_FN 0
+cglobal tx_mdct_prerot_float, 4, 6, 8, z, src, exp, len, src1, off
+    lea           offq, [lenq*8]            ; 2*len4 values
+    lea          src1q, [srcq + lenq*4 - mmsize]
+    lea           srcq, [srcq + lenq*4]
+    shr           lenq, 1
+    mova            m7, [mask_pmpmpmpm]
+
+.loop_lo: ; src[len4 + k] and src[len3 + k] against src[len4 - 1 - k] and src[len3 - 1 - k]
+    MDCT_PREROT [srcq], [srcq + offq], [src1q], [src1q + offq], 0
+    add           srcq, mmsize
+    sub          src1q, mmsize
+    sub           lenq, mmsize/8
+    jg .loop_lo
+
+    mov           lenq, offq
+    shr           lenq, 4
+    sub           srcq, offq
+    mova            m7, [mask_mpmpmpmp]
+
+.loop_hi: ; src[len4 + k] and src[k - len4] against src[5*len4 - 1 - k] and src[len3 - 1 - k]
+    MDCT_PREROT [srcq + offq], [srcq], [src1q + offq*2], [src1q + offq], 1
+    add           srcq, mmsize
+    sub          src1q, mmsize
+    sub           lenq, mmsize/8
+    jg .loop_hi
+
+    RET
+%endmacro
+
+%macro IMDCT_PREROT_FN 0
+cglobal tx_imdct_prerot_float, 4, 5, 4, z, src, exp, len, src1
+    lea          src1q, [srcq + lenq*8 - mmsize]
+
+.loop:
+    movu            m0, [srcq]
+    movu            m1, [src1q]
+    REVERSE_CPLX    m1
+    movsldup        m0, m0                  ; src[2*i]
+    movshdup        m1, m1                  ; src[2*len4 - 1 - 2*i]
+    movu            m2, [expq]
+    shufps          m3, m2, m2, q2301
+    mulps           m1, m2
+    mulps           m0, m3
+    addsubps        m1, m0
+    movu          [zq], m1
+
+    add             zq, mmsize
+    add           srcq, mmsize
+    add           expq, mmsize
+    sub          src1q, mmsize
+    sub           lenq, mmsize/8
+    jg .loop
+
+    RET
+%endmacro
+
+INIT_XMM sse3
+MDCT_PREROT_FN
+IMDCT_PREROT_FN
+INIT_YMM avx
+MDCT_PREROT_FN
+IMDCT_PREROT_FN
+
+;-----------------------------------------------------------------------------
+; void ff_tx_fft3_float(AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+; void ff_tx_fft5_float(AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+; void ff_tx_fft15_float(AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+; m 3, 5 or 15-point FFTs at once, see fft3()/fft5()/fft15() in
+; libavutil/tx_template.c. Input j of transform i is in[j*m + i], its output k
+; goes to out[k*m + i]. in is clobbered, m must be a multiple of mmsize/8.
+;-----------------------------------------------------------------------------
+
+; Does the 3-point FFTs of a register of each input, can be done in-place
+; %1-%3 - inputs
+; %4-%6 - outputs
+%macro FFT3_COLS 6
+    movu            m0, %1
+    movu            m1, %2
+    movu            m2, %3
+    addps           m3, m1, m2              ; s = in[1] + in[2]
+    subps           m1, m2                  ; d = in[1] - in[2]
+    addps           m2, m0, m3
+    mulps           m3, [s3_half]
+    shufps          m1, m1, q2301
+    subps           m0, m3                  ; t = in[0] - s/2
+    mulps           m1, [s3_mult]           ; u = swap(d)*{ cos(pi/6), -cos(pi/6) }
+    movu            %4, m2                  ; in[0] + s
+    addps           m2, m0, m1
+    subps           m0, m1
+    movu            %5, m2                  ; t + u
+    movu            %6, m0                  ; t - u
+%endmacro
+
+; Does the 5-point FFTs of a register of each input
+; %1-%5  - inputs
+; %6-%10 - outputs
+%macro FFT5_COLS 10
+    movu            m0, %1
+    movu            m1, %2
+    movu            m2, %3
+    movu            m3, %4
+    movu            m4, %5
+    addps           m5, m1, m4              ; s14 = in[1] + in[4]
+    subps           m1, m4                  ; d14 = in[1] - in[4]
+    addps           m4, m2, m3              ; s23 = in[2] + in[3]
+    subps           m2, m3                  ; d23 = in[2] - in[3]
+
+    addps           m3, m5, m4
+    addps           m3, m0
+    movu            %6, m3                  ; in[0] + s14 + s23
+
+    mulps           m3, m5, [s5_cos1]
+    mulps           m6, m4, [s5_cos2]
+    mulps           m4, [s5_cos1]
+    mulps           m5, [s5_cos2]
+    subps           m3, m6                  ; a = s14*cos(2pi/5) - s23*cos(pi/5)
+    subps           m4, m5                  ; c = s23*cos(2pi/5) - s14*cos(pi/5)
+    addps           m3, m0
+    addps           m4, m0
+
+    shufps          m1, m1, q2301
+    shufps          m2, m2, q2301
+    mulps           m5, m1, [s5_sin1]
+    mulps           m6, m2, [s5_sin2]
+    mulps           m2, [s5_sin1]
+    mulps           m1, [s5_sin2]
+    addps           m5, m6                  ; b = swap(d14)*sin(2pi/5) + swap(d23)*sin(pi/5)
+    subps           m2, m1                  ; e = swap(d23)*sin(2pi/5) - swap(d14)*sin(pi/5)
+
+    addps           m0, m3, m5
+    subps           m3, m5
+    addps           m1, m4, m2
+    subps           m4, m2
+    movu            %7, m0                  ; in[0] + a + b
+    movu            %8, m4                  ; in[0] + c - e
+    movu            %9, m1                  ; in[0] + c + e
+    movu           %10, m3                  ; in[0] + a - b
+%endmacro
+
+%macro FFT_COLS_FN 0
+cglobal tx_fft3_float, 3, 4, 4, out, in, stride, cnt
+    mov           cntq, strideq
+    shl        strideq, 3
+
+.loop:
+    FFT3_COLS [inq], [inq + strideq], [inq + strideq*2], \
+              [outq], [outq + strideq], [outq + strideq*2]
+    add           outq, mmsize
+    add            inq, mmsize
+    sub           cntq, mmsize/8
+    jg .loop
+
+    RET
+
+cglobal tx_fft5_float, 3, 5, 7, out, in, stride, stride3, cnt
+    mov           cntq, strideq
+    shl        strideq, 3
+    lea       stride3q, [strideq*3]
+
+.loop:
+    FFT5_COLS [inq],  [inq  + strideq], [inq  + strideq*2], [inq  + stride3q], [inq  + strideq*4], \
+              [outq], [outq + strideq], [outq + strideq*2], [outq + stride3q], [outq + strideq*4]
+    add           outq, mmsize
+    add            inq, mmsize
+    sub           cntq, mmsize/8
+    jg .loop
+
+    RET
+
+%if ARCH_X86_64
+cglobal tx_fft15_float, 3, 9, 7, out, in, stride, stride3, cnt, in0, in6, out5, out10
+    mov           cntq, strideq
+    shl        strideq, 3
+    lea       stride3q, [strideq*3]
+
+.loop:
+    ; 3-point FFTs of the inputs 3*i + j, with the outputs going in their place
+    mov           in0q, inq
+%rep 5
+    FFT3_COLS [in0q], [in0q + strideq], [in0q + strideq*2], \
+              [in0q], [in0q + strideq], [in0q + strideq*2]
+    add           in0q, stride3q
+%endrep
+
+    ; 5-point FFTs of the outputs j of the 3-point FFTs, stored as with fft5_m1(),
+    ; fft5_m2() and fft5_m3()
+    mov           in0q, inq
+    lea           in6q, [inq   + stride3q*2]
+    lea          out5q, [outq  + strideq*4]
+    add          out5q, strideq
+    lea         out10q, [out5q + strideq*4]
+    add         out10q, strideq
+
+    FFT5_COLS [in0q], [in0q + stride3q], [in6q], [in6q + stride3q], [in6q + stride3q*2], \
+              [outq], [out5q + strideq], [out10q + strideq*2], [outq + stride3q], [out5q + strideq*4]
+    add           in0q, strideq
+    add           in6q, strideq
+    FFT5_COLS [in0q], [in0q + stride3q], [in6q], [in6q + stride3q], [in6q + stride3q*2], \
+              [out10q], [outq + strideq], [out5q + strideq*2], [out10q + stride3q], [outq + strideq*4]
+    add           in0q, strideq
+    add           in6q, strideq
+    FFT5_COLS [in0q], [in0q + stride3q], [in6q], [in6q + stride3q], [in6q + stride3q*2], \
+              [out5q], [out10q + strideq], [outq + strideq*2], [out5q + stride3q], [out10q + strideq*4]
+
+    add           outq, mmsize
+    add            inq, mmsize
+    sub           cntq, mmsize/8
+    jg .loop
+
+    RET
+%endif
+%endmacro
+
+INIT_XMM sse
+FFT_COLS_FN
+INIT_YMM avx
+FFT_COLS_FN
+%if HAVE_AVX512_EXTERNAL
+INIT_ZMM avx512
+FFT_COLS_FN
+%endif
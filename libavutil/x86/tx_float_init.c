@@ -34,73 +34,185 @@ void ff_fft32_float_fma3    (AVTXContext *s, void *out, void *in, ptrdiff_t stri
 void ff_split_radix_fft_float_avx (AVTXContext *s, void *out, void *in, ptrdiff_t stride);
 void ff_split_radix_fft_float_avx2(AVTXContext *s, void *out, void *in, ptrdiff_t stride);
 
+void ff_tx_rdft_pairs_float_sse3(AVComplexFloat *z, const AVComplexFloat *tab, ptrdiff_t len);
+void ff_tx_rdft_pairs_float_avx (AVComplexFloat *z, const AVComplexFloat *tab, ptrdiff_t len);
+
+void ff_tx_mdct_postrot_float_sse3 (AVComplexFloat *z, const AVComplexFloat *exp, ptrdiff_t len8);
+void ff_tx_mdct_postrot_float_avx  (AVComplexFloat *z, const AVComplexFloat *exp, ptrdiff_t len8);
+void ff_tx_imdct_postrot_float_sse3(AVComplexFloat *z, const AVComplexFloat *exp, ptrdiff_t len8);
+void ff_tx_imdct_postrot_float_avx (AVComplexFloat *z, const AVComplexFloat *exp, ptrdiff_t len8);
+
+void ff_tx_mdct_prerot_float_sse3 (AVComplexFloat *z, const float *src, const AVComplexFloat *exp, ptrdiff_t len4);
+void ff_tx_mdct_prerot_float_avx  (AVComplexFloat *z, const float *src, const AVComplexFloat *exp, ptrdiff_t len4);
+void ff_tx_imdct_prerot_float_sse3(AVComplexFloat *z, const float *src, const AVComplexFloat *exp, ptrdiff_t len4);
+void ff_tx_imdct_prerot_float_avx (AVComplexFloat *z, const float *src, const AVComplexFloat *exp, ptrdiff_t len4);
+
+void ff_tx_fft3_float_sse     (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft3_float_avx     (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft3_float_avx512  (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft5_float_sse     (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft5_float_avx     (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft5_float_avx512  (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft15_float_sse    (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft15_float_avx    (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+void ff_tx_fft15_float_avx512 (AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m);
+
+/* Same as rdft_r2c()/rdft_c2r() in libavutil/tx_template.c */
+#define DECL_RDFT(isa)                                                         \
+static void rdft_r2c_float_ ## isa(AVTXContext *s, void *out, void *in,        \
+                                   ptrdiff_t stride)                           \
+{                                                                              \
+    AVComplexFloat *z = out;                                                   \
+    const AVComplexFloat *tab = s->exptab;                                     \
+    const int len = s->n*s->m;                                                 \
+                                                                               \
+    s->top_tx(s, z, in, sizeof(*z));                                           \
+                                                                               \
+    z[len].re = tab[4].re*(z[0].re - z[0].im);                                 \
+    z[0].re   = tab[4].re*(z[0].re + z[0].im);                                 \
+    z[len].im = z[0].im = 0;                                                   \
+                                                                               \
+    ff_tx_rdft_pairs_float_ ## isa(z, tab, len);                               \
+}                                                                              \
+                                                                               \
+static void rdft_c2r_float_ ## isa(AVTXContext *s, void *out, void *in,        \
+                                   ptrdiff_t stride)                           \
+{                                                                              \
+    AVComplexFloat *z = in;                                                    \
+    const AVComplexFloat *tab = s->exptab;                                     \
+    const int len = s->n*s->m;                                                 \
+    const float re = z[0].re;                                                  \
+                                                                               \
+    z[0].re = tab[4].re*(re + z[len].re);                                      \
+    z[0].im = tab[4].re*(re - z[len].re);                                      \
+                                                                               \
+    ff_tx_rdft_pairs_float_ ## isa(z, tab, len);                               \
+                                                                               \
+    s->top_tx(s, out, z, sizeof(*z));                                          \
+}
+
+DECL_RDFT(sse3)
+DECL_RDFT(avx)
+
 av_cold void ff_tx_init_float_x86(AVTXContext *s, av_tx_fn *tx)
 {
     int cpu_flags = av_get_cpu_flags();
     int gen_revtab = 0, basis, revtab_interleave;
+    const int is_mdct = ff_tx_type_is_mdct(s->type);
+    const int is_real = s->type == AV_TX_FLOAT_RDFT || s->type == AV_TX_FLOAT_DCT;
+    /* real transforms are done through an FFT in top_tx */
+    av_tx_fn *fft = is_real ? &s->top_tx : tx;
+    av_tx_fn ptwo = NULL;
+    void (*postrot)(AVComplexFloat *z, const AVComplexFloat *exp, ptrdiff_t len8) = NULL;
+    void (*prerot)(AVComplexFloat *z, const float *src,
+                   const AVComplexFloat *exp, ptrdiff_t len4) = NULL;
+    void (*fft_n)(AVComplexFloat *out, AVComplexFloat *in, ptrdiff_t m) = NULL;
 
     if (s->flags & AV_TX_UNALIGNED)
         return;
 
-    if (ff_tx_type_is_mdct(s->type))
-        return;
+    if (s->type == AV_TX_FLOAT_RDFT) {
+        const int len = s->n*s->m;
+
+        if (EXTERNAL_SSE3(cpu_flags) && !(len & 3))
+            *tx = s->inv ? rdft_c2r_float_sse3 : rdft_r2c_float_sse3;
+        if (EXTERNAL_AVX_FAST(cpu_flags) && !(len & 7))
+            *tx = s->inv ? rdft_c2r_float_avx  : rdft_r2c_float_avx;
+    }
 
 #define TXFN(fn, gentab, sr_basis, interleave) \
     do {                                       \
-        *tx = fn;                              \
+        ptwo = fn;                             \
         gen_revtab = gentab;                   \
         basis = sr_basis;                      \
         revtab_interleave = interleave;        \
     } while (0)
 
-    if (s->n == 1) {
-        if (EXTERNAL_SSE2(cpu_flags)) {
-            if (s->m == 4 && s->inv)
-                TXFN(ff_fft4_inv_float_sse2, 0, 0, 0);
-            else if (s->m == 4)
-                TXFN(ff_fft4_fwd_float_sse2, 0, 0, 0);
-        }
-
-        if (EXTERNAL_SSE3(cpu_flags)) {
-            if (s->m == 2)
-                TXFN(ff_fft2_float_sse3, 0, 0, 0);
-            else if (s->m == 8)
-                TXFN(ff_fft8_float_sse3, 1, 8, 0);
-        }
-
-        if (EXTERNAL_AVX_FAST(cpu_flags)) {
-            if (s->m == 8)
-                TXFN(ff_fft8_float_avx, 1, 8, 0);
-            else if (s->m == 16)
-                TXFN(ff_fft16_float_avx, 1, 8, 2);
+    /* Power-of-two FFT, also used for compound transforms and MDCTs */
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        if (s->m == 4 && s->inv)
+            TXFN(ff_fft4_inv_float_sse2, 0, 0, 0);
+        else if (s->m == 4)
+            TXFN(ff_fft4_fwd_float_sse2, 0, 0, 0);
+    }
+
+    if (EXTERNAL_SSE3(cpu_flags)) {
+        if (s->m == 2)
+            TXFN(ff_fft2_float_sse3, 0, 0, 0);
+        else if (s->m == 8)
+            TXFN(ff_fft8_float_sse3, 1, 8, 0);
+    }
+
+    if (EXTERNAL_AVX_FAST(cpu_flags)) {
+        if (s->m == 8)
+            TXFN(ff_fft8_float_avx, 1, 8, 0);
+        else if (s->m == 16)
+            TXFN(ff_fft16_float_avx, 1, 8, 2);
 #if ARCH_X86_64
-            else if (s->m == 32)
-                TXFN(ff_fft32_float_avx, 1, 8, 2);
-            else if (s->m >= 64 && s->m <= 131072 && !(s->flags & AV_TX_INPLACE))
-                TXFN(ff_split_radix_fft_float_avx, 1, 8, 2);
+        else if (s->m == 32)
+            TXFN(ff_fft32_float_avx, 1, 8, 2);
+        else if (s->m >= 64 && s->m <= 131072 && !(s->flags & AV_TX_INPLACE))
+            TXFN(ff_split_radix_fft_float_avx, 1, 8, 2);
 #endif
-        }
+    }
 
-        if (EXTERNAL_FMA3_FAST(cpu_flags)) {
-            if (s->m == 16)
-                TXFN(ff_fft16_float_fma3, 1, 8, 2);
+    if (EXTERNAL_FMA3_FAST(cpu_flags)) {
+        if (s->m == 16)
+            TXFN(ff_fft16_float_fma3, 1, 8, 2);
 #if ARCH_X86_64
-            else if (s->m == 32)
-                TXFN(ff_fft32_float_fma3, 1, 8, 2);
+        else if (s->m == 32)
+            TXFN(ff_fft32_float_fma3, 1, 8, 2);
 #endif
-        }
+    }
 
 #if ARCH_X86_64
-        if (EXTERNAL_AVX2_FAST(cpu_flags)) {
-            if (s->m >= 64 && s->m <= 131072 && !(s->flags & AV_TX_INPLACE))
-                TXFN(ff_split_radix_fft_float_avx2, 1, 8, 2);
-        }
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        if (s->m >= 64 && s->m <= 131072 && !(s->flags & AV_TX_INPLACE))
+            TXFN(ff_split_radix_fft_float_avx2, 1, 8, 2);
+    }
 #endif
+
+    if (!ptwo)
+        return;
+
+    if (EXTERNAL_SSE3(cpu_flags)) {
+        postrot = s->inv ? ff_tx_imdct_postrot_float_sse3 : ff_tx_mdct_postrot_float_sse3;
+        prerot  = s->inv ? ff_tx_imdct_prerot_float_sse3  : ff_tx_mdct_prerot_float_sse3;
     }
+    if (EXTERNAL_AVX_FAST(cpu_flags)) {
+        postrot = s->inv ? ff_tx_imdct_postrot_float_avx  : ff_tx_mdct_postrot_float_avx;
+        prerot  = s->inv ? ff_tx_imdct_prerot_float_avx   : ff_tx_mdct_prerot_float_avx;
+    }
+
+#define FFT_N(isa)                                                             \
+    do {                                                                       \
+        if (s->n == 3)                                                         \
+            fft_n = ff_tx_fft3_float_ ## isa;                                  \
+        else if (s->n == 5)                                                    \
+            fft_n = ff_tx_fft5_float_ ## isa;                                  \
+        else if (s->n == 15 && ARCH_X86_64)                                    \
+            fft_n = ff_tx_fft15_float_ ## isa;                                 \
+    } while (0)
+
+    /* Non-power-of-two part of compound transforms, all columns at once */
+    if (EXTERNAL_SSE(cpu_flags))
+        FFT_N(sse);
+    if (EXTERNAL_AVX_FAST(cpu_flags) && !(s->m & 3))
+        FFT_N(avx);
+    if (EXTERNAL_AVX512(cpu_flags) && !(s->m & 7))
+        FFT_N(avx512);
+
+    /* Splitting off the FFT is only worth it for the ones using a revtab */
+    if (s->n == 1 && !is_mdct)
+        *fft = ptwo;
+    else if (!gen_revtab || ff_tx_init_ptwo_sub_float(s, fft, ptwo, postrot,
+                                                      prerot, fft_n) < 0)
+        return;
 
     if (gen_revtab)
         ff_tx_gen_split_radix_parity_revtab(s->revtab, s->m, s->inv, basis,
                                             revtab_interleave);
 
 #undef TXFN
+#undef FFT_N
 }
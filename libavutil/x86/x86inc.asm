@@ -830,6 +830,8 @@ BRANCH_INSTR jz, je, jnz, jne, jl, jle, jnl, jnle, jg, jge, jng, jnge, ja, jae,
 %assign cpuflags_sse4     (1<<10)| cpuflags_ssse3
 %assign cpuflags_sse42    (1<<11)| cpuflags_sse4
 %assign cpuflags_aesni    (1<<12)| cpuflags_sse42
+%assign cpuflags_clmul    (1<<25)| cpuflags_sse42
+%assign cpuflags_shani    (1<<26)| cpuflags_sse42
 %assign cpuflags_avx      (1<<13)| cpuflags_sse42
 %assign cpuflags_xop      (1<<14)| cpuflags_avx
 %assign cpuflags_fma4     (1<<15)| cpuflags_avx
@@ -235,14 +235,22 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
+/*
+ * dst points to the first line of the destination band
+ * [dstSliceY, dstSliceY + dstSliceH) when only a part of the destination
+ * image is requested, and to the whole image otherwise.
+ */
 static int swscale(SwsContext *c, const uint8_t *src[],
                    int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+                   int srcSliceH, uint8_t *dst[], int dstStride[],
+                   int dstSliceY, int dstSliceH)
 {
+    const int scale_dst = dstSliceY > 0 || dstSliceH < c->dstH;
+
     /* load a few things into local vars to make the code more readable?
      * and faster */
     const int dstW                   = c->dstW;
-    const int dstH                   = c->dstH;
+    int dstH                         = c->dstH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -331,10 +339,15 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         }
     }
 
-    /* Note the user might start scaling the picture in the middle so this
-     * will not get executed. This is not really intended but works
-     * currently, so people might do it. */
-    if (srcSliceY == 0) {
+    if (scale_dst) {
+        dstY         = dstSliceY;
+        dstH         = dstY + dstSliceH;
+        lastInLumBuf = -1;
+        lastInChrBuf = -1;
+    } else if (srcSliceY == 0) {
+        /* Note the user might start scaling the picture in the middle so this
+         * will not get executed. This is not really intended but works
+         * currently, so people might do it. */
         dstY         = 0;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
@@ -352,8 +365,8 @@ static int swscale(SwsContext *c, const uint8_t *src[],
             srcSliceY, srcSliceH, chrSrcSliceY, chrSrcSliceH, 1);
 
     ff_init_slice_from_src(vout_slice, (uint8_t**)dst, dstStride, c->dstW,
-            dstY, dstH, dstY >> c->chrDstVSubSample,
-            AV_CEIL_RSHIFT(dstH, c->chrDstVSubSample), 0);
+            dstY, dstSliceH, dstY >> c->chrDstVSubSample,
+            AV_CEIL_RSHIFT(dstSliceH, c->chrDstVSubSample), scale_dst);
     if (srcSliceY == 0) {
         hout_slice->plane[0].sliceY = lastInLumBuf + 1;
         hout_slice->plane[1].sliceY = lastInChrBuf + 1;
@@ -477,7 +490,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
             c->chrDither8 = ff_dither_8x8_128[chrDstY & 7];
             c->lumDither8 = ff_dither_8x8_128[dstY    & 7];
         }
-        if (dstY >= dstH - 2) {
+        if (dstY >= c->dstH - 2) {
             /* hmm looks like we can't use MMX here without overwriting
              * this array's tail */
             ff_sws_init_output_funcs(c, &yuv2plane1, &yuv2planeX, &yuv2nv12cX,
@@ -493,21 +506,22 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         }
     }
     if (isPlanar(dstFormat) && isALPHA(dstFormat) && !needAlpha) {
+        int offset = lastDstY - (scale_dst ? dstSliceY : 0);
         int length = dstW;
         int height = dstY - lastDstY;
 
         if (is16BPS(dstFormat) || isNBPS(dstFormat)) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
-            fillPlane16(dst[3], dstStride[3], length, height, lastDstY,
+            fillPlane16(dst[3], dstStride[3], length, height, offset,
                     1, desc->comp[3].depth,
                     isBE(dstFormat));
         } else if (is32BPS(dstFormat)) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
-            fillPlane32(dst[3], dstStride[3], length, height, lastDstY,
+            fillPlane32(dst[3], dstStride[3], length, height, offset,
                     1, desc->comp[3].depth,
                     isBE(dstFormat), desc->flags & AV_PIX_FMT_FLAG_FLOAT);
         } else
-            fillPlane(dst[3], dstStride[3], length, height, lastDstY, 255);
+            fillPlane(dst[3], dstStride[3], length, height, offset, 255);
     }
 
 #if HAVE_MMXEXT_INLINE
@@ -524,6 +538,14 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale_src_slice(SwsContext *c, const uint8_t *src[],
+                             int srcStride[], int srcSliceY,
+                             int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return swscale(c, src, srcStride, srcSliceY, srcSliceH,
+                   dst, dstStride, 0, c->dstH);
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -594,7 +616,7 @@ SwsFunc ff_getSwsFunc(SwsContext *c)
     if (ARCH_ARM)
         ff_sws_init_swscale_arm(c);
 
-    return swscale;
+    return swscale_src_slice;
 }
 
 static void reset_ptr(const uint8_t *src[], enum AVPixelFormat format)
@@ -738,16 +760,38 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
     }
 }
 
+unsigned int sws_dst_slice_alignment(const struct SwsContext *c)
+{
+    /* Error diffusion carries state from one output line to the next, and
+     * cascaded contexts and the alpha blend away converter need the whole
+     * picture at once. */
+    if (c->cascaded_context[0] || c->dither == SWS_DITHER_ED ||
+        c->swscale == ff_sws_alphablendaway)
+        return FFMAX(c->dstH, 1);
+
+    /* unscaled converters are fed the source lines matching the band */
+    if (c->swscale != swscale_src_slice)
+        return FFMAX3(1 << c->chrSrcVSubSample, 1 << c->chrDstVSubSample,
+                      isBayer(c->srcFormat) ? 2 : 1);
+
+    return 1 << c->chrDstVSubSample;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
+ *
+ * When dstSliceY/dstSliceH do not cover the whole destination, the whole
+ * source image must be passed and only the given band of dst is written.
  */
-int attribute_align_arg sws_scale(struct SwsContext *c,
-                                  const uint8_t * const srcSlice[],
-                                  const int srcStride[], int srcSliceY,
-                                  int srcSliceH, uint8_t *const dst[],
-                                  const int dstStride[])
+static int scale_internal(SwsContext *c,
+                          const uint8_t * const srcSlice[],
+                          const int srcStride[], int srcSliceY,
+                          int srcSliceH, uint8_t *const dst[],
+                          const int dstStride[],
+                          int dstSliceY, int dstSliceH)
 {
+    const int scale_dst = dstSliceY > 0 || dstSliceH < c->dstH;
     int i, ret;
     const uint8_t *src2[4];
     uint8_t *dst2[4];
@@ -827,12 +871,16 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         return 0;
     }
 
-    if (c->sliceDir == 0 && srcSliceY != 0 && srcSliceY + srcSliceH != c->srcH) {
-        av_log(c, AV_LOG_ERROR, "Slices start in the middle!\n");
-        return 0;
-    }
-    if (c->sliceDir == 0) {
-        if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
+    if (scale_dst) {
+        c->sliceDir = 1;
+    } else {
+        if (c->sliceDir == 0 && srcSliceY != 0 && srcSliceY + srcSliceH != c->srcH) {
+            av_log(c, AV_LOG_ERROR, "Slices start in the middle!\n");
+            return 0;
+        }
+        if (c->sliceDir == 0) {
+            if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
+        }
     }
 
     if (usePal(c->srcFormat)) {
@@ -967,14 +1015,41 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+
+    if (!scale_dst) {
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    } else if (c->swscale == swscale_src_slice) {
+        uint8_t *dst_band[4];
+
+        for (i = 0; i < 4; i++) {
+            int vsub = (i == 1 || i == 2) ? c->chrDstVSubSample : 0;
+            dst_band[i] = dst2[i] ? dst2[i] + (dstSliceY >> vsub) * dstStride2[i] : NULL;
+        }
+        ret = swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH,
+                      dst_band, dstStride2, dstSliceY, dstSliceH);
+    } else {
+        /* unscaled conversion, the source band is the destination band */
+        for (i = 0; i < 4 && src2[i]; i++) {
+            int vsub = (i == 1 || i == 2) ? c->chrSrcVSubSample : 0;
+            if (i == 1 && usePal(c->srcFormat))
+                continue;
+            src2[i] += (dstSliceY >> vsub) * srcStride2[i];
+        }
+        ret = c->swscale(c, src2, srcStride2, dstSliceY, dstSliceH, dst2, dstStride2);
+    }
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
-        int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
-        uint16_t *dst16 = (uint16_t*)(dst2[0] + (dstY - ret) * dstStride2[0]);
-        av_assert0(dstY >= ret);
-        av_assert0(ret >= 0);
-        av_assert0(c->dstH >= dstY);
+        uint16_t *dst16;
+
+        if (scale_dst) {
+            dst16 = (uint16_t*)(dst2[0] + dstSliceY * dstStride2[0]);
+        } else {
+            int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
+            av_assert0(dstY >= ret);
+            av_assert0(ret >= 0);
+            av_assert0(c->dstH >= dstY);
+            dst16 = (uint16_t*)(dst2[0] + (dstY - ret) * dstStride2[0]);
+        }
 
         /* replace on the same data */
         rgb48Toxyz12(c, dst16, dst16, dstStride2[0]/2, ret);
@@ -983,3 +1058,78 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     av_free(rgb0_tmp);
     return ret;
 }
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext      *c = jobnr ? parent->slice_ctx[jobnr - 1] : parent;
+    const unsigned int align = sws_dst_slice_alignment(c);
+    const int slice_start = (c->dstH *  jobnr     ) / nb_jobs / align * align;
+    const int slice_end   = jobnr == nb_jobs - 1 ? c->dstH :
+                            (c->dstH * (jobnr + 1)) / nb_jobs / align * align;
+
+    parent->slice_err[jobnr] = slice_end == slice_start ? 0 :
+        scale_internal(c, parent->frame_src, parent->frame_src_stride,
+                       0, c->srcH, parent->frame_dst, parent->frame_dst_stride,
+                       slice_start, slice_end - slice_start);
+}
+
+static int scale_threaded(SwsContext *c, const uint8_t * const src[],
+                          const int srcStride[], uint8_t *const dst[],
+                          const int dstStride[])
+{
+    int i, ret = 0;
+
+    c->frame_src        = src;
+    c->frame_src_stride = srcStride;
+    c->frame_dst        = dst;
+    c->frame_dst_stride = dstStride;
+
+    avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx + 1, 0);
+
+    for (i = 0; i <= c->nb_slice_ctx; i++) {
+        if (c->slice_err[i] < 0)
+            return c->slice_err[i];
+        ret += c->slice_err[i];
+    }
+    return ret;
+}
+
+int attribute_align_arg sws_scale(struct SwsContext *c,
+                                  const uint8_t * const srcSlice[],
+                                  const int srcStride[], int srcSliceY,
+                                  int srcSliceH, uint8_t *const dst[],
+                                  const int dstStride[])
+{
+    /* only whole frames are split between the threads */
+    if (c->slicethread && srcSliceY == 0 && srcSliceH == c->srcH)
+        return scale_threaded(c, srcSlice, srcStride, dst, dstStride);
+
+    return scale_internal(c, srcSlice, srcStride, srcSliceY, srcSliceH,
+                          dst, dstStride, 0, c->dstH);
+}
+
+int attribute_align_arg sws_scale_dst_slice(struct SwsContext *c,
+                                            const uint8_t * const src[],
+                                            const int srcStride[],
+                                            uint8_t *const dst[],
+                                            const int dstStride[],
+                                            int dstSliceY, int dstSliceH)
+{
+    unsigned int align = sws_dst_slice_alignment(c);
+
+    if (dstSliceY < 0 || dstSliceH < 0 || dstSliceY % align ||
+        (dstSliceH % align && dstSliceY + dstSliceH != c->dstH) ||
+        dstSliceY + dstSliceH > c->dstH) {
+        av_log(c, AV_LOG_ERROR, "Destination slice parameters %d, %d are invalid\n",
+               dstSliceY, dstSliceH);
+        return AVERROR(EINVAL);
+    }
+
+    if (!dstSliceH)
+        return 0;
+
+    return scale_internal(c, src, srcStride, 0, c->srcH,
+                          dst, dstStride, dstSliceY, dstSliceH);
+}
@@ -218,6 +218,43 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
               const int srcStride[], int srcSliceY, int srcSliceH,
               uint8_t *const dst[], const int dstStride[]);
 
+/**
+ * Scale the whole source image and write only the horizontal band of the
+ * destination image starting at row dstSliceY and dstSliceH rows high.
+ *
+ * Unlike sws_scale(), the result does not depend on previous calls, so
+ * several contexts initialized with identical parameters can each produce
+ * a different band of the same destination image concurrently.
+ * The output is identical to what sws_scale() writes to the same rows.
+ *
+ * @param c          the scaling context
+ * @param src        the array containing the pointers to the planes of
+ *                   the whole source image
+ * @param srcStride  the array containing the strides for each plane of
+ *                   the source image
+ * @param dst        the array containing the pointers to the planes of
+ *                   the whole destination image
+ * @param dstStride  the array containing the strides for each plane of
+ *                   the destination image
+ * @param dstSliceY  first row of the band, must be a multiple of
+ *                   sws_dst_slice_alignment()
+ * @param dstSliceH  height of the band, must be a multiple of
+ *                   sws_dst_slice_alignment() unless the band ends at the
+ *                   bottom of the image
+ * @return           the height of the output band or a negative error code
+ */
+int sws_scale_dst_slice(struct SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[], int dstSliceY, int dstSliceH);
+
+/**
+ * @return the alignment required for the destination bands passed to
+ *         sws_scale_dst_slice(). A value greater than or equal to the
+ *         destination height means that the context can only produce
+ *         whole images.
+ */
+unsigned int sws_dst_slice_alignment(const struct SwsContext *c);
+
 /**
  * @param dstRange flag indicating the while-black range of the output (1=jpeg / 0=mpeg)
  * @param srcRange flag indicating the while-black range of the input (1=jpeg / 0=mpeg)
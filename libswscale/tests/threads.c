@@ -0,0 +1,154 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that scaling whole frames with the threads option gives the same
+ * output as the single threaded scaler.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+static const struct {
+    enum AVPixelFormat src_fmt;
+    int src_w, src_h;
+    enum AVPixelFormat dst_fmt;
+    int dst_w, dst_h;
+    int flags;
+    int colorspace;         ///< set BT.709 full range output after init
+} tests[] = {
+    { AV_PIX_FMT_YUV420P,     352, 288, AV_PIX_FMT_YUV420P,     176, 144, SWS_BICUBIC,  0 },
+    { AV_PIX_FMT_YUV420P,     352, 288, AV_PIX_FMT_YUV420P,     640, 480, SWS_LANCZOS,  0 },
+    { AV_PIX_FMT_YUV420P,     352, 288, AV_PIX_FMT_RGB24,       352, 288, SWS_BILINEAR, 0 },
+    { AV_PIX_FMT_YUV420P,     352, 288, AV_PIX_FMT_BGRA,        320, 240, SWS_BICUBIC,  1 },
+    { AV_PIX_FMT_RGB24,       320, 240, AV_PIX_FMT_YUV420P,     352, 288, SWS_BICUBIC,  0 },
+    { AV_PIX_FMT_RGB24,       320, 240, AV_PIX_FMT_YUV444P,     320, 240, SWS_POINT,    1 },
+    { AV_PIX_FMT_YUV422P10LE, 352, 288, AV_PIX_FMT_YUV420P,     352, 288, SWS_BICUBIC,  0 },
+    { AV_PIX_FMT_YUV444P,     352, 288, AV_PIX_FMT_GRAY16LE,    176, 144, SWS_AREA,     0 },
+};
+
+static struct SwsContext *alloc_context(int i, int threads)
+{
+    struct SwsContext *sws = sws_alloc_context();
+    int ret;
+
+    if (!sws)
+        return NULL;
+
+    av_opt_set_int(sws, "srcw",       tests[i].src_w,   0);
+    av_opt_set_int(sws, "srch",       tests[i].src_h,   0);
+    av_opt_set_int(sws, "src_format", tests[i].src_fmt, 0);
+    av_opt_set_int(sws, "dstw",       tests[i].dst_w,   0);
+    av_opt_set_int(sws, "dsth",       tests[i].dst_h,   0);
+    av_opt_set_int(sws, "dst_format", tests[i].dst_fmt, 0);
+    av_opt_set_int(sws, "sws_flags",  tests[i].flags | SWS_ACCURATE_RND | SWS_BITEXACT, 0);
+    av_opt_set_int(sws, "threads",    threads,          0);
+
+    ret = sws_init_context(sws, NULL, NULL);
+    if (ret >= 0 && tests[i].colorspace) {
+        int *inv_table, *table, src_range, dst_range, brightness, contrast, saturation;
+
+        sws_getColorspaceDetails(sws, &inv_table, &src_range, &table, &dst_range,
+                                 &brightness, &contrast, &saturation);
+        ret = sws_setColorspaceDetails(sws, sws_getCoefficients(SWS_CS_ITU709), src_range,
+                                       sws_getCoefficients(SWS_CS_ITU709), 1,
+                                       brightness, contrast, saturation);
+    }
+    if (ret < 0)
+        sws_freeContext(sws);
+    return ret < 0 ? NULL : sws;
+}
+
+static int run_test(int i, AVLFG *rnd)
+{
+    uint8_t *src[4], *dst[2][4] = { { NULL } };
+    int src_stride[4], dst_stride[4];
+    struct SwsContext *sws[2] = { NULL };
+    int j, size, ret;
+
+    ret = av_image_alloc(src, src_stride, tests[i].src_w, tests[i].src_h,
+                         tests[i].src_fmt, 16);
+    if (ret < 0)
+        return ret;
+    for (j = 0; j < ret; j++)
+        src[0][j] = av_lfg_get(rnd);
+
+    for (j = 0; j < 2; j++) {
+        size = av_image_alloc(dst[j], dst_stride, tests[i].dst_w, tests[i].dst_h,
+                              tests[i].dst_fmt, 16);
+        if (size < 0) {
+            ret = size;
+            goto end;
+        }
+        memset(dst[j][0], 0, size);
+
+        sws[j] = alloc_context(i, j ? 4 : 1);
+        if (!sws[j]) {
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+
+        ret = sws_scale(sws[j], (const uint8_t * const *)src, src_stride,
+                        0, tests[i].src_h, dst[j], dst_stride);
+        if (ret != tests[i].dst_h) {
+            fprintf(stderr, "sws_scale() returned %d\n", ret);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+    }
+
+    printf("%s %dx%d -> %s %dx%d: %s\n",
+           av_get_pix_fmt_name(tests[i].src_fmt), tests[i].src_w, tests[i].src_h,
+           av_get_pix_fmt_name(tests[i].dst_fmt), tests[i].dst_w, tests[i].dst_h,
+           memcmp(dst[0][0], dst[1][0], size) ? "MISMATCH" : "OK");
+    ret = 0;
+
+end:
+    av_freep(&src[0]);
+    for (j = 0; j < 2; j++) {
+        av_freep(&dst[j][0]);
+        sws_freeContext(sws[j]);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG rnd;
+    int i, ret;
+
+    av_lfg_init(&rnd, 0xdeadbeef);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        ret = run_test(i, &rnd);
+        if (ret < 0) {
+            fprintf(stderr, "test %d failed\n", i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
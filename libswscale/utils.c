@@ -869,6 +869,15 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        int ret = sws_setColorspaceDetails(c->slice_ctx[i], inv_table,
+                                           srcRange, table, dstRange,
+                                           brightness, contrast, saturation);
+        if (ret < 0)
+            return ret;
+    }
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -1169,8 +1178,8 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int sws_init_single_context(SwsContext *c, SwsFilter *srcFilter,
+                                           SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1882,6 +1891,74 @@ fail: // FIXME replace things by appropriate error codes
     return ret;
 }
 
+static av_cold int context_init_threaded(SwsContext *c, const SwsContext *opts,
+                                         SwsFilter *src_filter, SwsFilter *dst_filter)
+{
+    int i, ret;
+    int nb_threads = c->nb_threads ? c->nb_threads : av_cpu_count();
+
+    /* each thread needs at least one band of the required alignment */
+    nb_threads = FFMIN(nb_threads, c->dstH / sws_dst_slice_alignment(c));
+    if (nb_threads <= 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                    NULL, nb_threads);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    else if (ret < 0)
+        return ret;
+
+    c->slice_ctx = av_calloc(nb_threads - 1, sizeof(*c->slice_ctx));
+    c->slice_err = av_calloc(nb_threads, sizeof(*c->slice_err));
+    if (!c->slice_ctx || !c->slice_err)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads - 1; i++) {
+        c->slice_ctx[i] = sws_alloc_context();
+        if (!c->slice_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+
+        ret = av_opt_copy(c->slice_ctx[i], opts);
+        if (ret < 0)
+            return ret;
+        c->slice_ctx[i]->nb_threads = 1;
+
+        ret = sws_init_single_context(c->slice_ctx[i], src_filter, dst_filter);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    SwsContext *opts = NULL;
+    int ret;
+
+    /* initialization changes some of the options (e.g. the pixel formats),
+     * so keep a copy of them as set by the user for the slice contexts */
+    if (c->nb_threads != 1) {
+        opts = sws_alloc_context();
+        if (!opts)
+            return AVERROR(ENOMEM);
+        ret = av_opt_copy(opts, c);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = sws_init_single_context(c, srcFilter, dstFilter);
+    if (ret >= 0 && opts)
+        ret = context_init_threaded(c, opts, srcFilter, dstFilter);
+
+end:
+    sws_freeContext(opts);
+    return ret;
+}
+
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
                                int dstW, int dstH, enum AVPixelFormat dstFormat,
                                int flags, const double *param)
@@ -2244,6 +2321,12 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    av_freep(&c->slice_err);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
@@ -32,6 +32,7 @@ struct sender_data {
     int id;
     pthread_t tid;
     int workload;
+    int spsc;
     AVThreadMessageQueue *queue;
 };
 
@@ -40,6 +41,7 @@ struct receiver_data {
     pthread_t tid;
     int workload;
     int id;
+    int spsc;
     AVThreadMessageQueue *queue;
 };
 
@@ -66,7 +68,8 @@ static void *sender_thread(void *arg)
 
     av_log(NULL, AV_LOG_INFO, "sender #%d: workload=%d\n", wd->id, wd->workload);
     for (i = 0; i < wd->workload; i++) {
-        if (rand() % wd->workload < wd->workload / 10) {
+        /* only the receiver may flush a single producer/consumer queue */
+        if (!wd->spsc && rand() % wd->workload < wd->workload / 10) {
             av_log(NULL, AV_LOG_INFO, "sender #%d: flushing the queue\n", wd->id);
             av_thread_message_flush(wd->queue);
         } else {
@@ -135,18 +138,26 @@ static void *receiver_thread(void *arg)
                    av_thread_message_queue_nb_elems(rd->queue));
             av_thread_message_flush(rd->queue);
         } else {
-            struct message msg;
-            AVDictionary *meta;
-            AVDictionaryEntry *e;
-
-            ret = av_thread_message_queue_recv(rd->queue, &msg, 0);
-            if (ret < 0)
+            struct message msgs[4];
+            int j, nb_msgs = 1;
+
+            if (rd->spsc)
+                nb_msgs = av_thread_message_queue_recv_batch(rd->queue, msgs,
+                                                             FF_ARRAY_ELEMS(msgs), 0);
+            else
+                ret = av_thread_message_queue_recv(rd->queue, &msgs[0], 0);
+            if (ret < 0 || nb_msgs < 0) {
+                ret = FFMIN(ret, nb_msgs);
                 break;
-            av_assert0(msg.magic == MAGIC);
-            meta = msg.frame->metadata;
-            e = av_dict_get(meta, "sig", NULL, 0);
-            av_log(NULL, AV_LOG_INFO, "got \"%s\" (%p)\n", e->value, msg.frame);
-            av_frame_free(&msg.frame);
+            }
+            for (j = 0; j < nb_msgs; j++) {
+                AVDictionaryEntry *e;
+
+                av_assert0(msgs[j].magic == MAGIC);
+                e = av_dict_get(msgs[j].frame->metadata, "sig", NULL, 0);
+                av_log(NULL, AV_LOG_INFO, "got \"%s\" (%p)\n", e->value, msgs[j].frame);
+                av_frame_free(&msgs[j].frame);
+            }
         }
     }
 
@@ -167,14 +178,15 @@ int main(int ac, char **av)
     int max_queue_size;
     int nb_senders, sender_min_load, sender_max_load;
     int nb_receivers, receiver_min_load, receiver_max_load;
+    int spsc;
     struct sender_data *senders;
     struct receiver_data *receivers;
     AVThreadMessageQueue *queue = NULL;
 
-    if (ac != 8) {
+    if (ac != 8 && !(ac == 9 && !strcmp(av[8], "spsc"))) {
         av_log(NULL, AV_LOG_ERROR, "%s <max_queue_size> "
                "<nb_senders> <sender_min_send> <sender_max_send> "
-               "<nb_receivers> <receiver_min_recv> <receiver_max_recv>\n", av[0]);
+               "<nb_receivers> <receiver_min_recv> <receiver_max_recv> [spsc]\n", av[0]);
         return 1;
     }
 
@@ -185,6 +197,7 @@ int main(int ac, char **av)
     nb_receivers      = atoi(av[5]);
     receiver_min_load = atoi(av[6]);
     receiver_max_load = atoi(av[7]);
+    spsc              = ac == 9;
 
     if (max_queue_size <= 0 ||
         nb_senders <= 0 || sender_min_load <= 0 || sender_max_load <= 0 ||
@@ -192,6 +205,10 @@ int main(int ac, char **av)
         av_log(NULL, AV_LOG_ERROR, "negative values not allowed\n");
         return 1;
     }
+    if (spsc && (nb_senders != 1 || nb_receivers != 1)) {
+        av_log(NULL, AV_LOG_ERROR, "spsc requires one sender and one receiver\n");
+        return 1;
+    }
 
     av_log(NULL, AV_LOG_INFO, "qsize:%d / %d senders sending [%d-%d] / "
            "%d receivers receiving [%d-%d]\n", max_queue_size,
@@ -205,7 +222,8 @@ int main(int ac, char **av)
         goto end;
     }
 
-    ret = av_thread_message_queue_alloc(&queue, max_queue_size, sizeof(struct message));
+    ret = av_thread_message_queue_alloc2(&queue, max_queue_size, sizeof(struct message),
+                                         spsc ? AV_THREAD_MESSAGE_QUEUE_SPSC : 0);
     if (ret < 0)
         goto end;
 
@@ -216,6 +234,7 @@ int main(int ac, char **av)
         struct type##_data *td = &type##s[i];                                   \
                                                                                 \
         td->id = i;                                                             \
+        td->spsc = spsc;                                                        \
         td->queue = queue;                                                      \
         td->workload = get_workload(type##_min_load, type##_max_load);          \
                                                                                 \
@@ -0,0 +1,66 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/adler32.h"
+#include "libavutil/adler32_internal.h"
+#include "libavutil/mem_internal.h"
+
+#define BUF_SIZE 4096
+
+#define randomize_buffer(buf, size)          \
+    do {                                     \
+        int i;                               \
+        for (i = 0; i < size; i++)           \
+            buf[i] = rnd();                  \
+    } while (0)
+
+void checkasm_check_adler32(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [BUF_SIZE + 64]);
+    int i;
+
+    declare_func(AVAdler, AVAdler adler, const uint8_t *buf, size_t len);
+
+    if (check_func(ff_adler32_get_func(), "adler32_update")) {
+        for (i = 0; i < 16; i++) {
+            /* random lengths around the SIMD block sizes, at random
+             * alignments, with all bytes 0xff to get the largest sums */
+            size_t len = i < 4 ? FF_ADLER32_SIMD_MIN_LEN - 2 + i : rnd() % BUF_SIZE;
+            const uint8_t *src = buf + rnd() % 64;
+            AVAdler adler = rnd() % 65521 | (rnd() % 65521) << 16, ref, new;
+
+            if (i == 15)
+                memset(buf, 0xff, BUF_SIZE + 64);
+            else
+                randomize_buffer(buf, BUF_SIZE + 64);
+
+            ref = call_ref(adler, src, len);
+            new = call_new(adler, src, len);
+            if (ref != new) {
+                fprintf(stderr, "adler32: len %zu: %08x != %08x\n",
+                        len, (unsigned)ref, (unsigned)new);
+                fail();
+            }
+        }
+        bench_new(1, buf, BUF_SIZE);
+    }
+    report("adler32_update");
+}
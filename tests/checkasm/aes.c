@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/aes.h"
+#include "libavutil/aes_internal.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/mem_internal.h"
+
+#define BLOCKS 7 /* not a multiple of the SIMD block count */
+#define BUF_SIZE (BLOCKS * 16)
+
+#define randomize_buffer(buf, size)          \
+    do {                                     \
+        int i;                               \
+        for (i = 0; i < size; i++)           \
+            buf[i] = rnd();                  \
+    } while (0)
+
+static void check_crypt(AVAES *a, const uint8_t *src, int cbc)
+{
+    LOCAL_ALIGNED_16(uint8_t, ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, new, [BUF_SIZE]);
+    uint8_t iv[16], iv_ref[16], iv_new[16];
+
+    declare_func(void, AVAES *a, uint8_t *dst, const uint8_t *src,
+                 int count, uint8_t *iv, int rounds);
+
+    randomize_buffer(iv, 16);
+    memcpy(iv_ref, iv, 16);
+    memcpy(iv_new, iv, 16);
+
+    call_ref(a, ref, src, BLOCKS, cbc ? iv_ref : NULL, a->rounds);
+    call_new(a, new, src, BLOCKS, cbc ? iv_new : NULL, a->rounds);
+    if (memcmp(ref, new, BUF_SIZE) || memcmp(iv_ref, iv_new, 16))
+        fail();
+
+    /* in-place operation must give the same result */
+    memcpy(new, src, BUF_SIZE);
+    memcpy(iv_new, iv, 16);
+    call_new(a, new, new, BLOCKS, cbc ? iv_new : NULL, a->rounds);
+    if (memcmp(ref, new, BUF_SIZE) || memcmp(iv_ref, iv_new, 16))
+        fail();
+
+    bench_new(a, new, src, BLOCKS, cbc ? iv_new : NULL, a->rounds);
+}
+
+void checkasm_check_aes(void)
+{
+    LOCAL_ALIGNED_16(uint8_t, src, [BUF_SIZE]);
+    uint8_t key[32];
+    AVAES *a = av_aes_alloc();
+    int key_bits, decrypt, cbc;
+
+    if (!a)
+        return;
+
+    randomize_buffer(key, 32);
+    randomize_buffer(src, BUF_SIZE);
+
+    for (key_bits = 128; key_bits <= 256; key_bits += 64) {
+        for (decrypt = 0; decrypt <= 1; decrypt++) {
+            av_aes_init(a, key, key_bits, decrypt);
+            for (cbc = 0; cbc <= 1; cbc++) {
+                if (check_func(a->crypt, "aes_%s_%s_%d",
+                               decrypt ? "decrypt" : "encrypt",
+                               cbc ? "cbc" : "ecb", key_bits))
+                    check_crypt(a, src, cbc);
+            }
+        }
+    }
+    report("crypt");
+
+    av_free(a);
+}
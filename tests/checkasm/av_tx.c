@@ -16,6 +16,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <string.h>
+
 #include "libavutil/mem_internal.h"
 #include "libavutil/tx.h"
 #include "libavutil/error.h"
@@ -38,7 +40,7 @@
     } while (0)
 
 static const int check_lens[] = {
-    2, 4, 8, 16, 32, 64, 1024, 16384,
+    2, 4, 8, 16, 32, 40, 48, 64, 80, 96, 120, 480, 960, 1024, 16384,
 };
 
 #define CHECK_TEMPLATE(PREFIX, TYPE, DATA_TYPE, SCALE, LENGTHS, CHECK_EXPRESSION) \
@@ -83,6 +85,75 @@ static const int check_lens[] = {
             report(PREFIX);                                                       \
     } while (0)
 
+static const int check_lens_rdft[] = {
+    8, 16, 64, 480, 1024, 16384,
+};
+
+/* Includes the compound lengths used by AAC-LD/ELD and Opus, and
+ * 3 and 5 times a power of two ones */
+static const int check_lens_mdct[] = {
+    16, 48, 64, 80, 96, 120, 160, 240, 256, 480, 960, 1024, 1920, 2048,
+};
+
+/* Number of floats the input and output of real transforms of length len have */
+static void real_tx_size(enum AVTXType type, int inv, int len, int *nb_in, int *nb_out)
+{
+    if (type == AV_TX_FLOAT_RDFT) {
+        *nb_in  = inv ? len + 2 : len;
+        *nb_out = inv ? len     : len + 2;
+    } else {
+        *nb_in  = inv ? len : 2*len;
+        *nb_out = len;
+    }
+}
+
+static void check_real_float(void *in, void *tmp, void *out_ref, void *out_new,
+                             enum AVTXType type, const char *name, int inv,
+                             const int *lens, int nb_lens, float scale)
+{
+    int num_checks = 0, last_check = 0;
+    AVTXContext *tx;
+    av_tx_fn fn;
+    int err;
+
+    declare_func(void, AVTXContext *tx, void *out, void *in, ptrdiff_t stride);
+
+    for (int i = 0; i < nb_lens; i++) {
+        int len = lens[i], nb_in, nb_out;
+
+        if ((err = av_tx_init(&tx, &fn, type, inv, len, &scale, 0x0)) < 0) {
+            fprintf(stderr, "av_tx: %s\n", av_err2str(err));
+            return;
+        }
+        real_tx_size(type, inv, len, &nb_in, &nb_out);
+
+        if (check_func(fn, "%s_%i", name, len)) {
+            /* the inverse RDFT overwrites its input */
+            num_checks++;
+            last_check = len;
+            memcpy(tmp, in, nb_in * sizeof(float));
+            call_ref(tx, out_ref, tmp, sizeof(float));
+            memcpy(tmp, in, nb_in * sizeof(float));
+            call_new(tx, out_new, tmp, sizeof(float));
+            if (!float_near_abs_eps_array(out_ref, out_new, EPS, nb_out)) {
+                fail();
+                break;
+            }
+            memcpy(tmp, in, nb_in * sizeof(float));
+            bench_new(tx, out_new, tmp, sizeof(float));
+        }
+
+        av_tx_uninit(&tx);
+    }
+
+    av_tx_uninit(&tx);
+
+    if (num_checks == 1)
+        report("%s_%i", name, last_check);
+    else if (num_checks)
+        report("%s", name);
+}
+
 void checkasm_check_av_tx(void)
 {
     const float scale_float = 1.0f;
@@ -93,6 +164,7 @@ void checkasm_check_av_tx(void)
     void *in      = av_malloc(16384*2*8);
     void *out_ref = av_malloc(16384*2*8);
     void *out_new = av_malloc(16384*2*8);
+    void *tmp     = av_malloc(16384*2*8);
 
     randomize_complex(in, 16384, AVComplexFloat, SCALE_NOOP);
     CHECK_TEMPLATE("float_fft", AV_TX_FLOAT_FFT, AVComplexFloat, scale_float, check_lens,
@@ -102,7 +174,18 @@ void checkasm_check_av_tx(void)
     CHECK_TEMPLATE("double_fft", AV_TX_DOUBLE_FFT, AVComplexDouble, scale_double, check_lens,
                    !double_near_abs_eps_array(out_ref, out_new, EPS, len*2));
 
+    randomize_complex(in, 16384, AVComplexFloat, SCALE_NOOP);
+    check_real_float(in, tmp, out_ref, out_new, AV_TX_FLOAT_RDFT, "float_rdft_r2c", 0,
+                     check_lens_rdft, FF_ARRAY_ELEMS(check_lens_rdft), 1.0f);
+    check_real_float(in, tmp, out_ref, out_new, AV_TX_FLOAT_RDFT, "float_rdft_c2r", 1,
+                     check_lens_rdft, FF_ARRAY_ELEMS(check_lens_rdft), 1.0f);
+    check_real_float(in, tmp, out_ref, out_new, AV_TX_FLOAT_MDCT, "float_mdct", 0,
+                     check_lens_mdct, FF_ARRAY_ELEMS(check_lens_mdct), 1.0f / 1024);
+    check_real_float(in, tmp, out_ref, out_new, AV_TX_FLOAT_MDCT, "float_imdct", 1,
+                     check_lens_mdct, FF_ARRAY_ELEMS(check_lens_mdct), 1.0f / 1024);
+
     av_free(in);
+    av_free(tmp);
     av_free(out_ref);
     av_free(out_new);
 }
@@ -0,0 +1,79 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/crc.h"
+#include "libavutil/crc_internal.h"
+#include "libavutil/mem_internal.h"
+
+#define BUF_SIZE 4096
+
+#define randomize_buffer(buf, size)          \
+    do {                                     \
+        int i;                               \
+        for (i = 0; i < size; i++)           \
+            buf[i] = rnd();                  \
+    } while (0)
+
+static const char *const crc_names[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = "8_atm",
+    [AV_CRC_16_ANSI]    = "16_ansi",
+    [AV_CRC_16_CCITT]   = "16_ccitt",
+    [AV_CRC_32_IEEE]    = "32_ieee",
+    [AV_CRC_32_IEEE_LE] = "32_ieee_le",
+    [AV_CRC_16_ANSI_LE] = "16_ansi_le",
+    [AV_CRC_24_IEEE]    = "24_ieee",
+    [AV_CRC_8_EBU]      = "8_ebu",
+};
+
+void checkasm_check_crc(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [BUF_SIZE + 64]);
+    int id, i;
+
+    declare_func(uint32_t, const AVCRC *ctx, uint32_t crc,
+                 const uint8_t *buffer, size_t length);
+
+    randomize_buffer(buf, BUF_SIZE + 64);
+
+    for (id = 0; id < AV_CRC_MAX; id++) {
+        const AVCRC *ctx = av_crc_get_table(id);
+
+        if (check_func(ff_crc_get_func(id), "crc_%s", crc_names[id])) {
+            for (i = 0; i < 16; i++) {
+                /* random lengths around the SIMD block sizes, at random
+                 * alignments */
+                size_t len = i < 4 ? FF_CRC_SIMD_MIN_LEN - 2 + i : rnd() % BUF_SIZE;
+                const uint8_t *src = buf + rnd() % 64;
+                uint32_t crc = rnd(), ref, new;
+
+                ref = call_ref(ctx, crc, src, len);
+                new = call_new(ctx, crc, src, len);
+                if (ref != new) {
+                    fprintf(stderr, "crc %s: len %zu: %08x != %08x\n",
+                            crc_names[id], len, ref, new);
+                    fail();
+                }
+            }
+            bench_new(ctx, 0, buf, BUF_SIZE);
+        }
+    }
+    report("crc");
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/mem.h"
+#include "libavutil/mem_internal.h"
+#include "libavutil/sha.h"
+#include "libavutil/sha_internal.h"
+
+#define BLOCKS 4
+
+#define randomize_buffer(buf, size)          \
+    do {                                     \
+        int i;                               \
+        for (i = 0; i < size; i++)           \
+            buf[i] = rnd();                  \
+    } while (0)
+
+void checkasm_check_sha(void)
+{
+    LOCAL_ALIGNED_16(uint8_t, buf, [BLOCKS * 64 + 16]);
+    uint32_t state_ref[8], state_new[8];
+    AVSHA *ctx = av_sha_alloc();
+    int bits, i;
+
+    declare_func(void, uint32_t *state, const uint8_t buffer[64]);
+
+    if (!ctx)
+        return;
+
+    randomize_buffer(buf, BLOCKS * 64 + 16);
+
+    for (bits = 160; bits <= 256; bits += 96) {
+        av_sha_init(ctx, bits);
+        if (check_func(ctx->transform, "sha%d", bits == 160 ? 1 : 256)) {
+            /* several blocks in a row, at random alignments */
+            memcpy(state_ref, ctx->state, sizeof(state_ref));
+            memcpy(state_new, ctx->state, sizeof(state_new));
+            for (i = 0; i < BLOCKS; i++) {
+                const uint8_t *src = buf + i * 64 + rnd() % 16;
+
+                call_ref(state_ref, src);
+                call_new(state_new, src);
+                if (memcmp(state_ref, state_new, sizeof(state_ref)))
+                    fail();
+            }
+            bench_new(state_new, buf);
+        }
+    }
+    report("transform");
+
+    av_free(ctx);
+}
@@ -181,6 +181,14 @@ fmtstdout(){
     ffmpeg -bitexact "$@" -f $fmt -
 }
 
+stage_stats(){
+    progfile="${outdir}/${test}.progress"
+    cleanfiles="$cleanfiles $progfile"
+    ffmpeg "$@" -stage_stats -progress $(target_path $progfile) -f null - || return
+    # the times differ from run to run, only keep the last report without them
+    sed -n 's/_us":[0-9]*/_us":T/g; s/^stage_stats=//p' $progfile | tail -n 1
+}
+
 enc_dec_pcm(){
     out_fmt=$1
     dec_fmt=$2
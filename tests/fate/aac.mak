@@ -232,6 +232,19 @@ fate-aac-pred-encode: CMP_TARGET = 662
 fate-aac-pred-encode: FUZZ = 12
 fate-aac-pred-encode: SIZE_TOLERANCE = 3560
 
+# Multichannel encodes, with and without slice threads, must be identical.
+FATE_AAC_ENCODE_51 += fate-aac-51-encode
+fate-aac-51-encode: CMD = framecrc -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -af aresample -c:a aac -flags +bitexact
+
+FATE_AAC_ENCODE_51 += fate-aac-51-encode-threads
+fate-aac-51-encode-threads: CMD = framecrc -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -af aresample -c:a aac -flags +bitexact -threads 4 -thread_type slice
+fate-aac-51-encode-threads: REF = $(SRC_PATH)/tests/ref/fate/aac-51-encode
+
+FATE_AAC_ENCODE_51 += fate-aac-51-pred-encode-threads
+fate-aac-51-pred-encode-threads: CMD = framecrc -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -af aresample -c:a aac -profile:a aac_main -flags +bitexact -threads 4 -thread_type slice -t 1
+
+$(FATE_AAC_ENCODE_51): tests/data/asynth-44100-6.wav
+
 FATE_AAC_LATM += fate-aac-latm_000000001180bc60
 fate-aac-latm_000000001180bc60: CMD = pcm -i $(TARGET_SAMPLES)/aac/latm_000000001180bc60.mpg
 fate-aac-latm_000000001180bc60: REF = $(SAMPLES)/aac/latm_000000001180bc60.s16
@@ -255,9 +268,12 @@ $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE)
 
+FATE_AAC_ENCODE_51-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER ARESAMPLE_FILTER AAC_ENCODER FRAMECRC_MUXER) += $(FATE_AAC_ENCODE_51)
+
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_51-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes) $(FATE_AAC_ENCODE_51-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
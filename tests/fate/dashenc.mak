@@ -0,0 +1,20 @@
+tests/data/dash_segments.mpd: TAG = GEN
+tests/data/dash_segments.mpd: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -map 0 -codec:a mp2fixed \
+        -flags +bitexact -fflags +bitexact -seg_duration 2 \
+        -init_seg_name 'dash_segments_init_$$RepresentationID$$.m4s' \
+        -media_seg_name 'dash_segments_$$RepresentationID$$_$$Number%05d$$.m4s' \
+        -f dash $(TARGET_PATH)/tests/data/dash_segments.mpd 2>/dev/null
+
+FATE_DASHENC-$(call ALLYES, DASH_MUXER DASH_DEMUXER MP4_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER FRAMECRC_MUXER) += fate-dash-segments
+fate-dash-segments: tests/data/dash_segments.mpd
+fate-dash-segments: CMD = framecrc -i $(TARGET_PATH)/tests/data/dash_segments.mpd -c copy
+
+FATE_DASHENC-$(call ALLYES, DASH_MUXER DASH_DEMUXER MP4_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER FRAMECRC_MUXER) += fate-dash-prefetch
+fate-dash-prefetch: tests/data/dash_segments.mpd
+fate-dash-prefetch: CMD = framecrc -prefetch_segments 3 -prefetch_size 100000 -i $(TARGET_PATH)/tests/data/dash_segments.mpd -c copy
+fate-dash-prefetch: REF = $(SRC_PATH)/tests/ref/fate/dash-segments
+
+FATE_FFMPEG += $(FATE_DASHENC-yes)
+fate-dashenc: $(FATE_DASHENC-yes)
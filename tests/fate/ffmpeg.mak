@@ -41,6 +41,15 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+FATE_FFMPEG-$(if $(HAVE_THREADS),$(call ALLYES, TESTSRC_FILTER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER NEGATE_FILTER HSTACK_FILTER)) += fate-ffmpeg-filter-complex-parallel
+fate-ffmpeg-filter-complex-parallel: CMD = framecrc -filter_complex_parallel -filter_complex_threads 4 \
+  -lavfi "testsrc=d=1:r=5:s=64x48,split=3[a][b][c];[a]hflip[a1];[b]vflip[b1];[c]negate[c1];[a1][b1][c1]hstack=3" \
+  -fflags +bitexact
+
+FATE_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER SCALE_FILTER RAWVIDEO_ENCODER PCM_S16LE_ENCODER NULL_MUXER) += fate-ffmpeg-stage-stats
+fate-ffmpeg-stage-stats: CMD = stage_stats -f lavfi -i "testsrc2=d=1:r=10:s=64x64[out0];sine=d=1[out1]" \
+  -vf scale=32x32 -c:v rawvideo -c:a pcm_s16le
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -102,6 +111,66 @@ fate-copy-trac4914: $(SAMPLES)/mpeg2/xdcam8mp2-1s_small.ts
 fate-copy-trac4914: CMD = transcode mpegts $(TARGET_SAMPLES)/mpeg2/xdcam8mp2-1s_small.ts\
                       mxf "-c:a pcm_s16le -af aresample -c:v copy"
 
+FATE_FFMPEG-$(if $(HAVE_THREADS),$(call ENCDEC2, MPEG4, MP2, MATROSKA)) += fate-ffmpeg-parallel-chunks
+fate-ffmpeg-parallel-chunks: fate-lavf-mkv
+fate-ffmpeg-parallel-chunks: CMD = framecrc -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv \
+  -map 0:v -c:v mpeg4 -qscale 2 -g 100 -parallel_chunks 3
+
+tests/data/parallel_chunks.mkv: TAG = GEN
+tests/data/parallel_chunks.mkv: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc=d=8:s=176x144:r=25" -c:v mpeg4 -qscale 4 -g 25 \
+        -flags +bitexact -fflags +bitexact -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# the packet queues of the chunks must not grow beyond -chunk_queue_size
+FATE_FFMPEG-$(if $(HAVE_THREADS),$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MATROSKA_MUXER MATROSKA_DEMUXER MPEG4_DECODER MPEG4_ENCODER FRAMECRC_MUXER)) += fate-ffmpeg-parallel-chunks-queue
+fate-ffmpeg-parallel-chunks-queue: tests/data/parallel_chunks.mkv
+fate-ffmpeg-parallel-chunks-queue: CMD = framecrc -v verbose -i $(TARGET_PATH)/tests/data/parallel_chunks.mkv \
+  -map 0:v -c:v mpeg4 -qscale 2 -parallel_chunks 4 -chunk_queue_size 2
+fate-ffmpeg-parallel-chunks-queue: CMP = grep
+fate-ffmpeg-parallel-chunks-queue: REF = at most [12] input and [12] output packets queued per chunk
+
+FATE_FFMPEG-$(call ALLYES, MATROSKA_DEMUXER MPEG4_DECODER MP2_DECODER ARESAMPLE_FILTER MPEG4_ENCODER MP2_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-enc-serial
+fate-ffmpeg-enc-serial: fate-lavf-mkv
+fate-ffmpeg-enc-serial: CMD = framecrc -flags +bitexact -idct simple -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv \
+  -map 0 -c:v mpeg4 -qscale 2 -c:a mp2 -af aresample
+
+# encoding in separate threads must give the same output as above
+FATE_FFMPEG-$(if $(HAVE_THREADS),$(call ALLYES, MATROSKA_DEMUXER MPEG4_DECODER MP2_DECODER ARESAMPLE_FILTER MPEG4_ENCODER MP2_ENCODER FRAMECRC_MUXER)) += fate-ffmpeg-enc-thread-queue
+fate-ffmpeg-enc-thread-queue: fate-lavf-mkv
+fate-ffmpeg-enc-thread-queue: CMD = framecrc -flags +bitexact -idct simple -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv \
+  -map 0 -c:v mpeg4 -qscale 2 -c:a mp2 -af aresample -enc_thread_queue_size 2
+fate-ffmpeg-enc-thread-queue: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-enc-serial
+
+# and so must decoding and filtering in separate threads
+FATE_FFMPEG-$(if $(HAVE_THREADS),$(call ALLYES, MATROSKA_DEMUXER MPEG4_DECODER MP2_DECODER ARESAMPLE_FILTER MPEG4_ENCODER MP2_ENCODER FRAMECRC_MUXER)) += fate-ffmpeg-stage-thread-queue
+fate-ffmpeg-stage-thread-queue: fate-lavf-mkv
+fate-ffmpeg-stage-thread-queue: CMD = framecrc -flags +bitexact -idct simple -dec_thread_queue_size 2 -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv \
+  -map 0 -c:v mpeg4 -qscale 2 -c:a mp2 -af aresample -filter_thread_queue_size 2 -enc_thread_queue_size 2
+fate-ffmpeg-stage-thread-queue: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-enc-serial
+
+# mjpeg slice threaded encoding writes a restart marker after every MCU row
+FATE_FFMPEG-$(call ENCDEC, MJPEG, AVI) += fate-mjpeg-restart-markers
+fate-mjpeg-restart-markers: tests/data/vsynth1.yuv
+fate-mjpeg-restart-markers: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv \
+  avi "-c:v mjpeg -strict -1 -qscale 9 -threads 4 -thread_type slice" "-frames:v 10" -keep
+
+# decode the restart markers with slice threads, must match the reference above
+FATE_FFMPEG-$(call ENCDEC, MJPEG, AVI) += fate-mjpeg-restart-markers-slice
+fate-mjpeg-restart-markers-slice: fate-mjpeg-restart-markers
+fate-mjpeg-restart-markers-slice: THREADS = 4
+fate-mjpeg-restart-markers-slice: THREAD_TYPE = slice
+fate-mjpeg-restart-markers-slice: CMD = framecrc -idct simple -flags +bitexact \
+  -i $(TARGET_PATH)/tests/data/fate/mjpeg-restart-markers.avi -frames:v 10
+
+FATE_FFMPEG-$(call ALLYES, MATROSKA_MUXER MATROSKA_DEMUXER MPEG4_ENCODER MPEG4_DECODER \
+                          SCALE_FILTER SPLIT_FILTER RAWVIDEO_ENCODER) += fate-ffmpeg-scale-ladder
+fate-ffmpeg-scale-ladder: fate-lavf-mkv
+fate-ffmpeg-scale-ladder: CMD = framecrc -scale_ladder -flags +bitexact -idct simple \
+  -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv \
+  -map 0:v -s 176x144 -sws_flags +accurate_rnd+bitexact -f null - \
+  -map 0:v -s 88x72 -sws_flags +accurate_rnd+bitexact -c:v rawvideo
+
 FATE_STREAMCOPY-$(call ALLYES, MPEGTS_DEMUXER AVI_MUXER) += fate-copy-trac4914-avi
 fate-copy-trac4914-avi: $(SAMPLES)/mpeg2/xdcam8mp2-1s_small.ts
 fate-copy-trac4914-avi: CMD = transcode mpegts $(TARGET_SAMPLES)/mpeg2/xdcam8mp2-1s_small.ts\
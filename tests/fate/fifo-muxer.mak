@@ -13,7 +13,11 @@ FATE_SAMPLES_FIFO_MUXER-$(call ALLYES, FIFO_MUXER, WAV_DEMUXER) += fate-fifo-mux
 
 fate-fifo-muxer-tst: libavformat/tests/fifo_muxer$(EXESUF)
 fate-fifo-muxer-tst: CMD = run libavformat/tests/fifo_muxer$(EXESUF)
-FATE_FIFO_MUXER-$(call ALLYES, FIFO_MUXER NETWORK) += fate-fifo-muxer-tst
+FATE_FIFO_MUXER-$(call ALLYES, FIFO_MUXER TEE_MUXER NETWORK) += fate-fifo-muxer-tst
+
+fate-fifo-muxer-tee: CMD = ffmpeg -lavfi testsrc=d=1:r=5:s=64x48 -c:v rawvideo -flags +bitexact\
+                           -fflags +bitexact -f tee "[f=framecrc:onfull=block]pipe:|[f=null:onfull=drop]-"
+FATE_FIFO_MUXER-$(call ALLYES, FIFO_MUXER TEE_MUXER FRAMECRC_MUXER NULL_MUXER TESTSRC_FILTER RAWVIDEO_ENCODER PIPE_PROTOCOL) += fate-fifo-muxer-tee
 
 FATE_SAMPLES_FFMPEG += $(FATE_SAMPLES_FIFO_MUXER-yes)
 FATE_FFMPEG += $(FATE_FIFO_MUXER-yes)
@@ -134,4 +134,78 @@ fate-mov-cover-image: CMD = transcode mov $(TARGET_SAMPLES)/cover_art/Owner-iTun
 
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MOV_FFMPEG_FFPROBE-yes)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG_FFPROBE-yes)
+# more samples than a moov reserved for a 1 second duration can hold
+tests/data/mov-mpeg4-long.nut: TAG = GEN
+tests/data/mov-mpeg4-long.nut: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc2=d=50:r=100:s=16x16 -c:v mpeg4 -g 12 -threads 1 -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MOVENC_FFMPEG_FFPROBE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER MPEG4_ENCODER NUT_MUXER \
+                                          NUT_DEMUXER MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER) \
+                             += fate-mov-reserve-moov-fallback
+fate-mov-reserve-moov-fallback: tests/data/mov-mpeg4-long.nut
+fate-mov-reserve-moov-fallback: CMD = transcode nut tests/data/mov-mpeg4-long.nut mov "-c copy -movflags +reserve_moov -moov_duration 1" "-c copy -t 0.1" "" "-show_entries format=duration:stream=nb_frames"
+
+FATE_FFMPEG_FFPROBE += $(FATE_MOVENC_FFMPEG_FFPROBE-yes)
+
+# without edit list, so that the 5000 samples are indexed on demand
+tests/data/mov-lazy-index.mp4: TAG = GEN
+tests/data/mov-lazy-index.mp4: tests/data/mov-mpeg4-long.nut ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/ffmpeg$(PROGSSUF)$(EXESUF) -nostdin \
+        -i $(TARGET_PATH)/$< -c copy -use_editlist 0 -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MOV_LAZY_INDEX = fate-mov-lazy-index-0 fate-mov-lazy-index-1 \
+                      fate-mov-lazy-index-ss                      \
+                      fate-mov-lazy-index-seek-0 fate-mov-lazy-index-seek-1
+FATE_MOV_LAZY_INDEX-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER MPEG4_ENCODER NUT_MUXER NUT_DEMUXER \
+                                   MP4_MUXER MOV_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL MD5_PROTOCOL) \
+                      += $(FATE_MOV_LAZY_INDEX)
+$(FATE_MOV_LAZY_INDEX): tests/data/mov-lazy-index.mp4
+
+# the index entries built on demand must match the full index
+fate-mov-lazy-index-0 fate-mov-lazy-index-1: CMD = md5pipe -lazy_index $(subst fate-mov-lazy-index-,,$@) -i $(TARGET_PATH)/tests/data/mov-lazy-index.mp4 -c copy -f framecrc
+fate-mov-lazy-index-0 fate-mov-lazy-index-1: CMP = oneline
+fate-mov-lazy-index-0 fate-mov-lazy-index-1: REF = 0fa313f2556564696e8f333c92e9c24b
+
+fate-mov-lazy-index-ss: CMD = framecrc -lazy_index 1 -ss 45 -i $(TARGET_PATH)/tests/data/mov-lazy-index.mp4 -c copy -t 0.1
+
+fate-mov-lazy-index-seek-0 fate-mov-lazy-index-seek-1: libavformat/tests/seek$(EXESUF)
+fate-mov-lazy-index-seek-0 fate-mov-lazy-index-seek-1: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov-lazy-index.mp4 -duration 50 -lazy_index $(subst fate-mov-lazy-index-seek-,,$@)
+fate-mov-lazy-index-seek-0 fate-mov-lazy-index-seek-1: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-seek
+
+# B-frames and mp2 encoder delay, then cut out of a GOP: the tracks get an
+# empty edit and an edit starting inside a frame
+tests/data/mov-lazy-index-edit.mp4: TAG = GEN
+tests/data/mov-lazy-index-edit.mp4: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc2=d=100:r=100:s=16x16 -f lavfi -i sine=d=100 \
+        -c:v mpeg4 -bf 2 -g 12 -c:a mp2 -ar 48000 -threads 1 -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@.tmp.mp4 2>/dev/null
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -ss 7.3 -i $(TARGET_PATH)/$@.tmp.mp4 -c copy -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MOV_LAZY_INDEX_EDIT = fate-mov-lazy-index-edit-0 fate-mov-lazy-index-edit-1 \
+                           fate-mov-lazy-index-edit-ss                           \
+                           fate-mov-lazy-index-edit-seek-0 fate-mov-lazy-index-edit-seek-1
+FATE_MOV_LAZY_INDEX-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER MPEG4_ENCODER MP2_ENCODER \
+                                   MP4_MUXER MOV_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL MD5_PROTOCOL) \
+                      += $(FATE_MOV_LAZY_INDEX_EDIT)
+$(FATE_MOV_LAZY_INDEX_EDIT): tests/data/mov-lazy-index-edit.mp4
+
+# the edit list applied on the fly must give the same packets as mov_fix_index()
+fate-mov-lazy-index-edit-0 fate-mov-lazy-index-edit-1: CMD = md5pipe -lazy_index $(subst fate-mov-lazy-index-edit-,,$@) -i $(TARGET_PATH)/tests/data/mov-lazy-index-edit.mp4 -c copy -f framecrc
+fate-mov-lazy-index-edit-0 fate-mov-lazy-index-edit-1: CMP = oneline
+fate-mov-lazy-index-edit-0 fate-mov-lazy-index-edit-1: REF = 69aaadedbe8f7240fa16fc5cd87fd9e1
+
+fate-mov-lazy-index-edit-ss: CMD = framecrc -lazy_index 1 -ss 45 -i $(TARGET_PATH)/tests/data/mov-lazy-index-edit.mp4 -c copy -t 0.1
+
+fate-mov-lazy-index-edit-seek-0 fate-mov-lazy-index-edit-seek-1: libavformat/tests/seek$(EXESUF)
+fate-mov-lazy-index-edit-seek-0 fate-mov-lazy-index-edit-seek-1: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov-lazy-index-edit.mp4 -duration 100 -lazy_index $(subst fate-mov-lazy-index-edit-seek-,,$@)
+fate-mov-lazy-index-edit-seek-0 fate-mov-lazy-index-edit-seek-1: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-edit-seek
+
+FATE_FFMPEG += $(FATE_MOV_LAZY_INDEX-yes)
+
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG_FFPROBE-yes) $(FATE_MOVENC_FFMPEG_FFPROBE-yes) $(FATE_MOV_LAZY_INDEX-yes)